@@ -0,0 +1,263 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "binary-trace.h"
+#include "ns3/log.h"
+#include "ns3/system-mutex.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <unordered_set>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("BinaryTrace");
+
+namespace {
+
+/* Traces currently open in this process */
+std::map<std::string, BinaryTrace *> g_openTraces;
+/* Guards g_openTraces */
+SystemMutex g_openTracesMutex;
+
+const char INDEX_MAGIC[8] = {'N', 'S', '3', 'T', 'I', 'D', 'X', '2'};
+
+struct index_header
+{
+  char magic[8];
+  uint64_t trace_size;
+  int64_t trace_mtime;
+  uint64_t records;
+  uint64_t prefix_count;
+};
+
+} // anonymous namespace
+
+Ptr<BinaryTrace>
+BinaryTrace::Open (const std::string &path)
+{
+  {
+    CriticalSection cs (g_openTracesMutex);
+    auto it = g_openTraces.find (path);
+    /* A trace whose last reference is being released is opened again */
+    if (it != g_openTraces.end () && it->second->GetReferenceCount () > 0)
+      {
+        return Ptr<BinaryTrace> (it->second);
+      }
+  }
+
+  /* Mapped and indexed without the lock, the destructor of a trace
+     which can not be opened takes it */
+  Ptr<BinaryTrace> trace = Ptr<BinaryTrace> (new BinaryTrace (path), false);
+  if (!trace->Map ())
+    {
+      return 0;
+    }
+
+  std::string indexPath = path + ".idx";
+  if (!trace->LoadIndex (indexPath))
+    {
+      NS_LOG_INFO ("Building index for " << path);
+      trace->BuildIndex ();
+      trace->SaveIndex (indexPath);
+    }
+
+  Ptr<BinaryTrace> shared = trace;
+  {
+    CriticalSection cs (g_openTracesMutex);
+    auto it = g_openTraces.find (path);
+    if (it != g_openTraces.end () && it->second->GetReferenceCount () > 0)
+      {
+        /* Opened by another thread meanwhile */
+        shared = Ptr<BinaryTrace> (it->second);
+      }
+    else
+      {
+        g_openTraces[path] = PeekPointer (trace);
+      }
+  }
+  return shared;
+}
+
+BinaryTrace::BinaryTrace (const std::string &path)
+  : m_path (path),
+    m_data (0),
+    m_size (0),
+    m_mtime (0),
+    m_records (0)
+{
+}
+
+BinaryTrace::~BinaryTrace ()
+{
+  {
+    CriticalSection cs (g_openTracesMutex);
+    auto it = g_openTraces.find (m_path);
+    if (it != g_openTraces.end () && it->second == this)
+      {
+        g_openTraces.erase (it);
+      }
+  }
+  Unmap ();
+}
+
+bool
+BinaryTrace::Map (void)
+{
+  int fd = open (m_path.c_str (), O_RDONLY);
+  if (fd < 0)
+    {
+      return false;
+    }
+
+  struct stat st;
+  if (fstat (fd, &st) != 0)
+    {
+      close (fd);
+      return false;
+    }
+  m_size = st.st_size;
+  m_mtime = int64_t (st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+  /* A trailing partial record is ignored */
+  m_records = m_size / RECORD_SIZE;
+
+  if (m_size > 0)
+    {
+      void *data = mmap (0, m_size, PROT_READ, MAP_SHARED, fd, 0);
+      if (data == MAP_FAILED)
+        {
+          close (fd);
+          return false;
+        }
+      /* Records are replayed in order */
+      madvise (data, m_size, MADV_SEQUENTIAL);
+      m_data = static_cast<const uint8_t *> (data);
+    }
+  /* The mapping stays valid after closing the descriptor */
+  close (fd);
+  return true;
+}
+
+void
+BinaryTrace::Unmap (void)
+{
+  if (m_data)
+    {
+      munmap (const_cast<uint8_t *> (m_data), m_size);
+      m_data = 0;
+    }
+}
+
+bool
+BinaryTrace::LoadIndex (const std::string &indexPath)
+{
+  FILE *file = std::fopen (indexPath.c_str (), "rb");
+  if (!file)
+    {
+      return false;
+    }
+
+  index_header header;
+  bool valid = std::fread (&header, sizeof (header), 1, file) == 1
+    && std::memcmp (header.magic, INDEX_MAGIC, sizeof (INDEX_MAGIC)) == 0
+    && header.trace_size == m_size
+    && header.trace_mtime == m_mtime
+    && header.records == m_records;
+
+  if (valid)
+    {
+      m_prefixes.resize (header.prefix_count);
+      valid = std::fread (m_prefixes.data (), sizeof (uint32_t), m_prefixes.size (), file)
+        == m_prefixes.size ();
+    }
+  std::fclose (file);
+
+  if (!valid)
+    {
+      NS_LOG_INFO ("Stale or corrupted index " << indexPath);
+      m_prefixes.clear ();
+    }
+  return valid;
+}
+
+void
+BinaryTrace::BuildIndex (void)
+{
+  std::unordered_set<uint32_t> prefixes;
+  for (uint64_t i = 0; i < m_records; i++)
+    {
+      prefixes.insert (GetRecord (i).dst & 0xffffff00);
+    }
+
+  m_prefixes.assign (prefixes.begin (), prefixes.end ());
+  std::sort (m_prefixes.begin (), m_prefixes.end ());
+}
+
+void
+BinaryTrace::SaveIndex (const std::string &indexPath) const
+{
+  /* Written to a temporary file and renamed so that concurrent
+     simulations never read a half written index */
+  std::string tmpPath = indexPath + "." + std::to_string (getpid ());
+  FILE *file = std::fopen (tmpPath.c_str (), "wb");
+  if (!file)
+    {
+      NS_LOG_INFO ("Can not write index " << indexPath << ", keeping it in memory");
+      return;
+    }
+
+  index_header header;
+  std::memcpy (header.magic, INDEX_MAGIC, sizeof (INDEX_MAGIC));
+  header.trace_size = m_size;
+  header.trace_mtime = m_mtime;
+  header.records = m_records;
+  header.prefix_count = m_prefixes.size ();
+
+  bool ok = std::fwrite (&header, sizeof (header), 1, file) == 1
+    && std::fwrite (m_prefixes.data (), sizeof (uint32_t), m_prefixes.size (), file)
+    == m_prefixes.size ();
+  ok = (std::fclose (file) == 0) && ok;
+
+  if (!ok || std::rename (tmpPath.c_str (), indexPath.c_str ()) != 0)
+    {
+      NS_LOG_INFO ("Can not write index " << indexPath << ", keeping it in memory");
+      std::remove (tmpPath.c_str ());
+    }
+}
+
+const std::string &
+BinaryTrace::GetPath (void) const
+{
+  return m_path;
+}
+
+uint64_t
+BinaryTrace::GetRecordCount (void) const
+{
+  return m_records;
+}
+
+const std::vector<uint32_t> &
+BinaryTrace::GetPrefixes (void) const
+{
+  return m_prefixes;
+}
+
+uint32_t
+BinaryTrace::GetPrefixCount (void) const
+{
+  return m_prefixes.size ();
+}
+
+bool
+BinaryTrace::HasPrefix (uint32_t prefix) const
+{
+  return std::binary_search (m_prefixes.begin (), m_prefixes.end (), prefix);
+}
+
+} // namespace ns3
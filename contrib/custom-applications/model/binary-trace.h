@@ -0,0 +1,93 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#ifndef BINARY_TRACE_H
+#define BINARY_TRACE_H
+
+#include "ns3/ptr.h"
+#include "ns3/simple-ref-count.h"
+
+#include <string>
+#include <vector>
+#include <cstring>
+
+namespace ns3 {
+
+/**
+ * One record of a binary trace. On disk records are packed in 14 bytes
+ * (ts, dst, size) in host byte order.
+ */
+struct packet
+{
+  uint64_t ts = 0;
+  uint32_t dst = 0;
+  uint16_t size = 0;
+};
+
+/**
+ * \ingroup applications
+ *
+ * Read only view of a binary trace (.bin) file. The file is memory mapped,
+ * so all the senders of a process share a single instance (see Open) and
+ * parallel simulations replaying the same slice share the page cache
+ * instead of holding one copy each.
+ *
+ * Next to the trace a small side index (<trace>.idx) stores the number of
+ * records and the sorted set of /24 destination prefixes. It is built with
+ * one pass the first time a trace is opened and reused while the trace
+ * size and modification time match. If it can not be written the index is
+ * only kept in memory.
+ *
+ * Open may be called by several threads. The last reference of a trace
+ * must not be released while another thread opens the same path.
+ */
+class BinaryTrace : public SimpleRefCount<BinaryTrace>
+{
+public:
+  static const uint32_t RECORD_SIZE = 14;
+
+  /* Returns the shared trace for path, or 0 if it can not be opened */
+  static Ptr<BinaryTrace> Open (const std::string &path);
+
+  ~BinaryTrace ();
+
+  const std::string &GetPath (void) const;
+  uint64_t GetRecordCount (void) const;
+
+  packet
+  GetRecord (uint64_t index) const
+  {
+    const uint8_t *record = m_data + index * RECORD_SIZE;
+    packet p;
+    std::memcpy (&p.ts, record, sizeof (p.ts));
+    std::memcpy (&p.dst, record + 8, sizeof (p.dst));
+    std::memcpy (&p.size, record + 12, sizeof (p.size));
+    return p;
+  }
+
+  /* Distinct /24 destination prefixes, sorted */
+  const std::vector<uint32_t> &GetPrefixes (void) const;
+  uint32_t GetPrefixCount (void) const;
+  bool HasPrefix (uint32_t prefix) const;
+
+private:
+  BinaryTrace (const std::string &path);
+
+  bool Map (void);
+  void Unmap (void);
+  bool LoadIndex (const std::string &indexPath);
+  void BuildIndex (void);
+  void SaveIndex (const std::string &indexPath) const;
+
+  std::string m_path;
+  const uint8_t *m_data;
+  uint64_t m_size;
+  int64_t m_mtime;
+  uint64_t m_records;
+
+  /* Side index */
+  std::vector<uint32_t> m_prefixes;
+};
+
+} // namespace ns3
+
+#endif /* BINARY_TRACE_H */
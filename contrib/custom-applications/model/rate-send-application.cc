@@ -158,6 +158,7 @@ RateSendApplication::DoDispose (void)
   NS_LOG_FUNCTION (this);
 
   m_socket = 0;
+  m_finishedCallback = MakeNullCallback<void, Ptr<RateSendApplication> > ();
   // chain up
   Application::DoDispose ();
 }
@@ -174,6 +175,27 @@ void RateSendApplication::SetSocket(Ptr<Socket> s){
 	m_socket = s;
 }
 
+void RateSendApplication::SetFinishedCallback(Callback<void, Ptr<RateSendApplication> > cb){
+	NS_LOG_FUNCTION(this);
+	m_finishedCallback = cb;
+}
+
+void RateSendApplication::Restart(Time delay){
+	NS_LOG_FUNCTION(this << delay);
+
+	/* The old socket finishes closing on its own */
+	Simulator::Cancel(m_refillEvent);
+	m_socket = 0;
+	m_connected = false;
+	m_totBytes = 0;
+	m_bytesInBucket = 0;
+	m_previousBufferSize = 0;
+	m_previousBufferIncreaseCounter = 0;
+	m_sendingData = false;
+
+	m_startEvent = Simulator::Schedule(delay, &RateSendApplication::StartApplication, this);
+}
+
 
 // Application Methods
 void RateSendApplication::StartApplication (void) // Called at time specified by Start
@@ -360,6 +382,12 @@ void RateSendApplication::SendData (void)
   if (m_totBytes == m_maxBytes && m_connected) //&& (GetTxBufferSize() == 0))
     {
   		StopApplication();
+  		m_sendingData = false;
+  		if (!m_finishedCallback.IsNull())
+  		  {
+  		    m_finishedCallback(this);
+  		  }
+  		return;
     }
 
 	m_sendingData = false;
@@ -117,6 +117,20 @@ public:
 	 */
 	uint32_t GetTxBufferSize(void);
 
+	/**
+	 * \brief Set a callback invoked once all the bytes of the flow are sent
+	 * and its socket is closed.
+	 */
+	void SetFinishedCallback(Callback<void, Ptr<RateSendApplication> > cb);
+
+	/**
+	 * \brief Reset the flow state and start a new flow after delay.
+	 *
+	 * Used to recycle finished applications, attributes like Remote or
+	 * MaxBytes should be set before calling it.
+	 */
+	void Restart(Time delay);
+
 
 protected:
 	virtual void DoDispose(void);
@@ -147,6 +161,7 @@ private:
 	flow_tuple_rate m_flow_tuple;
 	EventId         m_refillEvent;
 	bool            m_sendingData;
+	Callback<void, Ptr<RateSendApplication> > m_finishedCallback;
 
 	/// Traced Callback: sent packets
 	TracedCallback<Ptr<const Packet> > m_txTrace;
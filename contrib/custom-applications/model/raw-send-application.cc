@@ -55,6 +55,11 @@ RawSendApplication::GetTypeId (void)
                   StringValue (""),
                   MakeStringAccessor(&RawSendApplication::m_outFile),
                   MakeStringChecker())
+  .AddAttribute ("BatchWindow", "Emit all the packets due within this window in a single event "
+                  "(0 sends one event per packet)",
+                  TimeValue (Seconds (0)),
+                  MakeTimeAccessor (&RawSendApplication::m_batchWindow),
+                  MakeTimeChecker ())
   ;
   return tid;
 }
@@ -278,6 +283,13 @@ void RawSendApplication::StartApplication (void)
   RandomInitializePackets (true);
   SaveFlows();
   m_nextTx = m_sendRate.CalculateBytesTxTime(m_packets[m_packetIndex]->GetSize ());
+  if (m_batchWindow.IsStrictlyPositive ())
+  {
+    m_txQueue = TimedTransmitQueue::GetOrCreate (m_device);
+    m_nextSendTime = Simulator::Now ();
+    SendBatch ();
+    return;
+  }
   SendPackets ();
 }
 
@@ -301,10 +313,41 @@ void RawSendApplication::SendPackets(void)
 
 }
 
+void RawSendApplication::SendBatch(void)
+{
+  /* Same packets and times as SendPackets, one event per window */
+  Time window_end = Simulator::Now() + m_batchWindow;
+  do
+  {
+    m_txQueue->Enqueue(m_nextSendTime, (*(m_packets+m_packetIndex))->Copy(), m_dstAddr, 0x0800, this);
+    m_nPackets--;
+    if (m_nPackets == 0)
+    {
+      return;
+    }
+
+    m_packetIndex = (m_packetIndex + 1) % m_nFlows;
+    m_nextSendTime += m_nextTx;
+
+    /* reset packets for new Ids*/
+    if (m_packetIndex == 0)
+    {
+      RandomInitializePackets (true);
+    }
+  } while (m_nextSendTime < window_end);
+
+  m_sendEvent = Simulator::Schedule(m_nextSendTime - Simulator::Now(), &RawSendApplication::SendBatch, this);
+}
+
 void RawSendApplication::StopApplication (void) 
 {
   NS_LOG_FUNCTION (this);
   Simulator::Cancel(m_sendEvent);
+  if (m_txQueue)
+  {
+    m_txQueue->Remove(this);
+    m_txQueue = 0;
+  }
   DoDispose ();
 }
 
@@ -9,6 +9,7 @@
 #include "ns3/ptr.h"
 #include "ns3/traced-callback.h"
 #include "ns3/data-rate.h"
+#include "timed-transmit-queue.h"
 
 #include <algorithm>
 #include <random>
@@ -49,6 +50,7 @@ private:
   void CleanPackets ();
   void RandomInitializePackets (bool randomize_dst_ip);
   void SendPackets(void);
+  void SendBatch(void);
   void SaveFlows ();
 
 	TypeId m_tid;         
@@ -69,6 +71,12 @@ private:
   Time m_nextTx;
   std::string m_outFile;
 
+  /* Batched mode, all the packets due within m_batchWindow are emitted in
+     one event and handed to the device at their time by m_txQueue */
+  Time m_batchWindow;
+  Time m_nextSendTime;
+  Ptr<TimedTransmitQueue> m_txQueue;
+
   
 };
 
@@ -0,0 +1,65 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "tcp-syn-template.h"
+#include "ns3/tcp-header.h"
+#include "ns3/ipv4-address.h"
+
+namespace ns3 {
+
+TcpSynPacketTemplate::TcpSynPacketTemplate (uint16_t srcPort, uint16_t dstPort)
+  : m_srcPort (srcPort),
+    m_dstPort (dstPort)
+{
+  // Fields shared by every packet
+  m_ipv4Header.SetProtocol (6);
+  m_ipv4Header.SetTtl (64);
+}
+
+TcpSynPacketTemplate::~TcpSynPacketTemplate ()
+{
+  Clear ();
+}
+
+void
+TcpSynPacketTemplate::Clear (void)
+{
+  m_prototypes.clear ();
+}
+
+Ptr<Packet>
+TcpSynPacketTemplate::GetPrototype (uint32_t payloadSize)
+{
+  if (payloadSize >= m_prototypes.size ())
+    {
+      m_prototypes.resize (payloadSize + 1);
+    }
+
+  Ptr<Packet> &prototype = m_prototypes[payloadSize];
+  if (!prototype)
+    {
+      TcpHeader tcp_header;
+      tcp_header.SetSourcePort (m_srcPort);
+      tcp_header.SetDestinationPort (m_dstPort);
+      tcp_header.SetFlags (TcpHeader::Flags_t::SYN);
+
+      prototype = ns3::Create<Packet> (payloadSize);
+      prototype->AddHeader (tcp_header);
+    }
+  return prototype;
+}
+
+Ptr<Packet>
+TcpSynPacketTemplate::Create (uint32_t payloadSize, uint32_t dstAddr, uint8_t tos, uint16_t id)
+{
+  Ptr<Packet> packet = GetPrototype (payloadSize)->CopyWithNewUid ();
+
+  m_ipv4Header.SetIdentification (id);
+  m_ipv4Header.SetTos (tos);
+  m_ipv4Header.SetDestination (Ipv4Address (dstAddr));
+  m_ipv4Header.SetPayloadSize (packet->GetSize ());
+  packet->AddHeader (m_ipv4Header);
+
+  return packet;
+}
+
+} // namespace ns3
@@ -0,0 +1,49 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#ifndef TCP_SYN_TEMPLATE_H
+#define TCP_SYN_TEMPLATE_H
+
+#include "ns3/ptr.h"
+#include "ns3/packet.h"
+#include "ns3/ipv4-header.h"
+
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup applications
+ *
+ * Prototype TCP SYN packets for the trace senders. Payload and TCP header
+ * only depend on the payload size and the ports, so they are serialized
+ * once per payload size. Every packet is a copy on write copy of that
+ * prototype with an IPv4 header on top whose per packet fields (id, tos,
+ * destination and length) are patched on a single reused header. The
+ * result is byte for byte the packet CreateTcpSynPacket used to build.
+ *
+ * Each copy gets its own uid, as a newly created packet would.
+ */
+class TcpSynPacketTemplate
+{
+public:
+  TcpSynPacketTemplate (uint16_t srcPort, uint16_t dstPort);
+  ~TcpSynPacketTemplate ();
+
+  Ptr<Packet> Create (uint32_t payloadSize, uint32_t dstAddr, uint8_t tos, uint16_t id);
+
+  /* Drops all the cached prototypes */
+  void Clear (void);
+
+private:
+  Ptr<Packet> GetPrototype (uint32_t payloadSize);
+
+  uint16_t m_srcPort;
+  uint16_t m_dstPort;
+  /* Indexed by payload size */
+  std::vector<Ptr<Packet> > m_prototypes;
+  Ipv4Header m_ipv4Header;
+};
+
+} // namespace ns3
+
+#endif /* TCP_SYN_TEMPLATE_H */
@@ -0,0 +1,186 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "timed-transmit-queue.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/packet.h"
+#include "ns3/net-device.h"
+#include "ns3/csma-net-device.h"
+
+#include <algorithm>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("TimedTransmitQueue");
+
+NS_OBJECT_ENSURE_REGISTERED (TimedTransmitQueue);
+
+TypeId
+TimedTransmitQueue::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::TimedTransmitQueue")
+    .SetParent<Object> ()
+    .SetGroupName ("Applications")
+    .AddConstructor<TimedTransmitQueue> ()
+  ;
+  return tid;
+}
+
+TimedTransmitQueue::TimedTransmitQueue ()
+  : m_seq (0),
+    m_releases (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TimedTransmitQueue::~TimedTransmitQueue ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+Ptr<TimedTransmitQueue>
+TimedTransmitQueue::GetOrCreate (Ptr<NetDevice> device)
+{
+  Ptr<TimedTransmitQueue> queue = device->GetObject<TimedTransmitQueue> ();
+  if (!queue)
+    {
+      queue = CreateObject<TimedTransmitQueue> ();
+      device->AggregateObject (queue);
+      queue->m_csma = DynamicCast<CsmaNetDevice> (device);
+      if (queue->m_csma)
+        {
+          queue->m_csma->SetTxReadyCallback (MakeCallback (&TimedTransmitQueue::TransmitReady,
+                                                           PeekPointer (queue)));
+        }
+    }
+  return queue;
+}
+
+void
+TimedTransmitQueue::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  Simulator::Cancel (m_releaseEvent);
+  m_packets.clear ();
+  if (m_csma)
+    {
+      m_csma->SetTxReadyCallback (MakeNullCallback<void> ());
+      m_csma = 0;
+    }
+  Object::DoDispose ();
+}
+
+void
+TimedTransmitQueue::Enqueue (Time at, Ptr<Packet> packet, const Address &dst, uint16_t protocol,
+                             const void *owner)
+{
+  NS_LOG_FUNCTION (this << at << packet);
+  NS_ASSERT (at >= Simulator::Now ());
+
+  /* Nothing pending ahead of it, no need to wait for an event */
+  if (at == Simulator::Now () && m_packets.empty ())
+    {
+      Ptr<NetDevice> device = GetObject<NetDevice> ();
+      device->SendFrom (packet, device->GetAddress (), dst, protocol);
+      return;
+    }
+
+  timed_packet entry;
+  entry.at = at;
+  entry.seq = m_seq++;
+  entry.packet = packet;
+  entry.dst = dst;
+  entry.protocol = protocol;
+  entry.owner = owner;
+  m_packets.push_back (entry);
+  std::push_heap (m_packets.begin (), m_packets.end (), &TimedTransmitQueue::Later);
+
+  /* Only rearm when the new packet is the earliest one */
+  if (!m_releaseEvent.IsRunning () || at < Time (m_releaseEvent.GetTs ()))
+    {
+      Arm ();
+    }
+}
+
+void
+TimedTransmitQueue::Remove (const void *owner)
+{
+  NS_LOG_FUNCTION (this << owner);
+  m_packets.erase (std::remove_if (m_packets.begin (), m_packets.end (),
+                                  [owner] (const timed_packet &entry) {
+                                    return entry.owner == owner;
+                                  }),
+                   m_packets.end ());
+  std::make_heap (m_packets.begin (), m_packets.end (), &TimedTransmitQueue::Later);
+  Arm ();
+}
+
+uint32_t
+TimedTransmitQueue::GetNPackets (void) const
+{
+  return m_packets.size ();
+}
+
+uint64_t
+TimedTransmitQueue::GetNReleases (void) const
+{
+  return m_releases;
+}
+
+bool
+TimedTransmitQueue::Later (const timed_packet &a, const timed_packet &b)
+{
+  return a.at > b.at || (a.at == b.at && a.seq > b.seq);
+}
+
+bool
+TimedTransmitQueue::IsDeviceBusy (void) const
+{
+  return m_csma && m_csma->IsTxBusy ();
+}
+
+void
+TimedTransmitQueue::Arm (void)
+{
+  Simulator::Cancel (m_releaseEvent);
+  /* A busy device calls TransmitReady, the due packets are sent from there */
+  if (!m_packets.empty () && !IsDeviceBusy ())
+    {
+      m_releaseEvent = Simulator::Schedule (m_packets.front ().at - Simulator::Now (),
+                                            &TimedTransmitQueue::Release, this);
+    }
+}
+
+void
+TimedTransmitQueue::SendDue (void)
+{
+  Ptr<NetDevice> device = GetObject<NetDevice> ();
+  Time now = Simulator::Now ();
+  while (!m_packets.empty () && m_packets.front ().at <= now)
+    {
+      /* Moved out first, sending can enqueue more packets */
+      std::pop_heap (m_packets.begin (), m_packets.end (), &TimedTransmitQueue::Later);
+      timed_packet entry = m_packets.back ();
+      m_packets.pop_back ();
+      device->SendFrom (entry.packet, device->GetAddress (), entry.dst, entry.protocol);
+    }
+}
+
+void
+TimedTransmitQueue::Release (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_releases++;
+  SendDue ();
+  Arm ();
+}
+
+void
+TimedTransmitQueue::TransmitReady (void)
+{
+  NS_LOG_FUNCTION (this);
+  SendDue ();
+  Arm ();
+}
+
+} // namespace ns3
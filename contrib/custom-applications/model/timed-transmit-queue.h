@@ -0,0 +1,94 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#ifndef TIMED_TRANSMIT_QUEUE_H
+#define TIMED_TRANSMIT_QUEUE_H
+
+#include "ns3/object.h"
+#include "ns3/address.h"
+#include "ns3/event-id.h"
+#include "ns3/nstime.h"
+#include "ns3/ptr.h"
+
+#include <vector>
+
+namespace ns3 {
+
+class NetDevice;
+class CsmaNetDevice;
+class Packet;
+
+/**
+ * \ingroup applications
+ *
+ * Timestamped transmit queue aggregated to a net device. Senders running
+ * in batched mode hand it every packet due within their window in a single
+ * event, each with the exact time it has to be given to the device. The
+ * queue keeps a single simulator event armed at the earliest timestamp and
+ * releases all the packets due at that instant in the order they were
+ * enqueued, so packet timing is the same as with one event per packet.
+ *
+ * On a CsmaNetDevice no event is armed while the device is sending. The
+ * device hands control back before it takes its next packet, and the
+ * packets due by then are queued behind the waiting ones, where they would
+ * have been with one event each. Only the time at which they enter the
+ * device queue changes, so this is exact as long as the queue is the only
+ * sender of the device.
+ */
+class TimedTransmitQueue : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+
+  TimedTransmitQueue ();
+  virtual ~TimedTransmitQueue ();
+
+  /* Returns the queue of device, aggregating a new one if needed */
+  static Ptr<TimedTransmitQueue> GetOrCreate (Ptr<NetDevice> device);
+
+  /* Sends packet through the device at time at. owner is only used by Remove */
+  void Enqueue (Time at, Ptr<Packet> packet, const Address &dst, uint16_t protocol,
+                const void *owner);
+  /* Drops all the packets of owner that are still pending */
+  void Remove (const void *owner);
+
+  uint32_t GetNPackets (void) const;
+  /* Number of release events executed so far */
+  uint64_t GetNReleases (void) const;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  struct timed_packet
+  {
+    Time at;
+    /* Enqueue order, for equal timestamps */
+    uint64_t seq;
+    Ptr<Packet> packet;
+    Address dst;
+    uint16_t protocol;
+    const void *owner;
+  };
+
+  /* Heap order, the earliest packet is at the front */
+  static bool Later (const timed_packet &a, const timed_packet &b);
+  /* True if the device calls TransmitReady before its next packet */
+  bool IsDeviceBusy (void) const;
+  void Arm (void);
+  /* Sends the packets due by now */
+  void SendDue (void);
+  void Release (void);
+  void TransmitReady (void);
+
+  /* Binary heap, without a node allocation per packet */
+  std::vector<timed_packet> m_packets;
+  uint64_t m_seq;
+  /* Set when the device is a CsmaNetDevice */
+  Ptr<CsmaNetDevice> m_csma;
+  EventId m_releaseEvent;
+  uint64_t m_releases;
+};
+
+} // namespace ns3
+
+#endif /* TIMED_TRANSMIT_QUEUE_H */
@@ -84,44 +84,20 @@ TraceSendApplication::GetTypeId (void)
                   StringValue (""),
                   MakeStringAccessor(&TraceSendApplication::m_outFile),
                   MakeStringChecker())
+  .AddAttribute ("BatchWindow", "Emit all the packets due within this window in a single event "
+                  "(0 sends one event per packet)",
+                  TimeValue (Seconds (0)),
+                  MakeTimeAccessor (&TraceSendApplication::m_batchWindow),
+                  MakeTimeChecker ())
   ;
   return tid;
 }
 
-Ptr<Packet> TraceSendApplication::CreateTcpSynPacket(uint16_t srcPort, uint16_t dstPort, 
-                                                     uint16_t packet_size, uint32_t dst_addr, uint8_t tos)
-{
-  
-  Ptr<Packet> packet = Create<Packet>(std::max(0, packet_size-58));
-  TcpHeader tcp_header;
-  Ipv4Header ipv4_header;
-
-  // Set IPV4 fields
-  ipv4_header.SetProtocol(6);
-  ipv4_header.SetTtl(64);
-  ipv4_header.SetIdentification(m_sentPackets & 0xFFFF); // in theory same than % 65536
-  ipv4_header.SetTos(tos);
-  ipv4_header.SetPayloadSize(44);
-  ipv4_header.SetDestination(Ipv4Address(dst_addr));
-
-  // Set TCP fields
-  tcp_header.SetSourcePort(srcPort);
-  tcp_header.SetDestinationPort(dstPort);
-  tcp_header.SetFlags(TcpHeader::Flags_t::SYN);
-  /* To remove */
-  //tcp_header.SetSequenceNumber(ns3::SequenceNumber32(m_sentPackets));
-  
-  packet->AddHeader(tcp_header);
-  ipv4_header.SetPayloadSize(packet->GetSize ());
-  packet->AddHeader(ipv4_header);
-
-  return packet;
-}
-
 TraceSendApplication::TraceSendApplication ()
   :
   m_packetIndex (0),
-  m_device (0)
+  m_device (0),
+  m_synTemplate (5555, 7777)
 {
   NS_LOG_FUNCTION (this);
 }
@@ -145,7 +121,8 @@ TraceSendApplication::DoDispose (void)
 
 void TraceSendApplication::CleanPackets ()
 {
-   /* void */
+  m_synTemplate.Clear ();
+  m_trace = 0;
 }
 
 void TraceSendApplication::SaveFailedPrefixes ()
@@ -210,6 +187,10 @@ void TraceSendApplication::StartApplication (void)
 
   /* Loads all packets and set of prefixes in the bin file */
   LoadBinaryFile();
+  if (!m_trace)
+  {
+    return;
+  }
   uint32_t prefixes_added = 0;
 
   /* When we only fail allowed prefixes prefixes, and we consider them all */
@@ -250,7 +231,7 @@ void TraceSendApplication::StartApplication (void)
     m_numTopEntries = failable_size;
   }
   
-  std::cout << "Failable Prefixes: " << failable_size << " Top prefixes size: " << top_prefixes.size() << " prefixes in trace: " << prefixes_in_trace.size() << "\n";
+  std::cout << "Failable Prefixes: " << failable_size << " Top prefixes size: " << top_prefixes.size() << " prefixes in trace: " << m_trace->GetPrefixCount() << "\n";
   std::cout << "num top entries " << m_numTopEntries << " num top drops " << m_topDrops << " num bottom drops " << m_bottomDrops << "\n";
  
   /* If num_top_entries < m_topDrops we ajust it */
@@ -316,6 +297,13 @@ void TraceSendApplication::StartApplication (void)
   SaveFailedPrefixes ();
   std::cout << "Traffic Loaded" << std::endl;
   std::cout << "Starts sending packets" << std::endl;
+  if (m_batchWindow.IsStrictlyPositive ())
+  {
+    m_txQueue = TimedTransmitQueue::GetOrCreate (m_device);
+    m_nextTx = Simulator::Now ();
+    SendBatch ();
+    return;
+  }
   SendPackets ();
 }
 
@@ -329,7 +317,7 @@ void TraceSendApplication::LoadTopPrefixes(std::string top_prefixes_file)
     /* Only add them if the prefix appears in the trace we send */
     /* This was more useful when we loaded a global top file, now we are using a sliced one*/
     /* however, just in case we can keep this check */
-    if (prefixes_in_trace.count(prefix) > 0)
+    if (m_trace->HasPrefix(prefix))
     {
       top_prefixes.push_back(prefix);
     }
@@ -433,63 +421,84 @@ int TraceSendApplication::AddToFailRandom(int min_limit, int max_limit, int numb
 
 void TraceSendApplication::SendPackets(void)
 {
-  packet data = m_binary_packets[m_sentPackets];
-
-  data.dst = (data.dst & 0xffffff00);
-  uint8_t tos = 0;
-  if (prefixes_to_fail.count(data.dst) > 0)
+  if (m_sentPackets >= m_trace->GetRecordCount())
   {
-    tos = 1;
+    return;
   }
-  Ptr<Packet> p = CreateTcpSynPacket(5555, 7777, data.size, data.dst, tos);
-  m_device->SendFrom(p, m_device->GetAddress(), m_dstAddr, 0x0800);
+  packet data = m_trace->GetRecord(m_sentPackets);
+  m_device->SendFrom(CreateTracePacket(data), m_device->GetAddress(), m_dstAddr, 0x0800);
   m_sentPackets++;
-  if (m_sentPackets == m_binary_packets.size())
+  if (m_sentPackets == m_trace->GetRecordCount())
   {
     return;
   }
 
-  packet next = m_binary_packets[m_sentPackets];
+  packet next = m_trace->GetRecord(m_sentPackets);
   
   /* Schedule the event for the next packet to be sent respecting the scaling factor */
   /* We use picoseconds so we can keep sub nanosecond precission */
   m_sendEvent = Simulator::Schedule(PicoSeconds((next.ts - data.ts)* 1000 * m_parsed_scaling), &TraceSendApplication::SendPackets, this);
 }
 
-void TraceSendApplication::LoadBinaryFile (void)
+Ptr<Packet> TraceSendApplication::CreateTracePacket(const packet &data)
 {
-  /* NOTE BE CAREFUL WITH THE IP ENDIANESS */
-  /*/ Read binary file */
-  std::ifstream file(m_inFile, std::ios::in | std::ios::binary);
-  if(!file) {
-    std::cout << "Cannot open file!" << std::endl;
+  uint32_t dst = (data.dst & 0xffffff00);
+  uint8_t tos = 0;
+  if (prefixes_to_fail.count(dst) > 0)
+  {
+    tos = 1;
+  }
+  /* Payload size as before: trace size minus 58 bytes of headers */
+  return m_synTemplate.Create(std::max(0, data.size - 58), dst, tos, m_sentPackets & 0xFFFF);
+}
+
+void TraceSendApplication::SendBatch(void)
+{
+  if (m_sentPackets >= m_trace->GetRecordCount())
+  {
     return;
   }
 
-  file.seekg (0, file.end);
-  int length = file.tellg();
-  file.seekg(0, file.beg);
+  /* Same packets and times as SendPackets, one event per window */
+  Time window_end = Simulator::Now() + m_batchWindow;
+  do
+  {
+    packet data = m_trace->GetRecord(m_sentPackets);
+    m_txQueue->Enqueue(m_nextTx, CreateTracePacket(data), m_dstAddr, 0x0800, this);
+    m_sentPackets++;
+    if (m_sentPackets >= m_trace->GetRecordCount())
+    {
+      return;
+    }
+
+    packet next = m_trace->GetRecord(m_sentPackets);
+    m_nextTx += PicoSeconds((next.ts - data.ts)* 1000 * m_parsed_scaling);
+  } while (m_nextTx < window_end);
 
-  int read_bytes = 0;
+  m_sendEvent = Simulator::Schedule(m_nextTx - Simulator::Now(), &TraceSendApplication::SendBatch, this);
+}
 
-  /* Read packets one by one */
-  while (read_bytes < length)
-  {
-    packet p;
-    file.read((char*)&p, 14);
-    /* add packet to packet stream */
-    m_binary_packets.push_back(p);
-    /* add dst to set of destinations */
-    prefixes_in_trace.insert(p.dst & 0xffffff00);
-    read_bytes +=14;
+void TraceSendApplication::LoadBinaryFile (void)
+{
+  /* NOTE BE CAREFUL WITH THE IP ENDIANESS */
+  /* Maps the binary file, the packets and set of prefixes come from the
+     shared trace and its side index instead of a private copy */
+  m_trace = BinaryTrace::Open(m_inFile);
+  if (!m_trace) {
+    std::cout << "Cannot open file!" << std::endl;
+    return;
   }
-  file.close();
 }
 
 void TraceSendApplication::StopApplication (void) 
 {
   NS_LOG_FUNCTION (this);
   Simulator::Cancel(m_sendEvent);
+  if (m_txQueue)
+  {
+    m_txQueue->Remove(this);
+    m_txQueue = 0;
+  }
   DoDispose ();
 }
 
@@ -9,6 +9,9 @@
 #include "ns3/ptr.h"
 #include "ns3/traced-callback.h"
 #include "ns3/data-rate.h"
+#include "tcp-syn-template.h"
+#include "binary-trace.h"
+#include "timed-transmit-queue.h"
 
 #include <unordered_set>
 #include <algorithm>
@@ -25,13 +28,6 @@ class Socket;
  * 
 **/
 
-struct packet 
-{
-  uint64_t ts = 0;
-  uint32_t dst = 0;
-  uint16_t size = 0;
-};
-
 enum fail_types {
   TopDown,
   Random,
@@ -59,10 +55,10 @@ private:
 	virtual void StartApplication(void);    // Called at time specified by Start
 	virtual void StopApplication(void);     // Called at time specified by Stop
 
-  Ptr<Packet> CreateTcpSynPacket(uint16_t srcPort, uint16_t dstPort, 
-                                                     uint16_t packet_size, uint32_t dst_addr, uint8_t tos);
   void CleanPackets ();
   void SendPackets(void);
+  void SendBatch(void);
+  Ptr<Packet> CreateTracePacket(const packet &data);
 
   fail_types GetFailType(std::string const& str_type);
 
@@ -95,6 +91,11 @@ private:
   std::string m_topFile;
   std::string m_allowedToFailFile;
 
+  /* Batched mode, all the packets due within m_batchWindow are emitted in
+     one event and handed to the device at their time by m_txQueue */
+  Time m_batchWindow;
+  Ptr<TimedTransmitQueue> m_txQueue;
+
   /* New attributes */
   uint32_t m_numTopEntries;
   uint32_t m_topDrops;
@@ -102,13 +103,15 @@ private:
   std::string m_topFailType;
   std::string m_bottomFailType;
 
-  std::vector<packet> m_binary_packets;
+  /* Memory mapped trace, shared with the other senders replaying it */
+  Ptr<BinaryTrace> m_trace;
+  /* Serialized SYN prototypes, one per payload size */
+  TcpSynPacketTemplate m_synTemplate;
   std::string m_inFile;
   uint32_t m_sentPackets = 0;
   std::string m_scaling;
   double m_parsed_scaling;
   std::unordered_set<uint32_t> prefixes_to_fail;
-  std::unordered_set<uint32_t> prefixes_in_trace;
   std::vector<uint32_t> top_prefixes;
   std::vector<uint32_t> allowed_prefixes;
   std::vector<uint32_t> failable_prefixes;
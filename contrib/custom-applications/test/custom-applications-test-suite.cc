@@ -2,6 +2,24 @@
 
 // Include a header file from your module to test.
 #include "ns3/custom-applications.h"
+#include "ns3/tcp-syn-template.h"
+#include "ns3/binary-trace.h"
+#include "ns3/timed-transmit-queue.h"
+#include "ns3/simple-net-device.h"
+#include "ns3/simple-channel.h"
+#include "ns3/csma-helper.h"
+#include "ns3/csma-net-device.h"
+#include "ns3/string.h"
+#include "ns3/drop-tail-queue.h"
+#include "ns3/mac48-address.h"
+#include "ns3/simulator.h"
+#include "ns3/node.h"
+#include "ns3/tcp-header.h"
+#include "ns3/ipv4-header.h"
+#include "ns3/ipv4-address.h"
+
+#include <fstream>
+#include <set>
 
 // An essential include is test.h
 #include "ns3/test.h"
@@ -46,6 +64,397 @@ CustomApplicationsTestCase1::DoRun (void)
   NS_TEST_ASSERT_MSG_EQ_TOL (0.01, 0.01, 0.001, "Numbers are not equal within tolerance");
 }
 
+// Packets built from the SYN template must match the ones built header by header
+class TcpSynTemplateTestCase : public TestCase
+{
+public:
+  TcpSynTemplateTestCase ();
+  virtual ~TcpSynTemplateTestCase ();
+
+private:
+  virtual void DoRun (void);
+  Ptr<Packet> CreateReference (uint32_t payloadSize, uint32_t dstAddr, uint8_t tos, uint16_t id);
+  std::vector<uint8_t> GetBytes (Ptr<Packet> packet);
+};
+
+TcpSynTemplateTestCase::TcpSynTemplateTestCase ()
+  : TestCase ("TCP SYN template packets are byte identical")
+{
+}
+
+TcpSynTemplateTestCase::~TcpSynTemplateTestCase ()
+{
+}
+
+Ptr<Packet>
+TcpSynTemplateTestCase::CreateReference (uint32_t payloadSize, uint32_t dstAddr, uint8_t tos, uint16_t id)
+{
+  Ptr<Packet> packet = Create<Packet> (payloadSize);
+  TcpHeader tcp_header;
+  Ipv4Header ipv4_header;
+
+  ipv4_header.SetProtocol (6);
+  ipv4_header.SetTtl (64);
+  ipv4_header.SetIdentification (id);
+  ipv4_header.SetTos (tos);
+  ipv4_header.SetDestination (Ipv4Address (dstAddr));
+
+  tcp_header.SetSourcePort (5555);
+  tcp_header.SetDestinationPort (7777);
+  tcp_header.SetFlags (TcpHeader::Flags_t::SYN);
+
+  packet->AddHeader (tcp_header);
+  ipv4_header.SetPayloadSize (packet->GetSize ());
+  packet->AddHeader (ipv4_header);
+  return packet;
+}
+
+std::vector<uint8_t>
+TcpSynTemplateTestCase::GetBytes (Ptr<Packet> packet)
+{
+  std::vector<uint8_t> bytes (packet->GetSize ());
+  packet->CopyData (bytes.data (), bytes.size ());
+  return bytes;
+}
+
+void
+TcpSynTemplateTestCase::DoRun (void)
+{
+  TcpSynPacketTemplate synTemplate (5555, 7777);
+  uint32_t sizes[] = {0, 1, 100, 1442, 100, 0};
+  std::vector<Ptr<Packet> > packets;
+  std::vector<std::vector<uint8_t> > expected;
+
+  for (uint32_t i = 0; i < sizeof (sizes) / sizeof (sizes[0]); i++)
+    {
+      uint32_t dst = 0x0a000100 + (i << 8);
+      uint8_t tos = i % 2;
+      Ptr<Packet> packet = synTemplate.Create (sizes[i], dst, tos, 65530 + i);
+      Ptr<Packet> reference = CreateReference (sizes[i], dst, tos, 65530 + i);
+      NS_TEST_ASSERT_MSG_EQ (packet->GetSize (), reference->GetSize (), "Template packet size differs");
+      NS_TEST_ASSERT_MSG_EQ ((GetBytes (packet) == GetBytes (reference)), true, "Template packet bytes differ");
+      packets.push_back (packet);
+      expected.push_back (GetBytes (reference));
+    }
+
+  // Later packets sharing a prototype must not change earlier ones
+  for (uint32_t i = 0; i < packets.size (); i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ ((GetBytes (packets[i]) == expected[i]), true, "Template packet modified by a later one");
+    }
+
+  // Every packet is traced as a new one, also the ones of a single prototype
+  std::set<uint64_t> uids;
+  for (uint32_t i = 0; i < packets.size (); i++)
+    {
+      uids.insert (packets[i]->GetUid ());
+    }
+  for (uint32_t i = 0; i < 10; i++)
+    {
+      Ptr<Packet> packet = synTemplate.Create (100, 0x0a000100, 0, i);
+      NS_TEST_ASSERT_MSG_EQ (uids.insert (packet->GetUid ()).second, true, "Template packet reuses a uid");
+    }
+}
+
+// The mapped trace and its side index must match a plain read of the file
+class BinaryTraceTestCase : public TestCase
+{
+public:
+  BinaryTraceTestCase ();
+  virtual ~BinaryTraceTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void CheckTrace (Ptr<BinaryTrace> trace, const std::vector<packet> &records);
+};
+
+BinaryTraceTestCase::BinaryTraceTestCase ()
+  : TestCase ("Binary trace records and prefix index")
+{
+}
+
+BinaryTraceTestCase::~BinaryTraceTestCase ()
+{
+}
+
+void
+BinaryTraceTestCase::CheckTrace (Ptr<BinaryTrace> trace, const std::vector<packet> &records)
+{
+  NS_TEST_ASSERT_MSG_EQ (trace->GetRecordCount (), records.size (), "Wrong number of records");
+
+  std::set<uint32_t> prefixes;
+  for (uint32_t i = 0; i < records.size (); i++)
+    {
+      packet p = trace->GetRecord (i);
+      NS_TEST_ASSERT_MSG_EQ (p.ts, records[i].ts, "Wrong timestamp");
+      NS_TEST_ASSERT_MSG_EQ (p.dst, records[i].dst, "Wrong destination");
+      NS_TEST_ASSERT_MSG_EQ (p.size, records[i].size, "Wrong size");
+      prefixes.insert (records[i].dst & 0xffffff00);
+    }
+  NS_TEST_ASSERT_MSG_EQ (trace->GetPrefixCount (), prefixes.size (), "Wrong number of prefixes");
+  for (uint32_t prefix : prefixes)
+    {
+      NS_TEST_ASSERT_MSG_EQ (trace->HasPrefix (prefix), true, "Missing prefix");
+    }
+  NS_TEST_ASSERT_MSG_EQ (trace->HasPrefix (0x01020300), false, "Unexpected prefix");
+}
+
+void
+BinaryTraceTestCase::DoRun (void)
+{
+  std::string path = CreateTempDirFilename ("trace.bin");
+  std::vector<packet> records;
+  std::ofstream out (path, std::ios::out | std::ios::binary);
+  uint64_t ts = 1000000000;
+  for (uint32_t i = 0; i < 3000; i++)
+    {
+      packet p;
+      // Bursts and long gaps
+      ts += (i % 500 == 0) ? 5000000 : (i * 7) % 3000;
+      p.ts = ts;
+      p.dst = 0x0a000000 + ((i * 13) % 200 << 8) + (i % 256);
+      p.size = 60 + i % 1400;
+      out.write ((const char *) &p.ts, sizeof (p.ts));
+      out.write ((const char *) &p.dst, sizeof (p.dst));
+      out.write ((const char *) &p.size, sizeof (p.size));
+      records.push_back (p);
+    }
+  out.close ();
+
+  Ptr<BinaryTrace> trace = BinaryTrace::Open (path);
+  NS_TEST_ASSERT_MSG_NE (trace, 0, "Could not open the trace");
+  NS_TEST_ASSERT_MSG_EQ (BinaryTrace::Open (path), trace, "Trace is not shared");
+  CheckTrace (trace, records);
+
+  // Reopening reads the side index written by the first open
+  trace = 0;
+  NS_TEST_ASSERT_MSG_EQ (std::ifstream (path + ".idx").good (), true, "Index not written");
+  trace = BinaryTrace::Open (path);
+  CheckTrace (trace, records);
+
+  NS_TEST_ASSERT_MSG_EQ (BinaryTrace::Open (path + ".missing"), 0, "Opened a missing trace");
+}
+
+// Packets handed to the timed transmit queue leave at their own timestamp
+class TimedTransmitQueueTestCase : public TestCase
+{
+public:
+  TimedTransmitQueueTestCase ();
+  virtual ~TimedTransmitQueueTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void EnqueueBatch (void);
+  bool Receive (Ptr<NetDevice> device, Ptr<const Packet> packet, uint16_t protocol,
+                const Address &from);
+
+  Ptr<SimpleNetDevice> m_tx;
+  Ptr<SimpleNetDevice> m_rx;
+  Ptr<TimedTransmitQueue> m_queue;
+  std::vector<std::pair<Time, uint32_t> > m_received;
+};
+
+TimedTransmitQueueTestCase::TimedTransmitQueueTestCase ()
+  : TestCase ("Timed transmit queue keeps packet timing")
+{
+}
+
+TimedTransmitQueueTestCase::~TimedTransmitQueueTestCase ()
+{
+}
+
+bool
+TimedTransmitQueueTestCase::Receive (Ptr<NetDevice> device, Ptr<const Packet> packet,
+                                     uint16_t protocol, const Address &from)
+{
+  m_received.push_back (std::make_pair (Simulator::Now (), packet->GetSize ()));
+  return true;
+}
+
+void
+TimedTransmitQueueTestCase::EnqueueBatch (void)
+{
+  int owner = 0;
+  int other = 0;
+  // Sizes identify the packets, enqueued out of order on purpose
+  m_queue->Enqueue (Simulator::Now (), Create<Packet> (5), m_rx->GetAddress (), 0x0800, &owner);
+  m_queue->Enqueue (MicroSeconds (3), Create<Packet> (3), m_rx->GetAddress (), 0x0800, &owner);
+  m_queue->Enqueue (MicroSeconds (1), Create<Packet> (1), m_rx->GetAddress (), 0x0800, &owner);
+  m_queue->Enqueue (MicroSeconds (1), Create<Packet> (2), m_rx->GetAddress (), 0x0800, &owner);
+  m_queue->Enqueue (MicroSeconds (2), Create<Packet> (100), m_rx->GetAddress (), 0x0800, &other);
+  m_queue->Enqueue (MicroSeconds (10), Create<Packet> (4), m_rx->GetAddress (), 0x0800, &owner);
+  m_queue->Remove (&other);
+}
+
+void
+TimedTransmitQueueTestCase::DoRun (void)
+{
+  Ptr<SimpleChannel> channel = CreateObject<SimpleChannel> ();
+  m_tx = CreateObject<SimpleNetDevice> ();
+  m_rx = CreateObject<SimpleNetDevice> ();
+  m_tx->SetAddress (Mac48Address::Allocate ());
+  m_rx->SetAddress (Mac48Address::Allocate ());
+  m_tx->SetChannel (channel);
+  m_rx->SetChannel (channel);
+  CreateObject<Node> ()->AddDevice (m_tx);
+  CreateObject<Node> ()->AddDevice (m_rx);
+  m_rx->SetReceiveCallback (MakeCallback (&TimedTransmitQueueTestCase::Receive, this));
+
+  m_queue = TimedTransmitQueue::GetOrCreate (m_tx);
+  NS_TEST_ASSERT_MSG_EQ (TimedTransmitQueue::GetOrCreate (m_tx), m_queue, "Queue is not shared");
+
+  Simulator::Schedule (Seconds (0), &TimedTransmitQueueTestCase::EnqueueBatch, this);
+  Simulator::Run ();
+
+  uint32_t sizes[] = {5, 1, 2, 3, 4};
+  int64_t times[] = {0, 1, 1, 3, 10};
+  NS_TEST_ASSERT_MSG_EQ (m_received.size (), 5, "Wrong number of packets received");
+  for (uint32_t i = 0; i < m_received.size (); i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (m_received[i].second, sizes[i], "Packets out of order");
+      NS_TEST_ASSERT_MSG_EQ (m_received[i].first, MicroSeconds (times[i]), "Packet left at the wrong time");
+    }
+  // One release for each distinct timestamp, the first packet goes out directly
+  NS_TEST_ASSERT_MSG_EQ (m_queue->GetNReleases (), 3, "Wrong number of release events");
+
+  Simulator::Destroy ();
+  m_queue = 0;
+  m_tx = 0;
+  m_rx = 0;
+}
+
+// Packets due while the device is busy are sent from its transmit ready callback
+class TimedTransmitQueueCsmaTestCase : public TestCase
+{
+public:
+  TimedTransmitQueueCsmaTestCase ();
+  virtual ~TimedTransmitQueueCsmaTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void EnqueueTrace (void);
+  void Send (uint32_t size);
+  bool Receive (Ptr<NetDevice> device, Ptr<const Packet> packet, uint16_t protocol,
+                const Address &from);
+  /* Sends the trace through the queue or with one event per packet, returns the number of events */
+  uint64_t RunTrace (bool timedQueue);
+
+  Ptr<CsmaNetDevice> m_tx;
+  Ptr<CsmaNetDevice> m_rx;
+  Ptr<TimedTransmitQueue> m_queue;
+  std::vector<std::pair<Time, uint32_t> > m_received;
+};
+
+/* Bursts of packets at distinct nanosecond timestamps, closer than their transmission time */
+static const uint32_t TRACE_BURSTS = 10;
+static const uint32_t TRACE_BURST_PACKETS = 100;
+static const uint32_t TRACE_PACKETS = TRACE_BURSTS * TRACE_BURST_PACKETS;
+
+static Time
+GetTraceTime (uint32_t i)
+{
+  return NanoSeconds (1 + i * 97 + (i / TRACE_BURST_PACKETS) * 1000000);
+}
+
+static uint32_t
+GetTraceSize (uint32_t i)
+{
+  return 100 + (i % 7) * 50;
+}
+
+TimedTransmitQueueCsmaTestCase::TimedTransmitQueueCsmaTestCase ()
+  : TestCase ("Timed transmit queue sends behind a busy device without events")
+{
+}
+
+TimedTransmitQueueCsmaTestCase::~TimedTransmitQueueCsmaTestCase ()
+{
+}
+
+bool
+TimedTransmitQueueCsmaTestCase::Receive (Ptr<NetDevice> device, Ptr<const Packet> packet,
+                                         uint16_t protocol, const Address &from)
+{
+  m_received.push_back (std::make_pair (Simulator::Now (), packet->GetSize ()));
+  return true;
+}
+
+void
+TimedTransmitQueueCsmaTestCase::Send (uint32_t size)
+{
+  m_tx->SendFrom (Create<Packet> (size), m_tx->GetAddress (), m_rx->GetAddress (), 0x0800);
+}
+
+void
+TimedTransmitQueueCsmaTestCase::EnqueueTrace (void)
+{
+  int owner = 0;
+  for (uint32_t i = 0; i < TRACE_PACKETS; i++)
+    {
+      m_queue->Enqueue (GetTraceTime (i), Create<Packet> (GetTraceSize (i)), m_rx->GetAddress (),
+                        0x0800, &owner);
+    }
+}
+
+uint64_t
+TimedTransmitQueueCsmaTestCase::RunTrace (bool timedQueue)
+{
+  NodeContainer nodes;
+  nodes.Create (2);
+  CsmaHelper csma;
+  csma.SetChannelAttribute ("DataRate", StringValue ("1Gbps"));
+  csma.SetChannelAttribute ("Delay", TimeValue (Time (0)));
+  csma.SetQueue ("ns3::DropTailQueue", "MaxSize",
+                 QueueSizeValue (QueueSize (QueueSizeUnit::PACKETS, TRACE_PACKETS)));
+  NetDeviceContainer devices = csma.Install (nodes);
+  m_tx = DynamicCast<CsmaNetDevice> (devices.Get (0));
+  m_rx = DynamicCast<CsmaNetDevice> (devices.Get (1));
+  m_rx->SetReceiveCallback (MakeCallback (&TimedTransmitQueueCsmaTestCase::Receive, this));
+
+  m_received.clear ();
+  if (timedQueue)
+    {
+      m_queue = TimedTransmitQueue::GetOrCreate (m_tx);
+      Simulator::Schedule (Seconds (0), &TimedTransmitQueueCsmaTestCase::EnqueueTrace, this);
+    }
+  else
+    {
+      for (uint32_t i = 0; i < TRACE_PACKETS; i++)
+        {
+          Simulator::Schedule (GetTraceTime (i), &TimedTransmitQueueCsmaTestCase::Send, this,
+                               GetTraceSize (i));
+        }
+    }
+  Simulator::Run ();
+  uint64_t events = Simulator::GetEventCount ();
+  Simulator::Destroy ();
+  m_tx = 0;
+  m_rx = 0;
+  return events;
+}
+
+void
+TimedTransmitQueueCsmaTestCase::DoRun (void)
+{
+  uint64_t perPacketEvents = RunTrace (false);
+  std::vector<std::pair<Time, uint32_t> > expected = m_received;
+  NS_TEST_ASSERT_MSG_EQ (expected.size (), TRACE_PACKETS, "Wrong number of packets received");
+
+  uint64_t queueEvents = RunTrace (true);
+  // The device is idle when a burst starts and busy for the rest of it
+  NS_TEST_ASSERT_MSG_EQ (m_queue->GetNReleases (), TRACE_BURSTS, "Not one release per burst");
+  // All the send events but one per burst and the enqueue one are saved
+  NS_TEST_ASSERT_MSG_EQ (perPacketEvents - queueEvents, TRACE_PACKETS - TRACE_BURSTS - 1,
+                         "Events not saved");
+  NS_TEST_ASSERT_MSG_EQ (m_received.size (), expected.size (), "Wrong number of packets received");
+  for (uint32_t i = 0; i < m_received.size () && i < expected.size (); i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (m_received[i].second, expected[i].second, "Packets out of order");
+      NS_TEST_ASSERT_MSG_EQ (m_received[i].first, expected[i].first, "Packet timing changed");
+    }
+  m_queue = 0;
+}
+
 // The TestSuite class names the TestSuite, identifies what type of TestSuite,
 // and enables the TestCases to be run.  Typically, only the constructor for
 // this class must be defined
@@ -61,6 +470,10 @@ CustomApplicationsTestSuite::CustomApplicationsTestSuite ()
 {
   // TestDuration for TestCase can be QUICK, EXTENSIVE or TAKES_FOREVER
   AddTestCase (new CustomApplicationsTestCase1, TestCase::QUICK);
+  AddTestCase (new TcpSynTemplateTestCase, TestCase::QUICK);
+  AddTestCase (new BinaryTraceTestCase, TestCase::QUICK);
+  AddTestCase (new TimedTransmitQueueTestCase, TestCase::QUICK);
+  AddTestCase (new TimedTransmitQueueCsmaTestCase, TestCase::QUICK);
 }
 
 // Do not forget to allocate an instance of this TestSuite
@@ -0,0 +1,363 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Distributed (MPI) simulation of independent FANCY pods.
+//
+// Every pod is a h<k> - s1_<k> - s2_<k> - r<k> chain of full-duplex csma
+// links, where a synthetic packet stream (as in bench-p4-switch) is sent
+// from h<k> to r<k> and some flows are blackholed at s1_<k>.  With more
+// than one process the two switches of a pod run on consecutive ranks,
+// so the s1_<k> - s2_<k> link is a CsmaRemoteChannel and FANCY exchanges
+// its keep alive and counter packets across processes.
+//
+// The number of delivered packets does not depend on the number of
+// processes, the wall time of the slowest rank shows the scaling.  The
+// ranks synchronize every --core-delay of simulated time, which must be
+// long compared to the packet interval for the pods to run in parallel.
+// Sample usage:  mpirun -np 4 ./waf --run 'fancy-multi-pod-distributed --pods=16'
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/csma-module.h"
+#include "ns3/mpi-interface.h"
+#include "ns3/p4-switch-module.h"
+
+#include <mpi.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("FancyMultiPodDistributed");
+
+/// Parameters of the pods
+struct PodConfig
+{
+  uint32_t flows = 200;           ///< number of flows of a pod (one destination each)
+  uint32_t packets = 20000;       ///< data packets sent by a pod
+  double rate = 1e6;              ///< data packets per simulated second
+  uint32_t size = 200;            ///< packet size (IP header included)
+  double zipf = 1.0;              ///< Zipf skew of the flow popularity, 0 is uniform
+  double loss = 0.1;              ///< fraction of flows blackholed at s1
+  uint32_t topEntries = 10;       ///< FANCY dedicated counter entries
+};
+
+/// Destination address of flow i, one /24 per flow
+static Ipv4Address
+FlowDestination (uint32_t i)
+{
+  return Ipv4Address ((20u << 24) | ((i + 1) << 8) | 1);
+}
+
+/// Sends the pre-computed packet stream of a pod out of its host port
+class PacketStream
+{
+public:
+  PacketStream (const PodConfig &config, int64_t stream, Ptr<NetDevice> device,
+                Address dst, Ipv4Address src)
+    : m_device (device),
+      m_dst (dst),
+      m_next (0),
+      m_interval (Seconds (1.0 / config.rate))
+  {
+    for (uint32_t i = 0; i < config.flows; i++)
+      {
+        Ptr<Packet> packet = Create<Packet> (config.size - 28);
+        UdpHeader udp;
+        udp.SetSourcePort (1024 + (i % 50000));
+        udp.SetDestinationPort (7000);
+        packet->AddHeader (udp);
+        Ipv4Header ipv4;
+        ipv4.SetSource (src);
+        ipv4.SetDestination (FlowDestination (i));
+        ipv4.SetProtocol (17);
+        ipv4.SetPayloadSize (packet->GetSize ());
+        ipv4.SetTtl (64);
+        packet->AddHeader (ipv4);
+        m_prototypes.push_back (packet);
+      }
+
+    /* Zipf CDF over the flow ranks, sampled by inversion */
+    std::vector<double> cdf (config.flows);
+    double sum = 0;
+    for (uint32_t i = 0; i < config.flows; i++)
+      {
+        sum += 1.0 / std::pow (i + 1, config.zipf);
+        cdf[i] = sum;
+      }
+    /* The pod stream, not the rank, selects the random numbers */
+    Ptr<UniformRandomVariable> uniform = CreateObject<UniformRandomVariable> ();
+    uniform->SetStream (stream);
+    m_order.reserve (config.packets);
+    for (uint32_t i = 0; i < config.packets; i++)
+      {
+        double u = uniform->GetValue (0, sum);
+        uint32_t flow = std::upper_bound (cdf.begin (), cdf.end (), u) - cdf.begin ();
+        m_order.push_back (std::min (flow, config.flows - 1));
+      }
+  }
+
+  void Start (void)
+  {
+    Simulator::ScheduleWithContext (m_device->GetNode ()->GetId (), Seconds (0),
+                                    &PacketStream::Send, this);
+  }
+
+  uint64_t GetSent (void) const
+  {
+    return m_next;
+  }
+
+private:
+  void Send (void)
+  {
+    m_device->Send (m_prototypes[m_order[m_next]]->Copy (), m_dst, 0x0800);
+    m_next++;
+    if (m_next < m_order.size ())
+      {
+        Simulator::Schedule (m_interval, &PacketStream::Send, this);
+      }
+  }
+
+  Ptr<NetDevice> m_device;
+  Address m_dst;
+  std::vector<Ptr<Packet> > m_prototypes;
+  std::vector<uint32_t> m_order;
+  uint64_t m_next;
+  Time m_interval;
+};
+
+static uint64_t g_delivered = 0;
+
+static void
+PacketDelivered (Ptr<const Packet> packet)
+{
+  g_delivered++;
+}
+
+/// Installs a FANCY switch with a fixed id, whatever the switches installed before on this rank
+static Ptr<P4SwitchNetDevice>
+InstallSwitch (const PodConfig &config, uint32_t switchId, Ptr<Node> node,
+               NetDeviceContainer ports, std::string topFile)
+{
+  GlobalValue::Bind ("switchId", UintegerValue (switchId));
+  P4SwitchHelper helper ("ns3::P4SwitchFancy");
+  helper.SetDeviceAttribute ("EnableDebug", BooleanValue (false));
+  helper.SetDeviceAttribute ("NumTopEntries", UintegerValue (config.topEntries));
+  helper.SetDeviceAttribute ("TopFile", StringValue (topFile));
+  return DynamicCast<P4SwitchNetDevice> (helper.Install<P4SwitchFancy> (node, ports).Get (0));
+}
+
+int
+main (int argc, char *argv[])
+{
+  PodConfig config;
+  uint32_t pods = 8;
+  uint32_t seed = 1;
+  bool nullmsg = false;
+  Time coreDelay = MicroSeconds (10);
+
+  CommandLine cmd;
+  cmd.Usage ("Distributed simulation of independent FANCY pods.\n"
+             "\n"
+             "The two switches of every pod run on consecutive MPI ranks and\n"
+             "are connected by a remote full-duplex csma link.");
+  cmd.AddValue ("pods", "number of pods", pods);
+  cmd.AddValue ("flows", "number of flows of a pod", config.flows);
+  cmd.AddValue ("packets", "number of data packets of a pod", config.packets);
+  cmd.AddValue ("rate", "data packets per simulated second", config.rate);
+  cmd.AddValue ("size", "packet size in bytes", config.size);
+  cmd.AddValue ("zipf", "Zipf skew of the flow popularity (0 = uniform)", config.zipf);
+  cmd.AddValue ("loss", "fraction of the flows blackholed at s1", config.loss);
+  cmd.AddValue ("top-entries", "FANCY dedicated counter entries", config.topEntries);
+  cmd.AddValue ("core-delay", "delay of the s1 - s2 links, the lookahead of the ranks", coreDelay);
+  cmd.AddValue ("seed", "random seed", seed);
+  cmd.AddValue ("nullmsg", "use the null message synchronization", nullmsg);
+  cmd.Parse (argc, argv);
+
+  NS_ABORT_MSG_IF (pods == 0 || pods > 127, "Need between 1 and 127 pods, switch ids are 8 bits");
+  NS_ABORT_MSG_IF (config.flows == 0 || config.packets == 0, "Need at least one flow and packet");
+  NS_ABORT_MSG_IF (config.size < 28, "Packets need room for the IPv4 and UDP headers");
+  NS_ABORT_MSG_IF (config.topEntries > config.flows, "More top entries than flows");
+
+  if (nullmsg)
+    {
+      GlobalValue::Bind ("SimulatorImplementationType",
+                         StringValue ("ns3::NullMessageSimulatorImpl"));
+    }
+  else
+    {
+      GlobalValue::Bind ("SimulatorImplementationType",
+                         StringValue ("ns3::DistributedSimulatorImpl"));
+    }
+  MpiInterface::Enable (&argc, &argv);
+  uint32_t systemId = MpiInterface::GetSystemId ();
+  uint32_t systemCount = MpiInterface::GetSize ();
+
+  /* Globals the switches expect */
+  static GlobalValue g_switchId = GlobalValue ("switchId", "Global Switch Id", UintegerValue (1),
+                                               MakeUintegerChecker<uint8_t> ());
+  static GlobalValue g_debugGlobal = GlobalValue ("debugGlobal", "Is debug globally enabled?",
+                                                  BooleanValue (false), MakeBooleanChecker ());
+  Config::SetDefault ("ns3::P4SwitchNetDevice::ForwardingType",
+                      EnumValue (P4SwitchNetDevice::ForwardingType::L3_SPECIAL_FORWARDING));
+  Time::SetResolution (Time::PS);
+  RngSeedManager::SetSeed (seed);
+
+  /* FANCY dedicated entries are the most popular flows */
+  std::string topFile = (std::filesystem::temp_directory_path () /
+                         ("fancy-multi-pod-" + std::to_string (getpid ()) + ".top")).string ();
+  {
+    std::ofstream top (topFile);
+    for (uint32_t i = 0; i < config.topEntries; i++)
+      {
+        top << FlowDestination (i) << "\n";
+      }
+  }
+
+  /* Every rank creates all the nodes and links, in the same order, so that
+     the node ids and the device indexes used by the MPI messages match */
+  CsmaHelper csma;
+  csma.SetChannelAttribute ("DataRate", DataRateValue (DataRate ("100Gbps")));
+  csma.SetChannelAttribute ("Delay", TimeValue (MicroSeconds (1)));
+  csma.SetChannelAttribute ("FullDuplex", BooleanValue (true));
+  csma.SetQueue ("ns3::DropTailQueue", "MaxSize", StringValue ("100000p"));
+  CsmaHelper core = csma;
+  core.SetChannelAttribute ("Delay", TimeValue (coreDelay));
+  InternetStackHelper internet;
+  Ipv4AddressHelper ipv4 ("10.0.0.0", "255.255.255.0");
+
+  std::vector<PacketStream *> streams;
+  uint32_t localSwitches = 0;
+  for (uint32_t k = 0; k < pods; k++)
+    {
+      uint32_t rank1 = k % systemCount;
+      uint32_t rank2 = (k + 1) % systemCount;
+      Ptr<Node> h = CreateObject<Node> (rank1);
+      Ptr<Node> s1 = CreateObject<Node> (rank1);
+      Ptr<Node> s2 = CreateObject<Node> (rank2);
+      Ptr<Node> r = CreateObject<Node> (rank2);
+      /* The switches look at the names to find their neighbours,
+         only the switch names contain an 's' */
+      Names::Add ("h" + std::to_string (k), h);
+      Names::Add ("s1_" + std::to_string (k), s1);
+      Names::Add ("s2_" + std::to_string (k), s2);
+      Names::Add ("r" + std::to_string (k), r);
+
+      NetDeviceContainer link0 = csma.Install (NodeContainer (h, s1));
+      NetDeviceContainer link1 = core.Install (NodeContainer (s1, s2));
+      NetDeviceContainer link2 = csma.Install (NodeContainer (s2, r));
+
+      /* Hosts need an address before the switches fill their tables */
+      internet.Install (NodeContainer (h, r));
+      ipv4.Assign (NetDeviceContainer (link0.Get (0), link2.Get (1)));
+      ipv4.NewNetwork ();
+
+      /* Only the local switches run, the remote ones would send their
+         FANCY packets twice */
+      if (rank1 == systemId)
+        {
+          Ptr<P4SwitchNetDevice> sw1 = InstallSwitch (config, 2 * k + 1, s1,
+                                                      NetDeviceContainer (link0.Get (1), link1.Get (0)),
+                                                      topFile);
+          /* Blackhole a random subset of the flows at s1 */
+          std::vector<std::pair<uint32_t, Ptr<NetDevice> > > failures;
+          Ptr<UniformRandomVariable> uniform = CreateObject<UniformRandomVariable> ();
+          uniform->SetStream (2 * k);
+          for (uint32_t i = 0; i < config.flows; i++)
+            {
+              if (uniform->GetValue () < config.loss)
+                {
+                  failures.push_back (std::make_pair (FlowDestination (i).Get (), Ptr<NetDevice> ()));
+                }
+            }
+          sw1->L3SpecialForwardingSetFailures (failures);
+
+          Ptr<Ipv4> hIpv4 = h->GetObject<Ipv4> ();
+          PacketStream *stream = new PacketStream (config, 2 * k + 1, link0.Get (0),
+                                                   link0.Get (1)->GetAddress (),
+                                                   hIpv4->GetAddress (1, 0).GetLocal ());
+          stream->Start ();
+          streams.push_back (stream);
+          localSwitches++;
+        }
+      if (rank2 == systemId)
+        {
+          /* s2 needs a route to r per flow */
+          Ptr<P4SwitchNetDevice> sw2 = InstallSwitch (config, 2 * k + 2, s2,
+                                                      NetDeviceContainer (link1.Get (1), link2.Get (0)),
+                                                      topFile);
+          std::vector<std::pair<uint32_t, Ptr<NetDevice> > > routes;
+          for (uint32_t i = 0; i < config.flows; i++)
+            {
+              routes.push_back (std::make_pair (FlowDestination (i).Get (), link2.Get (0)));
+            }
+          sw2->L3SpecialForwardingRemoveFailures (routes);
+          link2.Get (1)->TraceConnectWithoutContext ("MacRx", MakeCallback (&PacketDelivered));
+          localSwitches++;
+        }
+    }
+
+  Simulator::Stop (Seconds (config.packets / config.rate) + MilliSeconds (10));
+  auto start = std::chrono::steady_clock::now ();
+  Simulator::Run ();
+  auto end = std::chrono::steady_clock::now ();
+  double wallSeconds = std::chrono::duration<double> (end - start).count ();
+
+  uint64_t sent = 0;
+  for (auto stream : streams)
+    {
+      sent += stream->GetSent ();
+    }
+  uint64_t localSent = sent;
+  uint64_t localDelivered = g_delivered;
+  uint64_t totalSent = 0;
+  uint64_t totalDelivered = 0;
+  double maxWallSeconds = 0;
+  MPI_Reduce (&localSent, &totalSent, 1, MPI_UINT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
+  MPI_Reduce (&localDelivered, &totalDelivered, 1, MPI_UINT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
+  MPI_Reduce (&wallSeconds, &maxWallSeconds, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+  std::cout << "rank " << systemId << ": " << localSwitches << " switches, "
+            << localSent << " sent, " << localDelivered << " delivered, "
+            << wallSeconds << " s" << std::endl;
+  if (systemId == 0)
+    {
+      std::cout << "pods " << pods << ", ranks " << systemCount << ": "
+                << totalSent << " sent, " << totalDelivered << " delivered, "
+                << maxWallSeconds << " s wall time, "
+                << totalSent / maxWallSeconds << " pkt/s" << std::endl;
+    }
+
+  Simulator::Destroy ();
+  for (auto stream : streams)
+    {
+      delete stream;
+    }
+  Names::Clear ();
+  std::filesystem::remove (topFile);
+  MpiInterface::Disable ();
+  return 0;
+}
@@ -0,0 +1,138 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "l2-learning-table.h"
+#include "ns3/log.h"
+
+namespace ns3 {
+
+  NS_LOG_COMPONENT_DEFINE("L2LearningTable");
+
+  static const uint32_t g_initialBits = 6;
+
+  L2LearningTable::L2LearningTable(uint32_t wheel_slots)
+    : m_entries(1 << g_initialBits),
+    m_mask((1 << g_initialBits) - 1),
+    m_shift(64 - g_initialBits),
+    m_wheel(wheel_slots + 1)
+  {
+    NS_ASSERT_MSG(wheel_slots > 0, "The aging wheel needs at least one slot");
+  }
+
+  uint64_t
+    L2LearningTable::Find(uint64_t mac) const
+  {
+    uint64_t i = Hash(mac);
+    while (m_entries[i].mac != mac && m_entries[i].mac != EMPTY)
+    {
+      i = (i + 1) & m_mask;
+    }
+    return i;
+  }
+
+  void
+    L2LearningTable::Learn(uint64_t mac, uint32_t port)
+  {
+    uint64_t i = Find(mac);
+    entry& e = m_entries[i];
+    if (e.mac == EMPTY)
+    {
+      e.mac = mac;
+      m_size++;
+    }
+    else if (e.epoch == m_epoch)
+    {
+      /* Already in this tick's slot */
+      e.port = port;
+      return;
+    }
+    e.port = port;
+    e.epoch = m_epoch;
+    m_wheel[m_epoch % m_wheel.size()].push_back(mac);
+
+    /* Keep the load factor under 1/2 */
+    if (2 * m_size > m_entries.size())
+    {
+      Grow();
+    }
+  }
+
+  uint32_t
+    L2LearningTable::Tick(void)
+  {
+    m_epoch++;
+    /* This slot was last filled wheel_slots + 1 ticks ago */
+    std::vector<uint64_t>& slot = m_wheel[m_epoch % m_wheel.size()];
+    uint32_t expired = 0;
+    for (uint64_t mac : slot)
+    {
+      uint64_t i = Find(mac);
+      if (m_entries[i].mac == mac && m_epoch - m_entries[i].epoch >= m_wheel.size())
+      {
+        Erase(i);
+        expired++;
+      }
+    }
+    slot.clear();
+    NS_LOG_DEBUG("Aging tick " << m_epoch << " expired " << expired << " entries, " << m_size << " left");
+    return expired;
+  }
+
+  void
+    L2LearningTable::Erase(uint64_t index)
+  {
+    /* Backward shift: move up the entries whose probe sequence crosses the hole */
+    uint64_t hole = index;
+    for (uint64_t i = (hole + 1) & m_mask; m_entries[i].mac != EMPTY; i = (i + 1) & m_mask)
+    {
+      uint64_t home = Hash(m_entries[i].mac);
+      if (((i - home) & m_mask) >= ((i - hole) & m_mask))
+      {
+        m_entries[hole] = m_entries[i];
+        hole = i;
+      }
+    }
+    m_entries[hole] = entry();
+    m_size--;
+  }
+
+  void
+    L2LearningTable::Grow(void)
+  {
+    std::vector<entry> old;
+    old.swap(m_entries);
+    m_entries.resize(old.size() * 2);
+    m_mask = m_entries.size() - 1;
+    m_shift--;
+    for (const entry& e : old)
+    {
+      if (e.mac != EMPTY)
+      {
+        m_entries[Find(e.mac)] = e;
+      }
+    }
+  }
+
+  uint32_t
+    L2LearningTable::GetWheelSlots(void) const
+  {
+    return m_wheel.size() - 1;
+  }
+
+  uint32_t
+    L2LearningTable::GetSize(void) const
+  {
+    return m_size;
+  }
+
+  void
+    L2LearningTable::Clear(void)
+  {
+    m_entries.assign(m_entries.size(), entry());
+    m_size = 0;
+    for (auto& slot : m_wheel)
+    {
+      slot.clear();
+    }
+  }
+
+} // namespace ns3
@@ -0,0 +1,101 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef L2_LEARNING_TABLE_H
+#define L2_LEARNING_TABLE_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "ns3/mac48-address.h"
+
+namespace ns3 {
+
+  /* MAC learning table of the switches.
+   *
+   * Open addressing hash table (linear probing, backward shift deletion)
+   * from the 48 bit MAC value to a switch port number. Lookups do not
+   * look at the time: entries are aged by a coarse wheel that the owner
+   * advances with Tick every expiration_time / wheel_slots. An entry that
+   * is not refreshed is forgotten between wheel_slots and wheel_slots + 1
+   * ticks after its last Learn.
+   */
+  class L2LearningTable
+  {
+  public:
+    static constexpr uint32_t NO_PORT = 0xffffffff;
+
+    L2LearningTable(uint32_t wheel_slots = 8);
+
+    static inline uint64_t MacToKey(Mac48Address mac)
+    {
+      uint8_t buffer[6];
+      mac.CopyTo(buffer);
+      uint64_t key = 0;
+      for (int i = 0; i < 6; i++)
+      {
+        key = (key << 8) | buffer[i];
+      }
+      return key;
+    }
+
+    /* Adds or refreshes the port of a MAC */
+    void Learn(uint64_t mac, uint32_t port);
+    /* NO_PORT when the MAC is unknown */
+    inline uint32_t Lookup(uint64_t mac) const
+    {
+      for (uint64_t i = Hash(mac);; i = (i + 1) & m_mask)
+      {
+        const entry& e = m_entries[i];
+        if (e.mac == mac)
+        {
+          return e.port;
+        }
+        if (e.mac == EMPTY)
+        {
+          return NO_PORT;
+        }
+      }
+    }
+
+    /* Advances the wheel one slot, returns the number of expired entries */
+    uint32_t Tick(void);
+
+    uint32_t GetWheelSlots(void) const;
+    uint32_t GetSize(void) const;
+    void Clear(void);
+
+  private:
+    /* MACs only use 48 bits */
+    static constexpr uint64_t EMPTY = ~uint64_t(0);
+
+    struct entry
+    {
+      uint64_t mac = EMPTY;
+      uint32_t port = NO_PORT;
+      /* Tick of the last refresh */
+      uint32_t epoch = 0;
+    };
+
+    inline uint64_t Hash(uint64_t mac) const
+    {
+      return (mac * 0x9E3779B97F4A7C15ULL) >> m_shift;
+    }
+
+    /* Index of the entry or of the empty slot ending its probe sequence */
+    uint64_t Find(uint64_t mac) const;
+    void Erase(uint64_t index);
+    void Grow(void);
+
+    std::vector<entry> m_entries;
+    uint64_t m_mask;
+    uint32_t m_shift;
+    uint32_t m_size = 0;
+
+    uint32_t m_epoch = 0;
+    /* MACs refreshed at every tick, stale records are skipped when the
+       slot comes around */
+    std::vector<std::vector<uint64_t>> m_wheel;
+  };
+
+} // namespace ns3
+
+#endif /* L2_LEARNING_TABLE_H */
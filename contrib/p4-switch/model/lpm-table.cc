@@ -0,0 +1,268 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "lpm-table.h"
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/abort.h"
+
+#include <algorithm>
+
+namespace ns3 {
+
+  NS_LOG_COMPONENT_DEFINE("LpmTable");
+
+  void
+    LpmTable::Insert(uint32_t prefix, uint8_t length, uint16_t next_hop)
+  {
+    NS_ASSERT_MSG(length <= 32, "Invalid prefix length " << uint32_t(length));
+    NS_ASSERT_MSG(next_hop != NO_ROUTE && next_hop <= MAX_NEXT_HOP, "Invalid next hop " << next_hop);
+
+    if (m_tbl24.empty() && (!m_compact || length <= 24))
+    {
+      m_tbl24.resize(1 << 24, 0);
+      for (auto const& e : m_sparse24)
+      {
+        m_tbl24[e.first] = e.second;
+      }
+      m_sparse24.clear();
+    }
+
+    prefix &= Mask(length);
+    auto inserted = m_routes[length].insert({ prefix, next_hop });
+    if (inserted.second)
+    {
+      m_nRoutes++;
+    }
+    else
+    {
+      inserted.first->second = next_hop;
+    }
+
+    uint16_t entry = MakeEntry(length, next_hop);
+    if (length <= 24)
+    {
+      Fill(prefix >> 8, 1 << (24 - length), length, entry, false);
+    }
+    else
+    {
+      uint32_t index24 = prefix >> 8;
+      uint16_t e = Get24(index24);
+      uint32_t group = (e & EXTENDED) ? (e & GROUP_MASK) : AllocGroup(e);
+      Set24(index24, EXTENDED | group);
+      FillGroup(group, prefix & 0xff, 1 << (32 - length), length, entry, false);
+    }
+  }
+
+  bool
+    LpmTable::Remove(uint32_t prefix, uint8_t length)
+  {
+    NS_ASSERT_MSG(length <= 32, "Invalid prefix length " << uint32_t(length));
+
+    prefix &= Mask(length);
+    if (m_routes[length].erase(prefix) == 0)
+    {
+      return false;
+    }
+    m_nRoutes--;
+
+    /* Entries of this route go back to the covering one */
+    uint16_t entry = CoveringEntry(prefix, length);
+    if (length <= 24)
+    {
+      Fill(prefix >> 8, 1 << (24 - length), length, entry, true);
+    }
+    else
+    {
+      uint32_t index24 = prefix >> 8;
+      uint16_t e = Get24(index24);
+      NS_ASSERT(e & EXTENDED);
+      FillGroup(e & GROUP_MASK, prefix & 0xff, 1 << (32 - length), length, entry, true);
+      MaybeFreeGroup(index24);
+    }
+    return true;
+  }
+
+  void
+    LpmTable::SetCompact(bool compact)
+  {
+    NS_ASSERT_MSG(m_nRoutes == 0, "The layout is chosen before the first insert");
+    m_compact = compact;
+  }
+
+  void
+    LpmTable::Insert(std::vector<lpm_route> routes)
+  {
+    /* Covering routes first, groups are then allocated with their final default */
+    std::stable_sort(routes.begin(), routes.end(),
+      [](const lpm_route& a, const lpm_route& b) { return a.length < b.length; });
+    for (auto const& route : routes)
+    {
+      Insert(route.prefix, route.length, route.next_hop);
+    }
+  }
+
+  void
+    LpmTable::Remove(std::vector<lpm_route> routes)
+  {
+    /* Longer routes first, so groups are freed as soon as possible */
+    std::stable_sort(routes.begin(), routes.end(),
+      [](const lpm_route& a, const lpm_route& b) { return a.length > b.length; });
+    for (auto const& route : routes)
+    {
+      Remove(route.prefix, route.length);
+    }
+  }
+
+  uint16_t
+    LpmTable::Get24(uint32_t index24) const
+  {
+    if (!m_tbl24.empty())
+    {
+      return m_tbl24[index24];
+    }
+    auto it = m_sparse24.find(index24);
+    return it == m_sparse24.end() ? 0 : it->second;
+  }
+
+  void
+    LpmTable::Set24(uint32_t index24, uint16_t e)
+  {
+    if (!m_tbl24.empty())
+    {
+      m_tbl24[index24] = e;
+    }
+    else if (e == 0)
+    {
+      m_sparse24.erase(index24);
+    }
+    else
+    {
+      /* Without routes up to /24 the only non empty entries are groups */
+      NS_ASSERT(e & EXTENDED);
+      m_sparse24[index24] = e;
+    }
+  }
+
+  void
+    LpmTable::Fill(uint32_t first, uint32_t count, uint8_t length, uint16_t entry, bool replace)
+  {
+    for (uint32_t i = first; i < first + count; i++)
+    {
+      uint16_t e = m_tbl24[i];
+      if (e & EXTENDED)
+      {
+        FillGroup(e & GROUP_MASK, 0, 256, length, entry, replace);
+        if (replace)
+        {
+          MaybeFreeGroup(i);
+        }
+      }
+      else if (replace ? EntryLength(e) == length : EntryLength(e) <= length)
+      {
+        m_tbl24[i] = entry;
+      }
+    }
+  }
+
+  void
+    LpmTable::FillGroup(uint32_t group, uint32_t first, uint32_t count, uint8_t length, uint16_t entry, bool replace)
+  {
+    uint16_t* entries = &m_tbl8[group << 8];
+    for (uint32_t i = first; i < first + count; i++)
+    {
+      uint8_t e_length = EntryLength(entries[i]);
+      if (replace ? e_length == length : e_length <= length)
+      {
+        entries[i] = entry;
+      }
+    }
+  }
+
+  uint32_t
+    LpmTable::AllocGroup(uint16_t entry)
+  {
+    uint32_t group;
+    if (!m_freeGroups.empty())
+    {
+      group = m_freeGroups.back();
+      m_freeGroups.pop_back();
+    }
+    else
+    {
+      group = m_tbl8.size() >> 8;
+      NS_ABORT_MSG_IF(group > GROUP_MASK, "Out of tbl8 groups");
+      m_tbl8.resize(m_tbl8.size() + 256);
+    }
+    std::fill(m_tbl8.begin() + (group << 8), m_tbl8.begin() + ((group + 1) << 8), entry);
+    return group;
+  }
+
+  void
+    LpmTable::MaybeFreeGroup(uint32_t index24)
+  {
+    uint32_t group = Get24(index24) & GROUP_MASK;
+    const uint16_t* entries = &m_tbl8[group << 8];
+    /* Routes longer than /24 have to stay in the group to be removable */
+    if (EntryLength(entries[0]) > 24)
+    {
+      return;
+    }
+    for (uint32_t i = 1; i < 256; i++)
+    {
+      if (entries[i] != entries[0])
+      {
+        return;
+      }
+    }
+    Set24(index24, entries[0]);
+    m_freeGroups.push_back(group);
+  }
+
+  uint16_t
+    LpmTable::CoveringEntry(uint32_t prefix, uint8_t length) const
+  {
+    for (int l = int(length) - 1; l >= 0; l--)
+    {
+      auto it = m_routes[l].find(prefix & Mask(l));
+      if (it != m_routes[l].end())
+      {
+        return MakeEntry(l, it->second);
+      }
+    }
+    return 0;
+  }
+
+  uint16_t
+    LpmTable::GetRoute(uint32_t prefix, uint8_t length) const
+  {
+    auto it = m_routes[length].find(prefix & Mask(length));
+    return it == m_routes[length].end() ? NO_ROUTE : it->second;
+  }
+
+  uint32_t
+    LpmTable::GetNRoutes(void) const
+  {
+    return m_nRoutes;
+  }
+
+  uint32_t
+    LpmTable::GetNGroups(void) const
+  {
+    return (m_tbl8.size() >> 8) - m_freeGroups.size();
+  }
+
+  void
+    LpmTable::Clear(void)
+  {
+    std::vector<uint16_t>().swap(m_tbl24);
+    m_sparse24.clear();
+    std::vector<uint16_t>().swap(m_tbl8);
+    m_freeGroups.clear();
+    for (auto& routes : m_routes)
+    {
+      routes.clear();
+    }
+    m_nRoutes = 0;
+  }
+
+} // namespace ns3
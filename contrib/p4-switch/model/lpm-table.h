@@ -0,0 +1,129 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef LPM_TABLE_H
+#define LPM_TABLE_H
+
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+
+namespace ns3 {
+
+  /* IPv4 longest prefix match table, DIR-24-8 layout.
+   *
+   * tbl24 has one 16 bit entry per /24. Routes up to /24 are expanded in
+   * it, a /24 with longer routes points to a group of 256 tbl8 entries,
+   * so a lookup reads at most two entries. Entries keep the length of
+   * the route they come from, which is how inserts know what they may
+   * overwrite. The routes themselves are also kept per length to find
+   * the covering route when one is removed.
+   *
+   * Next hops are opaque values in [1, MAX_NEXT_HOP], 0 means no route.
+   * tbl24 (32 MiB) is allocated by the first insert. A compact table
+   * only allocates it for the first route up to /24: until then, as with
+   * host routes only, the /24s with longer routes are found through a
+   * hash map of their tbl24 entries, which saves the memory but costs a
+   * hash probe per lookup.
+   */
+  class LpmTable
+  {
+  public:
+    static constexpr uint16_t NO_ROUTE = 0;
+    static constexpr uint16_t MAX_NEXT_HOP = 0x1ff;
+
+    struct lpm_route
+    {
+      uint32_t prefix;
+      uint8_t length;
+      uint16_t next_hop;
+    };
+
+    inline uint16_t Lookup(uint32_t addr) const
+    {
+      uint16_t e;
+      if (!m_tbl24.empty())
+      {
+        e = m_tbl24[addr >> 8];
+      }
+      else
+      {
+        auto it = m_sparse24.find(addr >> 8);
+        if (it == m_sparse24.end())
+        {
+          return NO_ROUTE;
+        }
+        e = it->second;
+      }
+      if (e & EXTENDED)
+      {
+        e = m_tbl8[(uint32_t(e & GROUP_MASK) << 8) | (addr & 0xff)];
+      }
+      return e & NEXT_HOP_MASK;
+    }
+
+    /* Set before the first insert, kept by Clear */
+    void SetCompact(bool compact);
+    /* Adds or replaces a route */
+    void Insert(uint32_t prefix, uint8_t length, uint16_t next_hop);
+    /* Returns false if the route did not exist */
+    bool Remove(uint32_t prefix, uint8_t length);
+    /* Batched versions, shorter prefixes are applied first */
+    void Insert(std::vector<lpm_route> routes);
+    void Remove(std::vector<lpm_route> routes);
+
+    /* Next hop of an exact route, NO_ROUTE if it does not exist */
+    uint16_t GetRoute(uint32_t prefix, uint8_t length) const;
+    uint32_t GetNRoutes(void) const;
+    uint32_t GetNGroups(void) const;
+    /* Frees all the memory */
+    void Clear(void);
+
+    static inline uint32_t Mask(uint8_t length)
+    {
+      return length == 0 ? 0 : ~uint32_t(0) << (32 - length);
+    }
+
+  private:
+    /* Entry layout: extended flag | route length (6 bits) | next hop (9 bits),
+       extended tbl24 entries hold a tbl8 group index instead */
+    static constexpr uint16_t EXTENDED = 0x8000;
+    static constexpr uint16_t GROUP_MASK = 0x7fff;
+    static constexpr uint16_t NEXT_HOP_MASK = 0x1ff;
+    static constexpr uint32_t DEPTH_SHIFT = 9;
+
+    static inline uint16_t MakeEntry(uint8_t length, uint16_t next_hop)
+    {
+      return next_hop == NO_ROUTE ? 0 : (uint16_t(length) << DEPTH_SHIFT) | next_hop;
+    }
+
+    static inline uint8_t EntryLength(uint16_t e)
+    {
+      return (e >> DEPTH_SHIFT) & 0x3f;
+    }
+
+    /* tbl24 entry, from the hash map while tbl24 is not allocated */
+    uint16_t Get24(uint32_t index24) const;
+    void Set24(uint32_t index24, uint16_t e);
+    /* Sets the entries in [first, first + count) that come from a route
+       of length accordingly to replace (<= length on insert, == on remove) */
+    void Fill(uint32_t first, uint32_t count, uint8_t length, uint16_t entry, bool replace);
+    void FillGroup(uint32_t group, uint32_t first, uint32_t count, uint8_t length, uint16_t entry, bool replace);
+    uint32_t AllocGroup(uint16_t entry);
+    /* Back to a single tbl24 entry if all the group entries are equal */
+    void MaybeFreeGroup(uint32_t index24);
+    /* Longest route strictly shorter than length covering prefix */
+    uint16_t CoveringEntry(uint32_t prefix, uint8_t length) const;
+
+    std::vector<uint16_t> m_tbl24;
+    /* Non empty tbl24 entries while m_tbl24 is not allocated, all extended */
+    std::unordered_map<uint32_t, uint16_t> m_sparse24;
+    std::vector<uint16_t> m_tbl8;
+    std::vector<uint32_t> m_freeGroups;
+    /* prefix -> next hop, per route length */
+    std::unordered_map<uint32_t, uint16_t> m_routes[33];
+    uint32_t m_nRoutes = 0;
+    bool m_compact = false;
+  };
+
+} // namespace ns3
+
+#endif /* LPM_TABLE_H */
@@ -0,0 +1,203 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "nat-table.h"
+#include "ns3/log.h"
+#include "ns3/assert.h"
+
+namespace ns3 {
+
+  NS_LOG_COMPONENT_DEFINE("NatTable");
+
+  NatTable::NatTable(uint32_t capacity, uint32_t wheel_slots)
+    : m_wheel(wheel_slots + 1)
+  {
+    NS_ASSERT_MSG(wheel_slots > 0, "The timing wheel needs at least one slot");
+    Reserve(capacity);
+  }
+
+  void
+    NatTable::Reserve(uint32_t capacity)
+  {
+    NS_ASSERT_MSG(capacity > 0, "The NAT table needs at least one slot");
+    m_slots.assign(capacity, nat_slot());
+    m_freeSlots.resize(capacity);
+    for (uint32_t i = 0; i < capacity; i++)
+    {
+      /* Lowest slots are used first */
+      m_freeSlots[i] = capacity - 1 - i;
+    }
+    m_size = 0;
+    for (auto& position : m_wheel)
+    {
+      position.clear();
+    }
+    Rehash();
+  }
+
+  uint32_t
+    NatTable::Find(const flow_key& key) const
+  {
+    uint32_t i = Hash(key);
+    while (m_index[i] != EMPTY && !(m_slots[m_index[i]].key == key))
+    {
+      i = (i + 1) & m_mask;
+    }
+    return i;
+  }
+
+  void
+    NatTable::Touch(uint32_t slot)
+  {
+    nat_slot& s = m_slots[slot];
+    if (s.epoch != m_epoch)
+    {
+      s.epoch = m_epoch;
+      m_wheel[m_epoch % m_wheel.size()].push_back(slot);
+    }
+  }
+
+  void
+    NatTable::Insert(const flow_key& key, uint32_t ip)
+  {
+    uint32_t position = Find(key);
+    if (m_index[position] != EMPTY)
+    {
+      m_slots[m_index[position]].ip = ip;
+      Touch(m_index[position]);
+      return;
+    }
+
+    if (m_freeSlots.empty())
+    {
+      Grow();
+      position = Find(key);
+    }
+    uint32_t slot = m_freeSlots.back();
+    m_freeSlots.pop_back();
+
+    nat_slot& s = m_slots[slot];
+    s.key = key;
+    s.ip = ip;
+    s.used = true;
+    /* Force the wheel record */
+    s.epoch = m_epoch - 1;
+    Touch(slot);
+
+    m_index[position] = slot;
+    m_size++;
+  }
+
+  bool
+    NatTable::Lookup(const flow_key& key, uint32_t& ip)
+  {
+    uint32_t position = Find(key);
+    if (m_index[position] == EMPTY)
+    {
+      return false;
+    }
+    uint32_t slot = m_index[position];
+    ip = m_slots[slot].ip;
+    Touch(slot);
+    return true;
+  }
+
+  uint32_t
+    NatTable::Tick(void)
+  {
+    m_epoch++;
+    /* Slots used wheel_slots + 1 ticks ago, some were used again since */
+    std::vector<uint32_t>& position = m_wheel[m_epoch % m_wheel.size()];
+    uint32_t expired = 0;
+    for (uint32_t slot : position)
+    {
+      nat_slot& s = m_slots[slot];
+      if (s.used && m_epoch - s.epoch >= m_wheel.size())
+      {
+        Erase(Find(s.key));
+        expired++;
+      }
+    }
+    position.clear();
+    NS_LOG_DEBUG("Expiration tick " << m_epoch << " removed " << expired << " translations, " << m_size << " left");
+    return expired;
+  }
+
+  void
+    NatTable::Erase(uint32_t position)
+  {
+    uint32_t slot = m_index[position];
+    m_slots[slot].used = false;
+    m_freeSlots.push_back(slot);
+    m_size--;
+
+    /* Backward shift: move up the positions whose probe sequence crosses the hole */
+    uint32_t hole = position;
+    for (uint32_t i = (hole + 1) & m_mask; m_index[i] != EMPTY; i = (i + 1) & m_mask)
+    {
+      uint32_t home = Hash(m_slots[m_index[i]].key);
+      if (((i - home) & m_mask) >= ((i - hole) & m_mask))
+      {
+        m_index[hole] = m_index[i];
+        hole = i;
+      }
+    }
+    m_index[hole] = EMPTY;
+  }
+
+  void
+    NatTable::Grow(void)
+  {
+    uint32_t old_capacity = m_slots.size();
+    NS_LOG_WARN("NAT table full, growing from " << old_capacity << " slots");
+    m_slots.resize(old_capacity * 2);
+    for (uint32_t i = m_slots.size(); i > old_capacity; i--)
+    {
+      m_freeSlots.push_back(i - 1);
+    }
+    Rehash();
+  }
+
+  void
+    NatTable::Rehash(void)
+  {
+    uint32_t size = 2;
+    while (size < 2 * m_slots.size())
+    {
+      size <<= 1;
+    }
+    m_index.assign(size, EMPTY);
+    m_mask = size - 1;
+    for (uint32_t slot = 0; slot < m_slots.size(); slot++)
+    {
+      if (m_slots[slot].used)
+      {
+        m_index[Find(m_slots[slot].key)] = slot;
+      }
+    }
+  }
+
+  uint32_t
+    NatTable::GetWheelSlots(void) const
+  {
+    return m_wheel.size() - 1;
+  }
+
+  uint32_t
+    NatTable::GetSize(void) const
+  {
+    return m_size;
+  }
+
+  uint32_t
+    NatTable::GetCapacity(void) const
+  {
+    return m_slots.size();
+  }
+
+  void
+    NatTable::Clear(void)
+  {
+    Reserve(m_slots.size());
+  }
+
+} // namespace ns3
@@ -0,0 +1,80 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef NAT_TABLE_H
+#define NAT_TABLE_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "p4-switch-utils.h"
+
+namespace ns3 {
+
+  /* Translation table of the NAT switch, translated flow -> original ip.
+   *
+   * Translations live in a preallocated pool of slots, found through an
+   * open addressing index of slot numbers keyed by the packed five tuple.
+   * The pool doubles if it runs out. Expiration uses a timing wheel the
+   * owner advances with Tick every timeout / wheel_slots: every slot is
+   * recorded in the wheel position of the tick it was last used in, so a
+   * tick only visits the translations that may have expired. A
+   * translation not used for wheel_slots + 1 ticks is removed.
+   */
+  class NatTable
+  {
+  public:
+    NatTable(uint32_t capacity = 1024, uint32_t wheel_slots = 8);
+
+    /* Preallocates the slots, drops all the translations */
+    void Reserve(uint32_t capacity);
+
+    /* Adds or refreshes a translation */
+    void Insert(const flow_key& key, uint32_t ip);
+    /* Original ip of a translated flow, refreshes it. False if unknown */
+    bool Lookup(const flow_key& key, uint32_t& ip);
+
+    /* Advances the wheel one position, returns the number of expired translations */
+    uint32_t Tick(void);
+
+    uint32_t GetWheelSlots(void) const;
+    uint32_t GetSize(void) const;
+    uint32_t GetCapacity(void) const;
+    void Clear(void);
+
+  private:
+    static constexpr uint32_t EMPTY = 0xffffffff;
+
+    struct nat_slot
+    {
+      flow_key key;
+      uint32_t ip = 0;
+      /* Tick of the last use */
+      uint32_t epoch = 0;
+      bool used = false;
+    };
+
+    inline uint32_t Hash(const flow_key& key) const
+    {
+      return flow_key_hash()(key) & m_mask;
+    }
+
+    /* Index position of the key or of the empty position ending its probe sequence */
+    uint32_t Find(const flow_key& key) const;
+    void Touch(uint32_t slot);
+    void Erase(uint32_t position);
+    void Grow(void);
+    void Rehash(void);
+
+    std::vector<nat_slot> m_slots;
+    std::vector<uint32_t> m_freeSlots;
+    /* Slot numbers, kept at most half full */
+    std::vector<uint32_t> m_index;
+    uint32_t m_mask = 0;
+    uint32_t m_size = 0;
+
+    uint32_t m_epoch = 0;
+    std::vector<std::vector<uint32_t>> m_wheel;
+  };
+
+} // namespace ns3
+
+#endif /* NAT_TABLE_H */
@@ -62,6 +62,70 @@ namespace ns3 {
   Id m_numberTopEntries+1 belongs to a global dedicated counter.
 */
 
+  void
+    CounterTree::Allocate(uint32_t num_nodes, uint32_t counter_width, uint32_t tree_depth,
+      uint32_t layer_split, uint32_t bloom_filter_width)
+  {
+    nodes = num_nodes;
+    width = counter_width;
+    depth = tree_depth;
+    split = layer_split;
+    bloom_width = bloom_filter_width;
+    bloom_words = (bloom_filter_width + 63) / 64;
+
+    counters.assign(nodes * width, 0);
+    last_flow.assign(nodes * width, ip_five_tuple());
+    hashed_flows.assign(nodes * width, flow_key_map());
+    flows_seen.assign(nodes * width, 0);
+    bloom_filter.assign(nodes * width * bloom_words, 0);
+    max_cells.assign(nodes * depth * split, 0);
+    sample_size = 0;
+    offered.clear();
+    sample_keys.clear();
+  }
+
+  void
+    CounterTree::AllocateReservoir(uint32_t reservoir_size)
+  {
+    sample_size = reservoir_size;
+    offered.assign(nodes * width * OFFERED_WORDS, 0);
+    sample_keys.assign(nodes * width * sample_size, flow_key());
+  }
+
+  void
+    CounterTree::Reset(bool clear_flows)
+  {
+    if (counters.empty())
+    {
+      return;
+    }
+    std::memset(counters.data(), 0, counters.size() * sizeof(uint32_t));
+    std::memset(bloom_filter.data(), 0, bloom_filter.size() * sizeof(uint64_t));
+    if (clear_flows)
+    {
+      std::memset(flows_seen.data(), 0, flows_seen.size() * sizeof(uint32_t));
+      if (!offered.empty())
+      {
+        std::memset(offered.data(), 0, offered.size() * sizeof(uint64_t));
+      }
+      for (auto& flows : hashed_flows)
+      {
+        if (!flows.empty())
+        {
+          flows.clear();
+        }
+      }
+    }
+  }
+
+  void
+    CounterTree::ShiftMaxHistory(uint32_t node)
+  {
+    uint8_t* history = MaxCells(node, 0);
+    std::memmove(history + split, history, (depth - 1) * split);
+    std::memset(history, 0, split);
+  }
+
   TypeId
     P4SwitchFancy::GetTypeId(void)
   {
@@ -129,6 +193,14 @@ namespace ns3 {
         UintegerValue(1),
         MakeUintegerAccessor(&P4SwitchFancy::m_costType),
         MakeUintegerChecker<uint16_t>())
+      .AddAttribute("FlowAttribution", "Flows kept per tree cell for failure reports: 0 = off, 1 = reservoir sample, 2 = full.",
+        UintegerValue(2),
+        MakeUintegerAccessor(&P4SwitchFancy::m_flowAttribution),
+        MakeUintegerChecker<uint16_t>(0, 2))
+      .AddAttribute("FlowAttributionSampleSize", "Flows sampled per tree cell when the flow attribution is a reservoir.",
+        UintegerValue(8),
+        MakeUintegerAccessor(&P4SwitchFancy::m_flowAttributionSampleSize),
+        MakeUintegerChecker<uint32_t>(1))
       .AddAttribute("RerouteMinCost", "Min Cost to Reroute Something.",
         DoubleValue(0),
         MakeDoubleAccessor(&P4SwitchFancy::m_rerouteMinCost),
@@ -179,7 +251,7 @@ namespace ns3 {
         MakeStringChecker())
       .AddAttribute("OutFile", "Name of the output file for the data generated.",
         StringValue(""),
-        MakeStringAccessor(&P4SwitchFancy::m_outFile),
+        MakeStringAccessor(&P4SwitchFancy::GetOutFile, &P4SwitchFancy::SetOutFile),
         MakeStringChecker())
       .AddAttribute("EnableSaveDrops", "Enable saving all the drop timestamps into a file.",
         BooleanValue(false),
@@ -198,10 +270,7 @@ namespace ns3 {
   }
 
   P4SwitchFancy::P4SwitchFancy()
-    :
-    header_stack_reverse(header_stack)
   {
-    std::reverse(header_stack_reverse.begin(), header_stack_reverse.end());
   }
 
   P4SwitchFancy::~P4SwitchFancy()
@@ -215,7 +284,7 @@ namespace ns3 {
     if (m_outFile != "")
     {
       // save detections
-      m_simState->SaveInJson(m_outFile);
+      m_simState->Close();
 
       // save packet drops
       if (m_drop_times.size() > 0)
@@ -249,20 +318,47 @@ namespace ns3 {
     return m_hash->GetHash(s, 4, hash_index, modulo);
   }
 
+  /* Per packet hashes: indexes [0, m_treeDepth) are the counter indexes of
+     each tree level, [m_treeDepth, 2*m_treeDepth) the indexes of the counter
+     bloom filters. They only depend on the flow, so we compute them the first
+     time a stage needs them and reuse them for the rest of the pipeline */
+  void
+    P4SwitchFancy::ComputePacketHashes(pkt_info& meta)
+  {
+    if (meta.hashes_set)
+    {
+      return;
+    }
+
+    /* Same as calling m_packet_hash for every index, but the flow buffer
+       is built once and all the seeds are hashed in one batch */
+    char s[13];
+    (*m_packet_buffer_funct)(s, meta.flow);
+    m_hash->GetHashes(s, m_packet_buffer_size, 0, m_treeDepth * 2, meta.hashes);
+
+    for (uint32_t i = 0; i < m_treeDepth; i++)
+    {
+      meta.hashes[i] = meta.hashes[i] % m_counterWidth;
+      meta.hashes[i + m_treeDepth] = meta.hashes[i + m_treeDepth] % m_counterBloomFilterWidth;
+    }
+    meta.hashes_set = true;
+  }
+
   /* Bloom filter hashes */
   void
-    P4SwitchFancy::GetBloomFilterHashes(ip_five_tuple& ip_five_tuple, uint32_t hash_indexes[], int unit_modulo, int bloom_filter_modulo)
+    P4SwitchFancy::GetBloomFilterHashes(pkt_info& meta, uint32_t hash_indexes[], int bloom_filter_modulo)
   {
+    ComputePacketHashes(meta);
+
     char s[m_treeDepth];
-    char* ptr = s;
     for (uint32_t i = 0; i < m_treeDepth; i++)
     {
-      uint8_t h = uint8_t((this->*m_packet_hash)(ip_five_tuple, i, unit_modulo));
-      std::memcpy(ptr + (i), &h, 1);
+      s[i] = char(uint8_t(meta.hashes[i]));
     }
+    m_hash->GetHashes(s, m_treeDepth, 0, m_rerouteBloomFilterNumHashes, hash_indexes);
     for (uint32_t i = 0; i < m_rerouteBloomFilterNumHashes; i++)
     {
-      hash_indexes[i] = m_hash->GetHash(s, m_treeDepth, i, bloom_filter_modulo);
+      hash_indexes[i] = hash_indexes[i] % bloom_filter_modulo;
     }
   }
 
@@ -297,17 +393,19 @@ namespace ns3 {
 
     P4SwitchNetDevice::AddSwitchPort(switchPort);
 
-    uint32_t ifIndex = switchPort->GetIfIndex();
-    FancyPortInfo& portInfo = m_portsInfo[ifIndex];
+    uint32_t portNum = GetPortNumber(switchPort);
+    m_portsInfo.resize(m_ports.size());
+    FancyPortInfo& portInfo = m_portsInfo[portNum];
     //InitPortInfo(portInfo);
 
     /* With this we copy the parents hiden attribute info */
     /* https://stackoverflow.com/questions/57997870/nested-struct-attributes-inheritance#57997920 */
 
-    PortInfo& switchInfo = P4SwitchNetDevice::m_portsInfo[ifIndex];
+    PortInfo& switchInfo = P4SwitchNetDevice::m_portsInfo[portNum];
     portInfo.portDevice = switchInfo.portDevice;
     portInfo.otherPortDevice = switchInfo.otherPortDevice;
     portInfo.switchPort = switchInfo.switchPort;
+    portInfo.portNum = switchInfo.portNum;
 
     portInfo.last_time_received = Simulator::Now();
     portInfo.last_time_sent = Simulator::Now();
@@ -323,6 +421,44 @@ namespace ns3 {
     NS_LOG_UNCOND("Interface mapping: " << portInfo.link_name << " : " << switchPort->GetIfIndex());
   }
 
+  void
+    P4SwitchFancy::SetOutFile(std::string out_file)
+  {
+    m_outFile = out_file;
+    /* The output file is usually set after Init, start streaming then */
+    if (m_simState)
+    {
+      if (m_outFile != "")
+      {
+        m_simState->Open(m_outFile);
+      }
+      else
+      {
+        m_simState->Close();
+      }
+    }
+  }
+
+  std::string
+    P4SwitchFancy::GetOutFile(void) const
+  {
+    return m_outFile;
+  }
+
+  void
+    P4SwitchFancy::BranchOutFile(std::string out_file)
+  {
+    m_outFile = out_file;
+    if (m_simState && m_outFile != "")
+    {
+      m_simState->Branch(m_outFile);
+    }
+    else
+    {
+      SetOutFile(out_file);
+    }
+  }
+
   void
     P4SwitchFancy::SetDebug(bool state)
   {
@@ -337,10 +473,22 @@ namespace ns3 {
 
     /* allocates the simulation state object */
     m_simState = std::make_unique<FancySimulationState>(m_treeDepth, m_rerouteBloomFilterNumHashes);
+    if (m_outFile != "")
+    {
+      m_simState->Open(m_outFile);
+    }
 
     /* Set debugging details */
     m_simState->SetDetail(m_enableDebug);
 
+    /* The sampled flows only depend on the seed, the stream is far from
+       the ones fixed by the applications and the hash functions */
+    if (FlowAttribution(m_flowAttribution) == FlowAttribution::RESERVOIR && !m_attributionRng)
+    {
+      m_attributionRng = CreateObject<UniformRandomVariable>();
+      m_attributionRng->SetStream(ATTRIBUTION_STREAM_BASE + m_switchId);
+    }
+
     /* Sets tm drop error model */
     tm_em->SetAttribute("ErrorRate", DoubleValue(m_tm_drop_rate));
     tm_em->SetAttribute("ErrorUnit", EnumValue(RateErrorModel::ERROR_UNIT_PACKET));
@@ -353,23 +501,33 @@ namespace ns3 {
     if (m_packet_hash_type == "FiveTupleHash")
     {
       m_packet_hash = &P4SwitchFancy::GetFlowHash;
-      m_packet_str_funct = &IpFiveTupleToString;
+      m_packet_key_funct = &IpFiveTupleToFlowKey;
+      m_packet_buffer_funct = &IpFiveTupleToBuffer;
+      m_packet_buffer_size = 13;
     }
     else if (m_packet_hash_type == "DstPrefixHash")
     {
       m_packet_hash = &P4SwitchFancy::GetDstPrefixHash;
-      m_packet_str_funct = &DstPrefixToString;
+      m_packet_key_funct = &DstPrefixToFlowKey;
+      m_packet_buffer_funct = &DstPrefixToBuffer;
+      m_packet_buffer_size = 4;
     }
     else
     {
       m_packet_hash = &P4SwitchFancy::GetFlowHash;
-      m_packet_str_funct = &IpFiveTupleToString;
+      m_packet_key_funct = &IpFiveTupleToFlowKey;
+      m_packet_buffer_funct = &IpFiveTupleToBuffer;
+      m_packet_buffer_size = 13;
     }
 
     /* Compute the num nodes and timeout time */
     if (m_treeEnabled)
     {
       /* Set hashes array */
+      if (m_treeDepth * 2 > pkt_info::MAX_HASHES)
+      {
+        NS_FATAL_ERROR("TreeDepth too big, the per packet hashes only fit " << pkt_info::MAX_HASHES / 2 << " levels");
+      }
       m_hash = std::make_unique<HashUtils>(m_treeDepth * 2);
       if (m_layerSplit > 1)
       {
@@ -406,9 +564,8 @@ namespace ns3 {
     /* Allocate port structure memories */
     for (uint32_t i = 0; i < m_ports.size(); i++)
     {
-      uint32_t ifIndex = m_ports[i]->GetIfIndex();
       Ptr<NetDevice> switchPort = m_ports[i];
-      FancyPortInfo& portInfo = m_portsInfo[ifIndex];
+      FancyPortInfo& portInfo = m_portsInfo[i];
       InitPortInfo(portInfo);
 
       /* Start State Machine */
@@ -434,15 +591,19 @@ namespace ns3 {
         fancy_hdr.SetAction(KEEP_ALIVE);
 
         pkt_info meta(switchPort->GetAddress(), portInfo.otherPortDevice->GetAddress(), FANCY);
-        meta.headers["FANCY"] = fancy_hdr;
+        meta.headers.fancy = fancy_hdr;
+        meta.headers.SetValid(pkt_headers::HDR_FANCY);
         meta.outPort = switchPort;
 
         if (m_check_port_state_enable)
         {
           std::cout << "TIME TESTS " << m_send_port_state_ms << " " << m_check_port_state_ms << std::endl;
-          // Total link failure events to be scheduled
-          SendProbe(MilliSeconds(m_send_port_state_ms), packet, meta);
-          Simulator::Schedule(Seconds(m_start_system_sec), &P4SwitchFancy::CheckPortState, this, MilliSeconds(m_check_port_state_ms), switchPort);
+          // Total link failure events to be scheduled, in the context of the switch
+          // so that they run with its node when the nodes are partitioned
+          Simulator::ScheduleWithContext(GetNode()->GetId(), MilliSeconds(m_send_port_state_ms), &P4SwitchFancy::SendProbe,
+            this, MilliSeconds(m_send_port_state_ms), packet, meta);
+          Simulator::ScheduleWithContext(GetNode()->GetId(), Seconds(m_start_system_sec), &P4SwitchFancy::CheckPortState,
+            this, MilliSeconds(m_check_port_state_ms), switchPort);
         }
         else
         {
@@ -455,7 +616,7 @@ namespace ns3 {
         for (uint32_t id = 0; id < m_numTopEntries; id++)
         {
           start_at = Seconds(std::max(0.0, m_start_system_sec - random_generator->GetValue(0, 0.15)));
-          portInfo.greySend.currentEvent[id] = Simulator::Schedule(start_at, &P4SwitchFancy::SendGreyAction,
+          Simulator::ScheduleWithContext(GetNode()->GetId(), start_at, &P4SwitchFancy::StartGreyAction,
             this, switchPort, (GREY_START), id);
         }
 
@@ -463,7 +624,7 @@ namespace ns3 {
         if (m_treeEnabled)
         {
           // start_at = Seconds(std::max(0.0, m_start_system_sec - random_generator->GetValue(0, 0.05)));
-          portInfo.greySend.currentEvent[m_numTopEntries] = Simulator::Schedule(Seconds(m_start_system_sec), &P4SwitchFancy::SendGreyAction,
+          Simulator::ScheduleWithContext(GetNode()->GetId(), Seconds(m_start_system_sec), &P4SwitchFancy::StartGreyAction,
             this, switchPort, (GREY_START | COUNTER_MAXIMUMS), m_numTopEntries);
         }
 
@@ -473,23 +634,34 @@ namespace ns3 {
         if (m_treeEnableSoftDetections)
         {
           start_at = Seconds(std::max(0.0, m_start_system_sec - random_generator->GetValue(0, 0.15)));
-          portInfo.greySend.currentEvent[m_numTopEntries + 1] = Simulator::Schedule(start_at, &P4SwitchFancy::SendGreyAction,
+          Simulator::ScheduleWithContext(GetNode()->GetId(), start_at, &P4SwitchFancy::StartGreyAction,
             this, switchPort, (GREY_START), m_numTopEntries + 1);
         }
       }
     }
   }
 
+  void
+    P4SwitchFancy::StartGreyAction(Ptr<NetDevice> outPort, uint8_t action, uint32_t id)
+  {
+    /* The start events have no EventId to cancel, scheduled with a context */
+    if (m_allFSMDisabled || (m_topEntriesDisabled && id < m_numTopEntries))
+    {
+      return;
+    }
+    SendGreyAction(outPort, action, id);
+  }
+
   void
     P4SwitchFancy::DisableTopEntries()
   {
+    m_topEntriesDisabled = true;
 
     /* Allocate port structure memories */
     for (uint32_t i = 0; i < m_ports.size(); i++)
     {
-      uint32_t ifIndex = m_ports[i]->GetIfIndex();
       Ptr<NetDevice> switchPort = m_ports[i];
-      FancyPortInfo& portInfo = m_portsInfo[ifIndex];
+      FancyPortInfo& portInfo = m_portsInfo[i];
 
       Ptr<Node> otherSide = portInfo.otherPortDevice->GetNode();
       std::string otherSideName = Names::FindName(otherSide);
@@ -510,12 +682,12 @@ namespace ns3 {
   void
     P4SwitchFancy::DisableAllFSM()
   {
+    m_allFSMDisabled = true;
     /* Allocate port structure memories */
     for (uint32_t i = 0; i < m_ports.size(); i++)
     {
-      uint32_t ifIndex = m_ports[i]->GetIfIndex();
       Ptr<NetDevice> switchPort = m_ports[i];
-      FancyPortInfo& portInfo = m_portsInfo[ifIndex];
+      FancyPortInfo& portInfo = m_portsInfo[i];
 
       Ptr<Node> otherSide = portInfo.otherPortDevice->GetNode();
       std::string otherSideName = Names::FindName(otherSide);
@@ -550,25 +722,7 @@ namespace ns3 {
     /* initialize Zooming data structure for the receiver  Recv*/
     if (m_treeEnabled)
     {
-      portInfo.greyRecv.counter_tree = std::vector<HashCounter>(m_nodesInTree);
-      for (uint32_t i = 0; i < portInfo.greyRecv.counter_tree.size(); i++)
-      {
-        portInfo.greyRecv.counter_tree[i].counters = std::vector<uint32_t>(m_counterWidth);
-        portInfo.greyRecv.counter_tree[i].last_flow = std::vector<ip_five_tuple>(m_counterWidth);
-
-        portInfo.greyRecv.counter_tree[i].hashed_flows = std::vector<std::unordered_map<std::string, ip_five_tuple>>(m_counterWidth);
-        portInfo.greyRecv.counter_tree[i].bloom_filter = std::vector<boost::dynamic_bitset<>>(m_counterWidth);
-
-        for (uint32_t j = 0; j < m_counterWidth; j++)
-        {
-          portInfo.greyRecv.counter_tree[i].bloom_filter[j] = boost::dynamic_bitset<>(m_counterBloomFilterWidth);
-        }
-        portInfo.greyRecv.counter_tree[i].max_cells = std::vector<std::vector<uint8_t>>(m_treeDepth);
-        for (uint32_t j = 0; j < m_treeDepth; j++)
-        {
-          portInfo.greyRecv.counter_tree[i].max_cells[j] = std::vector<uint8_t>(m_layerSplit);
-        }
-      }
+      portInfo.greyRecv.counter_tree.Allocate(m_nodesInTree, m_counterWidth, m_treeDepth, m_layerSplit, m_counterBloomFilterWidth);
     }
 
     /* Prepare all the state machines */
@@ -582,24 +736,7 @@ namespace ns3 {
     /* Initialize Zooming data structure for the sender side*/
     if (m_treeEnabled)
     {
-      portInfo.greySend.counter_tree = std::vector<HashCounter>(m_nodesInTree);
-      for (uint32_t i = 0; i < portInfo.greySend.counter_tree.size(); i++)
-      {
-        portInfo.greySend.counter_tree[i].counters = std::vector<uint32_t>(m_counterWidth);
-        portInfo.greySend.counter_tree[i].last_flow = std::vector<ip_five_tuple>(m_counterWidth);
-        portInfo.greySend.counter_tree[i].hashed_flows = std::vector<std::unordered_map<std::string, ip_five_tuple>>(m_counterWidth);
-        portInfo.greySend.counter_tree[i].bloom_filter = std::vector<boost::dynamic_bitset<>>(m_counterWidth);
-
-        for (uint32_t j = 0; j < m_counterWidth; j++)
-        {
-          portInfo.greySend.counter_tree[i].bloom_filter[j] = boost::dynamic_bitset<>(m_counterBloomFilterWidth);
-        }
-        portInfo.greySend.counter_tree[i].max_cells = std::vector<std::vector<uint8_t>>(m_treeDepth);
-        for (uint32_t j = 0; j < m_treeDepth; j++)
-        {
-          portInfo.greySend.counter_tree[i].max_cells[j] = std::vector<uint8_t>(m_layerSplit);
-        }
-      }
+      portInfo.greySend.counter_tree.Allocate(m_nodesInTree, m_counterWidth, m_treeDepth, m_layerSplit, m_counterBloomFilterWidth);
     }
   }
 
@@ -637,24 +774,24 @@ namespace ns3 {
 
   void P4SwitchFancy::ParseFancy(Ptr<Packet> packet, pkt_info& meta)
   {
-    FancyHeader fancy_hdr;
+    FancyHeader& fancy_hdr = meta.headers.fancy;
     packet->RemoveHeader(fancy_hdr);
-    meta.headers["FANCY"] = fancy_hdr;
+    meta.headers.SetValid(pkt_headers::HDR_FANCY);
     Parser(packet, meta, fancy_hdr.GetNextHeader());
   }
 
   void P4SwitchFancy::ParseArp(Ptr<Packet> packet, pkt_info& meta)
   {
-    ArpHeader arp_hdr;
+    ArpHeader& arp_hdr = meta.headers.arp;
     packet->RemoveHeader(arp_hdr);
-    meta.headers["ARP"] = arp_hdr;
+    meta.headers.SetValid(pkt_headers::HDR_ARP);
   }
 
   void P4SwitchFancy::ParseIpv4(Ptr<Packet> packet, pkt_info& meta)
   {
-    Ipv4Header ipv4_hdr;
+    Ipv4Header& ipv4_hdr = meta.headers.ipv4;
     packet->RemoveHeader(ipv4_hdr);
-    meta.headers["IPV4"] = ipv4_hdr;
+    meta.headers.SetValid(pkt_headers::HDR_IPV4);
     ParseTransport(packet, meta, ipv4_hdr.GetProtocol());
   }
 
@@ -664,17 +801,17 @@ namespace ns3 {
     {
     case TCP:
     {
-      TcpHeader tcp_hdr;
+      TcpHeader& tcp_hdr = meta.headers.tcp;
       packet->RemoveHeader(tcp_hdr);
-      meta.headers["TCP"] = tcp_hdr;
+      meta.headers.SetValid(pkt_headers::HDR_TCP);
 
       break;
     }
     case UDP:
     {
-      UdpHeader udp_hdr;
+      UdpHeader& udp_hdr = meta.headers.udp;
       packet->RemoveHeader(udp_hdr);
-      meta.headers["UDP"] = udp_hdr;
+      meta.headers.SetValid(pkt_headers::HDR_UDP);
       break;
     }
     }
@@ -715,9 +852,9 @@ namespace ns3 {
     }
 
     // remove 1ttl just for testing
-    //if (meta.headers.count("IPV4") > 0)
+    //if (meta.headers.IsValid(pkt_headers::HDR_IPV4))
     //{
-    //  Ipv4Header & ipv4_hdr = std::any_cast<Ipv4Header&>(meta.headers["IPV4"]);
+    //  Ipv4Header & ipv4_hdr = meta.headers.ipv4;
     //  ipv4_hdr.SetTtl(ipv4_hdr.GetTtl()-1);
     //}
 
@@ -740,9 +877,9 @@ namespace ns3 {
     {
       /* Get action */
       uint8_t action = 0;
-      if (meta.headers.count("FANCY") > 0)
+      if (meta.headers.IsValid(pkt_headers::HDR_FANCY))
       {
-        FancyHeader& fancy_hdr = std::any_cast<FancyHeader&>(meta.headers["FANCY"]);
+        FancyHeader& fancy_hdr = meta.headers.fancy;
         action = fancy_hdr.GetAction();
 
       }
@@ -785,33 +922,27 @@ namespace ns3 {
     NS_LOG_FUNCTION_NOARGS();
 
     // Deparse valid headers if there are headers to deparse
-    if (meta.headers.size() > 0)
+    if (!meta.headers.Empty())
     {
-      for (auto hdr_type : header_stack_reverse)
+      if (meta.headers.IsValid(pkt_headers::HDR_TCP))
       {
-        if (meta.headers.count(hdr_type) > 0)
-        {
-          if (hdr_type == "FANCY")
-          {
-            packet->AddHeader(std::any_cast<FancyHeader>(meta.headers[hdr_type]));
-          }
-          else if (hdr_type == "ARP")
-          {
-            packet->AddHeader(std::any_cast<ArpHeader>(meta.headers[hdr_type]));
-          }
-          else if (hdr_type == "IPV4")
-          {
-            packet->AddHeader(std::any_cast<Ipv4Header>(meta.headers[hdr_type]));
-          }
-          else if (hdr_type == "TCP")
-          {
-            packet->AddHeader(std::any_cast<TcpHeader>(meta.headers[hdr_type]));
-          }
-          else if (hdr_type == "UDP")
-          {
-            packet->AddHeader(std::any_cast<UdpHeader>(meta.headers[hdr_type]));
-          }
-        }
+        packet->AddHeader(meta.headers.tcp);
+      }
+      if (meta.headers.IsValid(pkt_headers::HDR_UDP))
+      {
+        packet->AddHeader(meta.headers.udp);
+      }
+      if (meta.headers.IsValid(pkt_headers::HDR_IPV4))
+      {
+        packet->AddHeader(meta.headers.ipv4);
+      }
+      if (meta.headers.IsValid(pkt_headers::HDR_ARP))
+      {
+        packet->AddHeader(meta.headers.arp);
+      }
+      if (meta.headers.IsValid(pkt_headers::HDR_FANCY))
+      {
+        packet->AddHeader(meta.headers.fancy);
       }
     }
   }
@@ -821,10 +952,10 @@ namespace ns3 {
   {
     NS_LOG_FUNCTION_NOARGS();
 
-    if (meta.headers.count("IPV4") > 0)
+    if (meta.headers.IsValid(pkt_headers::HDR_IPV4))
     {
       // drop packet at the egress
-      Ipv4Header& ipv4_hdr = std::any_cast<Ipv4Header&>(meta.headers["IPV4"]);
+      Ipv4Header& ipv4_hdr = meta.headers.ipv4;
       uint8_t tos = ipv4_hdr.GetTos();
 
       /* Here is where we decide if a packet has to be dropped or not
@@ -852,7 +983,7 @@ namespace ns3 {
 
     // Before the packet leaves the switch
     // Update Send Timestamp
-    FancyPortInfo& outPortInfo = m_portsInfo[meta.outPort->GetIfIndex()];
+    FancyPortInfo& outPortInfo = m_portsInfo[GetPortNumber(meta.outPort)];
     outPortInfo.last_time_sent = Simulator::Now();
     /* Removed the sense of l2 swtich we had before, now for each packet we modify the mac address, useful to track what happens */
     SendOutFrom(packet, meta.outPort, meta.outPort->GetAddress(), outPortInfo.otherPortDevice->GetAddress(), meta.protocol);
@@ -888,9 +1019,7 @@ namespace ns3 {
       flow.src_port = uint16_t(5555);
       flow.dst_port = uint16_t(7777);
 
-      std::string flow_str = IpFiveTupleToString(flow);
-
-      m_topEntries[flow_str] = index;
+      m_topEntries[IpFiveTupleToFlowKey(flow)] = index;
       index++;
     }
 
@@ -912,8 +1041,7 @@ namespace ns3 {
       ip_five_tuple flow;
       flow.dst_ip = dst_prefix;
 
-      std::string dst_prefix_str = DstPrefixToString(flow);
-      m_topEntries[dst_prefix_str] = index;
+      m_topEntries[DstPrefixToFlowKey(flow)] = index;
       index++;
     }
 
@@ -925,7 +1053,7 @@ namespace ns3 {
   {
     NS_LOG_FUNCTION_NOARGS();
 
-    std::unordered_map<std::string, uint32_t>::iterator iter = m_topEntries.find(meta.str_flow);
+    auto iter = m_topEntries.find(meta.key);
     if (iter != m_topEntries.end())
     {
       return iter->second;
@@ -943,7 +1071,7 @@ namespace ns3 {
     std::cout << "=================" << std::endl;
     for (auto it = m_topEntries.begin(); it != m_topEntries.end(); it++)
     {
-      std::cout << it->first << " -> " << it->second << std::endl;
+      std::cout << FlowKeyToString(it->first) << " -> " << it->second << std::endl;
     }
   }
 
@@ -955,7 +1083,7 @@ namespace ns3 {
     NS_LOG_FUNCTION_NOARGS();
 
     // check if we really need to send 
-    FancyPortInfo& portInfo = m_portsInfo[meta.outPort->GetIfIndex()];
+    FancyPortInfo& portInfo = m_portsInfo[GetPortNumber(meta.outPort)];
     Simulator::Schedule(delay, &P4SwitchFancy::SendProbe, this, delay, packet, meta);
 
     // Only send if there is no traffic 
@@ -970,7 +1098,7 @@ namespace ns3 {
   {
     NS_LOG_FUNCTION_NOARGS();
 
-    FancyPortInfo& portInfo = m_portsInfo[port->GetIfIndex()];
+    FancyPortInfo& portInfo = m_portsInfo[GetPortNumber(port)];
 
     // Nothing received 
     if (Simulator::Now() - portInfo.last_time_received > delay)
@@ -1020,8 +1148,8 @@ namespace ns3 {
   {
     NS_LOG_FUNCTION_NOARGS();
 
-    uint32_t ifIndex = outPort->GetIfIndex();
-    FancyPortInfo& portInfo = m_portsInfo[ifIndex];
+    uint32_t portNum = GetPortNumber(outPort);
+    FancyPortInfo& portInfo = m_portsInfo[portNum];
 
     Ptr<Packet> packet = Create<Packet>();
     FancyHeader fancy_hdr;
@@ -1040,8 +1168,7 @@ namespace ns3 {
       for (uint16_t index = 0; index < m_nodesInTree; index++)
       {
         // We get the first level in the tree
-        //uint8_t * ptr = portInfo.greySend.counter_tree[index].max_cells[0];
-        fancy_hdr.SetDataMaximums(portInfo.greySend.counter_tree[index].max_cells[0], index);
+        fancy_hdr.SetDataMaximums(portInfo.greySend.counter_tree.MaxCells(index, 0), index);
       }
 
       // Schedule this to be sent again until the state machine cancells it
@@ -1079,7 +1206,8 @@ namespace ns3 {
     }
 
     pkt_info meta(outPort->GetAddress(), portInfo.otherPortDevice->GetAddress(), FANCY);
-    meta.headers["FANCY"] = fancy_hdr;
+    meta.headers.fancy = fancy_hdr;
+    meta.headers.SetValid(pkt_headers::HDR_FANCY);
     meta.outPort = outPort;
 
     //Send packet to traffic manager 
@@ -1091,9 +1219,9 @@ namespace ns3 {
   {
     NS_LOG_FUNCTION_NOARGS();
 
-    uint32_t ifIndex = outPort->GetIfIndex();
+    uint32_t portNum = GetPortNumber(outPort);
     FancyPortInfo& portInfo =
-      m_portsInfo[ifIndex];
+      m_portsInfo[portNum];
 
     Ptr<Packet> packet = Create<Packet>();
     FancyHeader fancy_hdr;
@@ -1109,8 +1237,7 @@ namespace ns3 {
       fancy_hdr.SetDataWidth(m_counterWidth);
       for (uint16_t index = 0; index < m_nodesInTree; index++)
       {
-        //uint32_t * ptr = portInfo.greyRecv.counter_tree[index].counters;
-        fancy_hdr.SetDataCounter(portInfo.greyRecv.counter_tree[index].counters, index);
+        fancy_hdr.SetDataCounter(portInfo.greyRecv.counter_tree.Counters(index), index);
       }
     }
 
@@ -1120,7 +1247,8 @@ namespace ns3 {
     SetGreyState(portInfo, GreyState::COUNTER_ACK, id, true);
 
     pkt_info meta(outPort->GetAddress(), portInfo.otherPortDevice->GetAddress(), FANCY);
-    meta.headers["FANCY"] = fancy_hdr;
+    meta.headers.fancy = fancy_hdr;
+    meta.headers.SetValid(pkt_headers::HDR_FANCY);
     meta.outPort = outPort;
 
     //Schedule again 
@@ -1133,6 +1261,8 @@ namespace ns3 {
 
   void P4SwitchFancy::PacketCounting(GreyInfo& greyPortInfo, uint32_t id, pkt_info& meta, bool sender)
   {
+    ComputePacketHashes(meta);
+
     // Increase counter 
     greyPortInfo.localCounter[id]++;
 
@@ -1143,11 +1273,6 @@ namespace ns3 {
     // index that points the counter in the flat tree array (not the depth)
     uint32_t counter_tree_index = 0;
 
-    if (sender && meta.str_flow == "")
-    {
-      meta.str_flow = (*m_packet_str_funct)(meta.flow);
-    }
-
     // Get zoom phase
     uint32_t zoom_phase = greyPortInfo.currentSEQ[id] % m_treeDepth;
 
@@ -1155,20 +1280,16 @@ namespace ns3 {
     if (zoom_phase == 0)
     {
       // Root algorithm
-      counter_index = (this->*m_packet_hash)(meta.flow, 0, m_counterWidth);
+      counter_index = meta.hashes[0];
       // Update counter
-      greyPortInfo.counter_tree[counter_tree_index].counters[counter_index]++;
+      greyPortInfo.counter_tree.Counter(counter_tree_index, counter_index)++;
       if (sender)
       {
-        greyPortInfo.counter_tree[counter_tree_index].last_flow[counter_index] = meta.flow;
-        if (greyPortInfo.counter_tree[counter_tree_index].hashed_flows[counter_index].count(meta.str_flow) == 0)
-        {
-          greyPortInfo.counter_tree[counter_tree_index].hashed_flows[counter_index][meta.str_flow] = meta.flow;
-        }
+        AttributeFlow(greyPortInfo.counter_tree, counter_tree_index, counter_index, meta);
       }
       /* Set bloom filter & count hit*/
-      bloom_filter_index = (this->*m_packet_hash)(meta.flow, (0 + m_treeDepth), m_counterBloomFilterWidth);
-      greyPortInfo.counter_tree[counter_tree_index].bloom_filter[counter_index].set(bloom_filter_index);
+      bloom_filter_index = meta.hashes[m_treeDepth];
+      greyPortInfo.counter_tree.SetBloomBit(counter_tree_index, counter_index, bloom_filter_index);
     }
     else /* other layers, we get the address if sequence of hashes, or pass otherwise */
     {
@@ -1177,11 +1298,11 @@ namespace ns3 {
       for (uint8_t tree_level = 0; tree_level < zoom_phase; tree_level++)
       {
         // Check if the hash is any of the max if so get the address
-        counter_index = (this->*m_packet_hash)(meta.flow, tree_level, m_counterWidth);
+        counter_index = meta.hashes[tree_level];
         bool zoom = false;
-        for (uint32_t ii = 0; ii < greyPortInfo.counter_tree[counter_tree_index].max_cells[0].size(); ii++)
+        for (uint32_t ii = 0; ii < m_layerSplit; ii++)
         {
-          if (greyPortInfo.counter_tree[counter_tree_index].max_cells[0][ii] == counter_index)
+          if (greyPortInfo.counter_tree.MaxCell(counter_tree_index, 0, ii) == counter_index)
           {
             counter_tree_index = (counter_tree_index * m_layerSplit) + (ii + 1);
             zoom = true;
@@ -1196,24 +1317,76 @@ namespace ns3 {
       }
 
       /*If we are here it means we found a hash path until the zoom phase. If so we update the counter*/
-      counter_index = (this->*m_packet_hash)(meta.flow, zoom_phase, m_counterWidth);
-      greyPortInfo.counter_tree[counter_tree_index].counters[counter_index]++;
+      counter_index = meta.hashes[zoom_phase];
+      greyPortInfo.counter_tree.Counter(counter_tree_index, counter_index)++;
       if (sender)
       {
-        greyPortInfo.counter_tree[counter_tree_index].last_flow[counter_index] = meta.flow;
-        if (greyPortInfo.counter_tree[counter_tree_index].hashed_flows[counter_index].count(meta.str_flow) == 0)
-        {
-          greyPortInfo.counter_tree[counter_tree_index].hashed_flows[counter_index][meta.str_flow] = meta.flow;
-        }
+        AttributeFlow(greyPortInfo.counter_tree, counter_tree_index, counter_index, meta);
       }
       // Set bloom filter & count hit
-      bloom_filter_index = (this->*m_packet_hash)(meta.flow, ((zoom_phase)+m_treeDepth), m_counterBloomFilterWidth);
-      greyPortInfo.counter_tree[counter_tree_index].bloom_filter[counter_index].set(bloom_filter_index);
+      bloom_filter_index = meta.hashes[zoom_phase + m_treeDepth];
+      greyPortInfo.counter_tree.SetBloomBit(counter_tree_index, counter_index, bloom_filter_index);
+    }
+  }
+
+  void P4SwitchFancy::AttributeFlow(CounterTree& tree, uint32_t node, uint32_t index, pkt_info& meta)
+  {
+    if (FlowAttribution(m_flowAttribution) == FlowAttribution::OFF)
+    {
+      return;
+    }
+
+    if (!meta.key_set)
+    {
+      meta.key = (*m_packet_key_funct)(meta.flow);
+      meta.key_set = true;
+    }
+
+    tree.LastFlow(node, index) = meta.flow;
+    flow_key_map& flows = tree.HashedFlows(node, index);
+    if (flows.count(meta.key) != 0)
+    {
+      return;
+    }
+
+    if (FlowAttribution(m_flowAttribution) == FlowAttribution::FULL)
+    {
+      flows[meta.key] = meta.flow;
+      return;
+    }
+
+    /* Reservoir sampling (algorithm R) over the distinct flows offered to
+       this cell, a flow evicted from the sample is not offered again */
+    if (tree.sample_size == 0)
+    {
+      tree.AllocateReservoir(m_flowAttributionSampleSize);
+    }
+    if (!tree.Offer(node, index, flow_key_hash()(meta.key)))
+    {
+      return;
+    }
+    uint32_t seen = ++tree.flows_seen[tree.Cell(node, index)];
+    flow_key* keys = tree.SampleKeys(node, index);
+    if (flows.size() < tree.sample_size)
+    {
+      keys[flows.size()] = meta.key;
+      flows[meta.key] = meta.flow;
+      return;
+    }
+    uint32_t slot = m_attributionRng->GetInteger(0, seen - 1);
+    if (slot < flows.size())
+    {
+      /* The new flow takes the slot of the evicted one */
+      flows.erase(keys[slot]);
+      keys[slot] = meta.key;
+      flows[meta.key] = meta.flow;
     }
   }
 
   void P4SwitchFancy::PipelinedPacketCounting(GreyInfo& greyPortInfo, uint32_t id, pkt_info& meta, bool sender)
   {
+    ComputePacketHashes(meta);
+
     // Increase counter
     greyPortInfo.localCounter[id]++;
 
@@ -1226,28 +1399,18 @@ namespace ns3 {
     // index that points the counter in the flat tree array (not the depth)
     uint32_t counter_tree_index = 0;
 
-    if (sender && meta.str_flow == "")
-    {
-      meta.str_flow = (*m_packet_str_funct)(meta.flow);
-    }
-
     // Root algorithm
-    counter_index = (this->*m_packet_hash)(meta.flow, 0, m_counterWidth);
+    counter_index = meta.hashes[0];
     // Update counter
-    greyPortInfo.counter_tree[counter_tree_index].counters[counter_index]++;
+    greyPortInfo.counter_tree.Counter(counter_tree_index, counter_index)++;
     if (sender)
     {
-      greyPortInfo.counter_tree[counter_tree_index].last_flow[counter_index] = meta.flow;
-
-      if (greyPortInfo.counter_tree[counter_tree_index].hashed_flows[counter_index].count(meta.str_flow) == 0)
-      {
-        greyPortInfo.counter_tree[counter_tree_index].hashed_flows[counter_index][meta.str_flow] = meta.flow;
-      }
+      AttributeFlow(greyPortInfo.counter_tree, counter_tree_index, counter_index, meta);
     }
 
     // Set bloom filter & count hit
-    bloom_filter_index = (this->*m_packet_hash)(meta.flow, (0 + m_treeDepth), m_counterBloomFilterWidth);
-    greyPortInfo.counter_tree[counter_tree_index].bloom_filter[counter_index].set(bloom_filter_index);
+    bloom_filter_index = meta.hashes[m_treeDepth];
+    greyPortInfo.counter_tree.SetBloomBit(counter_tree_index, counter_index, bloom_filter_index);
 
     // Lower layers and pipelining 
     for (uint8_t history_level = 0; history_level < m_treeDepth - 1; history_level++)
@@ -1259,11 +1422,11 @@ namespace ns3 {
       for (uint8_t tree_level = 0; tree_level <= history_level; tree_level++)
       {
         // Check if the hash is any of the max if so get the address
-        counter_index = (this->*m_packet_hash)(meta.flow, tree_level, m_counterWidth);
+        counter_index = meta.hashes[tree_level];
         bool zoom = false;
-        for (uint32_t ii = 0; ii < greyPortInfo.counter_tree[counter_tree_index].max_cells[history_level - tree_level].size(); ii++)
+        for (uint32_t ii = 0; ii < m_layerSplit; ii++)
         {
-          if (greyPortInfo.counter_tree[counter_tree_index].max_cells[history_level - tree_level][ii] == counter_index)
+          if (greyPortInfo.counter_tree.MaxCell(counter_tree_index, history_level - tree_level, ii) == counter_index)
           {
             counter_tree_index = (counter_tree_index * m_layerSplit) + (ii + 1);
             zoom = true;
@@ -1281,20 +1444,15 @@ namespace ns3 {
         if (tree_level == history_level)
         {
           // Update counter
-          counter_index = (this->*m_packet_hash)(meta.flow, tree_level + 1, m_counterWidth);
-          greyPortInfo.counter_tree[counter_tree_index].counters[counter_index]++;
+          counter_index = meta.hashes[tree_level + 1];
+          greyPortInfo.counter_tree.Counter(counter_tree_index, counter_index)++;
           if (sender)
           {
-            greyPortInfo.counter_tree[counter_tree_index].last_flow[counter_index] = meta.flow;
-
-            if (greyPortInfo.counter_tree[counter_tree_index].hashed_flows[counter_index].count(meta.str_flow) == 0)
-            {
-              greyPortInfo.counter_tree[counter_tree_index].hashed_flows[counter_index][meta.str_flow] = meta.flow;
-            }
+            AttributeFlow(greyPortInfo.counter_tree, counter_tree_index, counter_index, meta);
           }
           // Set bloom filter & count hit
-          bloom_filter_index = (this->*m_packet_hash)(meta.flow, ((tree_level + 1) + m_treeDepth), m_counterBloomFilterWidth);
-          greyPortInfo.counter_tree[counter_tree_index].bloom_filter[counter_index].set(bloom_filter_index);
+          bloom_filter_index = meta.hashes[(tree_level + 1) + m_treeDepth];
+          greyPortInfo.counter_tree.SetBloomBit(counter_tree_index, counter_index, bloom_filter_index);
         }
       }
     }
@@ -1321,7 +1479,7 @@ namespace ns3 {
         for (uint8_t j = 0; j < m_layerSplit; j++)
         {
           max_counter = start.ReadU8();
-          portInfo.greyRecv.counter_tree[i].max_cells[0][j] = max_counter;
+          portInfo.greyRecv.counter_tree.MaxCell(i, 0, j) = max_counter;
         }
       }
     }
@@ -1329,15 +1487,8 @@ namespace ns3 {
     // Reset State for this level
     if (zoom_phase == 0)
     {
-      for (uint32_t i = 0; i < m_nodesInTree; i++)
-      {
-        /* When we start at the tree root we erase everything*/
-        std::fill(portInfo.greyRecv.counter_tree[i].counters.begin(), portInfo.greyRecv.counter_tree[i].counters.end(), 0);
-        for (uint32_t j = 0; j < m_counterWidth; j++)
-        {
-          portInfo.greyRecv.counter_tree[i].bloom_filter[j].reset();
-        }
-      }
+      /* When we start at the tree root we erase everything*/
+      portInfo.greyRecv.counter_tree.Reset(false);
     }
   }
 
@@ -1355,32 +1506,18 @@ namespace ns3 {
         // Tree counter index
         i = start.ReadU16();
         // Get max counters and shift register
-        for (int index = m_treeDepth - 2; index >= 0; index--)
-        {
-          // Right shift
-          for (uint8_t j = 0; j < m_layerSplit; j++)
-          {
-            portInfo.greyRecv.counter_tree[i].max_cells[index + 1][j] = portInfo.greyRecv.counter_tree[i].max_cells[index][j];
-          }
-        }
+        portInfo.greyRecv.counter_tree.ShiftMaxHistory(i);
         // Set the last history
         for (uint8_t j = 0; j < m_layerSplit; j++)
         {
           max_counter = start.ReadU8();
-          portInfo.greyRecv.counter_tree[i].max_cells[0][j] = max_counter;
+          portInfo.greyRecv.counter_tree.MaxCell(i, 0, j) = max_counter;
         }
       }
     }
 
     // Reset all the counter state
-    for (uint32_t i = 0; i < m_nodesInTree; i++)
-    {
-      std::fill(portInfo.greyRecv.counter_tree[i].counters.begin(), portInfo.greyRecv.counter_tree[i].counters.end(), 0);
-      for (uint32_t j = 0; j < m_counterWidth; j++)
-      {
-        portInfo.greyRecv.counter_tree[i].bloom_filter[j].reset();
-      }
-    }
+    portInfo.greyRecv.counter_tree.Reset(false);
   }
 
   void P4SwitchFancy::PipelinedCounterExchangeAlgorithm(FancyPortInfo& inPortInfo, uint32_t id, FancyHeader& fancy_hdr)
@@ -1437,17 +1574,8 @@ namespace ns3 {
       // Tree counter index
       i = start.ReadU16();
       //std::cout << "TREE INDEX " << int(i) << std::endl;
-      // Shift max counter history
-      for (int index = m_treeDepth - 2; index >= 0; index--)
-      {
-        // Right shift
-        for (uint8_t j = 0; j < m_layerSplit; j++)
-        {
-          inPortInfo.greySend.counter_tree[i].max_cells[index + 1][j] = inPortInfo.greySend.counter_tree[i].max_cells[index][j];
-        }
-      }
-      /* Clean first level */
-      std::fill(inPortInfo.greySend.counter_tree[i].max_cells[0].begin(), inPortInfo.greySend.counter_tree[i].max_cells[0].end(), 0);
+      // Shift max counter history and clean first level
+      inPortInfo.greySend.counter_tree.ShiftMaxHistory(i);
       //std::vector<uint32_t> current_max (m_layerSplit);
       std::vector<std::pair<uint32_t, double>> current_max;
 
@@ -1466,7 +1594,7 @@ namespace ns3 {
       for (uint8_t j = 0; j < m_counterWidth; j++)
       {
         remote_counter = start.ReadU32();
-        cell_local_counter = inPortInfo.greySend.counter_tree[i].counters[j];
+        cell_local_counter = inPortInfo.greySend.counter_tree.Counter(i, j);
         counter_diff = cell_local_counter - remote_counter;
         if (counter_diff != 0)
         {
@@ -1496,11 +1624,11 @@ namespace ns3 {
         // before hit_counter[j]
 
         /* Save Tree node main state */
-        m_simState->SetCounterValues(cell_local_counter, remote_counter, inPortInfo.greySend.counter_tree[i].bloom_filter[j].count(),
-          inPortInfo.greySend.counter_tree[i].hashed_flows[j].size(), inPortInfo.greySend.counter_tree[i].bloom_filter[j]);
+        m_simState->SetCounterValues(cell_local_counter, remote_counter, inPortInfo.greySend.counter_tree.BloomCount(i, j),
+          inPortInfo.greySend.counter_tree.HashedFlows(i, j).size(), inPortInfo.greySend.counter_tree.BloomFilter(i, j), m_counterBloomFilterWidth);
 
         /* If we are at the last layer... we start doing the magic */
-        if (i >= last_layer_index && cost > m_rerouteMinCost && inPortInfo.greySend.counter_tree[i].bloom_filter[j].count() <= m_maxCounterCollisions)
+        if (i >= last_layer_index && cost > m_rerouteMinCost && inPortInfo.greySend.counter_tree.BloomCount(i, j) <= m_maxCounterCollisions)
         {
           uint16_t child_address = i;
           char hash_path[m_treeDepth];
@@ -1512,7 +1640,7 @@ namespace ns3 {
           {
             uint16_t parent_address = (child_address - 1) / m_layerSplit;
             uint16_t child_shift = (child_address - (m_layerSplit * parent_address)) - 1;
-            uint16_t hash_index = inPortInfo.greySend.counter_tree[parent_address].max_cells[t + 1][child_shift];
+            uint16_t hash_index = inPortInfo.greySend.counter_tree.MaxCell(parent_address, t + 1, child_shift);
             hash_path[m_treeDepth - (t + 2)] = hash_index;
             child_address = parent_address;
           }
@@ -1540,12 +1668,12 @@ namespace ns3 {
 
           std::cout << "Drops: " << counter_diff << std::endl;
           std::cout << "Loss: " << packet_loss << std::endl;
-          std::cout << "BF Collisions: " << inPortInfo.greySend.counter_tree[i].bloom_filter[j].count() << std::endl;
-          std::cout << "Real Collisions: " << inPortInfo.greySend.counter_tree[i].hashed_flows[j].size() << std::endl;
+          std::cout << "BF Collisions: " << inPortInfo.greySend.counter_tree.BloomCount(i, j) << std::endl;
+          std::cout << "Real Collisions: " << inPortInfo.greySend.counter_tree.HashedFlows(i, j).size() << std::endl;
           if (m_packet_hash_type == "FiveTupleHash")
           {
             std::cout << "Flows:" << std::endl;
-            for (auto it = inPortInfo.greySend.counter_tree[i].hashed_flows[j].begin(); it != inPortInfo.greySend.counter_tree[i].hashed_flows[j].end(); ++it)
+            for (auto it = inPortInfo.greySend.counter_tree.HashedFlows(i, j).begin(); it != inPortInfo.greySend.counter_tree.HashedFlows(i, j).end(); ++it)
             {
               PrintIpFiveTuple(it->second);
             }
@@ -1553,7 +1681,7 @@ namespace ns3 {
           else if (m_packet_hash_type == "DstPrefixHash")
           {
             std::cout << "Prefixes:" << std::endl;
-            for (auto it = inPortInfo.greySend.counter_tree[i].hashed_flows[j].begin(); it != inPortInfo.greySend.counter_tree[i].hashed_flows[j].end(); ++it)
+            for (auto it = inPortInfo.greySend.counter_tree.HashedFlows(i, j).begin(); it != inPortInfo.greySend.counter_tree.HashedFlows(i, j).end(); ++it)
             {
               PrintDstPrefix("", it->second);
             }
@@ -1564,8 +1692,8 @@ namespace ns3 {
           std::cout << "# End Failure Detected\033[0m" << std::endl << std::endl;
 
           /* Add failure detection event to the sim data*/
-          m_simState->SetFailureEvent(Simulator::Now().GetSeconds(), hash_path, bloom_filter_indexes, inPortInfo.greySend.counter_tree[i].hashed_flows[j],
-            inPortInfo.greySend.counter_tree[i].bloom_filter[j].count(), cell_local_counter, remote_counter, id, inPortInfo.failures_count);
+          m_simState->SetFailureEvent(Simulator::Now().GetSeconds(), hash_path, bloom_filter_indexes, inPortInfo.greySend.counter_tree.HashedFlows(i, j),
+            inPortInfo.greySend.counter_tree.BloomCount(i, j), cell_local_counter, remote_counter, id, inPortInfo.failures_count);
 
           /* TODO probably remove (there are 3 more)
           /* Early stop simulation */
@@ -1577,10 +1705,10 @@ namespace ns3 {
 
         }
         //collision
-        else if (i >= last_layer_index && cost > m_rerouteMinCost && inPortInfo.greySend.counter_tree[i].bloom_filter[j].count() > m_maxCounterCollisions)
+        else if (i >= last_layer_index && cost > m_rerouteMinCost && inPortInfo.greySend.counter_tree.BloomCount(i, j) > m_maxCounterCollisions)
         {
           /* We indicate that in this cell there is more "entries" than maxCounterCollisions*/
-          m_simState->SetCollisionEvent(seq, i, j, inPortInfo.greySend.counter_tree[i].bloom_filter[j].count());
+          m_simState->SetCollisionEvent(seq, i, j, inPortInfo.greySend.counter_tree.BloomCount(i, j));
           //std::cout << "# Too many flows hashed at the last layer: node=" << int(i) << " depth=" << KArryTreeDepth(m_layerSplit, i) 
           //<< " cell=" << int(j) << " collisions=" <<  << j << std::endl;
         }
@@ -1602,7 +1730,7 @@ namespace ns3 {
             {
               uint16_t parent_address = (child_address - 1) / m_layerSplit;
               uint16_t child_shift = (child_address - (m_layerSplit * parent_address)) - 1;
-              uint16_t hash_index = inPortInfo.greySend.counter_tree[parent_address].max_cells[t + 1][child_shift];
+              uint16_t hash_index = inPortInfo.greySend.counter_tree.MaxCell(parent_address, t + 1, child_shift);
               hash_path[m_treeDepth - (t + 2)] = hash_index;
               child_address = parent_address;
             }
@@ -1612,13 +1740,13 @@ namespace ns3 {
             //std::cout << "Path: ";
             //std::cout << "Drops: " << counter_diff << std::endl;
             //std::cout << "Loss: " << packet_loss << std::endl;
-            //std::cout << "BF Collisions: " << inPortInfo.greySend.counter_tree[i].bloom_filter[j].count() << std::endl;
-            //std::cout << "Real Collisions: " << inPortInfo.greySend.counter_tree[i].hashed_flows[j].size() << std::endl
+            //std::cout << "BF Collisions: " << inPortInfo.greySend.counter_tree.BloomCount(i, j) << std::endl;
+            //std::cout << "Real Collisions: " << inPortInfo.greySend.counter_tree.HashedFlows(i, j).size() << std::endl
             //std::cout << "# End Soft Failure Detected\033[0m" << std::endl << std::endl;
 
             /* Add failure detection event to the sim data*/
-            m_simState->SetSoftFailureEvent(Simulator::Now().GetSeconds(), 1, hash_path, inPortInfo.greySend.counter_tree[i].hashed_flows[j],
-              inPortInfo.greySend.counter_tree[i].bloom_filter[j].count(), cell_local_counter, remote_counter, id, current_depth);
+            m_simState->SetSoftFailureEvent(Simulator::Now().GetSeconds(), 1, hash_path, inPortInfo.greySend.counter_tree.HashedFlows(i, j),
+              inPortInfo.greySend.counter_tree.BloomCount(i, j), cell_local_counter, remote_counter, id, current_depth);
           }
         }
 
@@ -1628,13 +1756,13 @@ namespace ns3 {
         }
         if (cost > 0)
         {
-          _NS_LOG_DEBUG("\033[1;31m|" << std::setw(2) << int(j) << ":" << std::setw(6) << std::setprecision(4) << cost << ":" << std::setw(2) << int(inPortInfo.greySend.counter_tree[i].bloom_filter[j].count()) << "|\033[0m ", m_enableDebug);
+          _NS_LOG_DEBUG("\033[1;31m|" << std::setw(2) << int(j) << ":" << std::setw(6) << std::setprecision(4) << cost << ":" << std::setw(2) << int(inPortInfo.greySend.counter_tree.BloomCount(i, j)) << "|\033[0m ", m_enableDebug);
         }
         else
         {
-          _NS_LOG_DEBUG("|" << std::setw(2) << int(j) << ":" << std::setw(6) << std::setprecision(4) << cost << ":" << std::setw(2) << int(inPortInfo.greySend.counter_tree[i].bloom_filter[j].count()) << "| ", m_enableDebug);
+          _NS_LOG_DEBUG("|" << std::setw(2) << int(j) << ":" << std::setw(6) << std::setprecision(4) << cost << ":" << std::setw(2) << int(inPortInfo.greySend.counter_tree.BloomCount(i, j)) << "| ", m_enableDebug);
         }
-        flow_counter += inPortInfo.greySend.counter_tree[i].bloom_filter[j].count();
+        flow_counter += inPortInfo.greySend.counter_tree.BloomCount(i, j);
 
         /* New max method: we do it with std:: due to a lack of time */
         current_max.push_back(std::make_pair(j, cost));
@@ -1671,7 +1799,7 @@ namespace ns3 {
         std::sort(current_max.begin(), current_max.end(), sortbysec);
         for (uint32_t jj = 0; jj < m_layerSplit; jj++)
         {
-          inPortInfo.greySend.counter_tree[i].max_cells[0][jj] = current_max[jj].first;
+          inPortInfo.greySend.counter_tree.MaxCell(i, 0, jj) = current_max[jj].first;
         }
       }
       else
@@ -1684,10 +1812,10 @@ namespace ns3 {
         {
           /* Checks if the index was not in the past 2 histories */
           if ((current_max[jj].second > 0) &&
-            (std::find(inPortInfo.greySend.counter_tree[i].max_cells[1].begin(), inPortInfo.greySend.counter_tree[i].max_cells[1].end(), current_max[jj].first) == inPortInfo.greySend.counter_tree[i].max_cells[1].end()) &&
-            (std::find(inPortInfo.greySend.counter_tree[i].max_cells[2].begin(), inPortInfo.greySend.counter_tree[i].max_cells[2].end(), current_max[jj].first) == inPortInfo.greySend.counter_tree[i].max_cells[2].end()))
+            (std::find(inPortInfo.greySend.counter_tree.MaxCells(i, 1), inPortInfo.greySend.counter_tree.MaxCells(i, 1) + m_layerSplit, current_max[jj].first) == inPortInfo.greySend.counter_tree.MaxCells(i, 1) + m_layerSplit) &&
+            (std::find(inPortInfo.greySend.counter_tree.MaxCells(i, 2), inPortInfo.greySend.counter_tree.MaxCells(i, 2) + m_layerSplit, current_max[jj].first) == inPortInfo.greySend.counter_tree.MaxCells(i, 2) + m_layerSplit))
           {
-            inPortInfo.greySend.counter_tree[i].max_cells[0][max_found] = current_max[jj].first;
+            inPortInfo.greySend.counter_tree.MaxCell(i, 0, max_found) = current_max[jj].first;
             max_found++;
             if (max_found == m_layerSplit)
             {
@@ -1703,7 +1831,7 @@ namespace ns3 {
         //std::cout << int(max_found) << " " << backup.size() << " " << current_max.size() << std::endl;
         for (uint32_t jj = 0; max_found < m_layerSplit; jj++, max_found++)
         {
-          inPortInfo.greySend.counter_tree[i].max_cells[0][max_found] = backup[jj];
+          inPortInfo.greySend.counter_tree.MaxCell(i, 0, max_found) = backup[jj];
         }
         /* end max*/
       }
@@ -1720,11 +1848,11 @@ namespace ns3 {
       _NS_LOG_DEBUG("New max indexes: ", m_enableDebug);
       for (uint8_t jj = 0; jj < m_layerSplit; jj++)
       {
-        _NS_LOG_DEBUG(int(inPortInfo.greySend.counter_tree[i].max_cells[0][jj]) << " ", m_enableDebug);
-        //inPortInfo.greySend.counter_tree[i].max_cells[0][jj] = inPortInfo.greySend.counter_tree[i].max_cells[0][jj];
+        _NS_LOG_DEBUG(int(inPortInfo.greySend.counter_tree.MaxCell(i, 0, jj)) << " ", m_enableDebug);
+        //inPortInfo.greySend.counter_tree.MaxCell(i, 0, jj) = inPortInfo.greySend.counter_tree.MaxCell(i, 0, jj);
       }
 
-      m_simState->SetMaxHistory(inPortInfo.greySend.counter_tree[i].max_cells);
+      m_simState->SetMaxHistory(inPortInfo.greySend.counter_tree.MaxCells(i, 0), m_treeDepth, m_layerSplit);
 
       /* DEBUG*/
       _NS_LOG_DEBUG(std::endl, m_enableDebug);
@@ -1736,7 +1864,7 @@ namespace ns3 {
         for (uint8_t j = 0; j < m_layerSplit; j++)
         {
           // defined macro to aboid std::endl                      
-          _NS_LOG_DEBUG(int(inPortInfo.greySend.counter_tree[i].max_cells[index][j]) << " ", m_enableDebug);
+          _NS_LOG_DEBUG(int(inPortInfo.greySend.counter_tree.MaxCell(i, index, j)) << " ", m_enableDebug);
         }
         _NS_LOG_DEBUG("\b)", m_enableDebug);
       }
@@ -1744,16 +1872,7 @@ namespace ns3 {
     }
 
     // Reset all the counter state
-    for (uint32_t i = 0; i < m_nodesInTree; i++)
-    {
-      std::fill(inPortInfo.greySend.counter_tree[i].counters.begin(), inPortInfo.greySend.counter_tree[i].counters.end(), 0);
-
-      for (uint32_t j = 0; j < m_counterWidth; j++)
-      {
-        inPortInfo.greySend.counter_tree[i].bloom_filter[j].reset();
-        inPortInfo.greySend.counter_tree[i].hashed_flows[j].clear();
-      }
-    }
+    inPortInfo.greySend.counter_tree.Reset(true);
   }
 
   void P4SwitchFancy::CounterExchangeAlgorithm(FancyPortInfo& inPortInfo, uint32_t id, FancyHeader& fancy_hdr)
@@ -1816,7 +1935,7 @@ namespace ns3 {
       i = start.ReadU16();
 
       /* Clean first level */
-      std::fill(inPortInfo.greySend.counter_tree[i].max_cells[0].begin(), inPortInfo.greySend.counter_tree[i].max_cells[0].end(), 0);
+      std::fill_n(inPortInfo.greySend.counter_tree.MaxCells(i, 0), m_layerSplit, 0);
       //std::vector<uint32_t> current_max (m_layerSplit);
       std::vector<std::pair<uint32_t, double>> current_max;
 
@@ -1830,7 +1949,7 @@ namespace ns3 {
       for (uint8_t j = 0; j < m_counterWidth; j++)
       {
         remote_counter = start.ReadU32();
-        cell_local_counter = inPortInfo.greySend.counter_tree[i].counters[j];
+        cell_local_counter = inPortInfo.greySend.counter_tree.Counter(i, j);
         counter_diff = cell_local_counter - remote_counter;
         if (counter_diff != 0)
         {
@@ -1859,10 +1978,10 @@ namespace ns3 {
         // before hit_counter[j]
 
         /* Save Tree node main state */
-        m_simState->SetCounterValues(cell_local_counter, remote_counter, inPortInfo.greySend.counter_tree[i].bloom_filter[j].count(),
-          inPortInfo.greySend.counter_tree[i].hashed_flows[j].size(), inPortInfo.greySend.counter_tree[i].bloom_filter[j]);
+        m_simState->SetCounterValues(cell_local_counter, remote_counter, inPortInfo.greySend.counter_tree.BloomCount(i, j),
+          inPortInfo.greySend.counter_tree.HashedFlows(i, j).size(), inPortInfo.greySend.counter_tree.BloomFilter(i, j), m_counterBloomFilterWidth);
 
-        if (i >= last_layer_index && cost > m_rerouteMinCost && inPortInfo.greySend.counter_tree[i].bloom_filter[j].count() <= m_maxCounterCollisions)
+        if (i >= last_layer_index && cost > m_rerouteMinCost && inPortInfo.greySend.counter_tree.BloomCount(i, j) <= m_maxCounterCollisions)
         {
           uint16_t child_address = i;
           char hash_path[m_treeDepth];
@@ -1874,7 +1993,7 @@ namespace ns3 {
           {
             uint16_t parent_address = (child_address - 1) / m_layerSplit;
             uint16_t child_shift = (child_address - (m_layerSplit * parent_address)) - 1;
-            uint16_t hash_index = inPortInfo.greySend.counter_tree[parent_address].max_cells[0][child_shift];
+            uint16_t hash_index = inPortInfo.greySend.counter_tree.MaxCell(parent_address, 0, child_shift);
             hash_path[m_treeDepth - (t + 2)] = hash_index;
             child_address = parent_address;
           }
@@ -1902,12 +2021,12 @@ namespace ns3 {
 
           std::cout << "Drops: " << counter_diff << std::endl;
           std::cout << "Loss: " << packet_loss << std::endl;
-          std::cout << "BF Collisions: " << inPortInfo.greySend.counter_tree[i].bloom_filter[j].count() << std::endl;
-          std::cout << "Real Collisions: " << inPortInfo.greySend.counter_tree[i].hashed_flows[j].size() << std::endl;
+          std::cout << "BF Collisions: " << inPortInfo.greySend.counter_tree.BloomCount(i, j) << std::endl;
+          std::cout << "Real Collisions: " << inPortInfo.greySend.counter_tree.HashedFlows(i, j).size() << std::endl;
           if (m_packet_hash_type == "FiveTupleHash")
           {
             std::cout << "Flows:" << std::endl;
-            for (auto it = inPortInfo.greySend.counter_tree[i].hashed_flows[j].begin(); it != inPortInfo.greySend.counter_tree[i].hashed_flows[j].end(); ++it)
+            for (auto it = inPortInfo.greySend.counter_tree.HashedFlows(i, j).begin(); it != inPortInfo.greySend.counter_tree.HashedFlows(i, j).end(); ++it)
             {
               PrintIpFiveTuple(it->second);
             }
@@ -1915,7 +2034,7 @@ namespace ns3 {
           else if (m_packet_hash_type == "DstPrefixHash")
           {
             std::cout << "Prefixes:" << std::endl;
-            for (auto it = inPortInfo.greySend.counter_tree[i].hashed_flows[j].begin(); it != inPortInfo.greySend.counter_tree[i].hashed_flows[j].end(); ++it)
+            for (auto it = inPortInfo.greySend.counter_tree.HashedFlows(i, j).begin(); it != inPortInfo.greySend.counter_tree.HashedFlows(i, j).end(); ++it)
             {
               PrintDstPrefix("", it->second);
             }
@@ -1925,8 +2044,8 @@ namespace ns3 {
           std::cout << "# End Failure Detected\033[0m" << std::endl << std::endl;
 
           /* Add failure detection event to the sim data*/
-          m_simState->SetFailureEvent(Simulator::Now().GetSeconds(), hash_path, bloom_filter_indexes, inPortInfo.greySend.counter_tree[i].hashed_flows[j],
-            inPortInfo.greySend.counter_tree[i].bloom_filter[j].count(), cell_local_counter, remote_counter, id, inPortInfo.failures_count);
+          m_simState->SetFailureEvent(Simulator::Now().GetSeconds(), hash_path, bloom_filter_indexes, inPortInfo.greySend.counter_tree.HashedFlows(i, j),
+            inPortInfo.greySend.counter_tree.BloomCount(i, j), cell_local_counter, remote_counter, id, inPortInfo.failures_count);
           /* TODO probably remove (there are 3 more)
           /* Early stop simulation */
           if (m_early_stop_counter > 0 && inPortInfo.failures_count == m_early_stop_counter)
@@ -1937,10 +2056,10 @@ namespace ns3 {
 
 
         }
-        else if (i >= last_layer_index && cost > m_rerouteMinCost && inPortInfo.greySend.counter_tree[i].bloom_filter[j].count() > m_maxCounterCollisions)
+        else if (i >= last_layer_index && cost > m_rerouteMinCost && inPortInfo.greySend.counter_tree.BloomCount(i, j) > m_maxCounterCollisions)
         {
 
-          m_simState->SetCollisionEvent(seq, i, j, inPortInfo.greySend.counter_tree[i].bloom_filter[j].count());
+          m_simState->SetCollisionEvent(seq, i, j, inPortInfo.greySend.counter_tree.BloomCount(i, j));
           //std::cout << "# Too many flows hashed at the last layer: node=" << int(i) << " depth=" << KArryTreeDepth(m_layerSplit, i) 
           //<< " cell=" << int(j) << " collisions=" <<  << j << std::endl;
         }
@@ -1951,13 +2070,13 @@ namespace ns3 {
         }
         if (cost > 0)
         {
-          _NS_LOG_DEBUG("\033[1;31m|" << std::setw(2) << int(j) << ":" << std::setw(6) << std::setprecision(4) << cost << ":" << std::setw(2) << int(inPortInfo.greySend.counter_tree[i].bloom_filter[j].count()) << "|\033[0m ", m_enableDebug);
+          _NS_LOG_DEBUG("\033[1;31m|" << std::setw(2) << int(j) << ":" << std::setw(6) << std::setprecision(4) << cost << ":" << std::setw(2) << int(inPortInfo.greySend.counter_tree.BloomCount(i, j)) << "|\033[0m ", m_enableDebug);
         }
         else
         {
-          _NS_LOG_DEBUG("|" << std::setw(2) << int(j) << ":" << std::setw(6) << std::setprecision(4) << cost << ":" << std::setw(2) << int(inPortInfo.greySend.counter_tree[i].bloom_filter[j].count()) << "| ", m_enableDebug);
+          _NS_LOG_DEBUG("|" << std::setw(2) << int(j) << ":" << std::setw(6) << std::setprecision(4) << cost << ":" << std::setw(2) << int(inPortInfo.greySend.counter_tree.BloomCount(i, j)) << "| ", m_enableDebug);
         }
-        flow_counter += inPortInfo.greySend.counter_tree[i].bloom_filter[j].count();
+        flow_counter += inPortInfo.greySend.counter_tree.BloomCount(i, j);
 
         // checks if the difference is bigger than any of the current maxes if so sets it 
         //for (uint8_t jj=0 ; jj < m_layerSplit; jj++)
@@ -1972,10 +2091,10 @@ namespace ns3 {
         //    for (int shift_index = m_layerSplit-2; shift_index >= jj; shift_index--)
         //    {
         //      current_max[shift_index+1] = current_max[shift_index];
-        //      inPortInfo.greySend.counter_tree[i].max_cells[0][shift_index+1] = inPortInfo.greySend.counter_tree[i].max_cells[0][shift_index];
+        //      inPortInfo.greySend.counter_tree.MaxCell(i, 0, shift_index+1) = inPortInfo.greySend.counter_tree.MaxCell(i, 0, shift_index);
         //    }
         //    current_max[jj] = counter_diff;
-        //    inPortInfo.greySend.counter_tree[i].max_cells[0][jj] = j;
+        //    inPortInfo.greySend.counter_tree.MaxCell(i, 0, jj) = j;
         //    break;
         //  }
         //}
@@ -1988,7 +2107,7 @@ namespace ns3 {
       std::sort(current_max.begin(), current_max.end(), sortbysec);
       for (uint32_t jj = 0; jj < m_layerSplit; jj++)
       {
-        inPortInfo.greySend.counter_tree[i].max_cells[0][jj] = current_max[jj].first;
+        inPortInfo.greySend.counter_tree.MaxCell(i, 0, jj) = current_max[jj].first;
       }
 
       _NS_LOG_DEBUG(std::endl, m_enableDebug);
@@ -2002,11 +2121,11 @@ namespace ns3 {
       _NS_LOG_DEBUG("New max indexes: ", m_enableDebug);
       for (uint8_t jj = 0; jj < m_layerSplit; jj++)
       {
-        _NS_LOG_DEBUG(int(inPortInfo.greySend.counter_tree[i].max_cells[0][jj]) << " ", m_enableDebug);
-        inPortInfo.greySend.counter_tree[i].max_cells[0][jj] = inPortInfo.greySend.counter_tree[i].max_cells[0][jj];
+        _NS_LOG_DEBUG(int(inPortInfo.greySend.counter_tree.MaxCell(i, 0, jj)) << " ", m_enableDebug);
+        inPortInfo.greySend.counter_tree.MaxCell(i, 0, jj) = inPortInfo.greySend.counter_tree.MaxCell(i, 0, jj);
       }
 
-      m_simState->SetMaxHistory(inPortInfo.greySend.counter_tree[i].max_cells);
+      m_simState->SetMaxHistory(inPortInfo.greySend.counter_tree.MaxCells(i, 0), m_treeDepth, m_layerSplit);
 
       /* DEBUG*/
       _NS_LOG_DEBUG(std::endl, m_enableDebug);
@@ -2018,7 +2137,7 @@ namespace ns3 {
         for (uint8_t j = 0; j < m_layerSplit; j++)
         {
           // defined macro to aboid std::endl                      
-          _NS_LOG_DEBUG(int(inPortInfo.greySend.counter_tree[i].max_cells[index][j]) << " ", m_enableDebug);
+          _NS_LOG_DEBUG(int(inPortInfo.greySend.counter_tree.MaxCell(i, index, j)) << " ", m_enableDebug);
         }
         _NS_LOG_DEBUG("\b)", m_enableDebug);
       }
@@ -2028,16 +2147,7 @@ namespace ns3 {
     // Reset all the counter state when we are at the bottom of the tree
     if ((zoom_phase + 1) == m_treeDepth)
     {
-      for (uint32_t i = 0; i < m_nodesInTree; i++)
-      {
-        std::fill(inPortInfo.greySend.counter_tree[i].counters.begin(), inPortInfo.greySend.counter_tree[i].counters.end(), 0);
-
-        for (uint32_t j = 0; j < m_counterWidth; j++)
-        {
-          inPortInfo.greySend.counter_tree[i].bloom_filter[j].reset();
-          inPortInfo.greySend.counter_tree[i].hashed_flows[j].clear();
-        }
-      }
+      inPortInfo.greySend.counter_tree.Reset(true);
     }
   }
 
@@ -2045,7 +2155,7 @@ namespace ns3 {
   {
 
     // Update the receiving port time 
-    FancyPortInfo& portInfo = m_portsInfo[meta.inPort->GetIfIndex()];
+    FancyPortInfo& portInfo = m_portsInfo[GetPortNumber(meta.inPort)];
     portInfo.last_time_received = Simulator::Now();
 
     /* Wild card counting */
@@ -2060,16 +2170,17 @@ namespace ns3 {
     /* This counts packets for everything, maybe we should only check IPV4 ? */
     if (m_treeEnableSoftDetections)
     {
-      if (portInfo.greyRecv.greyState[m_numTopEntries + 1] == GreyState::COUNTING and meta.headers.count("IPV4") > 0)
+      if (portInfo.greyRecv.greyState[m_numTopEntries + 1] == GreyState::COUNTING and meta.headers.IsValid(pkt_headers::HDR_IPV4))
       {
         portInfo.greyRecv.localCounter[m_numTopEntries + 1]++;
       }
     }
 
     // If FANCY header is valid we run the state machine
-    if (meta.headers.count("FANCY") > 0)
+    if (meta.headers.IsValid(pkt_headers::HDR_FANCY))
     {
-      FancyHeader& fancy_hdr = std::any_cast<FancyHeader&>(meta.headers["FANCY"]);
+      FancyHeader& fancy_hdr = meta.headers.fancy;
+      meta.headers.SetModified(pkt_headers::HDR_FANCY);
 
       /* Receivers State machine */
       uint32_t id = fancy_hdr.GetId();
@@ -2396,11 +2507,12 @@ namespace ns3 {
      -> ! just match at the top entries table */
     if (meta.outPort != NULL)
     {
-      FancyPortInfo& outPortInfo = m_portsInfo[meta.outPort->GetIfIndex()];
+      FancyPortInfo& outPortInfo = m_portsInfo[GetPortNumber(meta.outPort)];
 
-      if (meta.str_flow == "")
+      if (!meta.key_set)
       {
-        meta.str_flow = (m_packet_str_funct)(meta.flow);
+        meta.key = (*m_packet_key_funct)(meta.flow);
+        meta.key_set = true;
       }
 
       /* Get State machine index */
@@ -2454,7 +2566,7 @@ namespace ns3 {
           if (m_treeEnabled)
           {
             uint32_t bloom_filter_indexes[m_rerouteBloomFilterNumHashes];
-            GetBloomFilterHashes(meta.flow, bloom_filter_indexes, m_counterWidth, m_rerouteBloomFilterWidth);
+            GetBloomFilterHashes(meta, bloom_filter_indexes, m_rerouteBloomFilterWidth);
 
             if (IsBloomFilterSet(outPortInfo, bloom_filter_indexes))
             {
@@ -2463,7 +2575,7 @@ namespace ns3 {
 
               /* Not the best way to check if they have been already rerouted */
               /* We could simplify this a bit, but for debugging maybe having the 3 positions is useful */
-              if (outPortInfo.reroute[bloom_filter_indexes[0]].already_rerouted.count(meta.str_flow) == 0)
+              if (outPortInfo.reroute[bloom_filter_indexes[0]].already_rerouted.count(meta.key) == 0)
               {
 
                 std::cout << "\033[1;32m# Reroute Event" << std::endl;
@@ -2474,7 +2586,7 @@ namespace ns3 {
                 for (uint32_t i = 0; i < m_rerouteBloomFilterNumHashes; i++)
                 {
                   _NS_LOG_DEBUG(bloom_filter_indexes[i] << " ", m_enableDebug);
-                  outPortInfo.reroute[bloom_filter_indexes[i]].already_rerouted.insert(meta.str_flow);
+                  outPortInfo.reroute[bloom_filter_indexes[i]].already_rerouted.insert(meta.key);
                 }
                 outPortInfo.reroute_count++;
                 std::cout << "Reroute number: " << outPortInfo.reroute_count << std::endl;
@@ -2510,9 +2622,10 @@ namespace ns3 {
     */
 
     // Egress State machine 
-    if (!meta.internalPacket && meta.headers.count("FANCY") > 0)
+    if (!meta.internalPacket && meta.headers.IsValid(pkt_headers::HDR_FANCY))
     {
-      FancyHeader& fancy_hdr = std::any_cast<FancyHeader&>(meta.headers["FANCY"]);
+      FancyHeader& fancy_hdr = meta.headers.fancy;
+      meta.headers.SetModified(pkt_headers::HDR_FANCY);
       bool fsm = fancy_hdr.GetFSMFlag();
 
       /* Only if its for our state machine, meaning the other side sent it*/
@@ -2526,7 +2639,7 @@ namespace ns3 {
 
         // Get Input port info: which is output port at the same time right?
         // in out is the same! 
-        FancyPortInfo& inPortInfo = m_portsInfo[meta.inPort->GetIfIndex()];
+        FancyPortInfo& inPortInfo = m_portsInfo[GetPortNumber(meta.inPort)];
 
         //Once the action is read we reset it
         fancy_hdr.ResetActionField();
@@ -2750,19 +2863,19 @@ namespace ns3 {
       }
     }
 
-    FancyPortInfo& outPortInfo = m_portsInfo[meta.outPort->GetIfIndex()];
+    FancyPortInfo& outPortInfo = m_portsInfo[GetPortNumber(meta.outPort)];
 
     /* Get the state machine index where to count from here */
     uint32_t id = meta.id;
 
     /* Wildcard state machine always counts */
-    if (outPortInfo.greySend.greyState[m_numTopEntries + 1] == GreyState::COUNTING && outPortInfo.switchPort && (meta.headers.count("IPV4") > 0))
+    if (outPortInfo.greySend.greyState[m_numTopEntries + 1] == GreyState::COUNTING && outPortInfo.switchPort && (meta.headers.IsValid(pkt_headers::HDR_IPV4)))
     {
       outPortInfo.greySend.localCounter[m_numTopEntries + 1]++;
     }
 
     // if the other side is a switch and we are GreyState::COUNTING
-    if (outPortInfo.greySend.greyState[id] == GreyState::COUNTING && outPortInfo.switchPort && (meta.headers.count("IPV4") > 0))
+    if (outPortInfo.greySend.greyState[id] == GreyState::COUNTING && outPortInfo.switchPort && (meta.headers.IsValid(pkt_headers::HDR_IPV4)))
     {
 
       /* Count Output Packets for the zooming data structure */
@@ -2784,10 +2897,11 @@ namespace ns3 {
       }
 
       /* we modify so we count at the other side in case the header is already here */
-      if (meta.headers.count("FANCY") > 0)
+      if (meta.headers.IsValid(pkt_headers::HDR_FANCY))
       {
         // Change it so the other side counts
-        FancyHeader& fancy_hdr = std::any_cast<FancyHeader&>(meta.headers["FANCY"]);
+        FancyHeader& fancy_hdr = meta.headers.fancy;
+        meta.headers.SetModified(pkt_headers::HDR_FANCY);
         //set count bit
         fancy_hdr.SetCountFlag(true);
         fancy_hdr.SetId(id);
@@ -2804,22 +2918,23 @@ namespace ns3 {
         fancy_hdr.SetNextHeader(meta.protocol);
         fancy_hdr.SetSeq(outPortInfo.greySend.currentSEQ[id]);
         meta.protocol = FANCY;
-        meta.headers["FANCY"] = fancy_hdr;
+        meta.headers.fancy = fancy_hdr;
+        meta.headers.SetValid(pkt_headers::HDR_FANCY);
       }
     }
     // If the other side is a host
-    else if (!outPortInfo.switchPort && meta.headers.count("FANCY") > 0)
+    else if (!outPortInfo.switchPort && meta.headers.IsValid(pkt_headers::HDR_FANCY))
     {
       // remove fancy header and set the ethrnet protocol of the next header that was
       // stored in the fancy header
-      meta.protocol = std::any_cast<FancyHeader>(meta.headers["FANCY"]).GetNextHeader();
+      meta.protocol = meta.headers.fancy.GetNextHeader();
 
       // Just in case the packet made it here we have to drop it
       if (meta.protocol == 0)
       {
         meta.drop_flag = true;
       }
-      meta.headers.erase("FANCY");
+      meta.headers.SetInvalid(pkt_headers::HDR_FANCY);
     }
 
   }
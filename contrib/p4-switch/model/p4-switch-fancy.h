@@ -27,6 +27,7 @@
 #include "ns3/event-id.h"
 #include "ns3/flow-error-model.h"
 #include "ns3/hash-utils.h"
+#include "ns3/random-variable-stream.h"
 #include "p4-switch-utils.h"
 #include "fancy-header.h"
 
@@ -35,7 +36,6 @@
 #include <map>
 #include <vector>
 #include <unordered_map>
-#include <any>
 #include <algorithm>
 #include <math.h>
 #include <unordered_set>
@@ -44,7 +44,6 @@
 #include <ctime>
 #include <iomanip>
 #include <memory>
-#include <boost/dynamic_bitset.hpp>
 
 namespace ns3 {
 
@@ -74,27 +73,129 @@ namespace ns3 {
     RELATIVE = 1  //1 
   };
 
-  struct HashCounter
+  /* How sender side packets are attributed to tree cells. Only used to
+   * report the flows behind a failure, detection does not depend on it */
+  enum class FlowAttribution
   {
+    OFF = 0,       //0 no per cell flow state at all
+    RESERVOIR = 1, //1 bounded reservoir sample of flows per cell
+    FULL = 2       //2 every flow hashed to the cell
+  };
+
+  /* Zooming counter tree stored as one structure of arrays for all the
+   * nodes. Per cell arrays are indexed by node * width + cell, every cell
+   * owns bloom_words 64-bit words of bloom filter and the max history of a
+   * node is a contiguous depth * split block (level 0 first). */
+  struct CounterTree
+  {
+    uint32_t nodes = 0;
+    uint32_t width = 0;
+    uint32_t depth = 0;
+    uint32_t split = 0;
+    uint32_t bloom_width = 0;
+    uint32_t bloom_words = 0;
+
     /* Packet loss counter*/
-    //uint32_t counters[COUNTER_WIDTH];
     std::vector<uint32_t> counters;
 
     /* last flow we have hashed */
-    //ip_five_tuple last_flow[COUNTER_WIDTH];
     std::vector<ip_five_tuple> last_flow;
 
     /* Hashed flows */
     /* All flows hashed in a cell for meassuring debugging propuses*/
-    std::vector<std::unordered_map<std::string, ip_five_tuple>> hashed_flows;
+    std::vector<flow_key_map> hashed_flows;
+
+    /* New flows offered to each cell reservoir since the last reset */
+    std::vector<uint32_t> flows_seen;
+
+    /* Reservoir attribution only, see AllocateReservoir: per cell bitmap
+     * of the flows offered since the last reset, indexed by the flow key
+     * hash, and the keys of the sampled flows, sample_size slots per cell */
+    static constexpr uint32_t OFFERED_WORDS = 16;
+    uint32_t sample_size = 0;
+    std::vector<uint64_t> offered;
+    std::vector<flow_key> sample_keys;
 
     /* bloom filters per cell to count flows*/
-    //std::bitset<COUNTER_BLOOM_FILTER_WIDTH> bloom_filter[COUNTER_WIDTH];
-    std::vector<boost::dynamic_bitset<>> bloom_filter;
+    std::vector<uint64_t> bloom_filter;
 
     /* where we save previous maxes */
-    //uint8_t max_cells[TREE_DEPTH][LAYER_SPLIT];
-    std::vector<std::vector<uint8_t>> max_cells;
+    std::vector<uint8_t> max_cells;
+
+    void Allocate(uint32_t num_nodes, uint32_t counter_width, uint32_t tree_depth,
+      uint32_t layer_split, uint32_t bloom_filter_width);
+    /* Allocates the reservoir state on the first sampled flow, so the
+     * other attribution modes do not pay for it */
+    void AllocateReservoir(uint32_t reservoir_size);
+
+    /* Clears counters and bloom filters of the whole tree (and the
+     * hashed flows when clear_flows is set) */
+    void Reset(bool clear_flows);
+
+    /* Shifts the max history of a node one level down and clears level 0 */
+    void ShiftMaxHistory(uint32_t node);
+
+    uint32_t Cell(uint32_t node, uint32_t index) const
+    {
+      return node * width + index;
+    }
+    uint32_t* Counters(uint32_t node)
+    {
+      return &counters[node * width];
+    }
+    uint32_t& Counter(uint32_t node, uint32_t index)
+    {
+      return counters[Cell(node, index)];
+    }
+    ip_five_tuple& LastFlow(uint32_t node, uint32_t index)
+    {
+      return last_flow[Cell(node, index)];
+    }
+    flow_key_map& HashedFlows(uint32_t node, uint32_t index)
+    {
+      return hashed_flows[Cell(node, index)];
+    }
+    uint8_t* MaxCells(uint32_t node, uint32_t level)
+    {
+      return &max_cells[(node * depth + level) * split];
+    }
+    uint8_t& MaxCell(uint32_t node, uint32_t level, uint32_t index)
+    {
+      return max_cells[(node * depth + level) * split + index];
+    }
+    const uint64_t* BloomFilter(uint32_t node, uint32_t index) const
+    {
+      return &bloom_filter[Cell(node, index) * bloom_words];
+    }
+    void SetBloomBit(uint32_t node, uint32_t index, uint32_t bit)
+    {
+      bloom_filter[Cell(node, index) * bloom_words + (bit >> 6)] |= uint64_t(1) << (bit & 63);
+    }
+    /* Marks a flow as offered to a cell, false if it already was. Flows
+     * evicted from the sample are not counted again, up to false positives
+     * once a cell has seen a good part of its OFFERED_WORDS * 64 bits */
+    bool Offer(uint32_t node, uint32_t index, std::size_t key_hash)
+    {
+      uint64_t& word = offered[Cell(node, index) * OFFERED_WORDS + (key_hash >> 6) % OFFERED_WORDS];
+      uint64_t bit = uint64_t(1) << (key_hash & 63);
+      bool fresh = (word & bit) == 0;
+      word |= bit;
+      return fresh;
+    }
+    flow_key* SampleKeys(uint32_t node, uint32_t index)
+    {
+      return &sample_keys[Cell(node, index) * sample_size];
+    }
+    uint32_t BloomCount(uint32_t node, uint32_t index) const
+    {
+      const uint64_t* words = BloomFilter(node, index);
+      uint32_t count = 0;
+      for (uint32_t w = 0; w < bloom_words; w++)
+      {
+        count += __builtin_popcountll(words[w]);
+      }
+      return count;
+    }
   };
 
   struct RerouteBloomFilter
@@ -102,7 +203,7 @@ namespace ns3 {
     bool set = false;
     //bool notified;
     /* this can be anything, a prefix or an entire flow */
-    std::unordered_set<std::string> already_rerouted;
+    std::unordered_set<flow_key, flow_key_hash> already_rerouted;
     uint8_t outPort = 0;
   };
 
@@ -130,8 +231,7 @@ namespace ns3 {
     std::vector<uint32_t> last_packet_seq;
 
     /* Tree data structure */
-    std::vector<HashCounter> counter_tree;
-    //HashCounter counter_tree[NODES_IN_TREE];
+    CounterTree counter_tree;
   };
 
   struct FancyPortInfo : PortInfo
@@ -163,6 +263,11 @@ namespace ns3 {
     virtual void AddSwitchPort(Ptr<NetDevice> switchPort);
     virtual void Init();
     virtual void SetDebug(bool state);
+    void SetOutFile(std::string out_file);
+    std::string GetOutFile(void) const;
+    /* Continues the output in out_file, which starts as a copy of the
+       current one. Used when the simulation is forked into branches */
+    void BranchOutFile(std::string out_file);
 
     void DisableTopEntries(void);
     void DisableAllFSM(void);
@@ -193,6 +298,7 @@ namespace ns3 {
     /* Failure detection specific methods */
     void SendProbe(const Time& delay, Ptr<const Packet> packet, pkt_info meta);
     void CheckPortState(const Time& delay, Ptr<NetDevice> port);
+    void StartGreyAction(Ptr<NetDevice> outPort, uint8_t action, uint32_t id);
     void SendGreyAction(Ptr<NetDevice> outPort, uint8_t action, uint32_t id);
     void SendGreyCounter(Ptr<NetDevice> outPort, uint32_t id);
 
@@ -202,6 +308,7 @@ namespace ns3 {
     /* Counting Functions */
     void PipelinedPacketCounting(GreyInfo& greyPortInfo, uint32_t id, pkt_info& meta, bool sender);
     void PacketCounting(GreyInfo& greyPortInfo, uint32_t id, pkt_info& meta, bool sender);
+    void AttributeFlow(CounterTree& tree, uint32_t node, uint32_t index, pkt_info& meta);
 
     /* State Resets at the receiver */
     void PipelinedInitReceiverStep(FancyPortInfo& portInfo, uint32_t id, uint16_t length, Buffer::Iterator& start, bool shift_history);
@@ -212,7 +319,8 @@ namespace ns3 {
     void CounterExchangeAlgorithm(FancyPortInfo& inPortInfo, uint32_t id, FancyHeader& fancy_hdr);
 
 
-    void GetBloomFilterHashes(ip_five_tuple& ip_five_tuple, uint32_t hash_indexes[], int unit_modulo, int bloom_filter_modulo);
+    void ComputePacketHashes(pkt_info& meta);
+    void GetBloomFilterHashes(pkt_info& meta, uint32_t hash_indexes[], int bloom_filter_modulo);
     uint32_t GetFlowHash(ip_five_tuple& five_tuple, int hash_index, int modulo);
     uint32_t GetDstPrefixHash(ip_five_tuple& five_tuple, int hash_index, int modulo);
 
@@ -234,8 +342,6 @@ namespace ns3 {
     /*
     Switch Pipeline State
     */
-    std::vector<std::string> header_stack = { "FANCY", "ARP","IPV4", "UDP", "TCP" };
-    std::vector<std::string> header_stack_reverse;
 
     //HashUtils * m_hash;
     std::unique_ptr<HashUtils> m_hash;
@@ -245,7 +351,10 @@ namespace ns3 {
     /* HOW TO CALL? (this->*m_packet_hash)(ip_five_tuple, i, unit_modulo) */
     /* This is used so we can have different ways of hashing a packet and then getting indexes */
     uint32_t(P4SwitchFancy::* m_packet_hash)(ip_five_tuple& five_tuple, int hash_index, int modulo);
-    std::string(*m_packet_str_funct)(ip_five_tuple& flow);
+    flow_key(*m_packet_key_funct)(ip_five_tuple& flow);
+    /* Buffer hashed by m_packet_hash, used to batch all the hashes of a packet */
+    void(*m_packet_buffer_funct)(char* data, ip_five_tuple& flow);
+    uint32_t m_packet_buffer_size;
 
     std::string m_packet_hash_type = "FiveTupleHash"; //DstPrefixHash
     // (this->*m_packet_hash)(ip_five_tuple, i, unit_modulo) (how to call)
@@ -253,13 +362,13 @@ namespace ns3 {
     /* Simulation run state */
     std::unique_ptr<FancySimulationState> m_simState;
 
-    std::unordered_map<uint32_t, FancyPortInfo> m_portsInfo;
+    std::vector<FancyPortInfo> m_portsInfo; // indexed by port number
     Ptr<RateErrorModel> tm_em = CreateObject<RateErrorModel>();
     Ptr<RateErrorModel> fail_em = CreateObject<RateErrorModel>();
 
     /* Top K Entries: TODO this should be done at a per-egress level but not
     strictly needed now */
-    std::unordered_map<std::string, uint32_t> m_topEntries;
+    std::unordered_map<flow_key, uint32_t, flow_key_hash> m_topEntries;
     uint32_t m_numTopEntries = 0;
 
     /* Zooming Algorithm Parameters */
@@ -279,6 +388,11 @@ namespace ns3 {
     uint16_t m_uniformLossThreshold = 0;
     uint16_t m_costType = 1;
     double   m_rerouteMinCost = 0;
+    uint16_t m_flowAttribution = 2;
+    uint32_t m_flowAttributionSampleSize = 8;
+    Ptr<UniformRandomVariable> m_attributionRng;
+    /* Fixed stream of the attribution variable, plus the switch id */
+    static constexpr int64_t ATTRIBUTION_STREAM_BASE = 1000000;
     /* zooming parameters */
 
     /* constant attributes that drive the state */
@@ -288,6 +402,9 @@ namespace ns3 {
     bool m_check_port_state_enable = true;
     double m_send_port_state_ms = m_check_port_state_ms / 2;
     double m_start_system_sec = 2;
+    /* Set by DisableTopEntries and DisableAllFSM, checked when the machines start */
+    bool m_topEntriesDisabled = false;
+    bool m_allFSMDisabled = false;
     double m_ack_wait_time_ms = 5;
     double m_send_counter_wait_ms = 5;
     double m_time_between_campaing_ms = 2;
@@ -46,6 +46,66 @@ namespace ns3 {
 #define TCP  6
 #define UDP  17
 
+  void
+    LossRadarMeter::Allocate(uint32_t num_cells)
+  {
+    src_ip.assign(num_cells, 0);
+    dst_ip.assign(num_cells, 0);
+    src_port.assign(num_cells, 0);
+    dst_port.assign(num_cells, 0);
+    id.assign(num_cells, 0);
+    protocol.assign(num_cells, 0);
+    pkt_counter.assign(num_cells, 0);
+  }
+
+  void
+    LossRadarMeter::Clear(void)
+  {
+    std::fill(src_ip.begin(), src_ip.end(), 0);
+    std::fill(dst_ip.begin(), dst_ip.end(), 0);
+    std::fill(src_port.begin(), src_port.end(), 0);
+    std::fill(dst_port.begin(), dst_port.end(), 0);
+    std::fill(id.begin(), id.end(), 0);
+    std::fill(protocol.begin(), protocol.end(), 0);
+    std::fill(pkt_counter.begin(), pkt_counter.end(), 0);
+  }
+
+  void
+    LossRadarMeter::Subtract(const LossRadarMeter& other)
+  {
+    /* One pass per field keeps every loop a plain element wise
+     * operation over two contiguous arrays */
+    uint32_t num_cells = pkt_counter.size();
+    for (uint32_t i = 0; i < num_cells; i++)
+    {
+      pkt_counter[i] -= other.pkt_counter[i];
+    }
+    for (uint32_t i = 0; i < num_cells; i++)
+    {
+      src_ip[i] ^= other.src_ip[i];
+    }
+    for (uint32_t i = 0; i < num_cells; i++)
+    {
+      dst_ip[i] ^= other.dst_ip[i];
+    }
+    for (uint32_t i = 0; i < num_cells; i++)
+    {
+      src_port[i] ^= other.src_port[i];
+    }
+    for (uint32_t i = 0; i < num_cells; i++)
+    {
+      dst_port[i] ^= other.dst_port[i];
+    }
+    for (uint32_t i = 0; i < num_cells; i++)
+    {
+      id[i] ^= other.id[i];
+    }
+    for (uint32_t i = 0; i < num_cells; i++)
+    {
+      protocol[i] ^= other.protocol[i];
+    }
+  }
+
   TypeId
     P4SwitchLossRadar::GetTypeId(void)
   {
@@ -79,17 +139,14 @@ namespace ns3 {
         MakeDoubleChecker<double>())
       .AddAttribute("OutFile", "Name of the output file for the data generated.",
         StringValue(""),
-        MakeStringAccessor(&P4SwitchLossRadar::m_outFile),
+        MakeStringAccessor(&P4SwitchLossRadar::GetOutFile, &P4SwitchLossRadar::SetOutFile),
         MakeStringChecker())
       ;
     return tid;
   }
 
   P4SwitchLossRadar::P4SwitchLossRadar()
-    :
-    header_stack_reverse(header_stack)
   {
-    std::reverse(header_stack_reverse.begin(), header_stack_reverse.end());
   }
 
   P4SwitchLossRadar::~P4SwitchLossRadar()
@@ -102,7 +159,7 @@ namespace ns3 {
 
     if (m_outFile != "")
     {
-      m_simState->SaveInJson(m_outFile);
+      m_simState->Close();
       // save packet drops
       if (m_drop_times.size() > 0)
       {
@@ -114,9 +171,9 @@ namespace ns3 {
   }
 
   LossRadarPortInfo&
-    P4SwitchLossRadar::GetPortInfo(uint32_t i)
+    P4SwitchLossRadar::GetPortInfo(uint32_t port_num)
   {
-    return m_portsInfo[i];
+    return m_portsInfo[port_num];
   }
 
   /* Hash functions */
@@ -128,9 +185,10 @@ namespace ns3 {
     char s[15];
     IpFiveTupleWithIdToBuffer(s, flow);
 
+    m_hash->GetHashes(s, 15, 0, m_numHashes, hash_indexes);
     for (uint32_t i = 0; i < m_numHashes; i++)
     {
-      hash_indexes[i] = m_hash->GetHash(s, 15, i, m_numCells);
+      hash_indexes[i] = hash_indexes[i] % m_numCells;
     }
   }
 
@@ -141,7 +199,7 @@ namespace ns3 {
 
     /* Get registers */
 
-    LossRadarPortInfo& portInfo = m_portsInfo[port->GetIfIndex()];
+    LossRadarPortInfo& portInfo = m_portsInfo[GetPortNumber(port)];
 
     NS_LOG_DEBUG("Link: " << portInfo.link_name << " batch id: " << uint32_t(batch_id));
     Ptr<Node> otherNode = portInfo.otherPortDevice->GetNode();
@@ -156,78 +214,95 @@ namespace ns3 {
       }
     }
 
-    LossRadarPortInfo& otherPortInfo = (DynamicCast<P4SwitchLossRadar>(otherNode->GetDevice(device_id)))->GetPortInfo(portInfo.otherPortDevice->GetIfIndex());
+    Ptr<P4SwitchLossRadar> otherSwitch = DynamicCast<P4SwitchLossRadar>(otherNode->GetDevice(device_id));
+    LossRadarPortInfo& otherPortInfo = otherSwitch->GetPortInfo(otherSwitch->GetPortNumber(portInfo.otherPortDevice));
+
+    LossRadarMeter& meter = portInfo.um_info[batch_id];
 
     /* Do register difference */
-    for (uint32_t i = 0; i < m_numCells; i++)
-    {
-      portInfo.um_info[batch_id][i].pkt_counter -= otherPortInfo.dm_info[batch_id][i].pkt_counter;
-      portInfo.um_info[batch_id][i].src_ip ^= otherPortInfo.dm_info[batch_id][i].src_ip;
-      portInfo.um_info[batch_id][i].dst_ip ^= otherPortInfo.dm_info[batch_id][i].dst_ip;
-      portInfo.um_info[batch_id][i].id ^= otherPortInfo.dm_info[batch_id][i].id;
-      portInfo.um_info[batch_id][i].src_port ^= otherPortInfo.dm_info[batch_id][i].src_port;
-      portInfo.um_info[batch_id][i].dst_port ^= otherPortInfo.dm_info[batch_id][i].dst_port;
-      portInfo.um_info[batch_id][i].protocol ^= otherPortInfo.dm_info[batch_id][i].protocol;
-    }
+    meter.Subtract(otherPortInfo.dm_info[batch_id]);
 
     /* count total packets in the filter */
     uint32_t total_packets_lost_in_batch = 0;
     for (uint32_t i = 0; i < m_numCells; i++)
     {
-      total_packets_lost_in_batch += portInfo.um_info[batch_id][i].pkt_counter;
+      total_packets_lost_in_batch += meter.pkt_counter[i];
     }
 
     /* Compute packet losses */
     std::vector<ip_five_tuple> packets_lost;
 
-    /* Report packet losses */
+    /* Report packet losses. Peeling decoder: instead of rescanning all
+     * the cells every round we keep a bitmap of pure cells (counter == 1)
+     * that is only updated for the cells touched by a removal. Each round
+     * walks the bitmap in increasing cell order from the position of the
+     * last decoded cell, which visits exactly the cells a full scan would
+     * decode, in the same order. */
+    uint32_t num_words = (m_numCells + 63) / 64;
+    std::vector<uint64_t> pure(num_words, 0);
+    for (uint32_t i = 0; i < m_numCells; i++)
+    {
+      if (meter.pkt_counter[i] == 1)
+      {
+        pure[i >> 6] |= uint64_t(1) << (i & 63);
+      }
+    }
+
+    uint32_t meter_hash_indexes[m_numHashes];
     bool converged = false;
     bool step = false;
     while (not converged)
     {
       step = false;
-      for (uint32_t i = 0; i < m_numCells; i++)
+      uint32_t i = 0;
+      while (i < m_numCells)
       {
-        if (portInfo.um_info[batch_id][i].pkt_counter == 1)
+        /* next pure cell at or after i */
+        uint32_t word = i >> 6;
+        uint64_t bits = pure[word] & (~uint64_t(0) << (i & 63));
+        while (bits == 0 && ++word < num_words)
+        {
+          bits = pure[word];
+        }
+        if (bits == 0)
         {
-          step = true;
-
-          /* get flow from the pure cell*/
-          ip_five_tuple flow;
-          flow.src_ip = portInfo.um_info[batch_id][i].src_ip;
-          flow.dst_ip = portInfo.um_info[batch_id][i].dst_ip;
-          flow.id = portInfo.um_info[batch_id][i].id;
-          flow.src_port = portInfo.um_info[batch_id][i].src_port;
-          flow.dst_port = portInfo.um_info[batch_id][i].dst_port;
-          flow.protocol = portInfo.um_info[batch_id][i].protocol;
-
-          /* Add packet to drops list */
-          packets_lost.push_back(flow);
-
-          /* get hashes for the flow in the pure cell*/
-          uint32_t meter_hash_indexes[m_numHashes];
-          GetMeterHashIndexes(flow, meter_hash_indexes);
-
-          /* Remove from the other cells */
-          for (int j = 0; j < m_numHashes; j++)
+          break;
+        }
+        i = (word << 6) + __builtin_ctzll(bits);
+
+        step = true;
+
+        /* get flow from the pure cell*/
+        ip_five_tuple flow = meter.GetFlow(i);
+
+        /* Add packet to drops list */
+        packets_lost.push_back(flow);
+
+        /* get hashes for the flow in the pure cell*/
+        GetMeterHashIndexes(flow, meter_hash_indexes);
+
+        /* Remove from the other cells */
+        for (int j = 0; j < m_numHashes; j++)
+        {
+          // What happens if we go negative here?
+          uint32_t cell = meter_hash_indexes[j];
+          meter.pkt_counter[cell] -= 1;
+          meter.Xor(cell, flow);
+          if (meter.pkt_counter[cell] == 1)
           {
-            // What happens if we go negative here?
-            portInfo.um_info[batch_id][meter_hash_indexes[j]].pkt_counter -= 1;
-            portInfo.um_info[batch_id][meter_hash_indexes[j]].src_ip ^= flow.src_ip;
-            portInfo.um_info[batch_id][meter_hash_indexes[j]].dst_ip ^= flow.dst_ip;
-            portInfo.um_info[batch_id][meter_hash_indexes[j]].id ^= flow.id;
-            portInfo.um_info[batch_id][meter_hash_indexes[j]].src_port ^= flow.src_port;
-            portInfo.um_info[batch_id][meter_hash_indexes[j]].dst_port ^= flow.dst_port;
-            portInfo.um_info[batch_id][meter_hash_indexes[j]].protocol ^= flow.protocol;
+            pure[cell >> 6] |= uint64_t(1) << (cell & 63);
+          }
+          else
+          {
+            pure[cell >> 6] &= ~(uint64_t(1) << (cell & 63));
           }
         }
+        i++;
       }
       if (not step)
       {
         converged = true;
       }
-
-
     }
 
     /* Do register difference */
@@ -238,9 +313,9 @@ namespace ns3 {
     uint32_t non_detected_packets = 0;
     for (uint32_t i = 0; i < m_numCells; i++)
     {
-      if (portInfo.um_info[batch_id][i].pkt_counter > 0)
+      if (meter.pkt_counter[i] > 0)
       {
-        non_detected_packets += portInfo.um_info[batch_id][i].pkt_counter;
+        non_detected_packets += meter.pkt_counter[i];
         non_pure_cells++;
       }
     }
@@ -270,8 +345,8 @@ namespace ns3 {
     }
 
     /* Clear registers */
-    std::fill(portInfo.um_info[batch_id].begin(), portInfo.um_info[batch_id].end(), LossRadarPacketInfo());
-    std::fill(otherPortInfo.dm_info[batch_id].begin(), otherPortInfo.dm_info[batch_id].end(), LossRadarPacketInfo());
+    meter.Clear();
+    otherPortInfo.dm_info[batch_id].Clear();
   }
 
 
@@ -280,7 +355,7 @@ namespace ns3 {
   {
     NS_LOG_FUNCTION_NOARGS();
 
-    LossRadarPortInfo& portInfo = m_portsInfo[port->GetIfIndex()];
+    LossRadarPortInfo& portInfo = m_portsInfo[GetPortNumber(port)];
 
     /* changes the batch ID every some time */
     NS_LOG_DEBUG("UPDATE BATCH ID");
@@ -306,8 +381,9 @@ namespace ns3 {
 
     P4SwitchNetDevice::AddSwitchPort(switchPort);
 
-    uint32_t ifIndex = switchPort->GetIfIndex();
-    LossRadarPortInfo& portInfo = m_portsInfo[ifIndex];
+    uint32_t portNum = GetPortNumber(switchPort);
+    m_portsInfo.resize(m_ports.size());
+    LossRadarPortInfo& portInfo = m_portsInfo[portNum];
 
     NS_LOG_DEBUG("Address of original port info: " << &portInfo);
 
@@ -316,10 +392,11 @@ namespace ns3 {
     /* With this we copy the parents hiden attribute info */
     /* https://stackoverflow.com/questions/57997870/nested-struct-attributes-inheritance#57997920 */
 
-    PortInfo& switchInfo = P4SwitchNetDevice::m_portsInfo[ifIndex];
+    PortInfo& switchInfo = P4SwitchNetDevice::m_portsInfo[portNum];
     portInfo.portDevice = switchInfo.portDevice;
     portInfo.otherPortDevice = switchInfo.otherPortDevice;
     portInfo.switchPort = switchInfo.switchPort;
+    portInfo.portNum = switchInfo.portNum;
 
     portInfo.last_time_received = Simulator::Now();
     portInfo.last_time_sent = Simulator::Now();
@@ -335,6 +412,44 @@ namespace ns3 {
     NS_LOG_UNCOND("Interface mapping: " << portInfo.link_name << " : " << switchPort->GetIfIndex());
   }
 
+  void
+    P4SwitchLossRadar::SetOutFile(std::string out_file)
+  {
+    m_outFile = out_file;
+    /* The output file is usually set after Init, start streaming then */
+    if (m_simState)
+    {
+      if (m_outFile != "")
+      {
+        m_simState->Open(m_outFile);
+      }
+      else
+      {
+        m_simState->Close();
+      }
+    }
+  }
+
+  std::string
+    P4SwitchLossRadar::GetOutFile(void) const
+  {
+    return m_outFile;
+  }
+
+  void
+    P4SwitchLossRadar::BranchOutFile(std::string out_file)
+  {
+    m_outFile = out_file;
+    if (m_simState && m_outFile != "")
+    {
+      m_simState->Branch(m_outFile);
+    }
+    else
+    {
+      SetOutFile(out_file);
+    }
+  }
+
   void
     P4SwitchLossRadar::SetDebug(bool state)
   {
@@ -349,6 +464,10 @@ namespace ns3 {
 
     /* allocates the simulation state object */
     m_simState = std::make_unique<LossRadarSimulationState>();
+    if (m_outFile != "")
+    {
+      m_simState->Open(m_outFile);
+    }
 
     /* Sets tm drop error model */
     tm_em->SetAttribute("ErrorRate", DoubleValue(m_tm_drop_rate));
@@ -364,9 +483,8 @@ namespace ns3 {
     /* Allocate port structure memories */
     for (uint32_t i = 0; i < m_ports.size(); i++)
     {
-      uint32_t ifIndex = m_ports[i]->GetIfIndex();
       Ptr<NetDevice> switchPort = m_ports[i];
-      LossRadarPortInfo& portInfo = m_portsInfo[ifIndex];
+      LossRadarPortInfo& portInfo = m_portsInfo[i];
       //NS_LOG_DEBUG("Address of port info during init : " <<  &portInfo);
 
       InitPortInfo(portInfo);
@@ -391,7 +509,8 @@ namespace ns3 {
         portInfo.switchPort = true;
         /* Start the batch id update process */
         //UpdateBatchId(switchPort, MilliSeconds(m_batchTimeMs));
-        Simulator::Schedule(MilliSeconds(m_batchTimeMs), &P4SwitchLossRadar::UpdateBatchId, this, switchPort, MilliSeconds(m_batchTimeMs));
+        Simulator::ScheduleWithContext(GetNode()->GetId(), MilliSeconds(m_batchTimeMs), &P4SwitchLossRadar::UpdateBatchId,
+          this, switchPort, MilliSeconds(m_batchTimeMs));
       }
     }
   }
@@ -401,15 +520,12 @@ namespace ns3 {
   {
 
     portInfo.current_batch_id = 0;
-    portInfo.um_info = std::vector<std::vector<LossRadarPacketInfo>>(m_numBatches);
-    for (int i = 0; i < m_numBatches; i++)
-    {
-      portInfo.um_info[i] = std::vector<LossRadarPacketInfo>(m_numCells);
-    }
-    portInfo.dm_info = std::vector<std::vector<LossRadarPacketInfo>>(m_numBatches);
+    portInfo.um_info = std::vector<LossRadarMeter>(m_numBatches);
+    portInfo.dm_info = std::vector<LossRadarMeter>(m_numBatches);
     for (int i = 0; i < m_numBatches; i++)
     {
-      portInfo.dm_info[i] = std::vector<LossRadarPacketInfo>(m_numCells);
+      portInfo.um_info[i].Allocate(m_numCells);
+      portInfo.dm_info[i].Allocate(m_numCells);
     }
 
     //NS_LOG_DEBUG("Address of port info during init port info : " <<  &portInfo);
@@ -443,16 +559,16 @@ namespace ns3 {
 
   void P4SwitchLossRadar::ParseArp(Ptr<Packet> packet, pkt_info& meta)
   {
-    ArpHeader arp_hdr;
+    ArpHeader& arp_hdr = meta.headers.arp;
     packet->RemoveHeader(arp_hdr);
-    meta.headers["ARP"] = arp_hdr;
+    meta.headers.SetValid(pkt_headers::HDR_ARP);
   }
 
   void P4SwitchLossRadar::ParseIpv4(Ptr<Packet> packet, pkt_info& meta)
   {
-    Ipv4Header ipv4_hdr;
+    Ipv4Header& ipv4_hdr = meta.headers.ipv4;
     packet->RemoveHeader(ipv4_hdr);
-    meta.headers["IPV4"] = ipv4_hdr;
+    meta.headers.SetValid(pkt_headers::HDR_IPV4);
     ParseTransport(packet, meta, ipv4_hdr.GetProtocol());
   }
 
@@ -462,17 +578,17 @@ namespace ns3 {
     {
     case TCP:
     {
-      TcpHeader tcp_hdr;
+      TcpHeader& tcp_hdr = meta.headers.tcp;
       packet->RemoveHeader(tcp_hdr);
-      meta.headers["TCP"] = tcp_hdr;
+      meta.headers.SetValid(pkt_headers::HDR_TCP);
 
       break;
     }
     case UDP:
     {
-      UdpHeader udp_hdr;
+      UdpHeader& udp_hdr = meta.headers.udp;
       packet->RemoveHeader(udp_hdr);
-      meta.headers["UDP"] = udp_hdr;
+      meta.headers.SetValid(pkt_headers::HDR_UDP);
       break;
     }
     }
@@ -516,22 +632,23 @@ namespace ns3 {
     // We do this such that we can use some IP header fields
     // and we do not have to add any new header. 
     // Also this means we only detect IPV4 packets, but its fine
-    if (meta.headers.count("IPV4") > 0) {
+    if (meta.headers.IsValid(pkt_headers::HDR_IPV4)) {
 
-      LossRadarPortInfo& inPortInfo = m_portsInfo[meta.inPort->GetIfIndex()];
+      LossRadarPortInfo& inPortInfo = m_portsInfo[GetPortNumber(meta.inPort)];
 
       /* Get previous switch batch id */
-      Ipv4Header& ipv4_hdr = std::any_cast<Ipv4Header&>(meta.headers["IPV4"]);
+      Ipv4Header& ipv4_hdr = meta.headers.ipv4;
       uint8_t tos = ipv4_hdr.GetTos();
       uint8_t previous_batch_id = getTosHi(tos);
 
       /* Decrease TTL */
       ipv4_hdr.SetTtl(ipv4_hdr.GetTtl() - 1);
+      meta.headers.SetModified(pkt_headers::HDR_IPV4);
 
       /* Does packet go to a host or switch ? */
       if (meta.outPort != NULL)
       {
-        LossRadarPortInfo& outPortInfo = m_portsInfo[meta.outPort->GetIfIndex()];
+        LossRadarPortInfo& outPortInfo = m_portsInfo[GetPortNumber(meta.outPort)];
         if (outPortInfo.switchPort) {
           uint8_t batch_id = outPortInfo.current_batch_id;
 
@@ -607,29 +724,23 @@ namespace ns3 {
     NS_LOG_FUNCTION_NOARGS();
 
     // Deparse valid headers if there are headers to deparse
-    if (meta.headers.size() > 0)
+    if (!meta.headers.Empty())
     {
-      for (auto hdr_type : header_stack_reverse)
+      if (meta.headers.IsValid(pkt_headers::HDR_TCP))
       {
-        if (meta.headers.count(hdr_type) > 0)
-        {
-          if (hdr_type == "ARP")
-          {
-            packet->AddHeader(std::any_cast<ArpHeader>(meta.headers[hdr_type]));
-          }
-          else if (hdr_type == "IPV4")
-          {
-            packet->AddHeader(std::any_cast<Ipv4Header>(meta.headers[hdr_type]));
-          }
-          else if (hdr_type == "TCP")
-          {
-            packet->AddHeader(std::any_cast<TcpHeader>(meta.headers[hdr_type]));
-          }
-          else if (hdr_type == "UDP")
-          {
-            packet->AddHeader(std::any_cast<UdpHeader>(meta.headers[hdr_type]));
-          }
-        }
+        packet->AddHeader(meta.headers.tcp);
+      }
+      if (meta.headers.IsValid(pkt_headers::HDR_UDP))
+      {
+        packet->AddHeader(meta.headers.udp);
+      }
+      if (meta.headers.IsValid(pkt_headers::HDR_IPV4))
+      {
+        packet->AddHeader(meta.headers.ipv4);
+      }
+      if (meta.headers.IsValid(pkt_headers::HDR_ARP))
+      {
+        packet->AddHeader(meta.headers.arp);
       }
     }
   }
@@ -641,10 +752,10 @@ namespace ns3 {
 
     // To remove 
 
-    if (meta.headers.count("IPV4") > 0)
+    if (meta.headers.IsValid(pkt_headers::HDR_IPV4))
     {
       // drop packet at the egress
-      Ipv4Header& ipv4_hdr = std::any_cast<Ipv4Header&>(meta.headers["IPV4"]);
+      Ipv4Header& ipv4_hdr = meta.headers.ipv4;
       /* gets 4 lsb */
       uint8_t lo_tos = getTosLo(ipv4_hdr.GetTos());
 
@@ -673,7 +784,7 @@ namespace ns3 {
 
     // Before the packet leaves the switch
     // Update Send Timestamp
-    LossRadarPortInfo& outPortInfo = m_portsInfo[meta.outPort->GetIfIndex()];
+    LossRadarPortInfo& outPortInfo = m_portsInfo[GetPortNumber(meta.outPort)];
     outPortInfo.last_time_sent = Simulator::Now();
     /* Removed the sense of l2 swtich we had before, now for each packet we modify the mac address, useful to track what happens */
     SendOutFrom(packet, meta.outPort, meta.outPort->GetAddress(), outPortInfo.otherPortDevice->GetAddress(), meta.protocol);
@@ -688,13 +799,8 @@ namespace ns3 {
     /* XORs and increments counter */
     for (uint32_t i = 0; i < m_numHashes; i++)
     {
-      portInfo.um_info[batch_id][hash_indexes[i]].src_ip ^= flow.src_ip;
-      portInfo.um_info[batch_id][hash_indexes[i]].dst_ip ^= flow.dst_ip;
-      portInfo.um_info[batch_id][hash_indexes[i]].id ^= flow.id;
-      portInfo.um_info[batch_id][hash_indexes[i]].src_port ^= flow.src_port;
-      portInfo.um_info[batch_id][hash_indexes[i]].dst_port ^= flow.dst_port;
-      portInfo.um_info[batch_id][hash_indexes[i]].protocol ^= flow.protocol;
-      portInfo.um_info[batch_id][hash_indexes[i]].pkt_counter++;
+      portInfo.um_info[batch_id].Xor(hash_indexes[i], flow);
+      portInfo.um_info[batch_id].pkt_counter[hash_indexes[i]]++;
     }
   }
 
@@ -706,13 +812,8 @@ namespace ns3 {
     /* XORs and increments counter */
     for (uint32_t i = 0; i < m_numHashes; i++)
     {
-      portInfo.dm_info[batch_id][hash_indexes[i]].src_ip ^= flow.src_ip;
-      portInfo.dm_info[batch_id][hash_indexes[i]].dst_ip ^= flow.dst_ip;
-      portInfo.dm_info[batch_id][hash_indexes[i]].id ^= flow.id;
-      portInfo.dm_info[batch_id][hash_indexes[i]].src_port ^= flow.src_port;
-      portInfo.dm_info[batch_id][hash_indexes[i]].dst_port ^= flow.dst_port;
-      portInfo.dm_info[batch_id][hash_indexes[i]].protocol ^= flow.protocol;
-      portInfo.dm_info[batch_id][hash_indexes[i]].pkt_counter++;
+      portInfo.dm_info[batch_id].Xor(hash_indexes[i], flow);
+      portInfo.dm_info[batch_id].pkt_counter[hash_indexes[i]]++;
     }
   }
 
@@ -34,7 +34,6 @@
 #include <map>
 #include <vector>
 #include <unordered_map>
-#include <any>
 #include <algorithm>
 #include <math.h>
 #include <unordered_set>
@@ -47,15 +46,45 @@
 namespace ns3 {
 
 class Node;
-struct LossRadarPacketInfo 
+/* Meter cells of one batch stored as a structure of arrays. The
+ * upstream/downstream difference is then a few straight loops over
+ * contiguous arrays that the compiler vectorizes. */
+struct LossRadarMeter
 {
-  uint32_t src_ip = 0;
-  uint32_t dst_ip = 0;
-  uint8_t protocol = 0;
-  uint16_t src_port = 0;
-  uint16_t dst_port =0;
-  uint16_t id = 0;
-  uint32_t pkt_counter = 0;
+  std::vector<uint32_t> src_ip;
+  std::vector<uint32_t> dst_ip;
+  std::vector<uint16_t> src_port;
+  std::vector<uint16_t> dst_port;
+  std::vector<uint16_t> id;
+  std::vector<uint8_t> protocol;
+  std::vector<uint32_t> pkt_counter;
+
+  void Allocate (uint32_t num_cells);
+  void Clear (void);
+  /* this = this - other (counters) and this ^= other (digests) */
+  void Subtract (const LossRadarMeter &other);
+
+  void Xor (uint32_t cell, const ip_five_tuple &flow)
+  {
+    src_ip[cell] ^= flow.src_ip;
+    dst_ip[cell] ^= flow.dst_ip;
+    id[cell] ^= flow.id;
+    src_port[cell] ^= flow.src_port;
+    dst_port[cell] ^= flow.dst_port;
+    protocol[cell] ^= flow.protocol;
+  }
+
+  ip_five_tuple GetFlow (uint32_t cell) const
+  {
+    ip_five_tuple flow;
+    flow.src_ip = src_ip[cell];
+    flow.dst_ip = dst_ip[cell];
+    flow.id = id[cell];
+    flow.src_port = src_port[cell];
+    flow.dst_port = dst_port[cell];
+    flow.protocol = protocol[cell];
+    return flow;
+  }
 };
 
 struct LossRadarPortInfo: PortInfo
@@ -74,8 +103,8 @@ struct LossRadarPortInfo: PortInfo
 
   /* Vector of vectors containing our xors */
   /* We split per batch first, and then we hash in the buckets */
-  std::vector<std::vector<LossRadarPacketInfo>> um_info;
-  std::vector<std::vector<LossRadarPacketInfo>> dm_info;
+  std::vector<LossRadarMeter> um_info;
+  std::vector<LossRadarMeter> dm_info;
 
   std::string link_name;
 
@@ -90,8 +119,13 @@ public:
   virtual void AddSwitchPort (Ptr<NetDevice> switchPort);
   virtual void Init ();
   virtual void SetDebug (bool state);
+  void SetOutFile (std::string out_file);
+  std::string GetOutFile (void) const;
+  /* Continues the output in out_file, which starts as a copy of the
+     current one. Used when the simulation is forked into branches */
+  void BranchOutFile (std::string out_file);
 
-  LossRadarPortInfo & GetPortInfo(uint32_t i);
+  LossRadarPortInfo & GetPortInfo(uint32_t port_num);
 
 protected:
 
@@ -131,8 +165,6 @@ private:
   /*
   Switch Pipeline State 
   */
-  std::vector<std::string> header_stack = {"LOSS_RADAR", "ARP","IPV4", "UDP", "TCP"};  
-  std::vector<std::string> header_stack_reverse;
 
   //HashUtils * m_hash;
   std::unique_ptr<HashUtils> m_hash;
@@ -140,7 +172,7 @@ private:
   /* Simulation run state */
   std::unique_ptr<LossRadarSimulationState> m_simState;
 
-  std::unordered_map<uint32_t, LossRadarPortInfo> m_portsInfo; 
+  std::vector<LossRadarPortInfo> m_portsInfo; // indexed by port number
   Ptr<RateErrorModel> tm_em = CreateObject<RateErrorModel> ();
   Ptr<RateErrorModel> fail_em = CreateObject<RateErrorModel> ();
 
@@ -61,15 +61,20 @@ P4SwitchNAT::GetTypeId (void)
                 DoubleValue (0),
                 MakeDoubleAccessor (&P4SwitchNAT::m_fail_drop_rate),
                 MakeDoubleChecker<double> (0,1))                                                           
+    .AddAttribute ("NatTableSize", "Number of translations preallocated, the table grows if they are not enough.",
+                UintegerValue (65536),
+                MakeUintegerAccessor (&P4SwitchNAT::m_natTableSize),
+                MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("NatTimeout", "Time a translation is kept without packets.",
+                TimeValue (Seconds (60)),
+                MakeTimeAccessor (&P4SwitchNAT::m_natTimeout),
+                MakeTimeChecker ())
   ;
   return tid;
 }
 
 P4SwitchNAT::P4SwitchNAT ()
-  :
-    header_stack_reverse(header_stack)
 {
-   std::reverse(header_stack_reverse.begin(), header_stack_reverse.end());
 }
 
 P4SwitchNAT::~P4SwitchNAT()
@@ -89,8 +94,9 @@ P4SwitchNAT::AddSwitchPort (Ptr<NetDevice> switchPort)
  
   P4SwitchNetDevice::AddSwitchPort(switchPort);
 
-  uint32_t ifIndex = switchPort->GetIfIndex();
-  NatPortInfo &portInfo = m_portsInfo[ifIndex];
+  uint32_t portNum = GetPortNumber(switchPort);
+  m_portsInfo.resize(m_ports.size());
+  NatPortInfo& portInfo = m_portsInfo[portNum];
 
   //NS_LOG_DEBUG("Address of original port info: " <<  &portInfo);
   //  
@@ -99,10 +105,11 @@ P4SwitchNAT::AddSwitchPort (Ptr<NetDevice> switchPort)
   /* With this we copy the parents hiden attribute info */
   /* https://stackoverflow.com/questions/57997870/nested-struct-attributes-inheritance#57997920 */
 //
-  PortInfo &switchInfo = P4SwitchNetDevice::m_portsInfo[ifIndex];
+  PortInfo& switchInfo = P4SwitchNetDevice::m_portsInfo[portNum];
   portInfo.portDevice = switchInfo.portDevice;
   portInfo.otherPortDevice = switchInfo.otherPortDevice;
   portInfo.switchPort = switchInfo.switchPort;
+  portInfo.portNum = switchInfo.portNum;
 
   portInfo.linkState = true;
 
@@ -143,7 +150,13 @@ P4SwitchNAT::AddSwitchPort (Ptr<NetDevice> switchPort)
 void 
 P4SwitchNAT::CleanMapper(Time interval)
 {
+  NS_LOG_FUNCTION_NOARGS ();
 
+  m_natTable.Tick ();
+  if (m_natTable.GetSize () > 0)
+    {
+      m_cleanMapperEvent = Simulator::Schedule (interval, &P4SwitchNAT::CleanMapper, this, interval);
+    }
 }
 
 void 
@@ -171,6 +184,8 @@ P4SwitchNAT::Init()
 
   m_numNatPorts = m_natPorts.size();
 
+  m_natTable.Reserve (m_natTableSize);
+
 }
 
 void
@@ -206,16 +221,16 @@ void P4SwitchNAT::DoParser(Ptr<Packet> packet, pkt_info &meta, uint16_t protocol
 
 void P4SwitchNAT::ParseArp (Ptr<Packet> packet, pkt_info &meta)
 {
-  ArpHeader arp_hdr;
+  ArpHeader& arp_hdr = meta.headers.arp;
   packet->RemoveHeader(arp_hdr);
-  meta.headers["ARP"] = arp_hdr;
+  meta.headers.SetValid(pkt_headers::HDR_ARP);
 }
 
 void P4SwitchNAT::ParseIpv4 (Ptr<Packet> packet, pkt_info &meta)
 {
-  Ipv4Header ipv4_hdr;
+  Ipv4Header& ipv4_hdr = meta.headers.ipv4;
   packet->RemoveHeader(ipv4_hdr);
-  meta.headers["IPV4"] = ipv4_hdr;
+  meta.headers.SetValid(pkt_headers::HDR_IPV4);
   ParseTransport(packet, meta, ipv4_hdr.GetProtocol());
 }
 
@@ -225,17 +240,17 @@ void P4SwitchNAT::ParseTransport (Ptr<Packet> packet, pkt_info &meta, uint16_t p
     {
       case TCP:
       {
-        TcpHeader tcp_hdr;
+        TcpHeader& tcp_hdr = meta.headers.tcp;
         packet->RemoveHeader(tcp_hdr);
-        meta.headers["TCP"] = tcp_hdr;
+        meta.headers.SetValid(pkt_headers::HDR_TCP);
 
         break;
       }
       case UDP:
       {
-        UdpHeader udp_hdr;
+        UdpHeader& udp_hdr = meta.headers.udp;
         packet->RemoveHeader(udp_hdr);
-        meta.headers["UDP"] = udp_hdr;
+        meta.headers.SetValid(pkt_headers::HDR_UDP);
         break;
       }
     }
@@ -259,21 +274,29 @@ P4SwitchNAT::DoIngress(Ptr<const Packet> packet, pkt_info &meta)
 
   NS_LOG_FUNCTION_NOARGS ();  
 
-  if (meta.headers.count("IPV4")> 0)
+  if (meta.headers.IsValid(pkt_headers::HDR_IPV4))
   {
       
-    Ipv4Header & ipv4_hdr = std::any_cast<Ipv4Header&>(meta.headers["IPV4"]);
+    Ipv4Header & ipv4_hdr = meta.headers.ipv4;
+    meta.headers.SetModified(pkt_headers::HDR_IPV4);
+    /* The transport checksum covers the addresses, write it again as well */
+    if (meta.headers.IsValid(pkt_headers::HDR_TCP))
+    {
+      meta.headers.SetModified(pkt_headers::HDR_TCP);
+    }
+    if (meta.headers.IsValid(pkt_headers::HDR_UDP))
+    {
+      meta.headers.SetModified(pkt_headers::HDR_UDP);
+    }
   
     // Set transport ports such that udp and tcp are unified
     ip_five_tuple flow = GetFlowFiveTuple(meta);
-    NatPortInfo &portInfo = m_portsInfo[meta.inPort->GetIfIndex()];
+    NatPortInfo &portInfo = m_portsInfo[GetPortNumber(meta.inPort)];
 
     /* if it comes from outside */
     if (portInfo.is_nat_interface)
     {
-      MapCell cell;
-      cell.ip = flow.dst_ip;
-      cell.last_accessed = Simulator::Now();
+      uint32_t original_ip = flow.dst_ip;
 
       char s[13];
       IpFiveTupleToBuffer(s, flow);    
@@ -283,10 +306,12 @@ P4SwitchNAT::DoIngress(Ptr<const Packet> packet, pkt_info &meta)
       meta.outPort = nat_port.port;
     
       flow.dst_ip = nat_port.other_side_ip;
-      std::string str_flow = IpFiveTupleToString(flow);
-
-      NatPortInfo &outInfo = m_portsInfo[meta.outPort->GetIfIndex()];
-      outInfo.nat_map[str_flow] = cell;
+      m_natTable.Insert (IpFiveTupleToFlowKey (flow), original_ip);
+      if (!m_cleanMapperEvent.IsRunning ())
+        {
+          Time interval = m_natTimeout / m_natTable.GetWheelSlots ();
+          m_cleanMapperEvent = Simulator::Schedule (interval, &P4SwitchNAT::CleanMapper, this, interval);
+        }
 
       ipv4_hdr.SetDestination(Ipv4Address(nat_port.other_side_ip));
 
@@ -302,8 +327,15 @@ P4SwitchNAT::DoIngress(Ptr<const Packet> packet, pkt_info &meta)
       reverse_flow.dst_port = flow.src_port;
       reverse_flow.protocol = flow.protocol;
 
-      MapCell cell = portInfo.nat_map[IpFiveTupleToString(reverse_flow)];
-      ipv4_hdr.SetSource(Ipv4Address(cell.ip));
+      uint32_t original_ip;
+      if (m_natTable.Lookup (IpFiveTupleToFlowKey (reverse_flow), original_ip))
+        {
+          ipv4_hdr.SetSource(Ipv4Address(original_ip));
+        }
+      else
+        {
+          NS_LOG_DEBUG ("No translation for " << IpFiveTupleToString (reverse_flow));
+        }
 
       /* Forwarding has to be done */
       meta.outPort = m_natInterface;
@@ -317,6 +349,7 @@ void
 P4SwitchNAT::DoDispose ()
 {
   NS_LOG_FUNCTION_NOARGS ();
+  m_cleanMapperEvent.Cancel ();
   P4SwitchNetDevice::DoDispose ();
 }
 
@@ -360,29 +393,23 @@ P4SwitchNAT::DoDeparser(Ptr<Packet> packet, pkt_info &meta)
   NS_LOG_FUNCTION_NOARGS ();
 
    // Deparse valid headers if there are headers to deparse
-  if (meta.headers.size() > 0)
+  if (!meta.headers.Empty())
   {
-    for (auto hdr_type: header_stack_reverse)
+    if (meta.headers.IsValid(pkt_headers::HDR_TCP))
     {
-      if (meta.headers.count(hdr_type) > 0)
-      {
-        if (hdr_type == "ARP")
-        {
-          packet->AddHeader(std::any_cast<ArpHeader>(meta.headers[hdr_type]));
-        }
-        else if (hdr_type == "IPV4")
-        {
-          packet->AddHeader(std::any_cast<Ipv4Header>(meta.headers[hdr_type]));
-        }
-        else if (hdr_type == "TCP")
-        {
-          packet->AddHeader(std::any_cast<TcpHeader>(meta.headers[hdr_type]));
-        }
-        else if (hdr_type == "UDP")
-        {
-          packet->AddHeader(std::any_cast<UdpHeader>(meta.headers[hdr_type]));
-        }
-      }
+      packet->AddHeader(meta.headers.tcp);
+    }
+    if (meta.headers.IsValid(pkt_headers::HDR_UDP))
+    {
+      packet->AddHeader(meta.headers.udp);
+    }
+    if (meta.headers.IsValid(pkt_headers::HDR_IPV4))
+    {
+      packet->AddHeader(meta.headers.ipv4);
+    }
+    if (meta.headers.IsValid(pkt_headers::HDR_ARP))
+    {
+      packet->AddHeader(meta.headers.arp);
     }
   }
 }
@@ -394,10 +421,10 @@ P4SwitchNAT::DoEgressTrafficManager(Ptr<Packet> packet, pkt_info &meta)
 
   // To remove 
 
-  if (meta.headers.count("IPV4")> 0)
+  if (meta.headers.IsValid(pkt_headers::HDR_IPV4))
   {
     // drop packet at the egress
-    Ipv4Header & ipv4_hdr = std::any_cast<Ipv4Header&>(meta.headers["IPV4"]);
+    Ipv4Header & ipv4_hdr = meta.headers.ipv4;
     /* gets 4 lsb */
     uint8_t lo_tos = getTosLo(ipv4_hdr.GetTos());
 
@@ -421,7 +448,7 @@ P4SwitchNAT::DoEgressTrafficManager(Ptr<Packet> packet, pkt_info &meta)
   } 
 
   /* we get it from the base class because the nat does not have port info */
-  PortInfo &outPortInfo = P4SwitchNetDevice::m_portsInfo[meta.outPort->GetIfIndex()];
+  PortInfo &outPortInfo = P4SwitchNetDevice::m_portsInfo[GetPortNumber(meta.outPort)];
   SendOutFrom(packet, meta.outPort, meta.outPort->GetAddress(), outPortInfo.otherPortDevice->GetAddress(), meta.protocol);
 }
 
@@ -28,13 +28,13 @@
 #include "ns3/flow-error-model.h"
 #include "ns3/hash-utils.h"
 #include "p4-switch-utils.h"
+#include "nat-table.h"
 
 #include <stdint.h>
 #include <string>
 #include <map>
 #include <vector>
 #include <unordered_map>
-#include <any>
 #include <algorithm>
 #include <math.h>
 #include <unordered_set>
@@ -48,12 +48,6 @@ namespace ns3 {
 
 class Node;
 
-struct MapCell
-{
-  uint32_t ip;
-  Time last_accessed;
-};
-
 struct TranslatePort
 {
   Ptr<NetDevice> port = NULL;
@@ -69,7 +63,6 @@ struct NatPortInfo: PortInfo
   std::string link_name;
 
   bool is_nat_interface = false;
-  std::unordered_map<std::string, MapCell> nat_map; 
 };
 
 class P4SwitchNAT : public P4SwitchNetDevice
@@ -102,6 +95,7 @@ protected:
   virtual void DoDeparser(Ptr<Packet> packet, pkt_info &meta);
   virtual void DoEgressTrafficManager(Ptr<Packet> packet, pkt_info &meta);
 
+  /* Expires the translations not used for NatTimeout, rescheduled while there are translations */
   void CleanMapper(Time interval);
   
 private:
@@ -111,8 +105,6 @@ private:
   /*
   Switch Pipeline State 
   */
-  std::vector<std::string> header_stack = {"ARP","IPV4", "UDP", "TCP"};  
-  std::vector<std::string> header_stack_reverse;
 
   //HashUtils * m_hash;
   std::unique_ptr<HashUtils> m_hash;
@@ -120,7 +112,7 @@ private:
   /* Simulation run state */
   //std::unique_ptr<SimulationState> m_simState;
 
-  std::unordered_map<uint32_t, NatPortInfo> m_portsInfo; 
+  std::vector<NatPortInfo> m_portsInfo; // indexed by port number
   
   Ptr<RateErrorModel> tm_em = CreateObject<RateErrorModel> ();
   Ptr<RateErrorModel> fail_em = CreateObject<RateErrorModel> ();
@@ -132,6 +124,12 @@ private:
   uint32_t m_numNatPorts = 1;
   Ptr<NetDevice> m_natInterface;
 
+  /* translated flow -> original destination */
+  NatTable m_natTable;
+  uint32_t m_natTableSize;
+  Time m_natTimeout;
+  EventId m_cleanMapperEvent;
+
 };
 
 } // namespace ns3
@@ -26,6 +26,7 @@
 #include "ns3/uinteger.h"
 #include "ns3/names.h"
 #include "ns3/global-value.h"
+#include "ns3/string.h"
 
 #include <fstream> 
 
@@ -70,6 +71,37 @@ namespace ns3 {
         MakeEnumChecker(ForwardingType::PORT_FORWARDING, "PortForwarding",
           ForwardingType::L3_SPECIAL_FORWARDING, "L3SpecialForwarding",
           ForwardingType::L2_FORWARDING, "L2Forwarding"))
+      .AddAttribute("ZeroCopyPipeline",
+        "Send the received bytes and only serialize the headers that changed. "
+        "If false every valid header is deparsed again (old behaviour). The switches "
+        "never compute checksums, so the old path writes the IPv4 and TCP checksums as "
+        "zero while the zero copy path keeps them in the headers left untouched",
+        BooleanValue(true),
+        MakeBooleanAccessor(&P4SwitchNetDevice::m_zeroCopy),
+        MakeBooleanChecker())
+      .AddAttribute("EnableProfiling",
+        "Count the cycles and packets of every pipeline stage, per switch and per port. "
+        "The profile is saved when the device is disposed",
+        BooleanValue(false),
+        MakeBooleanAccessor(&P4SwitchNetDevice::SetProfiling, &P4SwitchNetDevice::IsProfiling),
+        MakeBooleanChecker())
+      .AddAttribute("ProfileFile",
+        "File the profile is appended to as one JSON line. If empty a table is printed",
+        StringValue(""),
+        MakeStringAccessor(&P4SwitchNetDevice::m_profileFile),
+        MakeStringChecker())
+      .AddAttribute("L3RoutesFile",
+        "Routes bulk loaded in the L3 table after the directly connected hosts, "
+        "one \"<prefix>[/<length>] <port number> [gray drop]\" per line",
+        StringValue(""),
+        MakeStringAccessor(&P4SwitchNetDevice::m_L3RoutesFile),
+        MakeStringChecker())
+      .AddAttribute("CompactL3Table",
+        "Only allocate the 32 MiB first level of the L3 table for routes up to /24. "
+        "Saves memory with host routes only, but every lookup then probes a hash map",
+        BooleanValue(false),
+        MakeBooleanAccessor(&P4SwitchNetDevice::m_compactL3Table),
+        MakeBooleanChecker())
       ;
     return tid;
   }
@@ -78,6 +110,7 @@ namespace ns3 {
     : m_enableDebug(false),
     m_enableDebugGlobal(false),
     m_node(0),
+    m_zeroCopy(true),
     m_ifIndex(0),
     m_enableL2Forwarding(true)
   {
@@ -108,12 +141,71 @@ namespace ns3 {
     m_enableDebugGlobal = debug.Get();
 
     /* Set bandwidth data structures */
-    for (uint32_t i = 0; i < m_ports.size(); i++)
+    m_monitorOutBw.assign(m_ports.size(), 0);
+    m_monitorInBw.assign(m_ports.size(), 0);
+
+  }
+
+  void
+    pkt_headers::MarkParsed(void)
+  {
+    parsed = valid;
+    modified = 0;
+    for (int i = 0; i < HDR_COUNT; i++)
     {
-      m_monitorOutBw[m_ports[i]->GetIfIndex()] = 0;
-      m_monitorInBw[m_ports[i]->GetIfIndex()] = 0;
+      HeaderType type = HeaderType(i);
+      parsed_size[i] = IsValid(type) ? GetSerializedSize(type) : 0;
     }
+  }
 
+  uint32_t
+    pkt_headers::GetSerializedSize(HeaderType type) const
+  {
+    switch (type)
+    {
+    case HDR_ARP:
+      return arp.GetSerializedSize();
+    case HDR_IPV4:
+      return ipv4.GetSerializedSize();
+    case HDR_TCP:
+      return tcp.GetSerializedSize();
+    case HDR_UDP:
+      return udp.GetSerializedSize();
+    case HDR_FANCY:
+      return fancy.GetSerializedSize();
+    case HDR_NETSEER:
+      return net_seer.GetSerializedSize();
+    default:
+      return 0;
+    }
+  }
+
+  void
+    pkt_headers::AddHeader(Ptr<Packet> packet, HeaderType type) const
+  {
+    switch (type)
+    {
+    case HDR_ARP:
+      packet->AddHeader(arp);
+      break;
+    case HDR_IPV4:
+      packet->AddHeader(ipv4);
+      break;
+    case HDR_TCP:
+      packet->AddHeader(tcp);
+      break;
+    case HDR_UDP:
+      packet->AddHeader(udp);
+      break;
+    case HDR_FANCY:
+      packet->AddHeader(fancy);
+      break;
+    case HDR_NETSEER:
+      packet->AddHeader(net_seer);
+      break;
+    default:
+      break;
+    }
   }
 
   ip_five_tuple
@@ -121,24 +213,24 @@ namespace ns3 {
   {
     ip_five_tuple five_tuple;
 
-    if (meta.headers.count("IPV4") > 0)
+    if (meta.headers.IsValid(pkt_headers::HDR_IPV4))
     {
-      Ipv4Header& ipv4_hdr = std::any_cast<Ipv4Header&>(meta.headers["IPV4"]);
+      Ipv4Header& ipv4_hdr = meta.headers.ipv4;
       five_tuple.src_ip = ipv4_hdr.GetSource().Get();
       five_tuple.dst_ip = ipv4_hdr.GetDestination().Get();
       five_tuple.protocol = ipv4_hdr.GetProtocol();
       five_tuple.id = ipv4_hdr.GetIdentification();
 
     }
-    if (meta.headers.count("TCP") > 0 && five_tuple.protocol == 6)
+    if (meta.headers.IsValid(pkt_headers::HDR_TCP) && five_tuple.protocol == 6)
     {
-      TcpHeader& tcp_hdr = std::any_cast<TcpHeader&>(meta.headers["TCP"]);
+      TcpHeader& tcp_hdr = meta.headers.tcp;
       five_tuple.src_port = tcp_hdr.GetSourcePort();
       five_tuple.dst_port = tcp_hdr.GetDestinationPort();
     }
-    else if (meta.headers.count("UDP") > 0 && five_tuple.protocol == 17)
+    else if (meta.headers.IsValid(pkt_headers::HDR_UDP) && five_tuple.protocol == 17)
     {
-      UdpHeader& udp_hdr = std::any_cast<UdpHeader&>(meta.headers["UDP"]);
+      UdpHeader& udp_hdr = meta.headers.udp;
       five_tuple.src_port = udp_hdr.GetSourcePort();
       five_tuple.dst_port = udp_hdr.GetDestinationPort();
     }
@@ -164,11 +256,11 @@ namespace ns3 {
   }
 
   void
-    P4SwitchNetDevice::PrintBandwidth(double delay, uint32_t intf_index, uint64_t prev_counter, bool out)
+    P4SwitchNetDevice::PrintBandwidth(double delay, uint32_t port_num, uint64_t prev_counter, bool out)
   {
 
-    /* from intf index get the interface (just for the name)*/
-    PortInfo& portInfo = m_portsInfo[intf_index];
+    /* from the port number get the interface (just for the name)*/
+    PortInfo& portInfo = m_portsInfo[port_num];
 
     Ptr<Node> this_side = portInfo.portDevice->GetNode();
     Ptr<Node> other_side = portInfo.otherPortDevice->GetNode();
@@ -185,12 +277,12 @@ namespace ns3 {
     if (out)
     {
       full_link = thisSideName + "->" + otherSideName;
-      total_bytes_sent = m_monitorOutBw[intf_index];
+      total_bytes_sent = m_monitorOutBw[port_num];
     }
     else
     {
       full_link = otherSideName + "->" + thisSideName;
-      total_bytes_sent = m_monitorInBw[intf_index];
+      total_bytes_sent = m_monitorInBw[port_num];
     }
 
     /* compute bytes difference */
@@ -202,7 +294,7 @@ namespace ns3 {
     /* print */
     std::cout << "\033[1;34mBw(" << full_link << "): " << bw << "\033[0m" << std::endl;
 
-    Simulator::Schedule(Seconds(m_bwPrintFrequency), &P4SwitchNetDevice::PrintBandwidth, this, m_bwPrintFrequency, intf_index, prev_counter, out);
+    Simulator::Schedule(Seconds(m_bwPrintFrequency), &P4SwitchNetDevice::PrintBandwidth, this, m_bwPrintFrequency, port_num, prev_counter, out);
   }
 
   void
@@ -211,25 +303,27 @@ namespace ns3 {
     /* Enable the bandwidth printings */
     for (uint32_t i = 0; i < m_enableMonitorOutPorts.size(); i++)
     {
-      Simulator::Schedule(Seconds(m_bwPrintFrequency), &P4SwitchNetDevice::PrintBandwidth, this, m_bwPrintFrequency, m_enableMonitorOutPorts[i], 0, true);
+      Simulator::ScheduleWithContext(GetNode()->GetId(), Seconds(m_bwPrintFrequency), &P4SwitchNetDevice::PrintBandwidth,
+        this, m_bwPrintFrequency, m_enableMonitorOutPorts[i], 0, true);
     }
 
     for (uint32_t i = 0; i < m_enableMonitorInPorts.size(); i++)
     {
-      Simulator::Schedule(Seconds(m_bwPrintFrequency), &P4SwitchNetDevice::PrintBandwidth, this, m_bwPrintFrequency, m_enableMonitorInPorts[i], 0, false);
+      Simulator::ScheduleWithContext(GetNode()->GetId(), Seconds(m_bwPrintFrequency), &P4SwitchNetDevice::PrintBandwidth,
+        this, m_bwPrintFrequency, m_enableMonitorInPorts[i], 0, false);
     }
   }
 
   void
     P4SwitchNetDevice::EnableOutBandwidthPrint(Ptr<NetDevice> port)
   {
-    m_enableMonitorOutPorts.push_back(port->GetIfIndex());
+    m_enableMonitorOutPorts.push_back(GetPortNumber(port));
   }
 
   void
     P4SwitchNetDevice::EnableInBandwidthPrint(Ptr<NetDevice> port)
   {
-    m_enableMonitorInPorts.push_back(port->GetIfIndex());
+    m_enableMonitorInPorts.push_back(GetPortNumber(port));
   }
 
   void
@@ -257,10 +351,61 @@ namespace ns3 {
     m_enableDebug = state;
   }
 
+  void
+    P4SwitchNetDevice::SetProfiling(bool enable)
+  {
+    if (enable && !m_profiler)
+    {
+      m_profiler.reset(new PipelineProfiler());
+    }
+    else if (!enable)
+    {
+      m_profiler.reset();
+    }
+  }
+
+  bool
+    P4SwitchNetDevice::IsProfiling(void) const
+  {
+    return m_profiler != nullptr;
+  }
+
+  const PipelineProfiler*
+    P4SwitchNetDevice::GetProfiler(void) const
+  {
+    return m_profiler.get();
+  }
+
+  void
+    P4SwitchNetDevice::SaveProfile(void)
+  {
+    if (!m_profiler)
+    {
+      return;
+    }
+
+    std::string name = m_name != "" ? m_name : "switch-" + std::to_string(m_node ? m_node->GetId() : 0);
+    if (m_profileFile == "")
+    {
+      std::cout << m_profiler->ToTable(name);
+      return;
+    }
+
+    std::ofstream out(m_profileFile, std::ios::out | std::ios::app);
+    NS_ASSERT_MSG(out.is_open(), "Could not open the profile file " + m_profileFile);
+    out << m_profiler->ToJson(name) << '\n';
+  }
+
   void
     P4SwitchNetDevice::DoDispose()
   {
     NS_LOG_FUNCTION_NOARGS();
+
+    SaveProfile();
+    m_profiler.reset();
+    m_learnAgingEvent.Cancel();
+    m_learnState.Clear();
+    m_L3Table.Clear();
     for (std::vector< Ptr<NetDevice> >::iterator iter = m_ports.begin(); iter != m_ports.end(); iter++)
     {
       *iter = 0;
@@ -296,6 +441,12 @@ namespace ns3 {
     // Parser
     Parser(pkt, meta, meta.protocol);
 
+    if (m_zeroCopy)
+    {
+      meta.original = packet;
+      meta.headers.MarkParsed();
+    }
+
     // Call the ingress this triggers the pipeline sequence 
     //std::cout << "META ADDRESS " << &meta << std::endl;
     Ingress(pkt, meta);
@@ -305,6 +456,7 @@ namespace ns3 {
   {
     NS_LOG_FUNCTION_NOARGS();
 
+    PipelineStageScope stage(m_profiler.get(), PipelineProfiler::STAGE_PARSER, GetProfiledPort(meta.inPort));
     DoParser(packet, meta, protocol);
 
   }
@@ -334,9 +486,12 @@ namespace ns3 {
     NS_LOG_FUNCTION_NOARGS();
 
     /* count input bw*/
-    m_monitorInBw[meta.inPort->GetIfIndex()] += packet->GetSize() + 18;
+    m_monitorInBw[GetPortNumber(meta.inPort)] += packet->GetSize() + 18;
 
-    DoIngress(packet, meta);
+    {
+      PipelineStageScope stage(m_profiler.get(), PipelineProfiler::STAGE_INGRESS, GetProfiledPort(meta.inPort));
+      DoIngress(packet, meta);
+    }
 
     /* TO REMOVE Experiment*/
     //m_input_count++;
@@ -437,6 +592,7 @@ namespace ns3 {
     }
 
     /* An empty queueing system */
+    PipelineStageScope stage(m_profiler.get(), PipelineProfiler::STAGE_TRAFFIC_MANAGER, GetProfiledPort(meta.outPort));
     DoTrafficManager(packet, meta);
 
   }
@@ -452,7 +608,10 @@ namespace ns3 {
   {
     NS_LOG_FUNCTION_NOARGS();
 
-    DoEgress(packet, meta);
+    {
+      PipelineStageScope stage(m_profiler.get(), PipelineProfiler::STAGE_EGRESS, GetProfiledPort(meta.outPort));
+      DoEgress(packet, meta);
+    }
 
     UpdateChecksums(packet, meta);
   }
@@ -467,7 +626,21 @@ namespace ns3 {
   {
     NS_LOG_FUNCTION_NOARGS();
 
-    DoUpdateChecksums(packet, meta);
+    {
+      PipelineStageScope stage(m_profiler.get(), PipelineProfiler::STAGE_UPDATE_CHECKSUMS, GetProfiledPort(meta.outPort));
+      DoUpdateChecksums(packet, meta);
+    }
+
+    if (m_zeroCopy && meta.original)
+    {
+      Ptr<Packet> pkt;
+      {
+        PipelineStageScope stage(m_profiler.get(), PipelineProfiler::STAGE_DEPARSER, GetProfiledPort(meta.outPort));
+        pkt = ZeroCopyDeparser(meta);
+      }
+      EgressTrafficManager(pkt, meta);
+      return;
+    }
 
     Ptr<Packet> pkt = packet->Copy();
     Deparser(pkt, meta);
@@ -483,7 +656,10 @@ namespace ns3 {
   {
     NS_LOG_FUNCTION_NOARGS();
 
-    DoDeparser(packet, meta);
+    {
+      PipelineStageScope stage(m_profiler.get(), PipelineProfiler::STAGE_DEPARSER, GetProfiledPort(meta.outPort));
+      DoDeparser(packet, meta);
+    }
 
     EgressTrafficManager(packet, meta);
   }
@@ -494,6 +670,61 @@ namespace ns3 {
     NS_LOG_FUNCTION_NOARGS();
   }
 
+  /* Header stack from the outermost to the innermost header. FANCY and
+     NETSEER are never used together, neither are TCP and UDP */
+  static const pkt_headers::HeaderType g_headerOrder[] = {
+    pkt_headers::HDR_FANCY,
+    pkt_headers::HDR_NETSEER,
+    pkt_headers::HDR_ARP,
+    pkt_headers::HDR_IPV4,
+    pkt_headers::HDR_TCP,
+    pkt_headers::HDR_UDP
+  };
+
+  Ptr<Packet> P4SwitchNetDevice::ZeroCopyDeparser(pkt_info& meta)
+  {
+    NS_LOG_FUNCTION_NOARGS();
+
+    pkt_headers& headers = meta.headers;
+    Ptr<Packet> pkt = meta.original->Copy();
+
+    /* Innermost header that has to be written again */
+    int last = -1;
+    for (int i = 0; i < pkt_headers::HDR_COUNT; i++)
+    {
+      if (headers.IsDirty(g_headerOrder[i]))
+      {
+        last = i;
+      }
+    }
+
+    if (last < 0)
+    {
+      return pkt;
+    }
+
+    /* Strip the received headers up to that one (no data is copied) */
+    uint32_t strip = 0;
+    for (int i = 0; i <= last; i++)
+    {
+      if (headers.WasParsed(g_headerOrder[i]))
+      {
+        strip += headers.parsed_size[g_headerOrder[i]];
+      }
+    }
+    pkt->RemoveAtStart(strip);
+
+    /* And serialize them again from the inside out */
+    for (int i = last; i >= 0; i--)
+    {
+      if (headers.IsValid(g_headerOrder[i]))
+      {
+        headers.AddHeader(pkt, g_headerOrder[i]);
+      }
+    }
+    return pkt;
+  }
+
   void P4SwitchNetDevice::EgressTrafficManager(Ptr<Packet> packet, pkt_info& meta)
   {
     NS_LOG_FUNCTION_NOARGS();
@@ -516,6 +747,7 @@ namespace ns3 {
     }
 
     /* An empty queueing system */
+    PipelineStageScope stage(m_profiler.get(), PipelineProfiler::STAGE_EGRESS_TRAFFIC_MANAGER, GetProfiledPort(meta.outPort));
     DoEgressTrafficManager(packet, meta);
     //std::cout << "META ADDRESS " << &meta << std::endl;
     //Simulator::Stop(Seconds(0));
@@ -537,7 +769,7 @@ namespace ns3 {
       /* Count bandwidth in the case we have installed a meter for this port*/
       //std::cout << "packet size " << packet->GetSize() << " " << protocolNumber << std::endl;
       /* We add 18 for the ethernet header */
-      m_monitorOutBw[outPort->GetIfIndex()] += packet->GetSize() + 18;
+      m_monitorOutBw[GetPortNumber(outPort)] += packet->GetSize() + 18;
 
       /* Send Packet */
       outPort->SendFrom(packet, src, dst, protocolNumber);
@@ -552,6 +784,7 @@ namespace ns3 {
     meta_copy.outPort = meta.outPort;
     meta_copy.packetType = meta.packetType;
     meta_copy.headers = meta.headers;
+    meta_copy.original = meta.original;
     return meta_copy;
   }
 
@@ -627,7 +860,7 @@ namespace ns3 {
     uint32_t in_port;
     uint32_t out_port;
 
-    m_PortTable.clear();
+    m_PortTable.assign(m_ports.size(), NULL);
 
     while (std::getline(port_table_file, line))
     {
@@ -638,6 +871,7 @@ namespace ns3 {
 
       std::istringstream lineStream(line);
       lineStream >> in_port >> out_port;
+      NS_ASSERT_MSG(in_port < m_ports.size() && out_port < m_ports.size(), "Unknown port in " << table_path);
       Ptr<NetDevice> outPort = m_ports[out_port];
       NS_LOG_DEBUG("Port Forwarding fill table: " << in_port << " " << out_port);
       m_PortTable[in_port] = outPort;
@@ -647,31 +881,25 @@ namespace ns3 {
   void P4SwitchNetDevice::PortForwarding(pkt_info& meta)
   {
     NS_LOG_FUNCTION_NOARGS();
-    uint32_t port_index = meta.inPort->GetIfIndex();
-
-    std::map<uint32_t, Ptr<NetDevice>>::iterator iter = m_PortTable.find(port_index);
-    if (iter != m_PortTable.end())
-    {
-      meta.outPort = iter->second;
-    }
-    else
-    {
-      meta.outPort = NULL;
-    }
+    /* Unset entries are NULL */
+    uint32_t port_num = GetPortNumber(meta.inPort);
+    meta.outPort = port_num < m_PortTable.size() ? m_PortTable[port_num] : NULL;
   }
 
-  // Special L3 forwarding: We do not allow lpm forwarding. We just use /32
-  // address indexing. This forwarding is special for our dumbell topology all the
-  // leaves will have ips to be redirected to whereas  when there is a miss packets get 
-  // forwarded to the middle link.
+  // Special L3 forwarding: longest prefix match on the destination address.
+  // This forwarding is special for our dumbell topology all the leaves will
+  // have ips (/32) to be redirected to whereas when there is a miss packets get
+  // forwarded to the middle link. Failures are routes with the gray drop flag.
 
   void P4SwitchNetDevice::L3SpecialForwardingFillTable()
   {
     NS_LOG_FUNCTION_NOARGS();
 
-    m_L3Table.clear();
+    m_L3Table.Clear();
+    m_L3Table.SetCompact(m_compactL3Table);
 
     /* Iterate between all directly connected hosts and get ips*/
+    std::vector<l3_route> routes;
     for (uint32_t i = 0; i < m_portsInfo.size(); i++)
     {
       PortInfo& portInfo = m_portsInfo[i];
@@ -692,42 +920,92 @@ namespace ns3 {
 
       Ipv4Address ip = GetNodeIp(otherSide);
       NS_LOG_DEBUG("Looking for nodes: " << otherSideName << " " << ip);
-      m_L3Table[ip.Get()] = std::make_pair(outPort, false);
+      routes.push_back({ ip.Get(), 32, outPort, false });
+    }
+    L3AddRoutes(routes);
+
+    if (!m_L3RoutesFile.empty())
+    {
+      L3LoadRoutes(m_L3RoutesFile);
     }
   }
 
-  void P4SwitchNetDevice::L3SpecialForwardingSetFailures(std::vector<std::pair<uint32_t, Ptr<NetDevice>>> prefixes)
+  LpmTable::lpm_route
+    P4SwitchNetDevice::L3ToLpmRoute(const l3_route& route)
   {
-    for (uint32_t i = 0; i < prefixes.size(); i++)
+    Ptr<NetDevice> port = route.port == NULL ? m_L3Gateway : route.port;
+    NS_ABORT_MSG_IF(port == NULL, "L3 route without port and no gateway");
+    uint32_t next_hop = 1 + 2 * GetPortNumber(port) + route.gray_drop;
+    NS_ABORT_MSG_IF(next_hop > LpmTable::MAX_NEXT_HOP, "Too many ports for the L3 table");
+    return { route.prefix, route.length, uint16_t(next_hop) };
+  }
+
+  void P4SwitchNetDevice::L3AddRoutes(const std::vector<l3_route>& routes)
+  {
+    std::vector<LpmTable::lpm_route> lpm_routes;
+    lpm_routes.reserve(routes.size());
+    for (auto const& route : routes)
     {
-      std::pair<uint32_t, Ptr<NetDevice>> prefix = prefixes[i];
+      lpm_routes.push_back(L3ToLpmRoute(route));
+    }
+    m_L3Table.Insert(lpm_routes);
+  }
 
-      if (prefix.second == NULL)
+  void P4SwitchNetDevice::L3LoadRoutes(std::string table_path)
+  {
+    std::ifstream routes_file(table_path);
+    NS_ASSERT_MSG(routes_file, "Provide a valid routes file path: " << table_path);
+
+    std::string line;
+    std::vector<l3_route> routes;
+    while (std::getline(routes_file, line))
+    {
+      if (line.empty() || line[0] == '#')
       {
-        m_L3Table[prefix.first] = std::make_pair(m_L3Gateway, true);
+        continue;
       }
-      else
+
+      std::istringstream lineStream(line);
+      std::string prefix;
+      uint32_t out_port;
+      bool gray_drop = false;
+      lineStream >> prefix >> out_port >> gray_drop;
+
+      uint32_t length = 32;
+      size_t slash = prefix.find('/');
+      if (slash != std::string::npos)
       {
-        m_L3Table[prefix.first] = std::make_pair(prefix.second, true);
+        length = std::stoi(prefix.substr(slash + 1));
+        prefix = prefix.substr(0, slash);
       }
+      NS_ASSERT_MSG(length <= 32 && out_port < m_ports.size(), "Invalid route in " << table_path << ": " << line);
+      routes.push_back({ Ipv4Address(prefix.c_str()).Get(), uint8_t(length), m_ports[out_port], gray_drop });
     }
+
+    NS_LOG_DEBUG("Loaded " << routes.size() << " routes from " << table_path);
+    L3AddRoutes(routes);
   }
 
-  void P4SwitchNetDevice::L3SpecialForwardingRemoveFailures(std::vector<std::pair<uint32_t, Ptr<NetDevice>>> prefixes)
+  void P4SwitchNetDevice::L3SpecialForwardingSetFailures(std::vector<std::pair<uint32_t, Ptr<NetDevice>>> prefixes)
   {
-    for (uint32_t i = 0; i < prefixes.size(); i++)
+    std::vector<l3_route> routes;
+    routes.reserve(prefixes.size());
+    for (auto const& prefix : prefixes)
     {
-      std::pair<uint32_t, Ptr<NetDevice>> prefix = prefixes[i];
+      routes.push_back({ prefix.first, 32, prefix.second, true });
+    }
+    L3AddRoutes(routes);
+  }
 
-      if (prefix.second == NULL)
-      {
-        m_L3Table[prefix.first] = std::make_pair(m_L3Gateway, false);
-      }
-      else
-      {
-        m_L3Table[prefix.first] = std::make_pair(prefix.second, false);
-      }
+  void P4SwitchNetDevice::L3SpecialForwardingRemoveFailures(std::vector<std::pair<uint32_t, Ptr<NetDevice>>> prefixes)
+  {
+    std::vector<l3_route> routes;
+    routes.reserve(prefixes.size());
+    for (auto const& prefix : prefixes)
+    {
+      routes.push_back({ prefix.first, 32, prefix.second, false });
     }
+    L3AddRoutes(routes);
   }
 
 
@@ -735,15 +1013,14 @@ namespace ns3 {
   {
     NS_LOG_FUNCTION_NOARGS();
 
-    std::unordered_map<uint32_t, std::pair<Ptr<NetDevice>, bool>>::iterator iter = m_L3Table.find(meta.flow.dst_ip);
-    if (iter != m_L3Table.end())
+    uint16_t next_hop = m_L3Table.Lookup(meta.flow.dst_ip);
+    if (next_hop != LpmTable::NO_ROUTE)
     {
-      meta.outPort = iter->second.first;
-      meta.gray_drop = iter->second.second;
+      meta.outPort = m_ports[(next_hop - 1) >> 1];
+      meta.gray_drop = (next_hop - 1) & 1;
     }
     else
     {
-      //std::cout << "Got gateway" <<  m_L3Table.size() << " " << meta.flow.dst_ip << std::endl;
       // set default port. (can this be problematic when packet should not be forwarded???)
       meta.outPort = m_L3Gateway;
       meta.gray_drop = false;
@@ -845,9 +1122,24 @@ namespace ns3 {
     NS_LOG_FUNCTION_NOARGS();
     if (m_enableLearning)
     {
-      LearnedState& state = m_learnState[source];
-      state.associatedPort = port;
-      state.expirationTime = Simulator::Now() + m_expirationTime;
+      m_learnState.Learn(L2LearningTable::MacToKey(source), GetPortNumber(port));
+      if (!m_learnAgingEvent.IsRunning())
+      {
+        m_learnAgingEvent = Simulator::Schedule(m_expirationTime / m_learnState.GetWheelSlots(),
+          &P4SwitchNetDevice::AgeLearnedState, this);
+      }
+    }
+  }
+
+  void
+    P4SwitchNetDevice::AgeLearnedState(void)
+  {
+    NS_LOG_FUNCTION_NOARGS();
+    m_learnState.Tick();
+    if (m_learnState.GetSize() > 0)
+    {
+      m_learnAgingEvent = Simulator::Schedule(m_expirationTime / m_learnState.GetWheelSlots(),
+        &P4SwitchNetDevice::AgeLearnedState, this);
     }
   }
 
@@ -857,20 +1149,10 @@ namespace ns3 {
     NS_LOG_FUNCTION_NOARGS();
     if (m_enableLearning)
     {
-      Time now = Simulator::Now();
-      std::map<Mac48Address, LearnedState>::iterator iter =
-        m_learnState.find(source);
-      if (iter != m_learnState.end())
+      uint32_t port_num = m_learnState.Lookup(L2LearningTable::MacToKey(source));
+      if (port_num != L2LearningTable::NO_PORT)
       {
-        LearnedState& state = iter->second;
-        if (state.expirationTime > now)
-        {
-          return state.associatedPort;
-        }
-        else
-        {
-          m_learnState.erase(iter);
-        }
+        return m_ports[port_num];
       }
     }
     return NULL;
@@ -916,7 +1198,16 @@ namespace ns3 {
       0, switchPort, true);
 
 
+    uint32_t portNum = m_ports.size();
     m_ports.push_back(switchPort);
+    uint32_t ifIndex = switchPort->GetIfIndex();
+    if (ifIndex >= m_ifIndexToPort.size())
+    {
+      m_ifIndexToPort.resize(ifIndex + 1, NO_SWITCH_PORT);
+    }
+    m_ifIndexToPort[ifIndex] = portNum;
+    m_monitorOutBw.push_back(0);
+    m_monitorInBw.push_back(0);
     // Channels are not used at all
     m_channel->AddChannel(switchPort->GetChannel());
 
@@ -930,8 +1221,9 @@ namespace ns3 {
     }
 
     // Prepare port info
-    uint32_t ifIndex = switchPort->GetIfIndex();
-    PortInfo& portInfo = m_portsInfo[ifIndex];
+    m_portsInfo.resize(m_ports.size());
+    PortInfo& portInfo = m_portsInfo[portNum];
+    portInfo.portNum = portNum;
     portInfo.portDevice = switchPort;
     portInfo.otherPortDevice = otherPort;
 
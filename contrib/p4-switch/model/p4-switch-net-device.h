@@ -24,12 +24,22 @@
 #include "ns3/p4-switch-channel.h"
 #include "ns3/p4-switch-utils.h"
 #include "ns3/event-id.h"
+#include "ns3/packet.h"
+#include "ns3/arp-header.h"
+#include "ns3/ipv4-header.h"
+#include "ns3/tcp-header.h"
+#include "ns3/udp-header.h"
+#include "ns3/fancy-header.h"
+#include "ns3/net-seer-header.h"
+#include "ns3/pipeline-profiler.h"
+#include "ns3/l2-learning-table.h"
+#include "ns3/lpm-table.h"
 #include <stdint.h>
 #include <string>
+#include <memory>
 #include <map>
 #include <vector>
 #include <unordered_map>
-#include <any>
 #include <algorithm>
 #include <unordered_set>
 
@@ -42,6 +52,86 @@ namespace ns3 {
     Ptr<NetDevice> portDevice;
     Ptr<NetDevice> otherPortDevice;
     bool switchPort = false;
+    /* Switch local port number, index in m_ports and m_portsInfo */
+    uint32_t portNum = 0;
+  };
+
+  /* Typed header stack. Every header the switches can parse has a fixed
+   * slot and a validity bit, so parsing, lookups and metadata copies do
+   * not need to allocate. Only valid slots are deparsed.
+   *
+   * For the zero copy pipeline the stack also remembers which headers
+   * were parsed (and their size), and which ones were modified after
+   * parsing. Code that changes a header field in place has to call
+   * SetModified, adding or removing headers is detected automatically.
+   * Headers that are not written again keep their received bytes,
+   * checksums included.
+   */
+  struct pkt_headers
+  {
+    enum HeaderType
+    {
+      HDR_ARP = 0,
+      HDR_IPV4,
+      HDR_TCP,
+      HDR_UDP,
+      HDR_FANCY,
+      HDR_NETSEER,
+      HDR_COUNT
+    };
+
+    ArpHeader arp;
+    Ipv4Header ipv4;
+    TcpHeader tcp;
+    UdpHeader udp;
+    FancyHeader fancy;
+    NetSeerHeader net_seer;
+
+    /* One bit per HeaderType */
+    uint8_t valid = 0;
+    uint8_t parsed = 0;
+    uint8_t modified = 0;
+    /* Serialized size of the parsed headers */
+    uint16_t parsed_size[HDR_COUNT] = { 0 };
+
+    bool IsValid(HeaderType type) const
+    {
+      return (valid >> type) & 1;
+    }
+    void SetValid(HeaderType type)
+    {
+      valid |= (1 << type);
+    }
+    void SetInvalid(HeaderType type)
+    {
+      valid &= ~(1 << type);
+    }
+    bool Empty(void) const
+    {
+      return valid == 0;
+    }
+    void SetModified(HeaderType type)
+    {
+      modified |= (1 << type);
+    }
+    bool WasParsed(HeaderType type) const
+    {
+      return (parsed >> type) & 1;
+    }
+    /* The header differs from the bytes of the received packet */
+    bool IsDirty(HeaderType type) const
+    {
+      return ((modified | (valid ^ parsed)) >> type) & 1;
+    }
+    bool IsDirty(void) const
+    {
+      return (modified | (valid ^ parsed)) != 0;
+    }
+
+    /* Snapshot of the stack right after parsing */
+    void MarkParsed(void);
+    uint32_t GetSerializedSize(HeaderType type) const;
+    void AddHeader(Ptr<Packet> packet, HeaderType type) const;
   };
 
   /**
@@ -99,8 +189,17 @@ namespace ns3 {
 
       /* flow info this can be used to not have to get the flow info all the time*/
       ip_five_tuple flow;
-      /* flow in string form, mainly used as key for maps */
-      std::string str_flow = "";
+      /* flow in packed binary form, mainly used as key for maps */
+      flow_key key;
+      bool key_set = false;
+
+      /* Hash indexes of the flow. Computed once per packet and shared by
+       * all the stages that need them (e.g., the FANCY counter tree).
+       * Not copied to packet replicas, like the flow itself.
+       */
+      static constexpr uint32_t MAX_HASHES = 32;
+      uint32_t hashes[MAX_HASHES];
+      bool hashes_set = false;
 
       /* this packet has been tagged as a gray drop candidate
        * Being true does not mean this packet will be dropped,
@@ -133,7 +232,9 @@ namespace ns3 {
       uint16_t protocol;
 
       // Headers
-      std::unordered_map<std::string, std::any> headers;
+      pkt_headers headers;
+      /* Packet as received, headers included. Only set in zero copy mode */
+      Ptr<const Packet> original;
       pkt_info(Address const& a1, Address const& a2, uint16_t a3) : src(a1), dst(a2), protocol(a3) {}
     };
 
@@ -180,6 +281,23 @@ namespace ns3 {
      */
     Ptr<NetDevice> GetSwitchPort(uint32_t n) const;
 
+    /**
+     * \brief Gets the switch local number of a port.
+     *
+     * Port numbers are assigned by AddSwitchPort and go from 0 to
+     * GetNSwitchPorts() - 1, all per port state is stored in vectors
+     * indexed by them.
+     * \param port a switchd NetDevice
+     * \return the port number
+     */
+    inline uint32_t GetPortNumber(const Ptr<NetDevice>& port) const
+    {
+      uint32_t ifIndex = port->GetIfIndex();
+      NS_ASSERT_MSG(ifIndex < m_ifIndexToPort.size() && m_ifIndexToPort[ifIndex] != NO_SWITCH_PORT,
+        "Device is not a port of this switch");
+      return m_ifIndexToPort[ifIndex];
+    }
+
     virtual void Init(void);
 
     // inherited from NetDevice base class.
@@ -216,16 +334,43 @@ namespace ns3 {
     void EnableOutBandwidthPrint(Ptr<NetDevice> port);
     void EnableInBandwidthPrint(Ptr<NetDevice> port);
     void SetBandwidthPrintInterval(double delay);
-    void PrintBandwidth(double delay, uint32_t intf, uint64_t prev_counter, bool out);
+    void PrintBandwidth(double delay, uint32_t port_num, uint64_t prev_counter, bool out);
     void StartBandwidthMeasurament(void);
     void FillTables(std::string conf_path = "");
     void L3SpecialForwardingSetFailures(std::vector<std::pair<uint32_t, Ptr<NetDevice>>> prefixes);
     void L3SpecialForwardingRemoveFailures(std::vector<std::pair<uint32_t, Ptr<NetDevice>>> prefixes);
+
+    /* Route of the L3 forwarding, a NULL port means the gateway */
+    struct l3_route
+    {
+      uint32_t prefix;
+      uint8_t length;
+      Ptr<NetDevice> port;
+      bool gray_drop;
+    };
+    /* Batched updates of the L3 table, adding an existing route replaces it */
+    void L3AddRoutes(const std::vector<l3_route>& routes);
+    /* Bulk load, one "<prefix>[/<length>] <port number> [gray drop]" per line */
+    void L3LoadRoutes(std::string table_path);
     void SaveDrops(std::string outFile);
 
+    /* Per stage cycle accounting, see PipelineProfiler */
+    void SetProfiling(bool enable);
+    bool IsProfiling(void) const;
+    /* Null when profiling is disabled */
+    const PipelineProfiler* GetProfiler(void) const;
+    /* Appends the profile to ProfileFile, or prints it when not set */
+    void SaveProfile(void);
+
   protected:
     virtual void DoDispose(void);
 
+    /* Port number charged by the profiler, only resolved when profiling */
+    inline uint32_t GetProfiledPort(const Ptr<NetDevice>& port) const
+    {
+      return m_profiler && port ? GetPortNumber(port) : PipelineProfiler::NO_PORT;
+    }
+
     /**
      * \brief Receives a packet from one switchd port.
      * \param device the originating port
@@ -271,6 +416,15 @@ namespace ns3 {
     void EgressTrafficManager(Ptr<Packet> packet, pkt_info& meta);
     virtual void DoEgressTrafficManager(Ptr<Packet> packet, pkt_info& meta);
 
+    /**
+     * \brief Builds the outgoing packet from the received bytes
+     *
+     * Only the headers that are dirty, and the ones in front of them, are
+     * serialized again. Used instead of Deparser/DoDeparser when
+     * ZeroCopyPipeline is enabled and the packet was received by the switch.
+     */
+    Ptr<Packet> ZeroCopyDeparser(pkt_info& meta);
+
     // Primitives
     void Clone(Ptr<const Packet> packet, Ptr<NetDevice> outPort, CloneType cloneType, pkt_info& meta);
     pkt_info CopyMeta(pkt_info& meta);
@@ -289,6 +443,7 @@ namespace ns3 {
 
     void L3SpecialForwardingFillTable();
     void L3SpecialForwarding(pkt_info& meta);
+    LpmTable::lpm_route L3ToLpmRoute(const l3_route& route);
 
     /* End of added */
     /**
@@ -336,15 +491,26 @@ namespace ns3 {
      */
     Ptr<NetDevice> GetLearnedState(Mac48Address source);
 
+    /**
+     * \brief Advances the learned state aging wheel, rescheduled while
+     * there are learned addresses.
+     */
+    void AgeLearnedState(void);
+
 
     uint8_t m_switchId;
-    std::unordered_map<uint32_t, PortInfo> m_portsInfo;
+    std::vector<PortInfo> m_portsInfo; //!< indexed by port number
     Mac48Address m_address; //!< MAC address of the NetDevice
     Ptr<Node> m_node; //!< node owning this NetDevice
     std::string m_name;
     Ptr<P4SwitchChannel> m_channel; //!< virtual switchd channel
-    std::vector< Ptr<NetDevice> > m_ports; //!< switchd ports
+    std::vector< Ptr<NetDevice> > m_ports; //!< switchd ports, indexed by port number
+    static constexpr uint32_t NO_SWITCH_PORT = 0xffffffff;
+    std::vector<uint32_t> m_ifIndexToPort; //!< node interface index to port number
     ForwardingType m_forwardingType = ForwardingType::PORT_FORWARDING;
+    bool m_zeroCopy; //!< reuse received bytes instead of deparsing every header
+    std::unique_ptr<PipelineProfiler> m_profiler; //!< only allocated when profiling
+    std::string m_profileFile;
 
     // drop states
     std::vector<ns3::Time> m_drop_times;
@@ -375,35 +541,28 @@ namespace ns3 {
     L2 Learning state and attributes
     */
     Time m_expirationTime;  //!< time it takes for learned MAC state to expire
-    /**
-     * \ingroup switch
-     * Structure holding the status of an address
-     */
-    struct LearnedState
-    {
-      Ptr<NetDevice> associatedPort; //!< port associated with the address
-      Time expirationTime;  //!< time it takes for learned MAC state to expire
-    };
-    std::map<Mac48Address, LearnedState> m_learnState; //!< Container for known address statuses
+    L2LearningTable m_learnState; //!< MAC to port number, aged by AgeLearnedState
+    EventId m_learnAgingEvent; //!< next aging wheel tick
     bool m_enableLearning; //!< true if the switch will learn the node status
 
     /*
     L2 Forwarding & Port Forwarding
     */
     std::map<Mac48Address, Ptr<NetDevice>> m_L2Table;
-    std::map<uint32_t, Ptr<NetDevice>> m_PortTable;
+    std::vector<Ptr<NetDevice>> m_PortTable; //!< output port indexed by input port number
 
-    //std::unordered_map<uint32_t, Ptr<NetDevice>> m_L3Table;
-    /* contains a pair of dst to -> net device and fail status of a prefix */
-    std::unordered_map<uint32_t, std::pair<Ptr<NetDevice>, bool>> m_L3Table;
+    /* next hops are 1 + 2 * port number + gray drop, misses go to the gateway */
+    LpmTable m_L3Table;
+    std::string m_L3RoutesFile;
+    bool m_compactL3Table;
 
     Ptr<NetDevice> m_L3Gateway;
 
     bool m_enableL2Forwarding;
 
-    /* Our Own custom stats collector */
-    std::unordered_map<uint32_t, uint64_t> m_monitorOutBw;
-    std::unordered_map<uint32_t, uint64_t> m_monitorInBw;
+    /* Our Own custom stats collector, bytes indexed by port number */
+    std::vector<uint64_t> m_monitorOutBw;
+    std::vector<uint64_t> m_monitorInBw;
     std::vector<uint32_t> m_enableMonitorOutPorts;
     std::vector<uint32_t> m_enableMonitorInPorts;
     double m_bwPrintFrequency = 0.01;
@@ -80,7 +80,7 @@ namespace ns3 {
         MakeDoubleChecker<double>(0, 1))
       .AddAttribute("OutFile", "Name of the output file for the data generated.",
         StringValue(""),
-        MakeStringAccessor(&P4SwitchNetSeer::m_outFile),
+        MakeStringAccessor(&P4SwitchNetSeer::GetOutFile, &P4SwitchNetSeer::SetOutFile),
         MakeStringChecker())
       .AddAttribute("EarlyStopCounter", "Stops simulation before",
         UintegerValue(0),
@@ -91,10 +91,7 @@ namespace ns3 {
   }
 
   P4SwitchNetSeer::P4SwitchNetSeer()
-    :
-    header_stack_reverse(header_stack)
   {
-    std::reverse(header_stack_reverse.begin(), header_stack_reverse.end());
   }
 
   P4SwitchNetSeer::~P4SwitchNetSeer()
@@ -107,7 +104,7 @@ namespace ns3 {
 
     if (m_outFile != "")
     {
-      m_simState->SaveInJson(m_outFile);
+      m_simState->Close();
 
       // Report events that did not trigger at the end
 
@@ -130,17 +127,19 @@ namespace ns3 {
 
     P4SwitchNetDevice::AddSwitchPort(switchPort);
 
-    uint32_t ifIndex = switchPort->GetIfIndex();
-    NetSeerPortInfo& portInfo = m_portsInfo[ifIndex];
+    uint32_t portNum = GetPortNumber(switchPort);
+    m_portsInfo.resize(m_ports.size());
+    NetSeerPortInfo& portInfo = m_portsInfo[portNum];
     //InitPortInfo(portInfo);
 
     /* With this we copy the parents hiden attribute info */
     /* https://stackoverflow.com/questions/57997870/nested-struct-attributes-inheritance#57997920 */
 
-    PortInfo& switchInfo = P4SwitchNetDevice::m_portsInfo[ifIndex];
+    PortInfo& switchInfo = P4SwitchNetDevice::m_portsInfo[portNum];
     portInfo.portDevice = switchInfo.portDevice;
     portInfo.otherPortDevice = switchInfo.otherPortDevice;
     portInfo.switchPort = switchInfo.switchPort;
+    portInfo.portNum = switchInfo.portNum;
 
     portInfo.last_time_received = Simulator::Now();
     portInfo.last_time_sent = Simulator::Now();
@@ -156,6 +155,44 @@ namespace ns3 {
     NS_LOG_UNCOND("Interface mapping: " << portInfo.link_name << " : " << switchPort->GetIfIndex());
   }
 
+  void
+    P4SwitchNetSeer::SetOutFile(std::string out_file)
+  {
+    m_outFile = out_file;
+    /* The output file is usually set after Init, start streaming then */
+    if (m_simState)
+    {
+      if (m_outFile != "")
+      {
+        m_simState->Open(m_outFile);
+      }
+      else
+      {
+        m_simState->Close();
+      }
+    }
+  }
+
+  std::string
+    P4SwitchNetSeer::GetOutFile(void) const
+  {
+    return m_outFile;
+  }
+
+  void
+    P4SwitchNetSeer::BranchOutFile(std::string out_file)
+  {
+    m_outFile = out_file;
+    if (m_simState && m_outFile != "")
+    {
+      m_simState->Branch(m_outFile);
+    }
+    else
+    {
+      SetOutFile(out_file);
+    }
+  }
+
   void
     P4SwitchNetSeer::SetDebug(bool state)
   {
@@ -170,6 +207,10 @@ namespace ns3 {
 
     /* allocates the simulation state object */
     m_simState = std::make_unique<NetSeerSimulationState>();
+    if (m_outFile != "")
+    {
+      m_simState->Open(m_outFile);
+    }
 
     /* Sets tm drop error model */
     tm_em->SetAttribute("ErrorRate", DoubleValue(m_tm_drop_rate));
@@ -185,9 +226,8 @@ namespace ns3 {
     /* Allocate port structure memories */
     for (uint32_t i = 0; i < m_ports.size(); i++)
     {
-      uint32_t ifIndex = m_ports[i]->GetIfIndex();
       Ptr<NetDevice> switchPort = m_ports[i];
-      NetSeerPortInfo& portInfo = m_portsInfo[ifIndex];
+      NetSeerPortInfo& portInfo = m_portsInfo[i];
       InitPortInfo(portInfo);
 
       /* Start State Machine */
@@ -261,25 +301,25 @@ namespace ns3 {
 
   void P4SwitchNetSeer::ParseNetSeer(Ptr<Packet> packet, pkt_info& meta)
   {
-    NetSeerHeader net_seer_hdr;
+    NetSeerHeader& net_seer_hdr = meta.headers.net_seer;
     packet->RemoveHeader(net_seer_hdr);
-    meta.headers["NETSEER"] = net_seer_hdr;
+    meta.headers.SetValid(pkt_headers::HDR_NETSEER);
     /* Parse next layer*/
     Parser(packet, meta, net_seer_hdr.GetNextHeader());
   }
 
   void P4SwitchNetSeer::ParseArp(Ptr<Packet> packet, pkt_info& meta)
   {
-    ArpHeader arp_hdr;
+    ArpHeader& arp_hdr = meta.headers.arp;
     packet->RemoveHeader(arp_hdr);
-    meta.headers["ARP"] = arp_hdr;
+    meta.headers.SetValid(pkt_headers::HDR_ARP);
   }
 
   void P4SwitchNetSeer::ParseIpv4(Ptr<Packet> packet, pkt_info& meta)
   {
-    Ipv4Header ipv4_hdr;
+    Ipv4Header& ipv4_hdr = meta.headers.ipv4;
     packet->RemoveHeader(ipv4_hdr);
-    meta.headers["IPV4"] = ipv4_hdr;
+    meta.headers.SetValid(pkt_headers::HDR_IPV4);
     ParseTransport(packet, meta, ipv4_hdr.GetProtocol());
   }
 
@@ -289,17 +329,17 @@ namespace ns3 {
     {
     case TCP:
     {
-      TcpHeader tcp_hdr;
+      TcpHeader& tcp_hdr = meta.headers.tcp;
       packet->RemoveHeader(tcp_hdr);
-      meta.headers["TCP"] = tcp_hdr;
+      meta.headers.SetValid(pkt_headers::HDR_TCP);
 
       break;
     }
     case UDP:
     {
-      UdpHeader udp_hdr;
+      UdpHeader& udp_hdr = meta.headers.udp;
       packet->RemoveHeader(udp_hdr);
-      meta.headers["UDP"] = udp_hdr;
+      meta.headers.SetValid(pkt_headers::HDR_UDP);
       break;
     }
     }
@@ -319,8 +359,8 @@ namespace ns3 {
   void
     P4SwitchNetSeer::SendNACK(Ptr<NetDevice> outPort, uint32_t seq1, uint32_t seq2, uint32_t times)
   {
-    uint32_t ifIndex = outPort->GetIfIndex();
-    NetSeerPortInfo& portInfo = m_portsInfo[ifIndex];
+    uint32_t portNum = GetPortNumber(outPort);
+    NetSeerPortInfo& portInfo = m_portsInfo[portNum];
 
     Ptr<Packet> packet = Create<Packet>();
     NetSeerHeader net_seer_hdr;
@@ -331,7 +371,8 @@ namespace ns3 {
     // net_seer_hdr.SetNextHeader(meta.protocol);
 
     pkt_info meta(outPort->GetAddress(), portInfo.otherPortDevice->GetAddress(), NETSEER);
-    meta.headers["NETSEER"] = net_seer_hdr;
+    meta.headers.net_seer = net_seer_hdr;
+    meta.headers.SetValid(pkt_headers::HDR_NETSEER);
     meta.outPort = outPort;
 
     /* skip stuff */
@@ -365,13 +406,13 @@ namespace ns3 {
     }
 
     /* set input timestamp for debugging */
-    NetSeerPortInfo& portInfo = m_portsInfo[meta.inPort->GetIfIndex()];
+    NetSeerPortInfo& portInfo = m_portsInfo[GetPortNumber(meta.inPort)];
     portInfo.last_time_received = Simulator::Now();
 
     /* Do ingress logic */
-    if (meta.headers.count("NETSEER") > 0)
+    if (meta.headers.IsValid(pkt_headers::HDR_NETSEER))
     {
-      NetSeerHeader& net_seer_header = std::any_cast<NetSeerHeader&>(meta.headers["NETSEER"]);
+      NetSeerHeader& net_seer_header = meta.headers.net_seer;
       uint8_t action = net_seer_header.GetAction();
 
       /* Packet that comes from the other side and goes to the egress pipe */
@@ -620,23 +661,24 @@ namespace ns3 {
     }
 
     /* Do egress logic */
-    NetSeerPortInfo& outPortInfo = m_portsInfo[meta.outPort->GetIfIndex()];
+    NetSeerPortInfo& outPortInfo = m_portsInfo[GetPortNumber(meta.outPort)];
 
     if (outPortInfo.switchPort)
     {
       /* if we sending to a switch and the header is not here we add it */
-      if (not(meta.headers.count("NETSEER") > 0))
+      if (not(meta.headers.IsValid(pkt_headers::HDR_NETSEER)))
       {
         NetSeerHeader net_seer_hdr;
         net_seer_hdr.SetAction(SEQ);
         net_seer_hdr.SetSeq1(outPortInfo.sender_next_expected_seq);
         net_seer_hdr.SetNextHeader(meta.protocol);
         meta.protocol = NETSEER;
-        meta.headers["NETSEER"] = net_seer_hdr;
+        meta.headers.net_seer = net_seer_hdr;
+        meta.headers.SetValid(pkt_headers::HDR_NETSEER);
       }
 
       /* Get net seer header*/
-      NetSeerHeader& net_seer_header = std::any_cast<NetSeerHeader&>(meta.headers["NETSEER"]);
+      NetSeerHeader& net_seer_header = meta.headers.net_seer;
       uint8_t action = net_seer_header.GetAction();
 
       /* We received a nack from the ohter side */
@@ -663,11 +705,11 @@ namespace ns3 {
     else
     {
       /* Remove net seer header*/
-      if (meta.headers.count("NETSEER") > 0)
+      if (meta.headers.IsValid(pkt_headers::HDR_NETSEER))
       {
         /* Remove net seer header */
-        meta.protocol = std::any_cast<NetSeerHeader>(meta.headers["NETSEER"]).GetNextHeader();
-        meta.headers.erase("NETSEER");
+        meta.protocol = meta.headers.net_seer.GetNextHeader();
+        meta.headers.SetInvalid(pkt_headers::HDR_NETSEER);
       }
     }
   }
@@ -684,33 +726,27 @@ namespace ns3 {
     NS_LOG_FUNCTION_NOARGS();
 
     // Deparse valid headers if there are headers to deparse
-    if (meta.headers.size() > 0)
+    if (!meta.headers.Empty())
     {
-      for (auto hdr_type : header_stack_reverse)
+      if (meta.headers.IsValid(pkt_headers::HDR_TCP))
       {
-        if (meta.headers.count(hdr_type) > 0)
-        {
-          if (hdr_type == "NETSEER")
-          {
-            packet->AddHeader(std::any_cast<NetSeerHeader>(meta.headers[hdr_type]));
-          }
-          else if (hdr_type == "ARP")
-          {
-            packet->AddHeader(std::any_cast<ArpHeader>(meta.headers[hdr_type]));
-          }
-          else if (hdr_type == "IPV4")
-          {
-            packet->AddHeader(std::any_cast<Ipv4Header>(meta.headers[hdr_type]));
-          }
-          else if (hdr_type == "TCP")
-          {
-            packet->AddHeader(std::any_cast<TcpHeader>(meta.headers[hdr_type]));
-          }
-          else if (hdr_type == "UDP")
-          {
-            packet->AddHeader(std::any_cast<UdpHeader>(meta.headers[hdr_type]));
-          }
-        }
+        packet->AddHeader(meta.headers.tcp);
+      }
+      if (meta.headers.IsValid(pkt_headers::HDR_UDP))
+      {
+        packet->AddHeader(meta.headers.udp);
+      }
+      if (meta.headers.IsValid(pkt_headers::HDR_IPV4))
+      {
+        packet->AddHeader(meta.headers.ipv4);
+      }
+      if (meta.headers.IsValid(pkt_headers::HDR_ARP))
+      {
+        packet->AddHeader(meta.headers.arp);
+      }
+      if (meta.headers.IsValid(pkt_headers::HDR_NETSEER))
+      {
+        packet->AddHeader(meta.headers.net_seer);
       }
     }
   }
@@ -720,12 +756,12 @@ namespace ns3 {
   {
     NS_LOG_FUNCTION_NOARGS();
 
-    NetSeerPortInfo& outPortInfo = m_portsInfo[meta.outPort->GetIfIndex()];
+    NetSeerPortInfo& outPortInfo = m_portsInfo[GetPortNumber(meta.outPort)];
 
-    if (meta.headers.count("IPV4") > 0)
+    if (meta.headers.IsValid(pkt_headers::HDR_IPV4))
     {
       // drop packet at the egress
-      Ipv4Header& ipv4_hdr = std::any_cast<Ipv4Header&>(meta.headers["IPV4"]);
+      Ipv4Header& ipv4_hdr = meta.headers.ipv4;
       uint8_t tos = ipv4_hdr.GetTos();
 
       /* Here is where we decide if a packet has to be dropped or not
@@ -767,8 +803,7 @@ namespace ns3 {
 
     for (uint32_t i = 0; i < m_ports.size(); i++)
     {
-      uint32_t ifIndex = m_ports[i]->GetIfIndex();
-      NetSeerPortInfo& portInfo = m_portsInfo[ifIndex];
+      NetSeerPortInfo& portInfo = m_portsInfo[i];
 
       if (portInfo.failures_count > 0)
       {
@@ -35,7 +35,6 @@
 #include <map>
 #include <vector>
 #include <unordered_map>
-#include <any>
 #include <algorithm>
 #include <math.h>
 #include <unordered_set>
@@ -96,6 +95,11 @@ namespace ns3 {
     virtual void AddSwitchPort(Ptr<NetDevice> switchPort);
     virtual void Init();
     virtual void SetDebug(bool state);
+    void SetOutFile(std::string out_file);
+    std::string GetOutFile(void) const;
+    /* Continues the output in out_file, which starts as a copy of the
+       current one. Used when the simulation is forked into branches */
+    void BranchOutFile(std::string out_file);
 
   protected:
 
@@ -132,8 +136,6 @@ namespace ns3 {
     /*
     Switch Pipeline State
     */
-    std::vector<std::string> header_stack = { "NETSEER", "ARP","IPV4", "UDP", "TCP" };
-    std::vector<std::string> header_stack_reverse;
 
     //HashUtils * m_hash;
     std::unique_ptr<HashUtils> m_hash;
@@ -141,7 +143,7 @@ namespace ns3 {
     /* Simulation run state */
     std::unique_ptr<NetSeerSimulationState> m_simState;
 
-    std::unordered_map<uint32_t, NetSeerPortInfo> m_portsInfo;
+    std::vector<NetSeerPortInfo> m_portsInfo; // indexed by port number
     Ptr<RateErrorModel> tm_em = CreateObject<RateErrorModel>();
     Ptr<RateErrorModel> fail_em = CreateObject<RateErrorModel>();
 
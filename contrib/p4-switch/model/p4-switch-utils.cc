@@ -2,6 +2,8 @@
 
 #include "p4-switch-utils.h"
 #include <cstring>
+#include <filesystem>
+#include <set>
 #include <nlohmann/json.hpp>
 
 NS_LOG_COMPONENT_DEFINE("p4-switch-utils");
@@ -70,6 +72,40 @@ namespace ns3 {
     return tuple.str();
   }
 
+  /* Binary flow keys */
+
+  flow_key
+    IpFiveTupleToFlowKey(ip_five_tuple& flow)
+  {
+    flow_key key;
+    key.src_ip = flow.src_ip;
+    key.dst_ip = flow.dst_ip;
+    key.src_port = flow.src_port;
+    key.dst_port = flow.dst_port;
+    key.protocol = flow.protocol;
+    return key;
+  }
+
+  flow_key
+    DstPrefixToFlowKey(ip_five_tuple& flow)
+  {
+    flow_key key;
+    key.dst_ip = flow.dst_ip & 0xffffff00;
+    return key;
+  }
+
+  std::string
+    FlowKeyToString(const flow_key& key)
+  {
+    std::stringstream tuple;
+    tuple << key.src_ip << " ";
+    tuple << key.dst_ip << " ";
+    tuple << key.src_port << " ";
+    tuple << key.dst_port << " ";
+    tuple << int(key.protocol);
+    return tuple.str();
+  }
+
   std::string
     DstPrefixToString(ip_five_tuple& flow)
   {
@@ -120,379 +156,463 @@ namespace ns3 {
 
   /* Switch solutions OUTPUTs */
 
-  /* Fancy FancySimulationState*/
+  /* Streaming writer */
 
-  FancySimulationState::FancySimulationState(uint32_t depth, uint32_t bloom_hashes)
+  SimulationStateWriter::SimulationStateWriter()
+  {}
+
+  SimulationStateWriter::~SimulationStateWriter()
   {
-    m_treeDepth = depth;
-    m_rerouteBloomFilterNumHashes = bloom_hashes;
+    Close();
   }
 
-  FancySimulationState::~FancySimulationState()
-  {}
-
-  void FancySimulationState::SetDetail(bool detail)
+  std::string
+    SimulationStateWriter::GetStreamFileName(std::string file_name)
   {
-    m_save_details = detail;
+    std::filesystem::path path(file_name);
+    if (path.extension() != ".json")
+    {
+      return file_name;
+    }
+    return path.replace_extension(".ndjson").string();
   }
 
   void
-    FancySimulationState::SetSimulationStep(double timestamp, uint32_t step, uint32_t packets_sent, uint32_t packets_lost)
+    SimulationStateWriter::OpenStream(std::string file_name, std::ios::openmode mode)
   {
-    SimulationStep sim_step;
-    sim_step.timestamp = timestamp;
-    sim_step.step = step;
-    sim_step.packets_sent = packets_sent;
-    sim_step.packets_lost = packets_lost;
-    simulation_steps.push_back(sim_step);
+    m_fileName = GetStreamFileName(file_name);
+    m_out.open(m_fileName, std::ios::out | mode);
+    NS_ASSERT_MSG(m_out.is_open(), "Could not open the output file " + m_fileName);
   }
 
   void
-    FancySimulationState::SetSimulationTreeNode(uint32_t index)
+    SimulationStateWriter::Open(std::string file_name)
   {
-    if (m_save_details)
-    {
-      TreeNodeState node;
-      node.index = index;
-      simulation_steps.back().nodes.push_back(node);
-    }
+    Close();
+    OpenStream(file_name, std::ios::trunc);
   }
 
   void
-    FancySimulationState::SetCounterValues(uint32_t local_counter, uint32_t remote_counter, uint32_t bloom_count, uint32_t flow_count,
-      boost::dynamic_bitset<>& bloom_filter)
+    SimulationStateWriter::Close()
   {
-    if (m_save_details)
+    if (m_out.is_open())
     {
-      simulation_steps.back().nodes.back().local_counter.push_back(local_counter);
-      simulation_steps.back().nodes.back().remote_counter.push_back(remote_counter);
-      simulation_steps.back().nodes.back().bloom_count.push_back(bloom_count);
-      simulation_steps.back().nodes.back().flow_count.push_back(flow_count);
-
-      std::string buffer;
-      to_string(bloom_filter, buffer);
-      simulation_steps.back().nodes.back().bloom_filter.push_back(buffer);
+      m_out.close();
     }
   }
 
-  void
-    FancySimulationState::SetSoftFailureEvent(double timestamp, uint8_t soft_type, char hash_path[],
-      std::unordered_map<std::string, ip_five_tuple>& flows, uint32_t bloom_count,
-      uint32_t local_counter, uint32_t remote_counter, uint32_t id, uint32_t depth)
+  bool
+    SimulationStateWriter::IsOpen() const
   {
+    return m_out.is_open();
+  }
 
-    SoftFailureEventState soft_failure_event;
-    soft_failure_event.timestamp = timestamp;
-    soft_failure_event.soft_type = soft_type;
-    soft_failure_event.id = id;
-    soft_failure_event.local_counter = local_counter;
-    soft_failure_event.remote_counter = remote_counter;
-    for (uint32_t i = 0; i < depth; i++)
+  void
+    SimulationStateWriter::Branch(std::string file_name)
+  {
+    if (!m_out.is_open())
     {
-      soft_failure_event.hash_path.push_back(hash_path[i]);
+      Open(file_name);
+      return;
     }
 
-    soft_failure_event.flows = flows;
-    soft_failure_event.bloom_count = bloom_count;
-    soft_failure_event.flow_count = flows.size();
-    soft_failure_event.depth = depth;
-    soft_failure_events.push_back(soft_failure_event);
+    /* Records are flushed as they are written, the file is complete */
+    m_out.close();
+    std::filesystem::copy_file(m_fileName, GetStreamFileName(file_name),
+      std::filesystem::copy_options::overwrite_existing);
+    OpenStream(file_name, std::ios::app);
   }
 
   void
-    FancySimulationState::SetSoftFailureEvent(double timestamp, uint8_t soft_type, uint32_t id, uint32_t local_counter, uint32_t remote_counter)
+    SimulationStateWriter::WriteRecord(const std::string& record)
   {
-    SoftFailureEventState soft_failure_event;
-    soft_failure_event.timestamp = timestamp;
-    soft_failure_event.soft_type = soft_type;
-    soft_failure_event.id = id;
-    soft_failure_event.local_counter = local_counter;
-    soft_failure_event.remote_counter = remote_counter;
-    soft_failure_event.bloom_count = 0;
-    soft_failure_event.flow_count = 0;
-    soft_failure_event.depth = 0;
-    soft_failure_events.push_back(soft_failure_event);
+    m_out << record << '\n';
+    m_out.flush();
   }
 
-
-
-  void
-    FancySimulationState::SetFailureEvent(double timestamp, char hash_path[], uint32_t bloom_filter_indexes[],
-      std::unordered_map<std::string, ip_five_tuple>& flows, uint32_t bloom_count,
-      uint32_t local_counter, uint32_t remote_counter, uint32_t id, uint32_t failure_number)
+  static void
+    WriteJsonRecord(SimulationStateWriter& writer, const char* type, json& record)
   {
+    record["type"] = type;
+    writer.WriteRecord(record.dump());
+  }
 
-    FailureEventState failure_event;
-    failure_event.timestamp = timestamp;
-    failure_event.id = id;
-    failure_event.local_counter = local_counter;
-    failure_event.remote_counter = remote_counter;
-    for (uint32_t i = 0; i < m_treeDepth; i++)
+  static json
+    FlowsToJson(flow_key_map& flows)
+  {
+    /* Convert Flows Nicely */
+    std::vector<std::string> str_flows;
+    for (auto it = flows.begin(); it != flows.end(); it++)
     {
-      failure_event.hash_path.push_back(hash_path[i]);
+      ip_five_tuple flow = it->second;
+      str_flows.push_back(IpFiveTupleToBeautifulString(flow));
     }
-    for (uint32_t i = 0; i < m_rerouteBloomFilterNumHashes; i++)
+    return json(str_flows);
+  }
+
+  void
+    ConvertSimulationStateToJson(std::string ndjson_file, std::string json_file,
+      const std::vector<std::string>& collections)
+  {
+    /* The documents were dumped by nlohmann::json, whose objects sort their keys */
+    std::set<std::string> names(collections.begin(), collections.end());
+    std::string line;
+    std::ifstream in_file(ndjson_file);
+    NS_ASSERT_MSG(in_file, "Provide a valid simulation state file " + ndjson_file);
+    while (std::getline(in_file, line))
     {
-      failure_event.bloom_filter_indexes.push_back(bloom_filter_indexes[i]);
+      if (!line.empty())
+      {
+        names.insert(json::parse(line)["type"].get<std::string>());
+      }
     }
-    failure_event.flows = flows;
-    failure_event.bloom_count = bloom_count;
-    failure_event.flow_count = flows.size();
-    failure_event.failure_number = failure_number;
-    failure_events.push_back(failure_event);
 
+    std::ofstream out_file(json_file);
+    NS_ASSERT_MSG(out_file, "Could not open the output file " + json_file);
+    out_file << '{';
+    for (auto name = names.begin(); name != names.end(); name++)
+    {
+      if (name != names.begin())
+      {
+        out_file << ',';
+      }
+      out_file << json(*name).dump() << ':';
+
+      /* One pass per collection, copying its records one at a time */
+      in_file.clear();
+      in_file.seekg(0);
+      uint64_t records = 0;
+      while (std::getline(in_file, line))
+      {
+        if (line.empty())
+        {
+          continue;
+        }
+        json record = json::parse(line);
+        if (record["type"] != *name)
+        {
+          continue;
+        }
+        record.erase("type");
+        /* soft failures used to call their kind "type" */
+        if (record.contains("soft_type"))
+        {
+          record["type"] = record["soft_type"];
+          record.erase("soft_type");
+        }
+        out_file << (records++ == 0 ? '[' : ',') << record.dump();
+      }
+      out_file << (records == 0 ? "null" : "]");
+    }
+    out_file << '}';
   }
 
-  void
-    FancySimulationState::SetFailureEvent(double timestamp, uint32_t id, uint32_t local_counter, uint32_t remote_counter, uint32_t failure_number)
-  {
+  /* Fancy FancySimulationState*/
 
-    FailureEventState failure_event;
-    failure_event.timestamp = timestamp;
-    failure_event.id = id;
-    failure_event.local_counter = local_counter;
-    failure_event.remote_counter = remote_counter;
-    failure_event.bloom_count = 0;
-    failure_event.flow_count = 0;
-    failure_event.failure_number = failure_number;
-    failure_events.push_back(failure_event);
+  FancySimulationState::FancySimulationState(uint32_t depth, uint32_t bloom_hashes)
+  {
+    m_treeDepth = depth;
+    m_rerouteBloomFilterNumHashes = bloom_hashes;
   }
 
-  void
-    FancySimulationState::SetCollisionEvent(uint32_t step, uint32_t node_index, uint8_t  counter_cell, uint32_t num_collisions)
+  FancySimulationState::~FancySimulationState()
   {
-    CollisionEventState collision_event;
-    collision_event.step = step;
-    collision_event.node_index = node_index;
-    collision_event.counter_cell = counter_cell;
-    collision_event.num_collisions = num_collisions;
-
-    collision_events.push_back(collision_event);
+    Close();
   }
 
-  void
-    FancySimulationState::SetUniformFailureEvent(double timestamp, uint32_t step, uint16_t faulty_entries)
+  void FancySimulationState::SetDetail(bool detail)
   {
-    UniformFailureEventState uniform_failure_event;
-
-    uniform_failure_event.timestamp = timestamp;
-    uniform_failure_event.step = step;
-    uniform_failure_event.faulty_entries = faulty_entries;
-
-    uniform_failure_events.push_back(uniform_failure_event);
+    m_save_details = detail;
   }
 
+  std::vector<std::string>
+    FancySimulationState::GetCollections(void)
+  {
+    return { "collisions", "failures", "reroutes", "soft_failures", "steps", "uniform_failures" };
+  }
 
   void
-    FancySimulationState::SetMaxHistory(std::vector<std::vector<uint8_t>>& max_history)
+    FancySimulationState::Open(std::string file_name)
   {
-    if (m_save_details)
-    {
-      simulation_steps.back().nodes.back().max_history = max_history;
-    }
+    Close();
+    m_writer.Open(file_name);
   }
 
   void
-    FancySimulationState::SetRerouteEvent(double timestamp, uint32_t bloom_filter_indexes[], uint32_t reroute_number,
-      ip_five_tuple flow, uint32_t id)
-
+    FancySimulationState::Branch(std::string file_name)
   {
-    RerouteEventState reroute_event;
-    reroute_event.id = id;
-    reroute_event.timestamp = timestamp;
-    reroute_event.flow = flow;
-    reroute_event.reroute_number = reroute_number;
-
-    /* Set bloom filter indexes */
-    for (uint32_t i = 0; i < m_rerouteBloomFilterNumHashes; i++)
-    {
-      reroute_event.bloom_filter_indexes.push_back(bloom_filter_indexes[i]);
-    }
-    reroute_events.push_back(reroute_event);
+    m_writer.Branch(file_name);
   }
 
   void
-    FancySimulationState::SetRerouteEvent(double timestamp, uint32_t reroute_number, ip_five_tuple flow, uint32_t id)
+    FancySimulationState::Close()
   {
-    RerouteEventState reroute_event;
-    reroute_event.id = id;
-    reroute_event.timestamp = timestamp;
-    reroute_event.flow = flow;
-    reroute_event.reroute_number = reroute_number;
-    reroute_events.push_back(reroute_event);
+    FlushSimulationStep();
+    m_writer.Close();
   }
 
   void
-    FancySimulationState::SaveInJson(std::string file_name)
+    FancySimulationState::FlushSimulationStep(void)
   {
+    if (!m_stepPending)
+    {
+      return;
+    }
+    m_stepPending = false;
 
-    json state;
-
-    json reroutes;
-    json failures;
-    json soft_failures;
-    json steps;
-    json collisions;
-    json uniform_failures;
-
-
-    /* Add uniform failure events */
-    for (uint32_t i = 0; i < uniform_failure_events.size(); i++)
+    if (!m_writer.IsOpen())
     {
-      json uniform_failure;
+      return;
+    }
 
-      uniform_failure["timestamp"] = uniform_failure_events[i].timestamp;
-      uniform_failure["step"] = uniform_failure_events[i].step;
-      uniform_failure["faulty_entries"] = uniform_failure_events[i].faulty_entries;
+    json step;
+    step["timestamp"] = m_currentStep.timestamp;
+    step["step"] = m_currentStep.step;
+    step["packets_sent"] = m_currentStep.packets_sent;
+    step["packets_lost"] = m_currentStep.packets_lost;
 
-      uniform_failures.push_back(uniform_failure);
+    json nodes;
+    for (uint32_t j = 0; j < m_currentStep.nodes.size(); j++)
+    {
+      TreeNodeState& tree_node = m_currentStep.nodes[j];
+      json node;
+      node["index"] = tree_node.index;
+      node["local_counter"] = json(tree_node.local_counter);
+      node["remote_counter"] = json(tree_node.remote_counter);
+      node["bloom_count"] = json(tree_node.bloom_count);
+      node["flow_count"] = json(tree_node.flow_count);
+      node["bloom_filter"] = json(tree_node.bloom_filter);
+      node["max_history"] = json(tree_node.max_history);
+      nodes.push_back(node);
     }
+    step["nodes"] = nodes;
 
+    WriteJsonRecord(m_writer, "steps", step);
+  }
 
-    /* Add Collision Events */
-    for (uint32_t i = 0; i < collision_events.size(); i++)
-    {
-      json collision;
+  void
+    FancySimulationState::SetSimulationStep(double timestamp, uint32_t step, uint32_t packets_sent, uint32_t packets_lost)
+  {
+    FlushSimulationStep();
 
-      collision["step"] = collision_events[i].step;
-      collision["node_index"] = collision_events[i].node_index;
-      collision["counter_cell"] = collision_events[i].counter_cell;
-      collision["num_collisions"] = collision_events[i].num_collisions;
-      collisions.push_back(collision);
-    }
+    m_currentStep.timestamp = timestamp;
+    m_currentStep.step = step;
+    m_currentStep.packets_sent = packets_sent;
+    m_currentStep.packets_lost = packets_lost;
+    m_currentStep.nodes.clear();
+    m_stepPending = true;
+  }
 
-    /* Add Reroutes Events */
-    for (uint32_t i = 0; i < reroute_events.size(); i++)
+  void
+    FancySimulationState::SetSimulationTreeNode(uint32_t index)
+  {
+    if (m_save_details && m_writer.IsOpen())
     {
-      json reroute;
-      json indexes(reroute_events[i].bloom_filter_indexes);
-
-      reroute["timestamp"] = reroute_events[i].timestamp;
-      reroute["reroute_number"] = reroute_events[i].reroute_number;
-      reroute["flow"] = IpFiveTupleToBeautifulString(reroute_events[i].flow);
-      reroute["bloom_filter_indexes"] = indexes;
-      reroute["id"] = reroute_events[i].id;
-      reroutes.push_back(reroute);
+      TreeNodeState node;
+      node.index = index;
+      m_currentStep.nodes.push_back(node);
     }
+  }
 
-    /* Add Failure Events */
-
-    for (uint32_t i = 0; i < failure_events.size(); i++)
+  void
+    FancySimulationState::SetCounterValues(uint32_t local_counter, uint32_t remote_counter, uint32_t bloom_count, uint32_t flow_count,
+      const uint64_t* bloom_filter, uint32_t bloom_width)
+  {
+    if (m_save_details && m_writer.IsOpen())
     {
-
-      json failure;
-      json indexes(failure_events[i].bloom_filter_indexes);
-      json hash_path(failure_events[i].hash_path);
-
-      /* Convert Flows Nicely */
-      std::vector<std::string> str_flows;
-      for (auto it = failure_events[i].flows.begin(); it != failure_events[i].flows.end(); it++)
+      TreeNodeState& node = m_currentStep.nodes.back();
+      node.local_counter.push_back(local_counter);
+      node.remote_counter.push_back(remote_counter);
+      node.bloom_count.push_back(bloom_count);
+      node.flow_count.push_back(flow_count);
+
+      /* Most significant bit first, same format as boost::to_string */
+      std::string buffer(bloom_width, '0');
+      for (uint32_t bit = 0; bit < bloom_width; bit++)
       {
-        ip_five_tuple flow = it->second;
-        std::string beautiful_flow = IpFiveTupleToBeautifulString(flow);
-        str_flows.push_back(beautiful_flow);
+        if ((bloom_filter[bit >> 6] >> (bit & 63)) & 1)
+        {
+          buffer[bloom_width - 1 - bit] = '1';
+        }
       }
+      node.bloom_filter.push_back(buffer);
+    }
+  }
 
-      json flows(str_flows);
-
-      failure["timestamp"] = failure_events[i].timestamp;
-      failure["hash_path"] = hash_path;
-      failure["bloom_filter_indexes"] = indexes;
-      failure["flows"] = flows;
-      failure["bloom_count"] = failure_events[i].bloom_count;
-      failure["flow_count"] = failure_events[i].flow_count;
-      failure["id"] = failure_events[i].id;
-      failure["local_counter"] = failure_events[i].local_counter;
-      failure["remote_counter"] = failure_events[i].remote_counter;
-      failure["failure_number"] = failure_events[i].failure_number;
+  void
+    FancySimulationState::SetSoftFailureEvent(double timestamp, uint8_t soft_type, char hash_path[],
+      flow_key_map& flows, uint32_t bloom_count,
+      uint32_t local_counter, uint32_t remote_counter, uint32_t id, uint32_t depth)
+  {
+    if (!m_writer.IsOpen())
+    {
+      return;
+    }
 
-      failures.push_back(failure);
+    json soft_failure;
+    soft_failure["timestamp"] = timestamp;
+    soft_failure["hash_path"] = json(std::vector<char>(hash_path, hash_path + depth));
+    soft_failure["flows"] = FlowsToJson(flows);
+    soft_failure["bloom_count"] = bloom_count;
+    soft_failure["flow_count"] = flows.size();
+    soft_failure["id"] = id;
+    soft_failure["local_counter"] = local_counter;
+    soft_failure["remote_counter"] = remote_counter;
+    soft_failure["depth"] = depth;
+    soft_failure["soft_type"] = soft_type;
+    WriteJsonRecord(m_writer, "soft_failures", soft_failure);
+  }
 
+  void
+    FancySimulationState::SetSoftFailureEvent(double timestamp, uint8_t soft_type, uint32_t id, uint32_t local_counter, uint32_t remote_counter)
+  {
+    if (!m_writer.IsOpen())
+    {
+      return;
     }
 
-    /* Add Soft Failure Events */
+    json soft_failure;
+    soft_failure["timestamp"] = timestamp;
+    soft_failure["hash_path"] = json::array();
+    soft_failure["flows"] = json::array();
+    soft_failure["bloom_count"] = 0;
+    soft_failure["flow_count"] = 0;
+    soft_failure["id"] = id;
+    soft_failure["local_counter"] = local_counter;
+    soft_failure["remote_counter"] = remote_counter;
+    soft_failure["depth"] = 0;
+    soft_failure["soft_type"] = soft_type;
+    WriteJsonRecord(m_writer, "soft_failures", soft_failure);
+  }
 
-    for (uint32_t i = 0; i < soft_failure_events.size(); i++)
+  void
+    FancySimulationState::SetFailureEvent(double timestamp, char hash_path[], uint32_t bloom_filter_indexes[],
+      flow_key_map& flows, uint32_t bloom_count,
+      uint32_t local_counter, uint32_t remote_counter, uint32_t id, uint32_t failure_number)
+  {
+    if (!m_writer.IsOpen())
     {
-      json soft_failure;
-      json hash_path(soft_failure_events[i].hash_path);
-
-      /* Convert Flows Nicely */
-      std::vector<std::string> str_flows;
-      for (auto it = soft_failure_events[i].flows.begin(); it != soft_failure_events[i].flows.end(); it++)
-      {
-        ip_five_tuple flow = it->second;
-        std::string beautiful_flow = IpFiveTupleToBeautifulString(flow);
-        str_flows.push_back(beautiful_flow);
-      }
+      return;
+    }
 
-      json flows(str_flows);
+    json failure;
+    failure["timestamp"] = timestamp;
+    failure["hash_path"] = json(std::vector<char>(hash_path, hash_path + m_treeDepth));
+    failure["bloom_filter_indexes"] = json(std::vector<uint32_t>(bloom_filter_indexes,
+      bloom_filter_indexes + m_rerouteBloomFilterNumHashes));
+    failure["flows"] = FlowsToJson(flows);
+    failure["bloom_count"] = bloom_count;
+    failure["flow_count"] = flows.size();
+    failure["id"] = id;
+    failure["local_counter"] = local_counter;
+    failure["remote_counter"] = remote_counter;
+    failure["failure_number"] = failure_number;
+    WriteJsonRecord(m_writer, "failures", failure);
+  }
 
-      soft_failure["timestamp"] = soft_failure_events[i].timestamp;
-      soft_failure["type"] = soft_failure_events[i].soft_type;
-      soft_failure["hash_path"] = hash_path;
-      soft_failure["flows"] = flows;
-      soft_failure["bloom_count"] = soft_failure_events[i].bloom_count;
-      soft_failure["flow_count"] = soft_failure_events[i].flow_count;
-      soft_failure["id"] = soft_failure_events[i].id;
-      soft_failure["local_counter"] = soft_failure_events[i].local_counter;
-      soft_failure["remote_counter"] = soft_failure_events[i].remote_counter;
-      soft_failure["depth"] = soft_failure_events[i].depth;
+  void
+    FancySimulationState::SetFailureEvent(double timestamp, uint32_t id, uint32_t local_counter, uint32_t remote_counter, uint32_t failure_number)
+  {
+    if (!m_writer.IsOpen())
+    {
+      return;
+    }
 
-      soft_failures.push_back(soft_failure);
+    json failure;
+    failure["timestamp"] = timestamp;
+    failure["hash_path"] = json::array();
+    failure["bloom_filter_indexes"] = json::array();
+    failure["flows"] = json::array();
+    failure["bloom_count"] = 0;
+    failure["flow_count"] = 0;
+    failure["id"] = id;
+    failure["local_counter"] = local_counter;
+    failure["remote_counter"] = remote_counter;
+    failure["failure_number"] = failure_number;
+    WriteJsonRecord(m_writer, "failures", failure);
+  }
 
+  void
+    FancySimulationState::SetCollisionEvent(uint32_t step, uint32_t node_index, uint8_t  counter_cell, uint32_t num_collisions)
+  {
+    if (!m_writer.IsOpen())
+    {
+      return;
     }
 
-    /* Simulation Steps */
-    for (uint32_t i = 0; i < simulation_steps.size(); i++)
+    json collision;
+    collision["step"] = step;
+    collision["node_index"] = node_index;
+    collision["counter_cell"] = counter_cell;
+    collision["num_collisions"] = num_collisions;
+    WriteJsonRecord(m_writer, "collisions", collision);
+  }
+
+  void
+    FancySimulationState::SetUniformFailureEvent(double timestamp, uint32_t step, uint16_t faulty_entries)
+  {
+    if (!m_writer.IsOpen())
     {
-      json step;
+      return;
+    }
 
-      step["timestamp"] = simulation_steps[i].timestamp;
-      step["step"] = simulation_steps[i].step;
-      step["packets_sent"] = simulation_steps[i].packets_sent;
-      step["packets_lost"] = simulation_steps[i].packets_lost;
+    json uniform_failure;
+    uniform_failure["timestamp"] = timestamp;
+    uniform_failure["step"] = step;
+    uniform_failure["faulty_entries"] = faulty_entries;
+    WriteJsonRecord(m_writer, "uniform_failures", uniform_failure);
+  }
 
-      json nodes;
 
-      for (uint32_t j = 0; j < simulation_steps[i].nodes.size(); j++)
+  void
+    FancySimulationState::SetMaxHistory(const uint8_t* max_history, uint32_t depth, uint32_t split)
+  {
+    if (m_save_details && m_writer.IsOpen())
+    {
+      std::vector<std::vector<uint8_t>>& history = m_currentStep.nodes.back().max_history;
+      history.resize(depth);
+      for (uint32_t level = 0; level < depth; level++)
       {
-        json node;
-        json local_counter(simulation_steps[i].nodes[j].local_counter);
-        json remote_counter(simulation_steps[i].nodes[j].remote_counter);
-        json bloom_count(simulation_steps[i].nodes[j].bloom_count);
-        json flow_count(simulation_steps[i].nodes[j].flow_count);
-        json bloom_filter(simulation_steps[i].nodes[j].bloom_filter);
-        json max_history(simulation_steps[i].nodes[j].max_history);
-
-        node["index"] = simulation_steps[i].nodes[j].index;
-        node["local_counter"] = local_counter;
-        node["remote_counter"] = remote_counter;
-        node["bloom_count"] = bloom_count;
-        node["flow_count"] = flow_count;
-        node["bloom_filter"] = bloom_filter;
-        node["max_history"] = max_history;
-
-        nodes.push_back(node);
-
+        history[level].assign(max_history + level * split, max_history + (level + 1) * split);
       }
-      step["nodes"] = nodes;
-      steps.push_back(step);
+    }
+  }
+
+  void
+    FancySimulationState::SetRerouteEvent(double timestamp, uint32_t bloom_filter_indexes[], uint32_t reroute_number,
+      ip_five_tuple flow, uint32_t id)
+
+  {
+    if (!m_writer.IsOpen())
+    {
+      return;
     }
 
-    state["uniform_failures"] = uniform_failures;
-    state["collisions"] = collisions;
-    state["reroutes"] = reroutes;
-    state["failures"] = failures;
-    state["soft_failures"] = soft_failures;
-    state["steps"] = steps;
+    json reroute;
+    reroute["timestamp"] = timestamp;
+    reroute["reroute_number"] = reroute_number;
+    reroute["flow"] = IpFiveTupleToBeautifulString(flow);
+    reroute["bloom_filter_indexes"] = json(std::vector<uint32_t>(bloom_filter_indexes,
+      bloom_filter_indexes + m_rerouteBloomFilterNumHashes));
+    reroute["id"] = id;
+    WriteJsonRecord(m_writer, "reroutes", reroute);
+  }
 
-    /* Save json to ouput file */
-    std::fstream out_file;
-    out_file.open(file_name, std::ios::out);
-    out_file << state;
-    out_file.close();
+  void
+    FancySimulationState::SetRerouteEvent(double timestamp, uint32_t reroute_number, ip_five_tuple flow, uint32_t id)
+  {
+    if (!m_writer.IsOpen())
+    {
+      return;
+    }
 
+    json reroute;
+    reroute["timestamp"] = timestamp;
+    reroute["reroute_number"] = reroute_number;
+    reroute["flow"] = IpFiveTupleToBeautifulString(flow);
+    reroute["bloom_filter_indexes"] = json::array();
+    reroute["id"] = id;
+    WriteJsonRecord(m_writer, "reroutes", reroute);
   }
 
 
@@ -507,45 +627,48 @@ namespace ns3 {
 
   NetSeerSimulationState::~NetSeerSimulationState()
   {
+    Close();
+  }
 
+  void
+    NetSeerSimulationState::Open(std::string file_name)
+  {
+    m_writer.Open(file_name);
   }
 
   void
-    NetSeerSimulationState::SetFailureEvent(double timestamp, ip_five_tuple flow, uint32_t num_drops)
+    NetSeerSimulationState::Branch(std::string file_name)
   {
-    NetSeerFailureEventState failure_event;
-    failure_event.timestamp = timestamp;
-    failure_event.flow = flow;
-    failure_event.num_drops = num_drops;
-    failure_event.event_number = m_event_number;
-    m_event_number++;
-    failure_events.push_back(failure_event);
+    m_writer.Branch(file_name);
   }
 
   void
-    NetSeerSimulationState::SaveInJson(std::string file_name)
+    NetSeerSimulationState::Close()
   {
-    json state;
+    m_writer.Close();
+  }
 
-    json failures;
+  std::vector<std::string>
+    NetSeerSimulationState::GetCollections(void)
+  {
+    return { "failures" };
+  }
 
-    /* Add failure events */
-    for (uint32_t i = 0; i < failure_events.size(); i++)
+  void
+    NetSeerSimulationState::SetFailureEvent(double timestamp, ip_five_tuple flow, uint32_t num_drops)
+  {
+    uint32_t event_number = m_event_number++;
+    if (!m_writer.IsOpen())
     {
-      json failure;
-      failure["timestamp"] = failure_events[i].timestamp;
-      failure["flow"] = IpFiveTupleToBeautifulString(failure_events[i].flow);
-      failure["event_number"] = failure_events[i].event_number;
-      failure["num_drops"] = failure_events[i].num_drops;
-      failures.push_back(failure);
+      return;
     }
 
-    state["failures"] = failures;
-
-    std::fstream out_file;
-    out_file.open(file_name, std::ios::out);
-    out_file << state;
-    out_file.close();
+    json failure;
+    failure["timestamp"] = timestamp;
+    failure["flow"] = IpFiveTupleToBeautifulString(flow);
+    failure["event_number"] = event_number;
+    failure["num_drops"] = num_drops;
+    WriteJsonRecord(m_writer, "failures", failure);
   }
 
   // Loss radar
@@ -557,58 +680,58 @@ namespace ns3 {
 
   LossRadarSimulationState::~LossRadarSimulationState()
   {
+    Close();
+  }
 
+  void
+    LossRadarSimulationState::Open(std::string file_name)
+  {
+    m_writer.Open(file_name);
   }
 
   void
-    LossRadarSimulationState::SetFailureEvent(std::string link_name, double timestamp, std::vector<ip_five_tuple>& packets_lost,
-      uint32_t non_pure_cells, uint32_t non_detected_packets, uint32_t total_packets_lost_in_batch)
+    LossRadarSimulationState::Branch(std::string file_name)
   {
-    LossRadarFailureEventState failure_event;
-    failure_event.timestamp = timestamp;
-    failure_event.packets_lost = packets_lost;
-    failure_event.step = m_step_counter;
-    failure_event.non_detected_packets = non_detected_packets;
-    failure_event.non_pure_cells = non_pure_cells;
-    failure_event.total_packets_lost_in_batch = total_packets_lost_in_batch;
-    m_step_counter++;
-    failure_events.push_back(failure_event);
+    m_writer.Branch(file_name);
   }
 
   void
-    LossRadarSimulationState::SaveInJson(std::string file_name)
+    LossRadarSimulationState::Close()
   {
-    json state;
-    json failures;
+    m_writer.Close();
+  }
 
-    /* Add failure events */
-    for (uint32_t i = 0; i < failure_events.size(); i++)
-    {
-      json failure;
-      failure["timestamp"] = failure_events[i].timestamp;
-      failure["link_name"] = failure_events[i].link_name;
-      failure["non_detected_packets"] = failure_events[i].non_detected_packets;
-      failure["non_pure_cells"] = failure_events[i].non_pure_cells;
-      failure["total_packets_lost_in_batch"] = failure_events[i].total_packets_lost_in_batch;
-      failure["step"] = failure_events[i].step;
-
-      std::vector<std::string> packets_lost_str;
-      for (uint32_t j = 0; j < failure_events[i].packets_lost.size(); j++)
-      {
-        packets_lost_str.push_back(IpFiveTupleToBeautifulString(failure_events[i].packets_lost[j]));
-      }
+  std::vector<std::string>
+    LossRadarSimulationState::GetCollections(void)
+  {
+    return { "failures" };
+  }
 
-      json packets_lost(packets_lost_str);
-      failure["packets_lost"] = packets_lost;
-      failures.push_back(failure);
+  void
+    LossRadarSimulationState::SetFailureEvent(std::string link_name, double timestamp, std::vector<ip_five_tuple>& packets_lost,
+      uint32_t non_pure_cells, uint32_t non_detected_packets, uint32_t total_packets_lost_in_batch)
+  {
+    uint32_t step = m_step_counter++;
+    if (!m_writer.IsOpen())
+    {
+      return;
     }
 
-    state["failures"] = failures;
+    json failure;
+    failure["timestamp"] = timestamp;
+    failure["link_name"] = link_name;
+    failure["non_detected_packets"] = non_detected_packets;
+    failure["non_pure_cells"] = non_pure_cells;
+    failure["total_packets_lost_in_batch"] = total_packets_lost_in_batch;
+    failure["step"] = step;
 
-    std::fstream out_file;
-    out_file.open(file_name, std::ios::out);
-    out_file << state;
-    out_file.close();
+    std::vector<std::string> packets_lost_str;
+    for (uint32_t j = 0; j < packets_lost.size(); j++)
+    {
+      packets_lost_str.push_back(IpFiveTupleToBeautifulString(packets_lost[j]));
+    }
+    failure["packets_lost"] = json(packets_lost_str);
+    WriteJsonRecord(m_writer, "failures", failure);
   }
 
 
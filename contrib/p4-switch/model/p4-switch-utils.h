@@ -14,7 +14,6 @@
 #include "ns3/log.h"
 
 #include <unordered_map>
-#include <boost/dynamic_bitset.hpp>
 
 namespace ns3 {
 
@@ -30,11 +29,56 @@ namespace ns3 {
     //uint8_t tos = 0; 
   };
 
+  /* Packed binary flow identity. Used as key of the per flow maps
+     so we do not have to build a string for every packet. */
+  struct flow_key
+  {
+    uint32_t src_ip = 0;
+    uint32_t dst_ip = 0;
+    uint16_t src_port = 0;
+    uint16_t dst_port = 0;
+    uint8_t protocol = 0;
+
+    bool operator==(const flow_key& other) const
+    {
+      return src_ip == other.src_ip && dst_ip == other.dst_ip &&
+        src_port == other.src_port && dst_port == other.dst_port &&
+        protocol == other.protocol;
+    }
+  };
+
+  struct flow_key_hash
+  {
+    std::size_t operator()(const flow_key& key) const
+    {
+      uint64_t h = ((uint64_t)key.src_ip << 32) | key.dst_ip;
+      h ^= (((uint64_t)key.src_port << 24) | ((uint64_t)key.dst_port << 8) | key.protocol) * 0x9e3779b97f4a7c15ULL;
+      /* 64 bit finalizer (splitmix64) */
+      h ^= h >> 30;
+      h *= 0xbf58476d1ce4e5b9ULL;
+      h ^= h >> 27;
+      h *= 0x94d049bb133111ebULL;
+      h ^= h >> 31;
+      return (std::size_t)h;
+    }
+  };
+
+  typedef std::unordered_map<flow_key, ip_five_tuple, flow_key_hash> flow_key_map;
+
   int KArryTreeDepth(uint32_t split, uint32_t node_index);
 
   std::string
     IpFiveTupleToString(ip_five_tuple& flow);
 
+  flow_key
+    IpFiveTupleToFlowKey(ip_five_tuple& flow);
+
+  flow_key
+    DstPrefixToFlowKey(ip_five_tuple& flow);
+
+  std::string
+    FlowKeyToString(const flow_key& key);
+
   std::string
     IpFiveTupleToBeautifulString(ip_five_tuple& flow);
 
@@ -72,6 +116,51 @@ namespace ns3 {
 
   std::vector<std::string> LoadPrefixList(std::string file);
 
+  /* Streams simulation records as newline delimited JSON: one object
+     per line with a "type" field naming the collection it belongs to.
+     Every record is flushed when written so a killed run keeps all the
+     events reported so far and nothing is buffered in memory.
+
+     A file named <name>.json is streamed to <name>.ndjson, other names
+     are streamed as they are. The single document can be rebuilt after
+     the run with ConvertSimulationStateToJson, or the
+     p4-switch-state-to-json program. */
+  class SimulationStateWriter
+  {
+  public:
+    SimulationStateWriter();
+    ~SimulationStateWriter();
+
+    void Open(std::string file_name);
+    void Close();
+    bool IsOpen() const;
+
+    /* Continues in file_name: the records written so far are copied to it
+       and new records are appended there. Used by forked simulation
+       branches so each one owns a complete file */
+    void Branch(std::string file_name);
+
+    void WriteRecord(const std::string& record);
+
+    /* Name of the streamed file for an output file */
+    static std::string GetStreamFileName(std::string file_name);
+
+  private:
+    void OpenStream(std::string file_name, std::ios::openmode mode);
+
+    std::ofstream m_out;
+    /* Streamed file */
+    std::string m_fileName;
+  };
+
+  /* Rebuilds the single document layout ({"failures": [...], ...}) from a
+     streamed file, for tools that still expect it. Every collection is
+     written, null when it has no record as the documents used to be, and
+     only one record is held in memory: the file is read once per
+     collection */
+  void ConvertSimulationStateToJson(std::string ndjson_file, std::string json_file,
+    const std::vector<std::string>& collections);
+
   struct TreeNodeState
   {
     uint32_t index;
@@ -83,58 +172,6 @@ namespace ns3 {
     std::vector<std::vector<uint8_t>> max_history;
   };
 
-  struct CollisionEventState
-  {
-    uint32_t step;
-    uint32_t node_index;
-    uint8_t  counter_cell;
-    uint32_t num_collisions;
-  };
-
-  struct UniformFailureEventState
-  {
-    double timestamp;
-    uint32_t step;
-    uint16_t faulty_entries;
-  };
-
-  struct FailureEventState
-  {
-    double timestamp;
-    uint32_t id;
-    uint32_t local_counter;
-    uint32_t remote_counter;
-    std::vector<char> hash_path;
-    std::vector<uint32_t> bloom_filter_indexes;
-    std::unordered_map<std::string, ip_five_tuple> flows;
-    uint32_t bloom_count;
-    uint32_t flow_count;
-    uint32_t failure_number;
-  };
-
-  struct SoftFailureEventState
-  {
-    double timestamp;
-    uint8_t soft_type;
-    uint32_t id;
-    uint32_t local_counter;
-    uint32_t remote_counter;
-    std::vector<char> hash_path;
-    std::unordered_map<std::string, ip_five_tuple> flows;
-    uint32_t bloom_count;
-    uint32_t flow_count;
-    uint32_t depth;
-  };
-
-  struct RerouteEventState
-  {
-    double timestamp;
-    uint32_t id;
-    std::vector<uint32_t> bloom_filter_indexes;
-    uint32_t reroute_number;
-    ip_five_tuple flow;
-  };
-
   struct SimulationStep
   {
     double timestamp;
@@ -151,18 +188,25 @@ namespace ns3 {
     FancySimulationState(uint32_t depth, uint32_t bloom_hashes);
     ~FancySimulationState();
 
+    /* Starts streaming records to file_name, events reported while no
+       file is open are discarded */
+    void Open(std::string file_name);
+    void Close();
+    /* Moves to another file keeping the pending step in memory */
+    void Branch(std::string file_name);
+
     /* tree nodes */
     void SetSimulationStep(double timestamp, uint32_t step, uint32_t packets_sent, uint32_t packets_lost);
     void SetSimulationTreeNode(uint32_t index);
     void SetCounterValues(uint32_t local_counter, uint32_t remote_counter, uint32_t bloom_count, uint32_t flow_count,
-      boost::dynamic_bitset<>& bloom_filter);
+      const uint64_t* bloom_filter, uint32_t bloom_width);
 
     void SetFailureEvent(double timestamp, char hash_path[], uint32_t bloom_filter_indexes[],
-      std::unordered_map<std::string, ip_five_tuple>& flows, uint32_t bloom_count,
+      flow_key_map& flows, uint32_t bloom_count,
       uint32_t local_counter, uint32_t remote_counter, uint32_t id, uint32_t failure_number);
 
     void SetSoftFailureEvent(double timestamp, uint8_t soft_type, char hash_path[],
-      std::unordered_map<std::string, ip_five_tuple>& flows, uint32_t bloom_count,
+      flow_key_map& flows, uint32_t bloom_count,
       uint32_t local_counter, uint32_t remote_counter, uint32_t id, uint32_t depth);
 
     void SetSoftFailureEvent(double timestamp, uint8_t soft_type, uint32_t id, uint32_t local_counter, uint32_t remote_counter);
@@ -171,24 +215,27 @@ namespace ns3 {
 
     void SetCollisionEvent(uint32_t step, uint32_t node_index, uint8_t  counter_cell, uint32_t num_collisions);
 
-    void SetMaxHistory(std::vector<std::vector<uint8_t>>& max_history);
+    void SetMaxHistory(const uint8_t* max_history, uint32_t depth, uint32_t split);
     void SetRerouteEvent(double timestamp, uint32_t bloom_filter_indexes[], uint32_t reroute_number, ip_five_tuple flow, uint32_t id);
     void SetRerouteEvent(double timestamp, uint32_t reroute_number, ip_five_tuple flow, uint32_t id);
     void SetUniformFailureEvent(double timestamp, uint32_t step, uint16_t faulty_entries);
 
-    void SaveInJson(std::string file_name);
-
     void SetDetail(bool enabled);
 
+    /* Collections of the single document */
+    static std::vector<std::string> GetCollections(void);
+
   protected:
 
   private:
-    std::vector<SimulationStep> simulation_steps;
-    std::vector<FailureEventState> failure_events;
-    std::vector<SoftFailureEventState> soft_failure_events;
-    std::vector<RerouteEventState> reroute_events;
-    std::vector<CollisionEventState> collision_events;
-    std::vector<UniformFailureEventState> uniform_failure_events;
+    void FlushSimulationStep(void);
+
+    SimulationStateWriter m_writer;
+
+    /* Only the step being filled is kept, it is written when the next
+       one starts or when the state is closed */
+    SimulationStep m_currentStep;
+    bool m_stepPending = false;
 
     uint32_t m_treeDepth = 0;
     uint32_t m_rerouteBloomFilterNumHashes = 0;
@@ -198,56 +245,47 @@ namespace ns3 {
 
 
   /* Net Seer state object */
-  struct NetSeerFailureEventState
-  {
-    double timestamp;
-    ip_five_tuple flow;
-    uint32_t num_drops;
-    uint32_t event_number;
-  };
-
   class NetSeerSimulationState
   {
   public:
     NetSeerSimulationState();
     ~NetSeerSimulationState();
 
+    void Open(std::string file_name);
+    void Close();
+    void Branch(std::string file_name);
+
     void SetFailureEvent(double timestamp, ip_five_tuple flow, uint32_t num_drops);
-    void SaveInJson(std::string file_name);
+
+    static std::vector<std::string> GetCollections(void);
 
   protected:
 
   private:
-    std::vector<NetSeerFailureEventState> failure_events;
+    SimulationStateWriter m_writer;
     uint32_t m_event_number = 0;
   };
 
   /* Loss radar */
-  struct LossRadarFailureEventState
-  {
-    double timestamp;
-    std::string link_name;
-    std::vector<ip_five_tuple> packets_lost;
-    uint32_t non_pure_cells;
-    uint32_t non_detected_packets;
-    uint32_t total_packets_lost_in_batch;
-    uint32_t step;
-  };
-
   class LossRadarSimulationState
   {
   public:
     LossRadarSimulationState();
     ~LossRadarSimulationState();
 
+    void Open(std::string file_name);
+    void Close();
+    void Branch(std::string file_name);
+
     void SetFailureEvent(std::string link_name, double timestamp, std::vector<ip_five_tuple>& packets, uint32_t non_pure_cells,
       uint32_t non_detected_packets, uint32_t total_packets_lost_in_batch);
-    void SaveInJson(std::string file_name);
+
+    static std::vector<std::string> GetCollections(void);
 
   protected:
 
   private:
-    std::vector<LossRadarFailureEventState> failure_events;
+    SimulationStateWriter m_writer;
     uint32_t m_step_counter = 0;
   };
 
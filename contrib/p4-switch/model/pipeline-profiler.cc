@@ -0,0 +1,175 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "pipeline-profiler.h"
+#include "ns3/log.h"
+#include "ns3/assert.h"
+
+#include <iomanip>
+#include <sstream>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+namespace ns3 {
+
+  NS_LOG_COMPONENT_DEFINE("PipelineProfiler");
+
+  static const char* g_stageNames[PipelineProfiler::STAGE_COUNT] = {
+    "Parser",
+    "Ingress",
+    "TrafficManager",
+    "Egress",
+    "UpdateChecksums",
+    "Deparser",
+    "EgressTrafficManager"
+  };
+
+  const char*
+    PipelineProfiler::GetStageName(Stage stage)
+  {
+    return g_stageNames[stage];
+  }
+
+  void
+    PipelineProfiler::Enter(Stage stage, uint32_t port)
+  {
+    if (port != NO_PORT && port >= m_ports.size())
+    {
+      m_ports.resize(port + 1);
+    }
+    GetPort(port).used = true;
+
+    uint64_t now = ReadCycles();
+    /* Pause the stage that called this one */
+    if (!m_active.empty())
+    {
+      Charge(m_active.back(), now - m_active.back().start, 0);
+    }
+    m_active.push_back({ stage, port, now });
+  }
+
+  void
+    PipelineProfiler::Leave(void)
+  {
+    NS_ASSERT_MSG(!m_active.empty(), "Leaving a stage that was not entered");
+    uint64_t now = ReadCycles();
+    Charge(m_active.back(), now - m_active.back().start, 1);
+    m_active.pop_back();
+    /* And resume the caller */
+    if (!m_active.empty())
+    {
+      m_active.back().start = now;
+    }
+  }
+
+  void
+    PipelineProfiler::Charge(const active_stage& active, uint64_t cycles, uint64_t packets)
+  {
+    m_stages[active.stage].cycles += cycles;
+    m_stages[active.stage].packets += packets;
+    stage_stats& port_stats = GetPort(active.port).stages[active.stage];
+    port_stats.cycles += cycles;
+    port_stats.packets += packets;
+  }
+
+  const PipelineProfiler::stage_stats&
+    PipelineProfiler::GetStats(Stage stage) const
+  {
+    return m_stages[stage];
+  }
+
+  std::vector<uint32_t>
+    PipelineProfiler::GetPorts(void) const
+  {
+    std::vector<uint32_t> ports;
+    for (uint32_t port = 0; port < m_ports.size(); port++)
+    {
+      if (m_ports[port].used)
+      {
+        ports.push_back(port);
+      }
+    }
+    if (m_internal.used)
+    {
+      ports.push_back(NO_PORT);
+    }
+    return ports;
+  }
+
+  const PipelineProfiler::stage_stats&
+    PipelineProfiler::GetPortStats(uint32_t port, Stage stage) const
+  {
+    static const stage_stats empty;
+    if (port == NO_PORT)
+    {
+      return m_internal.stages[stage];
+    }
+    if (port >= m_ports.size())
+    {
+      return empty;
+    }
+    return m_ports[port].stages[stage];
+  }
+
+  std::string
+    PipelineProfiler::ToTable(std::string switch_name) const
+  {
+    std::ostringstream out;
+    uint64_t total = 0;
+    for (int i = 0; i < STAGE_COUNT; i++)
+    {
+      total += m_stages[i].cycles;
+    }
+
+    out << "Pipeline profile for " << switch_name << std::endl;
+    out << std::left << std::setw(22) << "stage" << std::right << std::setw(12) << "packets"
+      << std::setw(16) << "cycles" << std::setw(12) << "cyc/pkt" << std::setw(8) << "%" << std::endl;
+    for (int i = 0; i < STAGE_COUNT; i++)
+    {
+      const stage_stats& stats = m_stages[i];
+      double per_packet = stats.packets ? double(stats.cycles) / stats.packets : 0;
+      double share = total ? 100.0 * stats.cycles / total : 0;
+      out << std::left << std::setw(22) << g_stageNames[i] << std::right << std::setw(12) << stats.packets
+        << std::setw(16) << stats.cycles << std::setw(12) << std::fixed << std::setprecision(1) << per_packet
+        << std::setw(8) << share << std::endl;
+    }
+
+    for (uint32_t port : GetPorts())
+    {
+      out << "  port " << port << ":";
+      for (int i = 0; i < STAGE_COUNT; i++)
+      {
+        const stage_stats& stats = GetPortStats(port, Stage(i));
+        if (stats.packets)
+        {
+          out << " " << g_stageNames[i] << "=" << stats.packets << "/" << stats.cycles;
+        }
+      }
+      out << std::endl;
+    }
+    return out.str();
+  }
+
+  std::string
+    PipelineProfiler::ToJson(std::string switch_name) const
+  {
+    json profile;
+    profile["switch"] = switch_name;
+    for (int i = 0; i < STAGE_COUNT; i++)
+    {
+      profile["stages"][g_stageNames[i]] = { {"packets", m_stages[i].packets}, {"cycles", m_stages[i].cycles} };
+    }
+    for (uint32_t port : GetPorts())
+    {
+      json stages;
+      for (int i = 0; i < STAGE_COUNT; i++)
+      {
+        const stage_stats& stats = GetPortStats(port, Stage(i));
+        stages[g_stageNames[i]] = { {"packets", stats.packets}, {"cycles", stats.cycles} };
+      }
+      profile["ports"][std::to_string(port)] = stages;
+    }
+    return profile.dump();
+  }
+
+} // namespace ns3
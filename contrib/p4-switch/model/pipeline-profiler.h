@@ -0,0 +1,127 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef PIPELINE_PROFILER_H
+#define PIPELINE_PROFILER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <chrono>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace ns3 {
+
+  /* Per stage cycle accounting of the switch pipeline.
+   *
+   * Stages call each other (the traffic manager runs the egress, which
+   * runs the deparser...), so time is charged exclusively: entering a
+   * stage pauses the one that called it. Cycles are TSC ticks on x86 and
+   * steady_clock nanoseconds elsewhere. Ports are the switch local port
+   * numbers (see P4SwitchNetDevice::GetPortNumber).
+   */
+  class PipelineProfiler
+  {
+  public:
+    enum Stage
+    {
+      STAGE_PARSER,
+      STAGE_INGRESS,
+      STAGE_TRAFFIC_MANAGER,
+      STAGE_EGRESS,
+      STAGE_UPDATE_CHECKSUMS,
+      STAGE_DEPARSER,
+      STAGE_EGRESS_TRAFFIC_MANAGER,
+      STAGE_COUNT
+    };
+
+    struct stage_stats
+    {
+      uint64_t cycles = 0;
+      uint64_t packets = 0;
+    };
+
+    /* Port used for packets generated inside the switch */
+    static constexpr uint32_t NO_PORT = 0xffffffff;
+
+    static const char* GetStageName(Stage stage);
+
+    static inline uint64_t ReadCycles(void)
+    {
+#if defined(__x86_64__) || defined(__i386__)
+      return __rdtsc();
+#else
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    void Enter(Stage stage, uint32_t port);
+    void Leave(void);
+
+    const stage_stats& GetStats(Stage stage) const;
+    /* Ports that went through at least one stage */
+    std::vector<uint32_t> GetPorts(void) const;
+    const stage_stats& GetPortStats(uint32_t port, Stage stage) const;
+
+    /* Human readable table */
+    std::string ToTable(std::string switch_name) const;
+    /* One JSON object, written as a single line */
+    std::string ToJson(std::string switch_name) const;
+
+  private:
+    struct port_stats
+    {
+      stage_stats stages[STAGE_COUNT];
+      bool used = false;
+    };
+
+    struct active_stage
+    {
+      Stage stage;
+      uint32_t port;
+      uint64_t start;
+    };
+
+    inline port_stats& GetPort(uint32_t port)
+    {
+      return port == NO_PORT ? m_internal : m_ports[port];
+    }
+    void Charge(const active_stage& active, uint64_t cycles, uint64_t packets);
+
+    stage_stats m_stages[STAGE_COUNT];
+    /* Indexed by port number, grown when a port is first seen */
+    std::vector<port_stats> m_ports;
+    port_stats m_internal;
+    std::vector<active_stage> m_active;
+  };
+
+  /* Scope guard used by the pipeline, does nothing without a profiler */
+  class PipelineStageScope
+  {
+  public:
+    PipelineStageScope(PipelineProfiler* profiler, PipelineProfiler::Stage stage, uint32_t port)
+      : m_profiler(profiler)
+    {
+      if (m_profiler)
+      {
+        m_profiler->Enter(stage, port);
+      }
+    }
+
+    ~PipelineStageScope()
+    {
+      if (m_profiler)
+      {
+        m_profiler->Leave();
+      }
+    }
+
+  private:
+    PipelineProfiler* m_profiler;
+  };
+
+} // namespace ns3
+
+#endif /* PIPELINE_PROFILER_H */
@@ -0,0 +1,965 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "ns3/l2-learning-table.h"
+#include "ns3/lpm-table.h"
+#include "ns3/nat-table.h"
+#include "ns3/p4-switch-fancy.h"
+#include "ns3/p4-switch-helper.h"
+#include "ns3/p4-switch-loss-radar.h"
+#include "ns3/p4-switch-nat.h"
+#include "ns3/p4-switch-net-seer.h"
+#include "ns3/p4-switch-utils.h"
+#include "ns3/pipeline-profiler.h"
+
+#include "ns3/boolean.h"
+#include "ns3/csma-helper.h"
+#include "ns3/double.h"
+#include "ns3/enum.h"
+#include "ns3/ethernet-header.h"
+#include "ns3/ethernet-trailer.h"
+#include "ns3/global-value.h"
+#include "ns3/internet-stack-helper.h"
+#include "ns3/ipv4-address-helper.h"
+#include "ns3/ipv4-header.h"
+#include "ns3/names.h"
+#include "ns3/simulator.h"
+#include "ns3/string.h"
+#include "ns3/tcp-header.h"
+#include "ns3/udp-header.h"
+#include "ns3/uinteger.h"
+
+#include "ns3/test.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace ns3;
+
+// Longest prefix match against a linear scan of the routes
+class LpmTableTestCase : public TestCase
+{
+public:
+  LpmTableTestCase (bool compact);
+  virtual ~LpmTableTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  // (length, prefix) -> next hop
+  typedef std::map<std::pair<uint8_t, uint32_t>, uint16_t> RouteMap;
+
+  uint16_t ReferenceLookup (uint32_t addr) const;
+  void CheckLookups (const LpmTable &table, std::mt19937 &rng, const std::string &phase);
+  void AddRandomRoutes (LpmTable &table, std::mt19937 &rng, uint32_t count,
+                        uint8_t minLength, uint8_t maxLength);
+
+  RouteMap m_routes;
+  bool m_compact;
+};
+
+// Routes are drawn in 10.0.0.0/14, so that they overlap a lot
+static const uint32_t LPM_BASE = 0x0a000000;
+static const uint8_t LPM_SPACE_LENGTH = 14;
+
+LpmTableTestCase::LpmTableTestCase (bool compact)
+  : TestCase (std::string ("LPM table lookups match a linear longest prefix match")
+              + (compact ? " (compact)" : "")),
+    m_compact (compact)
+{
+}
+
+LpmTableTestCase::~LpmTableTestCase ()
+{
+}
+
+uint16_t
+LpmTableTestCase::ReferenceLookup (uint32_t addr) const
+{
+  int bestLength = -1;
+  uint16_t best = LpmTable::NO_ROUTE;
+  for (RouteMap::const_iterator it = m_routes.begin (); it != m_routes.end (); ++it)
+    {
+      uint8_t length = it->first.first;
+      if ((addr & LpmTable::Mask (length)) == it->first.second && length > bestLength)
+        {
+          bestLength = length;
+          best = it->second;
+        }
+    }
+  return best;
+}
+
+void
+LpmTableTestCase::CheckLookups (const LpmTable &table, std::mt19937 &rng, const std::string &phase)
+{
+  std::vector<uint32_t> addrs;
+  for (RouteMap::const_iterator it = m_routes.begin (); it != m_routes.end (); ++it)
+    {
+      uint32_t first = it->first.second;
+      uint32_t last = first | ~LpmTable::Mask (it->first.first);
+      addrs.push_back (first);
+      addrs.push_back (last);
+      addrs.push_back (first - 1);
+      addrs.push_back (last + 1);
+      addrs.push_back (first + rng () % (last - first + 1));
+    }
+  for (uint32_t i = 0; i < 2000; i++)
+    {
+      addrs.push_back (LPM_BASE + rng () % (1 << (32 - LPM_SPACE_LENGTH)));
+    }
+
+  NS_TEST_EXPECT_MSG_EQ (table.GetNRoutes (), m_routes.size (), phase << ": bad number of routes");
+  for (std::vector<uint32_t>::const_iterator it = addrs.begin (); it != addrs.end (); ++it)
+    {
+      NS_TEST_ASSERT_MSG_EQ (table.Lookup (*it), ReferenceLookup (*it),
+                             phase << ": bad next hop for " << std::hex << *it);
+    }
+}
+
+void
+LpmTableTestCase::AddRandomRoutes (LpmTable &table, std::mt19937 &rng, uint32_t count,
+                                   uint8_t minLength, uint8_t maxLength)
+{
+  std::vector<LpmTable::lpm_route> routes;
+  for (uint32_t i = 0; i < count; i++)
+    {
+      uint8_t length = minLength + rng () % (maxLength - minLength + 1);
+      uint32_t prefix = (LPM_BASE + rng () % (1 << (32 - LPM_SPACE_LENGTH))) & LpmTable::Mask (length);
+      uint16_t nextHop = 1 + rng () % LpmTable::MAX_NEXT_HOP;
+      routes.push_back ({ prefix, length, nextHop });
+      m_routes[std::make_pair (length, prefix)] = nextHop;
+    }
+  // a route repeated in the batch keeps its last next hop
+  table.Insert (routes);
+}
+
+void
+LpmTableTestCase::DoRun (void)
+{
+  std::mt19937 rng (1);
+  LpmTable table;
+  table.SetCompact (m_compact);
+  NS_TEST_ASSERT_MSG_EQ (table.Lookup (LPM_BASE), LpmTable::NO_ROUTE, "route in an empty table");
+
+  // host and longer than /24 routes only, without tbl24 if compact
+  AddRandomRoutes (table, rng, 300, 25, 32);
+  CheckLookups (table, rng, "long routes");
+
+  // removing all the routes of a /24 frees its group
+  uint32_t groups = table.GetNGroups ();
+  std::vector<std::pair<uint8_t, uint32_t> > removed;
+  uint32_t index24 = m_routes.begin ()->first.second >> 8;
+  for (RouteMap::const_iterator it = m_routes.begin (); it != m_routes.end (); ++it)
+    {
+      if (it->first.second >> 8 == index24)
+        {
+          removed.push_back (it->first);
+        }
+    }
+  for (uint32_t i = 0; i < removed.size (); i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (table.Remove (removed[i].second, removed[i].first), true, "route not removed");
+      m_routes.erase (removed[i]);
+    }
+  NS_TEST_ASSERT_MSG_EQ (table.GetNGroups (), groups - 1, "group of an empty /24 not freed");
+  NS_TEST_ASSERT_MSG_EQ (table.Remove (removed[0].second, removed[0].first), false, "removed route removed again");
+  CheckLookups (table, rng, "long routes removed");
+
+  // covering routes, which keep the longer routes (and allocate tbl24 if compact)
+  AddRandomRoutes (table, rng, 200, 8, 24);
+  CheckLookups (table, rng, "all lengths");
+  AddRandomRoutes (table, rng, 300, 16, 32);
+  CheckLookups (table, rng, "replaced and more routes");
+
+  // removals in random order, one by one and batched
+  std::vector<std::pair<uint8_t, uint32_t> > keys;
+  for (RouteMap::const_iterator it = m_routes.begin (); it != m_routes.end (); ++it)
+    {
+      keys.push_back (it->first);
+    }
+  std::shuffle (keys.begin (), keys.end (), rng);
+  uint32_t half = keys.size () / 2;
+  for (uint32_t i = 0; i < half; i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (table.Remove (keys[i].second, keys[i].first), true, "route not removed");
+      m_routes.erase (keys[i]);
+      if (i % 50 == 0)
+        {
+          CheckLookups (table, rng, "one by one removals");
+        }
+    }
+  CheckLookups (table, rng, "one by one removals");
+  std::vector<LpmTable::lpm_route> batch;
+  for (uint32_t i = half; i < keys.size (); i++)
+    {
+      batch.push_back ({ keys[i].second, keys[i].first, LpmTable::NO_ROUTE });
+      m_routes.erase (keys[i]);
+    }
+  table.Remove (batch);
+  CheckLookups (table, rng, "batched removals");
+  NS_TEST_ASSERT_MSG_EQ (table.GetNGroups (), 0, "groups left in an empty table");
+
+  table.Clear ();
+  NS_TEST_ASSERT_MSG_EQ (table.Lookup (LPM_BASE), LpmTable::NO_ROUTE, "route left after Clear");
+}
+
+// Streamed simulation state files are rebuilt as a single document on demand
+class SimulationStateWriterTestCase : public TestCase
+{
+public:
+  SimulationStateWriterTestCase ();
+  virtual ~SimulationStateWriterTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  uint32_t CountLines (std::string fileName);
+};
+
+SimulationStateWriterTestCase::SimulationStateWriterTestCase ()
+  : TestCase ("Simulation state NDJSON stream round trips to the JSON document")
+{
+}
+
+SimulationStateWriterTestCase::~SimulationStateWriterTestCase ()
+{
+}
+
+uint32_t
+SimulationStateWriterTestCase::CountLines (std::string fileName)
+{
+  std::ifstream in (fileName);
+  std::string line;
+  uint32_t lines = 0;
+  while (std::getline (in, line))
+    {
+      lines++;
+    }
+  return lines;
+}
+
+void
+SimulationStateWriterTestCase::DoRun (void)
+{
+  using nlohmann::json;
+
+  std::string jsonFile = CreateTempDirFilename ("state.json");
+  std::string streamFile = CreateTempDirFilename ("state.ndjson");
+  NS_TEST_ASSERT_MSG_EQ (SimulationStateWriter::GetStreamFileName (jsonFile), streamFile, "bad stream file name");
+  NS_TEST_ASSERT_MSG_EQ (SimulationStateWriter::GetStreamFileName (streamFile), streamFile, "bad stream file name");
+
+  SimulationStateWriter writer;
+  writer.Open (jsonFile);
+  writer.WriteRecord ("{\"type\":\"steps\",\"time\":1.5,\"counters\":[1,2]}");
+  writer.WriteRecord ("{\"type\":\"failures\",\"prefix\":\"10.0.0.0\",\"timestamp\":2}");
+  writer.WriteRecord ("{\"type\":\"steps\",\"time\":2.5,\"counters\":[3]}");
+  writer.WriteRecord ("{\"type\":\"soft_failures\",\"soft_type\":\"gray\",\"link\":\"s1->s2\"}");
+  // records are readable while the run goes on
+  NS_TEST_ASSERT_MSG_EQ (CountLines (streamFile), 4, "records not flushed");
+  writer.Close ();
+  NS_TEST_ASSERT_MSG_EQ (std::filesystem::exists (jsonFile), false, "document rebuilt without being asked");
+
+  // every collection is written, null when empty as in the old documents
+  ConvertSimulationStateToJson (streamFile, jsonFile, FancySimulationState::GetCollections ());
+  std::ifstream in (jsonFile);
+  json state = json::parse (in);
+  json expected = json::parse (
+    "{\"collisions\":null,\"reroutes\":null,\"uniform_failures\":null,"
+    "\"steps\":[{\"time\":1.5,\"counters\":[1,2]},{\"time\":2.5,\"counters\":[3]}],"
+    "\"failures\":[{\"prefix\":\"10.0.0.0\",\"timestamp\":2}],"
+    "\"soft_failures\":[{\"type\":\"gray\",\"link\":\"s1->s2\"}]}");
+  NS_TEST_ASSERT_MSG_EQ (state, expected, "document differs from the streamed records");
+
+  // a branch continues with the records written so far
+  std::string branchFile = CreateTempDirFilename ("branch.json");
+  writer.Open (jsonFile);
+  writer.WriteRecord ("{\"type\":\"reroutes\",\"time\":1}");
+  writer.Branch (branchFile);
+  writer.WriteRecord ("{\"type\":\"reroutes\",\"time\":2}");
+  writer.Close ();
+  NS_TEST_ASSERT_MSG_EQ (CountLines (streamFile), 1, "branch records written to the shared part");
+  std::string branchStream = SimulationStateWriter::GetStreamFileName (branchFile);
+  NS_TEST_ASSERT_MSG_EQ (CountLines (branchStream), 2, "branch stream incomplete");
+  ConvertSimulationStateToJson (branchStream, branchFile, NetSeerSimulationState::GetCollections ());
+  std::ifstream branchIn (branchFile);
+  json branch = json::parse (branchIn);
+  NS_TEST_ASSERT_MSG_EQ (branch, json::parse ("{\"failures\":null,\"reroutes\":[{\"time\":1},{\"time\":2}]}"),
+                         "branch document incomplete");
+}
+
+// MAC learning, backward shift deletion and aging of the learning table
+class L2LearningTableTestCase : public TestCase
+{
+public:
+  L2LearningTableTestCase ();
+  virtual ~L2LearningTableTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  void CheckEntries (const L2LearningTable &table, const std::string &phase);
+
+  // mac -> port, NO_PORT for the forgotten ones
+  std::map<uint64_t, uint32_t> m_macs;
+};
+
+L2LearningTableTestCase::L2LearningTableTestCase ()
+  : TestCase ("L2 learning table lookups, deletion and aging")
+{
+}
+
+L2LearningTableTestCase::~L2LearningTableTestCase ()
+{
+}
+
+void
+L2LearningTableTestCase::CheckEntries (const L2LearningTable &table, const std::string &phase)
+{
+  uint32_t learnt = 0;
+  for (std::map<uint64_t, uint32_t>::const_iterator it = m_macs.begin (); it != m_macs.end (); ++it)
+    {
+      NS_TEST_ASSERT_MSG_EQ (table.Lookup (it->first), it->second,
+                             phase << ": bad port for " << std::hex << it->first);
+      if (it->second != L2LearningTable::NO_PORT)
+        {
+          learnt++;
+        }
+    }
+  NS_TEST_EXPECT_MSG_EQ (table.GetSize (), learnt, phase << ": bad number of entries");
+}
+
+void
+L2LearningTableTestCase::DoRun (void)
+{
+  const uint32_t slots = 4;
+  const uint32_t count = 1000;
+  std::mt19937_64 rng (1);
+  L2LearningTable table (slots);
+  NS_TEST_ASSERT_MSG_EQ (table.GetWheelSlots (), slots, "bad number of wheel slots");
+
+  std::vector<uint64_t> macs;
+  while (macs.size () < count)
+    {
+      uint64_t mac = rng () & 0xffffffffffffULL;
+      if (m_macs.insert (std::make_pair (mac, L2LearningTable::NO_PORT)).second)
+        {
+          macs.push_back (mac);
+        }
+    }
+  // unknown MACs, looked up at every check
+  for (uint32_t i = 0; i < 100; i++)
+    {
+      m_macs.insert (std::make_pair (rng () & 0xffffffffffffULL, L2LearningTable::NO_PORT));
+    }
+  CheckEntries (table, "empty table");
+
+  // the table starts with 64 entries and grows several times
+  for (uint32_t i = 0; i < count; i++)
+    {
+      m_macs[macs[i]] = i % 48;
+      table.Learn (macs[i], i % 48);
+    }
+  CheckEntries (table, "grown table");
+  // moves to another port in the same tick
+  for (uint32_t i = 0; i < count; i += 3)
+    {
+      m_macs[macs[i]] = 47 - m_macs[macs[i]];
+      table.Learn (macs[i], m_macs[macs[i]]);
+    }
+  CheckEntries (table, "moved MACs");
+
+  // even MACs are refreshed at every tick, odd MACs are forgotten exactly
+  // wheel_slots + 1 ticks after they were learnt
+  for (uint32_t tick = 1; tick <= slots; tick++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (table.Tick (), 0, "entry expired at tick " << tick);
+      for (uint32_t i = 0; i < count; i += 2)
+        {
+          table.Learn (macs[i], m_macs[macs[i]]);
+        }
+    }
+  CheckEntries (table, "before expiration");
+  NS_TEST_ASSERT_MSG_EQ (table.Tick (), count / 2, "odd MACs not expired");
+  // the removed entries are spread over the probe sequences of the others
+  for (uint32_t i = 1; i < count; i += 2)
+    {
+      m_macs[macs[i]] = L2LearningTable::NO_PORT;
+    }
+  CheckEntries (table, "odd MACs expired");
+
+  // learnt again in the holes left by the deletions
+  for (uint32_t i = 1; i < count; i += 4)
+    {
+      m_macs[macs[i]] = i % 48;
+      table.Learn (macs[i], i % 48);
+    }
+  CheckEntries (table, "relearnt MACs");
+
+  // even MACs were last refreshed at tick slots, the relearnt ones at
+  // tick slots + 1
+  for (uint32_t tick = slots + 2; tick < 2 * slots + 1; tick++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (table.Tick (), 0, "entry expired at tick " << tick);
+    }
+  CheckEntries (table, "stale wheel records");
+  NS_TEST_ASSERT_MSG_EQ (table.Tick (), count / 2, "even MACs not expired");
+  NS_TEST_ASSERT_MSG_EQ (table.Tick (), count / 4, "relearnt MACs not expired");
+  NS_TEST_ASSERT_MSG_EQ (table.GetSize (), 0, "entries left after expiration");
+  for (uint32_t i = 0; i < count; i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (table.Lookup (macs[i]), L2LearningTable::NO_PORT, "expired MAC found");
+    }
+
+  table.Learn (macs[0], 1);
+  table.Clear ();
+  NS_TEST_ASSERT_MSG_EQ (table.GetSize (), 0, "entries left after Clear");
+  NS_TEST_ASSERT_MSG_EQ (table.Lookup (macs[0]), L2LearningTable::NO_PORT, "MAC found after Clear");
+}
+
+// Translation lookups, refresh, expiration and growth of the NAT table
+class NatTableTestCase : public TestCase
+{
+public:
+  NatTableTestCase ();
+  virtual ~NatTableTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  void AddFlows (NatTable &table, std::mt19937 &rng, uint32_t count);
+  // Looks up every flow, which refreshes the known ones
+  void CheckFlows (NatTable &table, const std::string &phase);
+
+  std::vector<flow_key> m_flows;
+  // original ip of the known flows
+  std::unordered_map<flow_key, uint32_t, flow_key_hash> m_ips;
+};
+
+NatTableTestCase::NatTableTestCase ()
+  : TestCase ("NAT table lookups, expiration and growth")
+{
+}
+
+NatTableTestCase::~NatTableTestCase ()
+{
+}
+
+void
+NatTableTestCase::AddFlows (NatTable &table, std::mt19937 &rng, uint32_t count)
+{
+  for (uint32_t i = 0; i < count; i++)
+    {
+      flow_key key;
+      key.src_ip = rng ();
+      key.dst_ip = rng ();
+      // unique flows
+      key.src_port = m_flows.size ();
+      key.dst_port = 80;
+      key.protocol = 6;
+      m_flows.push_back (key);
+      m_ips[key] = rng ();
+      table.Insert (key, m_ips[key]);
+    }
+}
+
+void
+NatTableTestCase::CheckFlows (NatTable &table, const std::string &phase)
+{
+  NS_TEST_EXPECT_MSG_EQ (table.GetSize (), m_ips.size (), phase << ": bad number of translations");
+  for (uint32_t i = 0; i < m_flows.size (); i++)
+    {
+      uint32_t ip = 0;
+      bool known = m_ips.count (m_flows[i]) > 0;
+      NS_TEST_ASSERT_MSG_EQ (table.Lookup (m_flows[i], ip), known,
+                             phase << ": bad lookup of " << FlowKeyToString (m_flows[i]));
+      if (known)
+        {
+          NS_TEST_ASSERT_MSG_EQ (ip, m_ips[m_flows[i]],
+                                 phase << ": bad ip for " << FlowKeyToString (m_flows[i]));
+        }
+    }
+}
+
+void
+NatTableTestCase::DoRun (void)
+{
+  const uint32_t slots = 4;
+  std::mt19937 rng (1);
+  NatTable table (64, slots);
+  NS_TEST_ASSERT_MSG_EQ (table.GetWheelSlots (), slots, "bad number of wheel slots");
+
+  AddFlows (table, rng, 64);
+  NS_TEST_ASSERT_MSG_EQ (table.GetCapacity (), 64, "table grown before it was full");
+  CheckFlows (table, "full table");
+  // the pool doubles, the index is rebuilt around the used slots
+  AddFlows (table, rng, 236);
+  NS_TEST_ASSERT_MSG_EQ (table.GetCapacity (), 512, "table not grown");
+  CheckFlows (table, "grown table");
+  // Insert updates the known translations
+  for (uint32_t i = 0; i < m_flows.size (); i += 3)
+    {
+      m_ips[m_flows[i]]++;
+      table.Insert (m_flows[i], m_ips[m_flows[i]]);
+    }
+  NS_TEST_ASSERT_MSG_EQ (table.GetSize (), m_flows.size (), "updated translations added again");
+
+  // even flows are looked up at every tick, odd flows expire exactly
+  // wheel_slots + 1 ticks after they were last used
+  for (uint32_t tick = 1; tick <= slots; tick++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (table.Tick (), 0, "translation expired at tick " << tick);
+      for (uint32_t i = 0; i < m_flows.size (); i += 2)
+        {
+          uint32_t ip;
+          NS_TEST_ASSERT_MSG_EQ (table.Lookup (m_flows[i], ip), true, "refreshed translation lost");
+        }
+    }
+  NS_TEST_ASSERT_MSG_EQ (table.Tick (), m_flows.size () / 2, "odd flows not expired");
+  for (uint32_t i = 1; i < m_flows.size (); i += 2)
+    {
+      m_ips.erase (m_flows[i]);
+    }
+  // the removed positions are spread over the probe sequences of the others
+  CheckFlows (table, "odd flows expired");
+
+  // new flows reuse the freed slots, then grow the pool while its used
+  // slots are scattered
+  AddFlows (table, rng, 150);
+  NS_TEST_ASSERT_MSG_EQ (table.GetCapacity (), 512, "table grown with free slots");
+  CheckFlows (table, "freed slots reused");
+  AddFlows (table, rng, 300);
+  NS_TEST_ASSERT_MSG_EQ (table.GetCapacity (), 1024, "table not grown");
+  CheckFlows (table, "table grown again");
+
+  // without lookups everything expires, the stale wheel records are skipped
+  for (uint32_t tick = 1; tick <= slots; tick++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (table.Tick (), 0, "translation expired at tick " << tick);
+    }
+  NS_TEST_ASSERT_MSG_EQ (table.Tick (), m_ips.size (), "translations not expired");
+  m_ips.clear ();
+  CheckFlows (table, "all flows expired");
+
+  AddFlows (table, rng, 10);
+  table.Clear ();
+  m_ips.clear ();
+  CheckFlows (table, "cleared table");
+  NS_TEST_ASSERT_MSG_EQ (table.GetCapacity (), 1024, "capacity lost by Clear");
+}
+
+// Exclusive per stage and per port accounting of the pipeline profiler
+class PipelineProfilerTestCase : public TestCase
+{
+public:
+  PipelineProfilerTestCase ();
+  virtual ~PipelineProfilerTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  // Busy waits for at least the given number of cycles
+  static void Spin (uint64_t cycles);
+};
+
+PipelineProfilerTestCase::PipelineProfilerTestCase ()
+  : TestCase ("Pipeline profiler stage counts and exclusive times")
+{
+}
+
+PipelineProfilerTestCase::~PipelineProfilerTestCase ()
+{
+}
+
+void
+PipelineProfilerTestCase::Spin (uint64_t cycles)
+{
+  uint64_t start = PipelineProfiler::ReadCycles ();
+  while (PipelineProfiler::ReadCycles () - start < cycles)
+    {
+    }
+}
+
+void
+PipelineProfilerTestCase::DoRun (void)
+{
+  const uint64_t outer = 20000;
+  const uint64_t inner = 50000;
+  const uint32_t packets = 10;
+  PipelineProfiler profiler;
+
+  // ingress on port 0 calls the traffic manager of port 2, which calls
+  // the deparser of a packet generated inside the switch
+  uint64_t start = PipelineProfiler::ReadCycles ();
+  for (uint32_t i = 0; i < packets; i++)
+    {
+      PipelineStageScope ingress (&profiler, PipelineProfiler::STAGE_INGRESS, 0);
+      Spin (outer);
+      {
+        PipelineStageScope trafficManager (&profiler, PipelineProfiler::STAGE_TRAFFIC_MANAGER, 2);
+        Spin (inner);
+        {
+          PipelineStageScope deparser (&profiler, PipelineProfiler::STAGE_DEPARSER, PipelineProfiler::NO_PORT);
+          Spin (inner);
+        }
+        Spin (inner);
+      }
+      Spin (outer);
+    }
+  uint64_t elapsed = PipelineProfiler::ReadCycles () - start;
+  PipelineStageScope disabled (0, PipelineProfiler::STAGE_PARSER, 1);
+
+  const PipelineProfiler::stage_stats &ingress = profiler.GetStats (PipelineProfiler::STAGE_INGRESS);
+  const PipelineProfiler::stage_stats &trafficManager = profiler.GetStats (PipelineProfiler::STAGE_TRAFFIC_MANAGER);
+  const PipelineProfiler::stage_stats &deparser = profiler.GetStats (PipelineProfiler::STAGE_DEPARSER);
+  NS_TEST_EXPECT_MSG_EQ (ingress.packets, packets, "bad ingress packets");
+  NS_TEST_EXPECT_MSG_EQ (trafficManager.packets, packets, "bad traffic manager packets");
+  NS_TEST_EXPECT_MSG_EQ (deparser.packets, packets, "bad deparser packets");
+  NS_TEST_EXPECT_MSG_EQ (profiler.GetStats (PipelineProfiler::STAGE_PARSER).packets, 0, "stage counted without a profiler");
+
+  // each stage spent at least its own spins, and the called stages are not
+  // charged to their callers again
+  NS_TEST_EXPECT_MSG_GT_OR_EQ (ingress.cycles, packets * 2 * outer, "ingress time too short");
+  NS_TEST_EXPECT_MSG_GT_OR_EQ (trafficManager.cycles, packets * 2 * inner, "traffic manager time too short");
+  NS_TEST_EXPECT_MSG_GT_OR_EQ (deparser.cycles, packets * inner, "deparser time too short");
+  uint64_t charged = 0;
+  for (int i = 0; i < PipelineProfiler::STAGE_COUNT; i++)
+    {
+      charged += profiler.GetStats (PipelineProfiler::Stage (i)).cycles;
+    }
+  NS_TEST_EXPECT_MSG_LT_OR_EQ (charged, elapsed, "time charged to more than one stage");
+
+  // the per port stats split the same counts
+  std::vector<uint32_t> ports = profiler.GetPorts ();
+  NS_TEST_ASSERT_MSG_EQ (ports.size (), 3, "bad number of ports");
+  NS_TEST_EXPECT_MSG_EQ (ports[0], 0, "bad port");
+  NS_TEST_EXPECT_MSG_EQ (ports[1], 2, "bad port");
+  NS_TEST_EXPECT_MSG_EQ (ports[2], PipelineProfiler::NO_PORT, "bad port");
+  NS_TEST_EXPECT_MSG_EQ (profiler.GetPortStats (0, PipelineProfiler::STAGE_INGRESS).cycles, ingress.cycles,
+                         "bad port 0 ingress time");
+  NS_TEST_EXPECT_MSG_EQ (profiler.GetPortStats (2, PipelineProfiler::STAGE_TRAFFIC_MANAGER).packets, packets,
+                         "bad port 2 traffic manager packets");
+  NS_TEST_EXPECT_MSG_EQ (profiler.GetPortStats (PipelineProfiler::NO_PORT, PipelineProfiler::STAGE_DEPARSER).cycles,
+                         deparser.cycles, "bad internal deparser time");
+  NS_TEST_EXPECT_MSG_EQ (profiler.GetPortStats (0, PipelineProfiler::STAGE_DEPARSER).packets, 0,
+                         "stage charged to the wrong port");
+  NS_TEST_EXPECT_MSG_EQ (profiler.GetPortStats (1, PipelineProfiler::STAGE_INGRESS).packets, 0,
+                         "stage charged to an unused port");
+  NS_TEST_EXPECT_MSG_EQ (profiler.GetPortStats (7, PipelineProfiler::STAGE_INGRESS).packets, 0,
+                         "stage charged to an unknown port");
+
+  nlohmann::json profile = nlohmann::json::parse (profiler.ToJson ("s1"));
+  NS_TEST_EXPECT_MSG_EQ (profile["stages"]["Egress"]["packets"], 0, "bad JSON profile");
+  NS_TEST_EXPECT_MSG_EQ (profile["ports"]["2"]["TrafficManager"]["cycles"], trafficManager.cycles,
+                         "bad JSON profile");
+  NS_TEST_EXPECT_MSG_EQ (profile["ports"].size (), 3, "bad JSON profile");
+}
+
+// The zero copy pipeline sends the same bytes as deparsing every header
+class ZeroCopyPipelineTestCase : public TestCase
+{
+public:
+  ZeroCopyPipelineTestCase ();
+  virtual ~ZeroCopyPipelineTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  typedef std::vector<std::vector<uint8_t> > Frames;
+
+  // Frames received behind the switches, with the given pipeline
+  Frames RunForwarding (std::string switchType, bool zeroCopy, std::string topFile);
+  Frames RunNat (bool zeroCopy);
+
+  // IPv4 packet of the given transport protocol (6 or 17)
+  static Ptr<Packet> MakePacket (uint8_t protocol, Ipv4Address src, Ipv4Address dst,
+                                 uint16_t srcPort, uint16_t dstPort, uint32_t payload, bool checksums);
+  // Saves the frame without its Ethernet header and trailer, the MAC
+  // addresses are allocated again by every run. The tag tells the links apart
+  static void Capture (Frames *frames, uint8_t tag, Ptr<const Packet> packet);
+  void Compare (const Frames &deparsed, const Frames &zeroCopy, std::string switchType);
+};
+
+ZeroCopyPipelineTestCase::ZeroCopyPipelineTestCase ()
+  : TestCase ("Zero copy pipeline output matches the deparsed output")
+{
+}
+
+ZeroCopyPipelineTestCase::~ZeroCopyPipelineTestCase ()
+{
+}
+
+Ptr<Packet>
+ZeroCopyPipelineTestCase::MakePacket (uint8_t protocol, Ipv4Address src, Ipv4Address dst,
+                                      uint16_t srcPort, uint16_t dstPort, uint32_t payload, bool checksums)
+{
+  Ptr<Packet> packet = Create<Packet> (payload);
+  if (protocol == 6)
+    {
+      TcpHeader tcp;
+      tcp.SetSourcePort (srcPort);
+      tcp.SetDestinationPort (dstPort);
+      tcp.SetSequenceNumber (SequenceNumber32 (srcPort * 1000));
+      tcp.SetFlags (TcpHeader::ACK);
+      if (checksums)
+        {
+          tcp.EnableChecksums ();
+          tcp.InitializeChecksum (src, dst, protocol);
+        }
+      packet->AddHeader (tcp);
+    }
+  else
+    {
+      UdpHeader udp;
+      udp.SetSourcePort (srcPort);
+      udp.SetDestinationPort (dstPort);
+      if (checksums)
+        {
+          udp.EnableChecksums ();
+          udp.InitializeChecksum (src, dst, protocol);
+        }
+      packet->AddHeader (udp);
+    }
+  Ipv4Header ipv4;
+  ipv4.SetSource (src);
+  ipv4.SetDestination (dst);
+  ipv4.SetProtocol (protocol);
+  ipv4.SetPayloadSize (packet->GetSize ());
+  ipv4.SetTtl (64);
+  if (checksums)
+    {
+      ipv4.EnableChecksum ();
+    }
+  packet->AddHeader (ipv4);
+  return packet;
+}
+
+void
+ZeroCopyPipelineTestCase::Capture (Frames *frames, uint8_t tag, Ptr<const Packet> packet)
+{
+  Ptr<Packet> copy = packet->Copy ();
+  EthernetHeader ethernet (false);
+  copy->RemoveHeader (ethernet);
+  EthernetTrailer trailer;
+  copy->RemoveTrailer (trailer);
+  std::vector<uint8_t> frame (copy->GetSize () + 1);
+  frame[0] = tag;
+  copy->CopyData (frame.data () + 1, copy->GetSize ());
+  frames->push_back (frame);
+}
+
+ZeroCopyPipelineTestCase::Frames
+ZeroCopyPipelineTestCase::RunForwarding (std::string switchType, bool zeroCopy, std::string topFile)
+{
+  const uint32_t flows = 12;
+  const uint32_t packets = 60;
+  Frames frames;
+  GlobalValue::Bind ("switchId", UintegerValue (1));
+
+  // h0 - s1 - s2 - r0, as in the p4-switch benchmark
+  NodeContainer nodes;
+  nodes.Create (4);
+  Names::Add ("h0", nodes.Get (0));
+  Names::Add ("s1", nodes.Get (1));
+  Names::Add ("s2", nodes.Get (2));
+  Names::Add ("r0", nodes.Get (3));
+
+  CsmaHelper csma;
+  csma.SetChannelAttribute ("DataRate", DataRateValue (DataRate ("10Gbps")));
+  csma.SetChannelAttribute ("Delay", TimeValue (MicroSeconds (1)));
+  csma.SetChannelAttribute ("FullDuplex", BooleanValue (true));
+  NetDeviceContainer link0 = csma.Install (NodeContainer (nodes.Get (0), nodes.Get (1)));
+  NetDeviceContainer link1 = csma.Install (NodeContainer (nodes.Get (1), nodes.Get (2)));
+  NetDeviceContainer link2 = csma.Install (NodeContainer (nodes.Get (2), nodes.Get (3)));
+
+  InternetStackHelper internet;
+  internet.Install (NodeContainer (nodes.Get (0), nodes.Get (3)));
+  Ipv4AddressHelper ipv4 ("10.0.0.0", "255.255.255.0");
+  ipv4.Assign (NetDeviceContainer (link0.Get (0), link2.Get (1)));
+
+  P4SwitchHelper helper ("ns3::P4Switch" + switchType);
+  helper.SetDeviceAttribute ("EnableDebug", BooleanValue (false));
+  helper.SetDeviceAttribute ("FailDropRate", DoubleValue (1));
+  helper.SetDeviceAttribute ("ForwardingType", EnumValue (P4SwitchNetDevice::ForwardingType::L3_SPECIAL_FORWARDING));
+  helper.SetDeviceAttribute ("ZeroCopyPipeline", BooleanValue (zeroCopy));
+  std::vector<Ptr<P4SwitchNetDevice> > switches;
+  for (uint32_t i = 1; i <= 2; i++)
+    {
+      NetDeviceContainer ports (i == 1 ? link0.Get (1) : link1.Get (1), i == 1 ? link1.Get (0) : link2.Get (0));
+      NetDeviceContainer device;
+      if (switchType == "Fancy")
+        {
+          helper.SetDeviceAttribute ("NumTopEntries", UintegerValue (0));
+          helper.SetDeviceAttribute ("TopFile", StringValue (topFile));
+          device = helper.Install<P4SwitchFancy> (nodes.Get (i), ports);
+        }
+      else if (switchType == "LossRadar")
+        {
+          device = helper.Install<P4SwitchLossRadar> (nodes.Get (i), ports);
+        }
+      else
+        {
+          device = helper.Install<P4SwitchNetSeer> (nodes.Get (i), ports);
+        }
+      switches.push_back (DynamicCast<P4SwitchNetDevice> (device.Get (0)));
+    }
+
+  // s2 routes every flow to r0, s1 blackholes one flow in three
+  std::vector<std::pair<uint32_t, Ptr<NetDevice> > > routes;
+  std::vector<std::pair<uint32_t, Ptr<NetDevice> > > failures;
+  for (uint32_t i = 0; i < flows; i++)
+    {
+      uint32_t dst = (20u << 24) | ((i + 1) << 8) | 1;
+      routes.push_back (std::make_pair (dst, link2.Get (0)));
+      if (i % 3 == 0)
+        {
+          failures.push_back (std::make_pair (dst, Ptr<NetDevice> ()));
+        }
+    }
+  switches[1]->L3SpecialForwardingRemoveFailures (routes);
+  switches[0]->L3SpecialForwardingSetFailures (failures);
+
+  link1.Get (1)->TraceConnectWithoutContext ("PhyRxEnd", MakeBoundCallback (&Capture, &frames, 1));
+  link2.Get (1)->TraceConnectWithoutContext ("PhyRxEnd", MakeBoundCallback (&Capture, &frames, 2));
+
+  // TCP and UDP flows with zero checksums: a switch that leaves a header
+  // untouched forwards its received checksum in zero copy mode, but the
+  // deparser writes the IPv4 and TCP ones as zero
+  Ipv4Address src = nodes.Get (0)->GetObject<Ipv4> ()->GetAddress (1, 0).GetLocal ();
+  for (uint32_t i = 0; i < packets; i++)
+    {
+      uint32_t flow = i % flows;
+      Ptr<Packet> packet = MakePacket (flow % 2 ? 6 : 17, src, Ipv4Address ((20u << 24) | ((flow + 1) << 8) | 1),
+                                       1024 + flow, 7000, 100 + i, false);
+      Simulator::Schedule (MicroSeconds (10 * i), &NetDevice::Send, link0.Get (0), packet,
+                           link0.Get (1)->GetAddress (), 0x0800);
+    }
+
+  Simulator::Stop (MilliSeconds (20));
+  Simulator::Run ();
+  Simulator::Destroy ();
+  Names::Clear ();
+  return frames;
+}
+
+ZeroCopyPipelineTestCase::Frames
+ZeroCopyPipelineTestCase::RunNat (bool zeroCopy)
+{
+  const uint32_t flows = 8;
+  Frames frames;
+  GlobalValue::Bind ("switchId", UintegerValue (1));
+
+  // h0 (private side) - n1 (NAT) - s2 (public side, any node named s)
+  NodeContainer nodes;
+  nodes.Create (3);
+  Names::Add ("h0", nodes.Get (0));
+  Names::Add ("n1", nodes.Get (1));
+  Names::Add ("s2", nodes.Get (2));
+
+  CsmaHelper csma;
+  csma.SetChannelAttribute ("DataRate", DataRateValue (DataRate ("10Gbps")));
+  csma.SetChannelAttribute ("Delay", TimeValue (MicroSeconds (1)));
+  csma.SetChannelAttribute ("FullDuplex", BooleanValue (true));
+  NetDeviceContainer link0 = csma.Install (NodeContainer (nodes.Get (0), nodes.Get (1)));
+  NetDeviceContainer link1 = csma.Install (NodeContainer (nodes.Get (1), nodes.Get (2)));
+
+  InternetStackHelper internet;
+  internet.Install (nodes.Get (0));
+  Ipv4AddressHelper ipv4 ("10.0.0.0", "255.255.255.0");
+  ipv4.Assign (NetDeviceContainer (link0.Get (0)));
+
+  P4SwitchHelper helper ("ns3::P4SwitchNAT");
+  helper.SetDeviceAttribute ("EnableDebug", BooleanValue (false));
+  helper.SetDeviceAttribute ("ForwardingType", EnumValue (P4SwitchNetDevice::ForwardingType::L2_FORWARDING));
+  helper.SetDeviceAttribute ("ZeroCopyPipeline", BooleanValue (zeroCopy));
+  helper.Install<P4SwitchNAT> (nodes.Get (1), NetDeviceContainer (link0.Get (1), link1.Get (0)));
+
+  link0.Get (0)->TraceConnectWithoutContext ("PhyRxEnd", MakeBoundCallback (&Capture, &frames, 0));
+  link1.Get (1)->TraceConnectWithoutContext ("PhyRxEnd", MakeBoundCallback (&Capture, &frames, 1));
+
+  // Requests to the public address are translated to h0 and the replies
+  // back, with valid checksums that the rewritten addresses invalidate
+  Ipv4Address publicIp ("30.0.0.1");
+  Ipv4Address privateIp = nodes.Get (0)->GetObject<Ipv4> ()->GetAddress (1, 0).GetLocal ();
+  for (uint32_t i = 0; i < flows; i++)
+    {
+      uint8_t protocol = i % 2 ? 6 : 17;
+      Ipv4Address client ((40u << 24) | (i + 1));
+      Ptr<Packet> request = MakePacket (protocol, client, publicIp, 1024 + i, 80, 100 + i, true);
+      Simulator::Schedule (MicroSeconds (10 * i), &NetDevice::Send, link1.Get (1), request,
+                           link1.Get (0)->GetAddress (), 0x0800);
+      Ptr<Packet> reply = MakePacket (protocol, privateIp, client, 80, 1024 + i, 200 + i, true);
+      Simulator::Schedule (MicroSeconds (10 * (flows + i)), &NetDevice::Send, link0.Get (0), reply,
+                           link0.Get (1)->GetAddress (), 0x0800);
+    }
+
+  Simulator::Stop (MilliSeconds (1));
+  Simulator::Run ();
+  Simulator::Destroy ();
+  Names::Clear ();
+  return frames;
+}
+
+void
+ZeroCopyPipelineTestCase::Compare (const Frames &deparsed, const Frames &zeroCopy, std::string switchType)
+{
+  NS_TEST_ASSERT_MSG_GT (deparsed.size (), 0, switchType << ": nothing forwarded");
+  NS_TEST_ASSERT_MSG_EQ (zeroCopy.size (), deparsed.size (), switchType << ": different number of frames");
+  for (uint32_t i = 0; i < deparsed.size (); i++)
+    {
+      NS_TEST_EXPECT_MSG_EQ ((zeroCopy[i] == deparsed[i]), true, switchType << ": frame " << i << " differs");
+    }
+}
+
+void
+ZeroCopyPipelineTestCase::DoRun (void)
+{
+  // Globals the switches expect
+  static GlobalValue g_switchId = GlobalValue ("switchId", "Global Switch Id", UintegerValue (1),
+                                               MakeUintegerChecker<uint8_t> ());
+  static GlobalValue g_debugGlobal = GlobalValue ("debugGlobal", "Is debug globally enabled?",
+                                                  BooleanValue (false), MakeBooleanChecker ());
+  std::string topFile = CreateTempDirFilename ("top.txt");
+  std::ofstream (topFile).close ();
+
+  for (std::string switchType : {"Fancy", "LossRadar", "NetSeer"})
+    {
+      Frames deparsed = RunForwarding (switchType, false, topFile);
+      Frames zeroCopy = RunForwarding (switchType, true, topFile);
+      Compare (deparsed, zeroCopy, switchType);
+    }
+
+  Frames deparsed = RunNat (false);
+  Frames zeroCopy = RunNat (true);
+  Compare (deparsed, zeroCopy, "NAT");
+  // both directions were translated
+  NS_TEST_EXPECT_MSG_EQ (deparsed.size (), 16, "NAT dropped packets");
+}
+
+class P4SwitchTestSuite : public TestSuite
+{
+public:
+  P4SwitchTestSuite ();
+};
+
+P4SwitchTestSuite::P4SwitchTestSuite ()
+  : TestSuite ("p4-switch", UNIT)
+{
+  AddTestCase (new LpmTableTestCase (false), TestCase::QUICK);
+  AddTestCase (new LpmTableTestCase (true), TestCase::QUICK);
+  AddTestCase (new SimulationStateWriterTestCase, TestCase::QUICK);
+  AddTestCase (new L2LearningTableTestCase, TestCase::QUICK);
+  AddTestCase (new NatTableTestCase, TestCase::QUICK);
+  AddTestCase (new PipelineProfilerTestCase, TestCase::QUICK);
+  AddTestCase (new ZeroCopyPipelineTestCase, TestCase::QUICK);
+}
+
+static P4SwitchTestSuite p4SwitchTestSuite;
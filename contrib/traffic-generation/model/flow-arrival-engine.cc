@@ -0,0 +1,195 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "flow-arrival-engine.h"
+#include "traffic-app-install-helpers.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/boolean.h"
+#include "ns3/node-list.h"
+#include "ns3/ipv4-address.h"
+
+#include <algorithm>
+
+NS_LOG_COMPONENT_DEFINE ("FlowArrivalEngine");
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (FlowArrivalEngine);
+
+TypeId
+FlowArrivalEngine::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::FlowArrivalEngine")
+    .SetParent<Object> ()
+    .SetGroupName ("TrafficGeneration")
+    .AddConstructor<FlowArrivalEngine> ()
+    .AddAttribute ("Lookahead", "How long before its start time a flow application is created",
+                   TimeValue (MilliSeconds (100)),
+                   MakeTimeAccessor (&FlowArrivalEngine::m_lookahead),
+                   MakeTimeChecker (Time (0)))
+    .AddAttribute ("RecycleApplications", "Reuse the applications of finished flows",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&FlowArrivalEngine::m_recycle),
+                   MakeBooleanChecker ())
+    .AddAttribute ("StopTime", "Absolute time at which the flow applications stop, "
+                   "flows starting later are not installed",
+                   TimeValue (Seconds (10000)),
+                   MakeTimeAccessor (&FlowArrivalEngine::m_stopTime),
+                   MakeTimeChecker (Time (0)))
+  ;
+  return tid;
+}
+
+FlowArrivalEngine::FlowArrivalEngine ()
+  : m_nextFlow (0),
+    m_created (0),
+    m_recycled (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+FlowArrivalEngine::~FlowArrivalEngine ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+FlowArrivalEngine::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  Simulator::Cancel (m_instantiateEvent);
+  m_idleApps.clear ();
+  m_flows.clear ();
+  Object::DoDispose ();
+}
+
+void
+FlowArrivalEngine::AddFlow (Ptr<Node> srcHost, std::string dst_ip, uint16_t dport,
+                            uint32_t n_packets, uint64_t max_size, double duration, double rtt,
+                            double startTime, std::string protocol)
+{
+  flow_descriptor flow;
+  flow.start_time = startTime;
+  flow.duration = duration;
+  flow.rtt = rtt;
+  flow.bytes = max_size;
+  flow.packets = n_packets;
+  flow.dst_ip = Ipv4Address (dst_ip.c_str ()).Get ();
+  flow.node_id = srcHost->GetId ();
+  flow.dport = dport;
+  flow.protocol = (protocol == "TCP") ? 6 : 17;
+  m_flows.push_back (flow);
+}
+
+void
+FlowArrivalEngine::Start (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  /* Stable so flows starting together keep the order they were added in */
+  std::stable_sort (m_flows.begin (), m_flows.end (),
+                    [] (const flow_descriptor &a, const flow_descriptor &b) {
+                      return a.start_time < b.start_time;
+                    });
+  m_nextFlow = 0;
+
+  if (!m_flows.empty ())
+    {
+      Time first = Seconds (m_flows[0].start_time) - m_lookahead - Simulator::Now ();
+      m_instantiateEvent = Simulator::Schedule (Max (first, Time (0)),
+                                                &FlowArrivalEngine::InstantiateFlows,
+                                                Ptr<FlowArrivalEngine> (this));
+    }
+}
+
+void
+FlowArrivalEngine::InstantiateFlows (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  Time horizon = Simulator::Now () + m_lookahead;
+  while (m_nextFlow < m_flows.size () && Seconds (m_flows[m_nextFlow].start_time) <= horizon)
+    {
+      if (Seconds (m_flows[m_nextFlow].start_time) < m_stopTime)
+        {
+          InstallFlow (m_flows[m_nextFlow]);
+        }
+      m_nextFlow++;
+    }
+
+  if (m_nextFlow < m_flows.size ())
+    {
+      Time next = Seconds (m_flows[m_nextFlow].start_time) - m_lookahead - Simulator::Now ();
+      m_instantiateEvent = Simulator::Schedule (Max (next, Time (0)),
+                                                &FlowArrivalEngine::InstantiateFlows,
+                                                Ptr<FlowArrivalEngine> (this));
+    }
+  else
+    {
+      /* All flows are installed, the descriptors are not needed anymore */
+      std::vector<flow_descriptor> ().swap (m_flows);
+      m_nextFlow = 0;
+    }
+}
+
+void
+FlowArrivalEngine::InstallFlow (const flow_descriptor &flow)
+{
+  Time delay = Max (Seconds (flow.start_time) - Simulator::Now (), Time (0));
+  std::string protocol = (flow.protocol == 6) ? "TCP" : "UDP";
+
+  Ptr<RateSendApplication> app;
+  std::vector<Ptr<RateSendApplication> > &idle = m_idleApps[flow.node_id];
+  if (!idle.empty ())
+    {
+      app = idle.back ();
+      idle.pop_back ();
+      ConfigureRateSend (app, Ipv4Address (flow.dst_ip), flow.dport, flow.packets, flow.bytes,
+                         flow.duration, flow.rtt, protocol);
+      app->Restart (delay);
+      m_recycled++;
+    }
+  else
+    {
+      app = CreateObject<RateSendApplication> ();
+      ConfigureRateSend (app, Ipv4Address (flow.dst_ip), flow.dport, flow.packets, flow.bytes,
+                         flow.duration, flow.rtt, protocol);
+      NodeList::GetNode (flow.node_id)->AddApplication (app);
+      /* Relative to the initialization AddApplication schedules now */
+      app->SetStartTime (delay);
+      app->SetStopTime (m_stopTime - Simulator::Now ());
+      if (m_recycle)
+        {
+          app->SetFinishedCallback (MakeCallback (&FlowArrivalEngine::FlowFinished,
+                                                  Ptr<FlowArrivalEngine> (this)));
+        }
+      m_created++;
+    }
+}
+
+void
+FlowArrivalEngine::FlowFinished (Ptr<RateSendApplication> app)
+{
+  NS_LOG_FUNCTION (this << app);
+  m_idleApps[app->GetNode ()->GetId ()].push_back (app);
+}
+
+uint64_t
+FlowArrivalEngine::GetNPending (void) const
+{
+  return m_flows.size () - m_nextFlow;
+}
+
+uint64_t
+FlowArrivalEngine::GetNCreated (void) const
+{
+  return m_created;
+}
+
+uint64_t
+FlowArrivalEngine::GetNRecycled (void) const
+{
+  return m_recycled;
+}
+
+} // namespace ns3
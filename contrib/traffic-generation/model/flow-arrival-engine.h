@@ -0,0 +1,90 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef FLOW_ARRIVAL_ENGINE_H
+#define FLOW_ARRIVAL_ENGINE_H
+
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+#include "ns3/node.h"
+#include "ns3/rate-send-application.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3 {
+
+/* Everything needed to install a rate send flow later on */
+struct flow_descriptor
+{
+  double start_time;
+  double duration;
+  double rtt;
+  uint64_t bytes;
+  uint32_t packets;
+  uint32_t dst_ip;
+  uint32_t node_id;
+  uint16_t dport;
+  uint8_t protocol;
+};
+
+/**
+ * \ingroup traffic-generation
+ *
+ * Just in time flow instantiation for the traffic schedulers. Flows are
+ * kept as a compact list of descriptors sorted by start time, and their
+ * RateSendApplication is only created Lookahead before the flow starts.
+ * Applications whose flow finished are kept in a per node pool and reused
+ * for the next flows of that node, so the number of applications follows
+ * the number of concurrent flows instead of the total number of flows.
+ */
+class FlowArrivalEngine : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+
+  FlowArrivalEngine ();
+  virtual ~FlowArrivalEngine ();
+
+  /* Same arguments as InstallRateSend, startTime is absolute */
+  void AddFlow (Ptr<Node> srcHost, std::string dst_ip, uint16_t dport, uint32_t n_packets,
+                uint64_t max_size, double duration, double rtt, double startTime,
+                std::string protocol);
+
+  /* Sorts the flows and schedules the first instantiation. The scheduled
+     events keep the engine alive, callers do not need to hold it */
+  void Start (void);
+
+  /* Flows whose application is not created yet */
+  uint64_t GetNPending (void) const;
+  /* Applications created and reused so far */
+  uint64_t GetNCreated (void) const;
+  uint64_t GetNRecycled (void) const;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  void InstantiateFlows (void);
+  void InstallFlow (const flow_descriptor &flow);
+  void FlowFinished (Ptr<RateSendApplication> app);
+
+  Time m_lookahead;
+  bool m_recycle;
+  /* Absolute stop time of the applications */
+  Time m_stopTime;
+
+  std::vector<flow_descriptor> m_flows;
+  /* Next flow to instantiate */
+  uint64_t m_nextFlow;
+  EventId m_instantiateEvent;
+
+  /* Finished applications per node id */
+  std::unordered_map<uint32_t, std::vector<Ptr<RateSendApplication> > > m_idleApps;
+
+  uint64_t m_created;
+  uint64_t m_recycled;
+};
+
+} // namespace ns3
+
+#endif /* FLOW_ARRIVAL_ENGINE_H */
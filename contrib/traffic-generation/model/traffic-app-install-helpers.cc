@@ -108,11 +108,12 @@ InstallOnOffSend (Ptr<Node> srcHost, Ptr<Node> dstHost, uint16_t dport, DataRate
   onoff_sender->SetStopTime (Seconds (1000));
 }
 
-/* Used by fancy schedulers */
+/* Sets the flow attributes of a rate send app, shared by InstallRateSend
+   and the flow arrival engine when it recycles applications */
 void
-InstallRateSend (Ptr<Node> srcHost, std::string dst_ip, uint16_t dport, uint32_t n_packets,
-                 uint64_t max_size, double duration, double rtt, double startTime,
-                 std::string protocol)
+ConfigureRateSend (Ptr<RateSendApplication> rate_send_app, Ipv4Address addr, uint16_t dport,
+                   uint32_t n_packets, uint64_t max_size, double duration, double rtt,
+                   std::string protocol)
 {
 
   NS_LOG_DEBUG ("test: " << n_packets << " " << max_size << " " << duration << " " << rtt);
@@ -123,11 +124,8 @@ InstallRateSend (Ptr<Node> srcHost, std::string dst_ip, uint16_t dport, uint32_t
   //  return;
   //}
 
-  Ipv4Address addr = Ipv4Address (Ipv4Address (dst_ip.c_str ()).Get ());
   Address sinkAddress (InetSocketAddress (addr, dport));
 
-  Ptr<RateSendApplication> rate_send_app = CreateObject<RateSendApplication> ();
-
   if (protocol == "TCP")
     {
       rate_send_app->SetAttribute ("Protocol", TypeIdValue (TcpSocketFactory::GetTypeId ()));
@@ -195,11 +193,22 @@ InstallRateSend (Ptr<Node> srcHost, std::string dst_ip, uint16_t dport, uint32_t
   rate_send_app->SetAttribute ("MaxBytes", UintegerValue (max_size_int));
   rate_send_app->SetAttribute ("BytesPerInterval", UintegerValue (bytes_per_period));
   rate_send_app->SetAttribute ("IntervalDuration", DoubleValue (interval_duration));
+}
+
+/* Used by fancy schedulers */
+Ptr<RateSendApplication>
+InstallRateSend (Ptr<Node> srcHost, std::string dst_ip, uint16_t dport, uint32_t n_packets,
+                 uint64_t max_size, double duration, double rtt, double startTime,
+                 std::string protocol)
+{
+  Ptr<RateSendApplication> rate_send_app = CreateObject<RateSendApplication> ();
+  ConfigureRateSend (rate_send_app, Ipv4Address (dst_ip.c_str ()), dport, n_packets, max_size, duration, rtt, protocol);
 
   srcHost->AddApplication (rate_send_app);
   rate_send_app->SetStartTime (Seconds (startTime));
   //TODO: check if this has some implication.
   rate_send_app->SetStopTime (Seconds (10000));
+  return rate_send_app;
 }
 
 /* old method used in blink, the only difference at the time of writing this
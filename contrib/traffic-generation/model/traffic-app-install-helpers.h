@@ -5,6 +5,7 @@
 #include <string.h>
 #include <string>
 #include "ns3/network-module.h"
+#include "ns3/rate-send-application.h"
 #include <unordered_map>
 #include <vector>
 
@@ -27,7 +28,8 @@ void InstallNormalBulkSend(Ptr<Node> srcHost, Ptr<Node> dstHost, uint16_t dport,
 void InstallOnOffSend(Ptr<Node> srcHost, Ptr<Node> dstHost, uint16_t dport, DataRate dataRate, uint32_t packet_size, uint64_t max_size, double startTime);
 void InstallRateSend(Ptr<Node> srcHost, Ptr<Node> dstHost, uint16_t dport, uint32_t n_packets, uint64_t max_size, double duration, double rtt, double startTime);
 
-void InstallRateSend(Ptr<Node> srcHost, std::string dst, uint16_t dport, uint32_t n_packets, uint64_t max_size, double duration, double rtt, double startTime, std::string protocol);
+Ptr<RateSendApplication> InstallRateSend(Ptr<Node> srcHost, std::string dst, uint16_t dport, uint32_t n_packets, uint64_t max_size, double duration, double rtt, double startTime, std::string protocol);
+void ConfigureRateSend(Ptr<RateSendApplication> app, Ipv4Address dst, uint16_t dport, uint32_t n_packets, uint64_t max_size, double duration, double rtt, std::string protocol);
 
 }
 
@@ -97,6 +97,8 @@ namespace ns3 {
     uint64_t num_flows_started = 0;
 
     Ptr<UniformRandomVariable> random_variable = CreateObject<UniformRandomVariable>();
+    /* Applications are created just before each flow starts */
+    Ptr<FlowArrivalEngine> flow_engine = CreateObject<FlowArrivalEngine>();
 
     // for every prefix 
     for (uint32_t j = 0; j < prefixes; j++)
@@ -150,7 +152,7 @@ namespace ns3 {
             << "\tDuration: " << flow.duration);
         }
 
-        InstallRateSend(src, flow.prefix, dport, flow.packets, flow.bytes, flow.duration, rtt, flow_start_time, protocol);
+        flow_engine->AddFlow(src, flow.prefix, dport, flow.packets, flow.bytes, flow.duration, rtt, flow_start_time, protocol);
         // Just print the first 100
         num_flows_started++;
         /* update first packet data structure */
@@ -161,6 +163,7 @@ namespace ns3 {
       }
     }
 
+    flow_engine->Start();
     NS_LOG_UNCOND("Number of flows Started: " << num_flows_started);
     if (output_file != "")
     {
@@ -230,6 +233,8 @@ namespace ns3 {
     uint64_t num_flows_started = 0;
 
     Ptr<UniformRandomVariable> random_variable = CreateObject<UniformRandomVariable>();
+    /* Applications are created just before each flow starts */
+    Ptr<FlowArrivalEngine> flow_engine = CreateObject<FlowArrivalEngine>();
 
     // for every second
     while ((startTime - 1) < simulationTime) {
@@ -280,7 +285,7 @@ namespace ns3 {
               << "\tDuration: " << flow.duration);
           }
 
-          InstallRateSend(src, flow.prefix, dport, flow.packets, flow.bytes, flow.duration, rtt, flow_start_time, protocol);
+          flow_engine->AddFlow(src, flow.prefix, dport, flow.packets, flow.bytes, flow.duration, rtt, flow_start_time, protocol);
 
           // Just print the first 100
 
@@ -298,6 +303,7 @@ namespace ns3 {
       startTime += 1;
     }
 
+    flow_engine->Start();
     NS_LOG_UNCOND("Number of flows Started: " << num_flows_started);
     if (output_file != "")
     {
@@ -353,6 +359,8 @@ namespace ns3 {
     uint64_t num_flows_started = 0;
 
     Ptr<UniformRandomVariable> random_variable = CreateObject<UniformRandomVariable>();
+    /* Applications are created just before each flow starts */
+    Ptr<FlowArrivalEngine> flow_engine = CreateObject<FlowArrivalEngine>();
 
     while ((startTime - 1) < simulationTime) {
 
@@ -405,7 +413,7 @@ namespace ns3 {
           << "\tDuration: " << flow.duration);
       }
 
-      InstallRateSend(src, flow.prefix, dport, flow.packets, flow.bytes, flow.duration, rtt, startTime, protocol);
+      flow_engine->AddFlow(src, flow.prefix, dport, flow.packets, flow.bytes, flow.duration, rtt, startTime, protocol);
 
       //return prefixes_stats;
 
@@ -441,6 +449,7 @@ namespace ns3 {
       }
     }
 
+    flow_engine->Start();
     NS_LOG_UNCOND("Number of flows Started: " << num_flows_started);
     if (output_file != "")
     {
@@ -498,6 +507,8 @@ namespace ns3 {
     uint64_t num_flows_started = 0;
 
     Ptr<UniformRandomVariable> random_variable = CreateObject<UniformRandomVariable>();
+    /* Applications are created just before each flow starts */
+    Ptr<FlowArrivalEngine> flow_engine = CreateObject<FlowArrivalEngine>();
 
 
     for (uint32_t i = 0; i < flowDist.size(); i++)
@@ -545,7 +556,7 @@ namespace ns3 {
           << "\tDuration: " << flow.duration);
       }
 
-      InstallRateSend(src, flow.prefix, dport, flow.packets, flow.bytes, flow.duration, rtt, startTime, protocol);
+      flow_engine->AddFlow(src, flow.prefix, dport, flow.packets, flow.bytes, flow.duration, rtt, startTime, protocol);
 
       //return prefixes_stats;
 
@@ -581,6 +592,7 @@ namespace ns3 {
       }
     }
 
+    flow_engine->Start();
     NS_LOG_UNCOND("Number of flows Started: " << num_flows_started);
     if (output_file != "")
     {
@@ -637,6 +649,8 @@ namespace ns3 {
     double simulationTime = duration;
     uint64_t num_flows_started = 0;
     Ptr<UniformRandomVariable> random_variable = CreateObject<UniformRandomVariable>();
+    /* Applications are created just before each flow starts */
+    Ptr<FlowArrivalEngine> flow_engine = CreateObject<FlowArrivalEngine>();
 
     for (uint32_t i = 0; i < flowDist.size(); i++)
     {
@@ -687,7 +701,7 @@ namespace ns3 {
 
       }
 
-      InstallRateSend(src, flow.prefix, dport, flow.packets, flow.bytes, flow.duration, rtt, startTime, protocol);
+      flow_engine->AddFlow(src, flow.prefix, dport, flow.packets, flow.bytes, flow.duration, rtt, startTime, protocol);
 
       //return prefixes_stats;
 
@@ -726,6 +740,7 @@ namespace ns3 {
       }
     }
 
+    flow_engine->Start();
     NS_LOG_UNCOND("Number of flows Started: " << num_flows_started);
     /* Only if there is output file, in this case we do not use it */
     if (output_file != "")
@@ -1,6 +1,16 @@
 /* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
 
 // Include a header file from your module to test.
+#include "ns3/flow-arrival-engine.h"
+#include "ns3/internet-stack-helper.h"
+#include "ns3/ipv4-address-helper.h"
+#include "ns3/simple-net-device-helper.h"
+#include "ns3/packet-sink-helper.h"
+#include "ns3/packet-sink.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/udp-socket-factory.h"
+#include "ns3/simulator.h"
+#include "ns3/boolean.h"
 
 // An essential include is test.h
 #include "ns3/test.h"
@@ -45,6 +55,138 @@ TrafficGenerationTestCase1::DoRun (void)
   NS_TEST_ASSERT_MSG_EQ_TOL (0.01, 0.01, 0.001, "Numbers are not equal within tolerance");
 }
 
+// Flows are installed lazily and finished applications are reused
+class FlowArrivalEngineTestCase : public TestCase
+{
+public:
+  FlowArrivalEngineTestCase ();
+  virtual ~FlowArrivalEngineTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void CheckNotInstalled (Ptr<Node> node);
+};
+
+FlowArrivalEngineTestCase::FlowArrivalEngineTestCase ()
+  : TestCase ("Flow arrival engine installs and recycles rate send flows")
+{
+}
+
+FlowArrivalEngineTestCase::~FlowArrivalEngineTestCase ()
+{
+}
+
+void
+FlowArrivalEngineTestCase::CheckNotInstalled (Ptr<Node> node)
+{
+  NS_TEST_ASSERT_MSG_EQ (node->GetNApplications (), 0, "Application created too early");
+}
+
+void
+FlowArrivalEngineTestCase::DoRun (void)
+{
+  NodeContainer nodes;
+  nodes.Create (2);
+  SimpleNetDeviceHelper simple;
+  NetDeviceContainer devices = simple.Install (nodes);
+  InternetStackHelper internet;
+  internet.Install (nodes);
+  Ipv4AddressHelper address ("10.0.0.0", "255.255.255.0");
+  Ipv4InterfaceContainer interfaces = address.Assign (devices);
+
+  uint16_t port = 5000;
+  PacketSinkHelper sinkHelper ("ns3::UdpSocketFactory",
+                               InetSocketAddress (Ipv4Address::GetAny (), port));
+  ApplicationContainer sinks = sinkHelper.Install (nodes.Get (1));
+  sinks.Start (Seconds (0));
+
+  // Six short UDP flows one after the other, added out of order
+  Ptr<FlowArrivalEngine> engine = CreateObject<FlowArrivalEngine> ();
+  std::string dst = "10.0.0.2";
+  double starts[] = {2.0, 1.0, 1.5, 3.0, 2.5, 3.5};
+  for (uint32_t i = 0; i < 6; i++)
+    {
+      engine->AddFlow (nodes.Get (0), dst, port, 10, 10000, 0.1, 0.01, starts[i], "UDP");
+    }
+  engine->Start ();
+  NS_TEST_ASSERT_MSG_EQ (engine->GetNPending (), 6, "Flows installed at setup");
+
+  Simulator::Schedule (Seconds (0.5), &FlowArrivalEngineTestCase::CheckNotInstalled, this,
+                       nodes.Get (0));
+  Simulator::Stop (Seconds (5));
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (engine->GetNPending (), 0, "Flows never installed");
+  NS_TEST_ASSERT_MSG_EQ (engine->GetNCreated (), 1, "Finished applications not reused");
+  NS_TEST_ASSERT_MSG_EQ (engine->GetNRecycled (), 5, "Wrong number of recycled applications");
+  NS_TEST_ASSERT_MSG_EQ (nodes.Get (0)->GetNApplications (), 1, "Too many applications");
+  // Payload of every flow: max size minus 54 bytes of headers per packet
+  NS_TEST_ASSERT_MSG_EQ (DynamicCast<PacketSink> (sinks.Get (0))->GetTotalRx (), 6 * (10000 - 10 * 54),
+                         "Wrong number of bytes received");
+
+  Simulator::Destroy ();
+}
+
+// Flows are stopped at the engine stop time, later flows are not installed
+class FlowArrivalEngineStopTestCase : public TestCase
+{
+public:
+  FlowArrivalEngineStopTestCase ();
+  virtual ~FlowArrivalEngineStopTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+FlowArrivalEngineStopTestCase::FlowArrivalEngineStopTestCase ()
+  : TestCase ("Flow arrival engine stops the flows at its stop time")
+{
+}
+
+FlowArrivalEngineStopTestCase::~FlowArrivalEngineStopTestCase ()
+{
+}
+
+void
+FlowArrivalEngineStopTestCase::DoRun (void)
+{
+  NodeContainer nodes;
+  nodes.Create (2);
+  SimpleNetDeviceHelper simple;
+  NetDeviceContainer devices = simple.Install (nodes);
+  InternetStackHelper internet;
+  internet.Install (nodes);
+  Ipv4AddressHelper address ("10.0.0.0", "255.255.255.0");
+  address.Assign (devices);
+
+  uint16_t port = 5000;
+  PacketSinkHelper sinkHelper ("ns3::UdpSocketFactory",
+                               InetSocketAddress (Ipv4Address::GetAny (), port));
+  ApplicationContainer sinks = sinkHelper.Install (nodes.Get (1));
+  sinks.Start (Seconds (0));
+
+  // Created at 1.9 s, so a stop relative to the creation would be later
+  Ptr<FlowArrivalEngine> engine = CreateObject<FlowArrivalEngine> ();
+  engine->SetAttribute ("RecycleApplications", BooleanValue (false));
+  engine->SetAttribute ("StopTime", TimeValue (Seconds (2.05)));
+  std::string dst = "10.0.0.2";
+  engine->AddFlow (nodes.Get (0), dst, port, 10, 10000, 0.1, 0.01, 1.0, "UDP");
+  engine->AddFlow (nodes.Get (0), dst, port, 10, 10000, 0.1, 0.01, 2.0, "UDP");
+  engine->AddFlow (nodes.Get (0), dst, port, 10, 10000, 0.1, 0.01, 3.0, "UDP");
+  engine->Start ();
+
+  Simulator::Stop (Seconds (5));
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (engine->GetNPending (), 0, "Flows never considered");
+  NS_TEST_ASSERT_MSG_EQ (engine->GetNCreated (), 2, "Flow after the stop time installed");
+  uint64_t rx = DynamicCast<PacketSink> (sinks.Get (0))->GetTotalRx ();
+  NS_TEST_ASSERT_MSG_GT (rx, 10000 - 10 * 54, "Second flow not started");
+  NS_TEST_ASSERT_MSG_LT (rx, 2 * (10000 - 10 * 54), "Second flow not stopped at the stop time");
+
+  Simulator::Destroy ();
+}
+
 // The TestSuite class names the TestSuite, identifies what type of TestSuite,
 // and enables the TestCases to be run.  Typically, only the constructor for
 // this class must be defined
@@ -60,6 +202,8 @@ TrafficGenerationTestSuite::TrafficGenerationTestSuite ()
 {
   // TestDuration for TestCase can be QUICK, EXTENSIVE or TAKES_FOREVER
   AddTestCase (new TrafficGenerationTestCase1, TestCase::QUICK);
+  AddTestCase (new FlowArrivalEngineTestCase, TestCase::QUICK);
+  AddTestCase (new FlowArrivalEngineStopTestCase, TestCase::QUICK);
 }
 
 // Do not forget to allocate an instance of this TestSuite
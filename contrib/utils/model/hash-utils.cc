@@ -9,15 +9,11 @@ NS_LOG_COMPONENT_DEFINE ("hash-utils");
 
 
 HashUtils::HashUtils(void)
-  :
-  m_hashes(NULL)
 {
   ;
 }
 
 HashUtils::HashUtils(uint32_t num)
-  :
-  m_hashes(NULL)
 {
   SetHashes(num);
 }
@@ -28,8 +24,9 @@ HashUtils::~HashUtils(void)
 }
 
 HashUtils::HashUtils(const HashUtils &x)
+  :
+  m_seeds(x.m_seeds)
 {
-  m_hashes = x.m_hashes;
 }
 
 void 
@@ -37,13 +34,10 @@ HashUtils::SetHashes(uint32_t num)
 {
   Ptr<UniformRandomVariable> random_generator = CreateObject<UniformRandomVariable>();
   random_generator->SetStream(5);
-  AllocateHashes(num);
-  for (int i=0; i < num; i++)
+  m_seeds.resize(num);
+  for (uint32_t i=0; i < num; i++)
   {
-    uint32_t seed = random_generator->GetInteger(0, ((uint32_t)-1));
-    Ptr<Hash::Implementation> hp = Create<Hash::Function::Murmur3>(seed);
-    Hasher * hash =  new Hasher(hp);
-    *(m_hashes+i) = hash;
+    m_seeds[i] = random_generator->GetInteger(0, ((uint32_t)-1));
   }
 }
 
@@ -51,47 +45,19 @@ void
 HashUtils::SetHashes(void)
 {
   uint32_t hash_seeds_size = sizeof(HASH_SEEDS)/sizeof(HASH_SEEDS[0]);
-  AllocateHashes(hash_seeds_size);
-  for (int i=0; i < hash_seeds_size; i++)
-  {
-    Ptr<Hash::Implementation> hp = Create<Hash::Function::Murmur3>(HASH_SEEDS[i]);
-    Hasher * hash = new Hasher(hp);
-    *(m_hashes+i) = hash;
-  }
-}
-
-uint32_t
-HashUtils::GetHash(char data[], std::size_t size, int hash_index, uint32_t modulo)
-{
-  (*(m_hashes + hash_index))->clear();
-  uint32_t hash = (*(m_hashes + hash_index))->GetHash32(data, size) % modulo;
-  return hash;
+  m_seeds.assign(HASH_SEEDS, HASH_SEEDS + hash_seeds_size);
 }
 
 uint32_t
 HashUtils::GetHash(std::string data , int hash_index, uint32_t modulo)
 {
-  (*(m_hashes + hash_index))->clear();
-  uint32_t hash = (*(m_hashes + hash_index))->GetHash32(data) % modulo;
-  return hash;
-}
-
-void 
-HashUtils::AllocateHashes(uint32_t num)
-{
-  Clean();
-  m_hashes = new Hasher*[num];
+  return Murmur3Hash32(data.c_str(), data.size(), m_seeds[hash_index]) % modulo;
 }
 
 void 
 HashUtils::Clean(void)
 {
-  if (m_hashes != NULL)
-  {
-
-    delete[] m_hashes;
-    m_hashes = NULL;
-  }
+  m_seeds.clear();
 }
 
 }
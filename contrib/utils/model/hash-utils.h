@@ -4,6 +4,7 @@
 
 #include <string.h>
 #include <stdint.h>
+#include <vector>
 
 #include "ns3/log.h"
 #include "ns3/hash.h"
@@ -21,6 +22,119 @@ const uint32_t HASH_SEEDS[] = {
   0x8BADFFFE, 0x7BADFFFE, 0x6BADFFFE, 0x5BADFFFE, 0x4BADFFFE, 0x3BADFFFE,
 };
 
+/* Inlined MurmurHash3_x86_32. Same output as Hash::Function::Murmur3
+ * (GetHash32 right after clear()) for the given seed, without the virtual
+ * calls and the incremental hasher state.
+ */
+inline uint32_t
+Murmur3Rotl32 (uint32_t x, int8_t r)
+{
+  return (x << r) | (x >> (32 - r));
+}
+
+inline uint32_t
+Murmur3MixBlock (uint32_t k1)
+{
+  k1 *= 0xcc9e2d51;
+  k1 = Murmur3Rotl32 (k1, 15);
+  k1 *= 0x1b873593;
+  return k1;
+}
+
+inline uint32_t
+Murmur3Finalize (uint32_t h1, std::size_t size)
+{
+  h1 ^= (uint32_t) size;
+  h1 ^= h1 >> 16;
+  h1 *= 0x85ebca6b;
+  h1 ^= h1 >> 13;
+  h1 *= 0xc2b2ae35;
+  h1 ^= h1 >> 16;
+  return h1;
+}
+
+/* Mixes the last size % 4 bytes */
+inline uint32_t
+Murmur3Tail (const uint8_t * tail, std::size_t size)
+{
+  uint32_t k1 = 0;
+  switch (size & 3)
+  {
+    case 3: k1 ^= tail[2] << 16;
+    /* fall through */
+    case 2: k1 ^= tail[1] << 8;
+    /* fall through */
+    case 1: k1 ^= tail[0];
+  }
+  return Murmur3MixBlock (k1);
+}
+
+inline uint32_t
+Murmur3Hash32 (const char * data, std::size_t size, uint32_t seed)
+{
+  const uint8_t * bytes = (const uint8_t *) data;
+  const std::size_t nblocks = size / 4;
+  uint32_t h1 = seed;
+
+  for (std::size_t i = 0; i < nblocks; i++)
+  {
+    uint32_t k1;
+    memcpy (&k1, bytes + i * 4, 4);
+    h1 ^= Murmur3MixBlock (k1);
+    h1 = Murmur3Rotl32 (h1, 13);
+    h1 = h1 * 5 + 0xe6546b64;
+  }
+
+  if (size & 3)
+  {
+    h1 ^= Murmur3Tail (bytes + nblocks * 4, size);
+  }
+
+  return Murmur3Finalize (h1, size);
+}
+
+/* Same data hashed with many seeds. The block mixing does not depend on
+ * the seed, so it is done once and only the per seed chain is repeated.
+ * Works for keys up to 64 bytes (flow tuples, hash paths), longer keys
+ * fall back to one Murmur3Hash32 per seed.
+ */
+inline void
+Murmur3Hash32Batch (const char * data, std::size_t size, const uint32_t seeds[], uint32_t num, uint32_t out[])
+{
+  const std::size_t nblocks = size / 4;
+  if (nblocks > 16)
+  {
+    for (uint32_t s = 0; s < num; s++)
+    {
+      out[s] = Murmur3Hash32 (data, size, seeds[s]);
+    }
+    return;
+  }
+
+  const uint8_t * bytes = (const uint8_t *) data;
+  uint32_t blocks[16];
+  for (std::size_t i = 0; i < nblocks; i++)
+  {
+    uint32_t k1;
+    memcpy (&k1, bytes + i * 4, 4);
+    blocks[i] = Murmur3MixBlock (k1);
+  }
+  uint32_t tail = (size & 3) ? Murmur3Tail (bytes + nblocks * 4, size) : 0;
+
+  for (uint32_t s = 0; s < num; s++)
+  {
+    uint32_t h1 = seeds[s];
+    for (std::size_t i = 0; i < nblocks; i++)
+    {
+      h1 ^= blocks[i];
+      h1 = Murmur3Rotl32 (h1, 13);
+      h1 = h1 * 5 + 0xe6546b64;
+    }
+    h1 ^= tail;
+    out[s] = Murmur3Finalize (h1, size);
+  }
+}
+
 class HashUtils
 {
   public:
@@ -32,14 +146,25 @@ class HashUtils
     void SetHashes (uint32_t num);
     void SetHashes (void);
     void Clean (void);
-    uint32_t GetHash(char data[], std::size_t size, int hash_index, uint32_t modulo = ((uint32_t) - 1));
+    uint32_t GetHash(const char data[], std::size_t size, int hash_index, uint32_t modulo = ((uint32_t) - 1))
+    {
+      return Murmur3Hash32 (data, size, m_seeds[hash_index]) % modulo;
+    }
     uint32_t GetHash(std::string data , int hash_index, uint32_t modulo = ((uint32_t) - 1));
+    /* Raw (no modulo) hashes of data for hash indexes [first, first + num) */
+    void GetHashes(const char data[], std::size_t size, uint32_t first, uint32_t num, uint32_t out[])
+    {
+      Murmur3Hash32Batch (data, size, &m_seeds[first], num, out);
+    }
+    uint32_t GetSeed(int hash_index) const
+    {
+      return m_seeds[hash_index];
+    }
     
   protected:
 
   private:
-    Hasher ** m_hashes = NULL; 
-    void AllocateHashes(uint32_t num);
+    std::vector<uint32_t> m_seeds;
 };
 
 }
@@ -2,6 +2,8 @@
 
 // Include a header file from your module to test.
 #include "ns3/utils.h"
+#include "ns3/hash-utils.h"
+#include "ns3/hash.h"
 
 // An essential include is test.h
 #include "ns3/test.h"
@@ -46,6 +48,64 @@ UtilsTestCase1::DoRun (void)
   NS_TEST_ASSERT_MSG_EQ_TOL (0.01, 0.01, 0.001, "Numbers are not equal within tolerance");
 }
 
+// Checks that the inlined Murmur3 used by HashUtils gives the same hashes
+// as ns-3's Hash::Function::Murmur3 for every seed and key length
+class HashUtilsMurmur3TestCase : public TestCase
+{
+public:
+  HashUtilsMurmur3TestCase ();
+  virtual ~HashUtilsMurmur3TestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+HashUtilsMurmur3TestCase::HashUtilsMurmur3TestCase ()
+  : TestCase ("Inlined Murmur3 matches Hash::Function::Murmur3")
+{
+}
+
+HashUtilsMurmur3TestCase::~HashUtilsMurmur3TestCase ()
+{
+}
+
+void
+HashUtilsMurmur3TestCase::DoRun (void)
+{
+  char data[40];
+  for (uint32_t i = 0; i < sizeof (data); i++)
+    {
+      data[i] = (char)(i * 37 + 11);
+    }
+
+  HashUtils fixed_seeds;
+  fixed_seeds.SetHashes ();
+  HashUtils random_seeds (10);
+  uint32_t num_seeds = sizeof (HASH_SEEDS) / sizeof (HASH_SEEDS[0]);
+
+  for (std::size_t size = 0; size <= sizeof (data); size++)
+    {
+      uint32_t batch[sizeof (HASH_SEEDS) / sizeof (HASH_SEEDS[0])];
+      fixed_seeds.GetHashes (data, size, 0, num_seeds, batch);
+
+      for (uint32_t i = 0; i < num_seeds; i++)
+        {
+          Hasher hasher = Hasher (Create<Hash::Function::Murmur3> (HASH_SEEDS[i]));
+          uint32_t expected = hasher.clear ().GetHash32 (data, size);
+          NS_TEST_ASSERT_MSG_EQ (Murmur3Hash32 (data, size, HASH_SEEDS[i]), expected, "Murmur3 mismatch, size " << size);
+          NS_TEST_ASSERT_MSG_EQ (batch[i], expected, "Batched Murmur3 mismatch, size " << size);
+          NS_TEST_ASSERT_MSG_EQ (fixed_seeds.GetHash (data, size, i, 1000), expected % 1000, "HashUtils mismatch, size " << size);
+        }
+
+      for (uint32_t i = 0; i < 10; i++)
+        {
+          Hasher hasher = Hasher (Create<Hash::Function::Murmur3> (random_seeds.GetSeed (i)));
+          uint32_t expected = hasher.clear ().GetHash32 (data, size);
+          NS_TEST_ASSERT_MSG_EQ (random_seeds.GetHash (data, size, i), expected % ((uint32_t) - 1), "HashUtils mismatch, size " << size);
+        }
+    }
+}
+
 // The TestSuite class names the TestSuite, identifies what type of TestSuite,
 // and enables the TestCases to be run.  Typically, only the constructor for
 // this class must be defined
@@ -61,6 +121,7 @@ UtilsTestSuite::UtilsTestSuite ()
 {
   // TestDuration for TestCase can be QUICK, EXTENSIVE or TAKES_FOREVER
   AddTestCase (new UtilsTestCase1, TestCase::QUICK);
+  AddTestCase (new HashUtilsMurmur3TestCase, TestCase::QUICK);
 }
 
 // Do not forget to allocate an instance of this TestSuite
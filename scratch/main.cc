@@ -54,6 +54,10 @@
 #include <filesystem>
 #include <ctime>
 #include <random>
+#include <functional>
+#include <thread>
+#include <unistd.h>
+#include <sys/wait.h>
 
 #include "ns3/core-module.h"
 #include "ns3/network-module.h"
@@ -137,6 +141,10 @@ bool enable_nat = false;
 /* Enable debugs and pcaps */
 bool debug_flag = false;
 bool pcap_enabled = false;
+/* Per stage cycle accounting of the switches, saved to <out>-profile.json */
+bool profile_pipeline = false;
+/* Runs the s1 side and the s2 side of the topology in two threads */
+bool multithreaded = false;
 
 uint32_t sim_seed = 1;
 std::string out_dir_base = "./output/";
@@ -185,6 +193,17 @@ double sim_duration = 10;
 
 double fail_time = 2;
 
+/* Scenario branching: the simulation runs once up to fail_time and then
+ * forks one process per line of the branch file, each one applying its own
+ * failures from that instant and writing to its own output base. Lines are
+ * "<out_dir_base> <num_drops> [fail_seed]", empty or # lines are skipped.
+ * Only the StatefulSyntheticTraffic and HybridTraceTraffic generators can
+ * branch, since their traffic does not depend on the failures applied.
+*/
+std::string branch_file = "";
+/* Branches running at the same time, 0 uses one per core */
+uint32_t branch_parallelism = 0;
+
 uint32_t flows_per_sec = 10;
 
 /* Synthetic traces */
@@ -203,6 +222,9 @@ uint32_t synthetic_num_prefixes = 10;
 
 /* Caida Traces*/
 std::string scaling_speed = "x1";
+/* Window of packets emitted per sender event, 0 = one event per packet */
+double sender_batch_window_us = 0;
+/* Batched packets are released on multiples of this window, 0 = exact times */
 uint32_t num_top_entries_traffic = 1000;
 uint32_t num_top_drops = 0;
 uint32_t num_bottom_drops = 0;
@@ -233,6 +255,8 @@ uint32_t m_rerouteBloomFilterWidth = 100000;
 uint32_t m_rerouteBloomFilterNumHashes = 4;
 uint16_t m_maxCounterCollisions = 1;
 uint16_t m_costType = 1;
+uint16_t m_flowAttribution = 2;
+uint32_t m_flowAttributionSampleSize = 8;
 uint32_t num_top_entries_system = 100;
 
 /* constant attributes that drive the state */
@@ -281,6 +305,10 @@ GetGeneralSimulationCmds()
   cmd.AddValue("EnableNat", "Flag to enable a NAT switch with the advanced topo", enable_nat);
   cmd.AddValue("DebugFlag", "If enabled debugging messages will be printed", debug_flag);
   cmd.AddValue("PcapEnabled", "If enabled interfaces traffic will be captured", pcap_enabled);
+  cmd.AddValue("ProfilePipeline", "Count the cycles spent in every switch pipeline stage",
+    profile_pipeline);
+  cmd.AddValue("Multithreaded", "Run s1 with the senders and s2 with the receivers in two threads",
+    multithreaded);
   cmd.AddValue("Seed", "Random seed", sim_seed);
   cmd.AddValue("OutDirBase", "Root of where to put output files", out_dir_base);
   cmd.AddValue("InDirBase", "Input directory base where to find input files", in_dir_base);
@@ -292,6 +320,9 @@ GetGeneralSimulationCmds()
   /* Overwriten by start + duration */
   //cmd.AddValue ("SimDuration", "Simulation duration", sim_duration);
   cmd.AddValue("FailTime", "Time at witch some failure are scheduled", fail_time);
+  cmd.AddValue("BranchFile", "Fork one branch per line of this file at FailTime", branch_file);
+  cmd.AddValue("BranchParallelism", "Branches running at the same time, 0 = number of cores",
+    branch_parallelism);
 
   cmd.AddValue("SendRate", "Datarate to send", send_rate);
   cmd.AddValue("SyntheticNumPrefixes", "Number of prefixes to use in our synthetic generation",
@@ -305,6 +336,9 @@ GetGeneralSimulationCmds()
   cmd.AddValue("ElephantShare", "Byte share of elephant flows", elephant_share);
 
   cmd.AddValue("Scaling", "Scaling speed of the pcap trace", scaling_speed);
+  cmd.AddValue("SenderBatchWindowUs",
+    "Packets due within this window (us) are emitted in one sender event, 0 = disabled",
+    sender_batch_window_us);
   cmd.AddValue("TraceSlice", "Trace slice to simulate", trace_slice);
   cmd.AddValue("AllowedToFail", "List of prefixes that can be failed", allowed_to_fail_file);
   //cmd.AddValue("TraceBin", "File with the binary trace to inject", trace_bin);
@@ -364,6 +398,10 @@ GetFancyCmds()
     "Number of maximum amout of collisions accepted in a counter field.",
     m_maxCounterCollisions);
   cmd.AddValue("CostType", "0 = absolute, 1 = relative.", m_costType);
+  cmd.AddValue("FlowAttribution", "Flows kept per tree cell: 0 = off, 1 = reservoir, 2 = full.",
+    m_flowAttribution);
+  cmd.AddValue("FlowAttributionSampleSize", "Flows sampled per tree cell in reservoir mode.",
+    m_flowAttributionSampleSize);
   cmd.AddValue("NumTopEntriesSystem", "Number of prefixes with dedicated memory",
     num_top_entries_system);
 
@@ -410,11 +448,25 @@ void
 SetGeneralSimulationDefaults()
 {
   Config::SetDefault("ns3::P4SwitchNetDevice::EnableDebug", BooleanValue(debug_flag));
+  if (profile_pipeline)
+  {
+    /* Switches append to it */
+    std::filesystem::remove(out_dir_base + "-profile.json");
+    Config::SetDefault("ns3::P4SwitchNetDevice::EnableProfiling", BooleanValue(true));
+    Config::SetDefault("ns3::P4SwitchNetDevice::ProfileFile",
+      StringValue(out_dir_base + "-profile.json"));
+  }
 
   //Set globals defaults
   Config::SetDefault("ns3::CsmaChannel::FullDuplex",
     BooleanValue(true)); //same than DupAckThreshold
 
+  /* Batched senders */
+  Config::SetDefault("ns3::TraceSendApplication::BatchWindow",
+    TimeValue(MicroSeconds(sender_batch_window_us)));
+  Config::SetDefault("ns3::RawSendApplication::BatchWindow",
+    TimeValue(MicroSeconds(sender_batch_window_us)));
+
   /* TCP defaults */
   Config::SetDefault("ns3::TcpSocket::SegmentSize", UintegerValue(1446)); //MTU 1446
 }
@@ -485,6 +537,9 @@ SetFancyDefaults()
   Config::SetDefault("ns3::P4SwitchFancy::MaxCounterCollisions",
     UintegerValue(m_maxCounterCollisions));
   Config::SetDefault("ns3::P4SwitchFancy::CostType", UintegerValue(m_costType));
+  Config::SetDefault("ns3::P4SwitchFancy::FlowAttribution", UintegerValue(m_flowAttribution));
+  Config::SetDefault("ns3::P4SwitchFancy::FlowAttributionSampleSize",
+    UintegerValue(m_flowAttributionSampleSize));
   Config::SetDefault("ns3::P4SwitchFancy::NumTopEntries", UintegerValue(num_top_entries_system));
   /* swtich drop rates*/
   Config::SetDefault("ns3::P4SwitchFancy::TmDropRate", DoubleValue(m_tm_drop_rate));
@@ -563,6 +618,7 @@ SetFancyMetadata(std::unordered_map<std::string, std::string>& sim_metadata)
   sim_metadata["LayerSplit"] = std::to_string(m_layerSplit);
   sim_metadata["CounterWidth"] = std::to_string(m_counterWidth);
   sim_metadata["CostType"] = std::to_string(m_costType);
+  sim_metadata["FlowAttribution"] = std::to_string(m_flowAttribution);
   sim_metadata["ProbingTimeZoomingMs"] = std::to_string(m_probing_time_zooming_ms);
   sim_metadata["ProbingTimeTopEntriesMs"] = std::to_string(m_probing_time_top_entries_ms);
   sim_metadata["TreeEnabled"] = std::to_string(m_treeEnabled);
@@ -746,6 +802,153 @@ StatefulSyntheticRestoreScheduler(std::vector<FlowMetadata> flowDist, NetDeviceC
   DynamicCast<P4SwitchNetDevice>(sw.Get(0))->L3SpecialForwardingRemoveFailures(prefixes);
 }
 
+/* Scenario branching */
+
+struct BranchVariant
+{
+  std::string out_dir_base;
+  uint32_t num_drops;
+  uint32_t fail_seed;
+};
+
+/* Selects the multithreaded simulator, before any node is created */
+void
+SetMultithreadedSimulator()
+{
+#ifdef NS3_MULTITHREADING
+  NS_ABORT_MSG_IF(switch_type == "LossRadar",
+    "The LossRadar controller reads the registers of the peer switch, both must run in one thread");
+  NS_ABORT_MSG_IF(switch_to_switch_delay == 0,
+    "Multithreaded runs need a SwitchDelay, the lookahead between the two threads");
+  Simulator::SetImplementation(CreateObject<MultithreadedSimulatorImpl>());
+#else
+  NS_ABORT_MSG("Multithreaded runs need ns-3 configured with --enable-multithreading");
+#endif
+}
+
+/* Each switch runs with its side of the topology in its own thread.
+   The failures are scheduled without node context, in the thread of s1 */
+void
+PartitionSwitches(NodeContainer s1_side, NodeContainer s2_side)
+{
+#ifdef NS3_MULTITHREADING
+  PartitionHelper partitions;
+  partitions.Assign(s1_side, 0);
+  partitions.Assign(s2_side, 1);
+  Time lookahead = partitions.Install();
+  std::cout << "Multithreaded run, lookahead " << lookahead.As(Time::US) << std::endl;
+#endif
+}
+
+std::vector<BranchVariant>
+LoadBranchVariants(std::string branch_file)
+{
+  std::vector<BranchVariant> variants;
+  std::ifstream in_file(branch_file);
+  NS_ABORT_MSG_IF(!in_file, "Could not open the branch file " << branch_file);
+
+  std::string line;
+  while (std::getline(in_file, line))
+  {
+    if (line.empty() || line[0] == '#')
+    {
+      continue;
+    }
+    std::istringstream fields(line);
+    BranchVariant variant;
+    variant.fail_seed = 0;
+    if (!(fields >> variant.out_dir_base >> variant.num_drops))
+    {
+      continue;
+    }
+    fields >> variant.fail_seed;
+    variants.push_back(variant);
+  }
+  return variants;
+}
+
+/* Order in which a branch picks the prefixes to fail: the original one
+   when fail_seed is 0, a shuffle seeded with it otherwise */
+template <typename T>
+std::vector<T>
+BranchFailureOrder(std::vector<T> candidates, uint32_t fail_seed)
+{
+  if (fail_seed != 0)
+  {
+    std::shuffle(candidates.begin(), candidates.end(), std::default_random_engine(fail_seed));
+  }
+  return candidates;
+}
+
+void
+BranchSwitchOutput(Ptr<NetDevice> sw, std::string out_file)
+{
+  if (switch_type == "Fancy")
+  {
+    DynamicCast<P4SwitchFancy>(sw)->BranchOutFile(out_file);
+  }
+  else if (switch_type == "LossRadar")
+  {
+    DynamicCast<P4SwitchLossRadar>(sw)->BranchOutFile(out_file);
+  }
+  else if (switch_type == "NetSeer")
+  {
+    DynamicCast<P4SwitchNetSeer>(sw)->BranchOutFile(out_file);
+  }
+}
+
+/**
+ *  \brief Forks one child per branch variant, at most parallelism at a time
+ *
+ *  \return the variant index in the children, -1 in the parent once all
+ *  the children exited
+ */
+int
+ForkBranches(std::vector<BranchVariant>& variants, uint32_t parallelism)
+{
+  if (parallelism == 0)
+  {
+    parallelism = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  /* Otherwise buffered output would be printed again by every child */
+  std::cout.flush();
+  std::fflush(nullptr);
+
+  uint32_t running = 0;
+  uint32_t failed = 0;
+  for (uint32_t i = 0; i < variants.size(); i++)
+  {
+    if (running == parallelism)
+    {
+      int status;
+      if (wait(&status) > 0)
+      {
+        running--;
+        failed += !(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+      }
+    }
+
+    pid_t pid = fork();
+    NS_ABORT_MSG_IF(pid < 0, "Could not fork branch " << variants[i].out_dir_base);
+    if (pid == 0)
+    {
+      return int(i);
+    }
+    running++;
+  }
+
+  int status;
+  while (running > 0 && wait(&status) > 0)
+  {
+    running--;
+    failed += !(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  }
+
+  std::cout << "Branches finished: " << variants.size() << " failed: " << failed << std::endl;
+  return -1;
+}
+
 int
 main(int argc, char* argv[])
 {
@@ -768,6 +971,18 @@ main(int argc, char* argv[])
   /* Gets overwritten */
   sim_duration = send_duration + traffic_start;
 
+  /* Scenario branches, each one applies its failures at fail_time */
+  std::vector<BranchVariant> branch_variants;
+  std::function<void(const BranchVariant&)> branch_failure;
+  Ptr<NetDevice> sw1_out;
+  if (branch_file != "")
+  {
+    branch_variants = LoadBranchVariants(branch_file);
+    NS_ABORT_MSG_IF(branch_variants.empty(), "No branches found in " << branch_file);
+    NS_ABORT_MSG_IF(fail_time < 0 || fail_time >= sim_duration,
+      "Branching needs a FailTime inside the simulation");
+  }
+
   /* Setting Global Parameters */
   RngSeedManager::SetRun(7); // Changes run number from default of 1 to 7
   RngSeedManager::SetSeed(sim_seed);
@@ -819,6 +1034,9 @@ main(int argc, char* argv[])
   std::filesystem::path absolute_path = std::filesystem::absolute(relative_path);
   sim_metadata["OutDirBase"] = absolute_path.string();
   sim_metadata["SendDuration"] = std::to_string(send_duration);
+  sim_metadata["SenderBatchWindowUs"] = std::to_string(sender_batch_window_us);
+  sim_metadata["ProfilePipeline"] = std::to_string(profile_pipeline);
+  sim_metadata["Multithreaded"] = std::to_string(multithreaded);
   relative_path = in_dir_base;
   absolute_path = std::filesystem::absolute(relative_path);
   sim_metadata["InDirBase"] = absolute_path;
@@ -890,6 +1108,11 @@ main(int argc, char* argv[])
   /* Save links for later use */
   std::unordered_map<std::string, NetDeviceContainer> links;
 
+  if (multithreaded)
+  {
+    SetMultithreadedSimulator();
+  }
+
   /* latency to node map */
   std::unordered_map<double, std::vector<Ptr<Node>>> senders_latency_to_node;
 
@@ -1136,8 +1359,14 @@ main(int argc, char* argv[])
     }
 
     NetDeviceContainer sw1_devs = switch_devices[0];
+    sw1_out = sw1_devs.Get(0);
     NetDeviceContainer sw2_devs = switch_devices[1];
 
+    if (multithreaded)
+    {
+      PartitionSwitches(NodeContainer(senders, s1), NodeContainer(NodeContainer(s2, nat), receivers));
+    }
+
     /* Set the forwarding type and reload tables */
     DynamicCast<P4SwitchNetDevice>(sw1_devs.Get(0))
       ->SetAttribute("ForwardingType",
@@ -1545,8 +1774,36 @@ main(int argc, char* argv[])
       }
 
       /* Schedule failures */
-      Simulator::Schedule(Seconds(fail_time), &HybridFailureScheduler, prefixes_to_fail,
-        sw1_devs);
+      if (!branch_variants.empty())
+      {
+        /* Only the prefixes picked above have real flows, branches fail a subset of them */
+        std::vector<uint32_t> candidates(prefixes_to_fail.begin(), prefixes_to_fail.end());
+        std::sort(candidates.begin(), candidates.end());
+        branch_failure = [candidates, sw1_devs](const BranchVariant& variant)
+        {
+          NS_ABORT_MSG_IF(variant.num_drops > candidates.size(),
+            "Branch " << variant.out_dir_base << " fails more prefixes than NumDrops");
+          std::vector<uint32_t> order = BranchFailureOrder(candidates, variant.fail_seed);
+          std::unordered_set<uint32_t> branch_prefixes(order.begin(), order.begin() + variant.num_drops);
+
+          std::ofstream file(variant.out_dir_base + "-failed_prefixes.txt");
+          for (auto const& d : branch_prefixes)
+          {
+            file << Ipv4Address(d) << "\n";
+          }
+
+          if (switch_type == "NetSeer" || switch_type == "Fancy")
+          {
+            sw1_devs.Get(0)->SetAttribute("EarlyStopCounter", UintegerValue(variant.num_drops));
+          }
+          HybridFailureScheduler(branch_prefixes, sw1_devs);
+        };
+      }
+      else
+      {
+        Simulator::Schedule(Seconds(fail_time), &HybridFailureScheduler, prefixes_to_fail,
+          sw1_devs);
+      }
     }
     /* This was used for the heat maps */
     /* Used for both the evaluation of the tree
@@ -1597,7 +1854,19 @@ main(int argc, char* argv[])
       }
 
       /* failures scheduler */
-      if (fail_time >= 0)
+      if (!branch_variants.empty())
+      {
+        branch_failure = [flowDist, sw1_devs](const BranchVariant& variant)
+        {
+          if (switch_type == "NetSeer" || switch_type == "Fancy")
+          {
+            sw1_devs.Get(0)->SetAttribute("EarlyStopCounter", UintegerValue(variant.num_drops));
+          }
+          StatefulSyntheticFailureScheduler(BranchFailureOrder(flowDist, variant.fail_seed),
+            sw1_devs, variant.num_drops);
+        };
+      }
+      else if (fail_time >= 0)
       {
         Simulator::Schedule(Seconds(fail_time), &StatefulSyntheticFailureScheduler,
           flowDist, sw1_devs, num_drops);
@@ -1721,6 +1990,11 @@ main(int argc, char* argv[])
     NetDeviceContainer sw1_devs = switch_devices[0];
     NetDeviceContainer sw2_devs = switch_devices[1];
 
+    if (multithreaded)
+    {
+      PartitionSwitches(NodeContainer(h0, h1, h2, s1), NodeContainer(s2, h3, h4, h5));
+    }
+
     /* Enables bw measurament */
     DynamicCast<P4SwitchNetDevice>(sw1_devs.Get(0))->EnableOutBandwidthPrint(link3.Get(0));
     DynamicCast<P4SwitchNetDevice>(sw1_devs.Get(0))->EnableInBandwidthPrint(link3.Get(0));
@@ -1885,7 +2159,54 @@ main(int argc, char* argv[])
   //  }
 
   NS_LOG_INFO("Run Simulation.");
-  Simulator::Stop(Seconds(sim_duration));
+  if (!branch_variants.empty())
+  {
+    NS_ABORT_MSG_IF(!branch_failure,
+      "Branching is only supported by StatefulSyntheticTraffic and HybridTraceTraffic");
+
+    /* Shared part, identical for all the branches */
+    Simulator::Stop(Seconds(fail_time));
+    Simulator::Run();
+    std::clock_t shared_execution_time = std::clock() - simulation_execution_time;
+
+    /* An early stop during the shared part ends every branch as well */
+    bool stopped_early = Simulator::Now() < Seconds(fail_time);
+    if (stopped_early)
+    {
+      std::cout << "Simulation stopped before FailTime, no branches started" << std::endl;
+    }
+
+    int branch = stopped_early ? -1 : ForkBranches(branch_variants, branch_parallelism);
+    if (branch < 0)
+    {
+      sim_metadata["NumBranches"] = std::to_string(branch_variants.size());
+      float real_simulation_time = (float(clock() - simulation_execution_time) / CLOCKS_PER_SEC);
+      sim_metadata["RealSimulationTime"] = std::to_string(real_simulation_time);
+      SaveSimulationMetadata(out_dir_base + ".info", sim_metadata);
+      Simulator::Destroy();
+      return 0;
+    }
+
+    /* From here on this process is one of the branches, the CPU time of
+       a child starts at 0 so add the shared part back */
+    simulation_execution_time = std::clock() - shared_execution_time;
+    const BranchVariant& variant = branch_variants[branch];
+    out_dir_base = variant.out_dir_base;
+    sim_metadata["OutDirBase"] = std::filesystem::absolute(out_dir_base).string();
+    sim_metadata["NumDrops"] = std::to_string(variant.num_drops);
+    sim_metadata["BranchFailSeed"] = std::to_string(variant.fail_seed);
+    sim_metadata["BranchOf"] = branch_file;
+
+    BranchSwitchOutput(sw1_out, out_dir_base + "_s1.json");
+    if (profile_pipeline)
+    {
+      Config::Set("/NodeList/*/DeviceList/*/$ns3::P4SwitchNetDevice/ProfileFile",
+        StringValue(out_dir_base + "-profile.json"));
+    }
+    branch_failure(variant);
+  }
+
+  Simulator::Stop(Seconds(sim_duration) - Simulator::Now());
   Simulator::Run();
 
   // Save total simulation time
@@ -0,0 +1,356 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file
+ * \ingroup core-examples
+ * \ingroup scheduler
+ * Benchmark the event schedulers on a packet level event mix.
+ */
+
+#include "ns3/core-module.h"
+
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("BenchScheduler");
+
+namespace {
+
+/** The kinds of events in the trace. */
+enum EventKind
+{
+  TRANSMIT,     //!< Serialization of a packet, sub microsecond.
+  RECEIVE,      //!< Propagation and queueing, microseconds.
+  TIMER,        //!< Retransmission timer removed by a later receive.
+  TIMEOUT,      //!< Retransmission timer which expires, milliseconds.
+  FLOW_START,   //!< Start of a new flow, long tailed seconds.
+  N_KINDS
+};
+
+/** Names of the event kinds, as used in trace files. */
+const char *g_kindNames[N_KINDS] = { "tx", "rx", "timer", "timeout", "flow" };
+
+/** A trace record: an event to schedule. */
+struct TraceRecord
+{
+  uint8_t kind;   //!< The EventKind.
+  uint64_t delay; //!< Delay from the current event, in ns.
+};
+
+/**
+ * Generate a trace of the event mix.
+ *
+ * \param [in] length The number of records.
+ * \param [in] timers The fraction of timer events.
+ * \param [in] timeouts The fraction of timers which expire.
+ * \param [in] flows The fraction of flow start events.
+ * \returns The trace.
+ */
+std::vector<TraceRecord>
+GenerateTrace (uint32_t length, double timers, double timeouts, double flows)
+{
+  Ptr<UniformRandomVariable> kind = CreateObject<UniformRandomVariable> ();
+  Ptr<UniformRandomVariable> tx = CreateObject<UniformRandomVariable> ();
+  tx->SetAttribute ("Min", DoubleValue (100));
+  tx->SetAttribute ("Max", DoubleValue (1200));
+  Ptr<ExponentialRandomVariable> rx = CreateObject<ExponentialRandomVariable> ();
+  rx->SetAttribute ("Mean", DoubleValue (10000));
+  rx->SetAttribute ("Bound", DoubleValue (500000));
+  Ptr<UniformRandomVariable> rto = CreateObject<UniformRandomVariable> ();
+  rto->SetAttribute ("Min", DoubleValue (1e6));
+  rto->SetAttribute ("Max", DoubleValue (200e6));
+  Ptr<ParetoRandomVariable> flow = CreateObject<ParetoRandomVariable> ();
+  flow->SetAttribute ("Scale", DoubleValue (10e6));
+  flow->SetAttribute ("Shape", DoubleValue (1.2));
+  flow->SetAttribute ("Bound", DoubleValue (100e9));
+
+  std::vector<TraceRecord> trace (length);
+  for (uint32_t i = 0; i < length; ++i)
+    {
+      TraceRecord &r = trace[i];
+      double u = kind->GetValue ();
+      if (u < flows)
+        {
+          r.kind = FLOW_START;
+          r.delay = flow->GetInteger ();
+        }
+      else if (u < flows + timers)
+        {
+          r.kind = kind->GetValue () < timeouts ? TIMEOUT : TIMER;
+          r.delay = rto->GetInteger ();
+        }
+      else if (u < flows + timers + (1 - flows - timers) / 2)
+        {
+          r.kind = TRANSMIT;
+          r.delay = tx->GetInteger ();
+        }
+      else
+        {
+          r.kind = RECEIVE;
+          r.delay = rx->GetInteger ();
+        }
+    }
+  return trace;
+}
+
+/**
+ * Read a trace file, one "<kind> <delay in ns>" record per line.
+ *
+ * \param [in] filename The trace file name.
+ * \returns The trace.
+ */
+std::vector<TraceRecord>
+ReadTrace (std::string filename)
+{
+  std::ifstream input (filename.c_str ());
+  NS_ABORT_MSG_UNLESS (input, "Cannot open " << filename);
+  std::vector<TraceRecord> trace;
+  std::string line;
+  while (std::getline (input, line))
+    {
+      std::istringstream fields (line);
+      std::string name;
+      TraceRecord r;
+      if (!(fields >> name >> r.delay))
+        {
+          continue;
+        }
+      uint8_t k = 0;
+      while (k < N_KINDS && name != g_kindNames[k])
+        {
+          ++k;
+        }
+      NS_ABORT_MSG_IF (k == N_KINDS, "Unknown event kind " << name);
+      r.kind = k;
+      trace.push_back (r);
+    }
+  NS_ABORT_MSG_IF (trace.empty (), "No records in " << filename);
+  return trace;
+}
+
+/**
+ * Write a trace file, in the format read by ReadTrace.
+ *
+ * \param [in] filename The trace file name.
+ * \param [in] trace The trace.
+ */
+void
+WriteTrace (std::string filename, const std::vector<TraceRecord> &trace)
+{
+  std::ofstream output (filename.c_str ());
+  NS_ABORT_MSG_UNLESS (output, "Cannot open " << filename);
+  for (std::vector<TraceRecord>::const_iterator i = trace.begin (); i != trace.end (); ++i)
+    {
+      output << g_kindNames[i->kind] << " " << i->delay << "\n";
+    }
+}
+
+/**
+ * Replay a trace as a hold model: every event executed schedules the
+ * next record of the trace, so the number of pending events stays
+ * at the initial population. Receive events also remove the oldest
+ * pending timer, as an acknowledgment would, and schedule a
+ * replacement record.
+ */
+class Replay
+{
+public:
+  /**
+   * Constructor.
+   *
+   * \param [in] trace The trace, replayed cyclically.
+   * \param [in] population The number of pending events.
+   * \param [in] total The number of events to execute.
+   */
+  Replay (const std::vector<TraceRecord> &trace, uint32_t population, uint32_t total)
+    : m_trace (trace),
+      m_population (population),
+      m_total (total)
+  {
+  }
+
+  /**
+   * Run the replay with a scheduler type.
+   *
+   * \param [in] type The scheduler TypeId name.
+   */
+  void Run (std::string type);
+
+private:
+  /** Schedule the next record of the trace. */
+  void ScheduleNext (void);
+  /**
+   * Execute an event.
+   *
+   * \param [in] kind The EventKind.
+   */
+  void Fire (uint8_t kind);
+
+  const std::vector<TraceRecord> &m_trace; //!< The trace.
+  uint32_t m_population;                   //!< Pending events.
+  uint32_t m_total;                        //!< Events to execute.
+  uint32_t m_next;                         //!< Next record.
+  uint32_t m_count;                        //!< Events executed.
+  uint32_t m_removed;                      //!< Timers removed.
+  std::deque<EventId> m_timers;            //!< Pending timers, oldest first.
+};
+
+void
+Replay::ScheduleNext (void)
+{
+  const TraceRecord &r = m_trace[m_next];
+  m_next = (m_next + 1) % m_trace.size ();
+  EventId id = Simulator::Schedule (NanoSeconds (r.delay), &Replay::Fire, this, r.kind);
+  if (r.kind == TIMER)
+    {
+      m_timers.push_back (id);
+    }
+}
+
+void
+Replay::Fire (uint8_t kind)
+{
+  if (m_count >= m_total)
+    {
+      Simulator::Stop ();
+      return;
+    }
+  ++m_count;
+  ScheduleNext ();
+  if (kind == RECEIVE)
+    {
+      while (!m_timers.empty () && m_timers.front ().IsExpired ())
+        {
+          m_timers.pop_front ();
+        }
+      if (!m_timers.empty ())
+        {
+          Simulator::Remove (m_timers.front ());
+          m_timers.pop_front ();
+          ++m_removed;
+          ScheduleNext ();
+        }
+    }
+}
+
+void
+Replay::Run (std::string type)
+{
+  Simulator::SetScheduler (ObjectFactory (type));
+  m_next = 0;
+  m_count = 0;
+  m_removed = 0;
+  m_timers.clear ();
+
+  SystemWallClockMs clock;
+  clock.Start ();
+  for (uint32_t i = 0; i < m_population; ++i)
+    {
+      ScheduleNext ();
+    }
+  double init = clock.End () / 1000.0;
+
+  clock.Start ();
+  Simulator::Run ();
+  double run = clock.End () / 1000.0;
+  Time simulated = Simulator::Now ();
+  Simulator::Destroy ();
+
+  std::cout << std::left << std::setw (24) << type << std::right
+            << std::setw (10) << init
+            << std::setw (10) << run
+            << std::setw (14) << (run > 0 ? m_count / run : 0)
+            << std::setw (10) << m_removed
+            << std::setw (14) << simulated.GetSeconds ()
+            << std::endl;
+}
+
+} // unnamed namespace
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t population = 100000;
+  uint32_t total = 2000000;
+  uint32_t length = 1 << 20;
+  double timers = 0.08;
+  double timeouts = 0.1;
+  double flows = 0.005;
+  std::string schedulers = "ns3::ListScheduler,ns3::HeapScheduler,ns3::MapScheduler,"
+    "ns3::CalendarScheduler,ns3::LadderScheduler";
+  std::string traceFile = "";
+  std::string saveFile = "";
+
+  CommandLine cmd;
+  cmd.Usage ("Benchmark the event schedulers on a packet level event mix.\n"
+             "\n"
+             "Mostly near future transmit and receive events, retransmission\n"
+             "timers which are mostly removed before they expire, and a long\n"
+             "tail of flow starts. The same trace is replayed against every\n"
+             "scheduler, either generated or read from --trace, with one\n"
+             "\"<tx|rx|timer|timeout|flow> <delay in ns>\" record per line.");
+  cmd.AddValue ("pop", "number of pending events", population);
+  cmd.AddValue ("total", "number of events to execute", total);
+  cmd.AddValue ("length", "number of records of the generated trace", length);
+  cmd.AddValue ("timers", "fraction of retransmission timers", timers);
+  cmd.AddValue ("timeouts", "fraction of the timers which expire", timeouts);
+  cmd.AddValue ("flows", "fraction of flow starts", flows);
+  cmd.AddValue ("schedulers", "comma separated scheduler types", schedulers);
+  cmd.AddValue ("trace", "trace file to replay instead of generating one", traceFile);
+  cmd.AddValue ("save", "file to save the generated trace to", saveFile);
+  cmd.Parse (argc, argv);
+
+  std::vector<TraceRecord> trace;
+  if (traceFile != "")
+    {
+      trace = ReadTrace (traceFile);
+    }
+  else
+    {
+      trace = GenerateTrace (length, timers, timeouts, flows);
+      if (saveFile != "")
+        {
+          WriteTrace (saveFile, trace);
+        }
+    }
+
+  std::cout << "population: " << population << ", total events: " << total
+            << ", trace records: " << trace.size () << std::endl;
+  std::cout << std::left << std::setw (24) << "Scheduler" << std::right
+            << std::setw (10) << "Init (s)"
+            << std::setw (10) << "Run (s)"
+            << std::setw (14) << "Rate (ev/s)"
+            << std::setw (10) << "Removed"
+            << std::setw (14) << "Sim time (s)"
+            << std::endl;
+
+  Replay replay (trace, population, total);
+  std::istringstream types (schedulers);
+  std::string type;
+  while (std::getline (types, type, ','))
+    {
+      replay.Run (type);
+    }
+  return 0;
+}
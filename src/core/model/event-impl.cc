@@ -21,6 +21,8 @@
 #include "event-impl.h"
 #include "log.h"
 
+#include <atomic>
+
 /**
  * \file
  * \ingroup events
@@ -66,4 +68,72 @@ EventImpl::IsCancelled (void)
   return m_cancel;
 }
 
+#ifndef DISABLE_EVENT_POOL
+
+namespace {
+
+/** Bytes of the event blocks allocated from the system, by all threads. */
+std::atomic<std::size_t> g_poolBytes (0);
+
+} // unnamed namespace
+
+thread_local EventImpl::PoolLists EventImpl::m_pool;
+
+EventImpl::PoolReleaser::~PoolReleaser ()
+{
+  EventImpl::PoolRelease ();
+}
+
+void *
+EventImpl::PoolAllocate (std::size_t sizeClass)
+{
+  std::size_t blockSize = (sizeClass + 1) * POOL_GRANULARITY;
+  g_poolBytes.fetch_add (blockSize, std::memory_order_relaxed);
+  return ::operator new (blockSize);
+}
+
+void
+EventImpl::PoolFree (void *block, std::size_t sizeClass)
+{
+  if (m_pool.state == POOL_UNINITIALIZED)
+    {
+      // register the release of the lists when the thread exits
+      static thread_local PoolReleaser releaser;
+      (void) &releaser;
+      m_pool.state = POOL_INITIALIZED;
+      *static_cast<void **> (block) = m_pool.heads[sizeClass];
+      m_pool.heads[sizeClass] = block;
+      m_pool.counts[sizeClass]++;
+      return;
+    }
+  g_poolBytes.fetch_sub ((sizeClass + 1) * POOL_GRANULARITY, std::memory_order_relaxed);
+  ::operator delete (block);
+}
+
+void
+EventImpl::PoolRelease (void)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  for (std::size_t i = 0; i < POOL_CLASSES; i++)
+    {
+      while (m_pool.heads[i] != 0)
+        {
+          void *block = m_pool.heads[i];
+          m_pool.heads[i] = *static_cast<void **> (block);
+          g_poolBytes.fetch_sub ((i + 1) * POOL_GRANULARITY, std::memory_order_relaxed);
+          ::operator delete (block);
+        }
+      m_pool.counts[i] = 0;
+    }
+  m_pool.state = POOL_DESTROYED;
+}
+
+std::size_t
+EventImpl::GetPoolBytes (void)
+{
+  return g_poolBytes.load (std::memory_order_relaxed);
+}
+
+#endif /* DISABLE_EVENT_POOL */
+
 } // namespace ns3
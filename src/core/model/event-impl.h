@@ -21,6 +21,8 @@
 #define EVENT_IMPL_H
 
 #include <stdint.h>
+#include <cstddef>
+#include <new>
 #include "simple-ref-count.h"
 
 /**
@@ -40,6 +42,16 @@ namespace ns3 {
  * when it reaches the time associated to this event. Most subclasses
  * are usually created by one of the many Simulator::Schedule
  * methods.
+ *
+ * Unless ns-3 is configured with \c --disable-event-pool (for memory
+ * debuggers such as valgrind), events are allocated from per thread
+ * free lists, one per size class of \c POOL_GRANULARITY bytes up to
+ * \c POOL_MAX_SIZE. The size class of an event type is a constant
+ * derived from the size of its bound arguments, larger events use
+ * the global operator new. Freed events go back to the free list of
+ * the freeing thread. Each list keeps at most \c POOL_MAX_LIST_BYTES,
+ * the blocks beyond are returned to the system, and all lists are
+ * emptied when their thread exits.
  */
 class EventImpl : public SimpleRefCount<EventImpl>
 {
@@ -66,6 +78,29 @@ public:
    */
   bool IsCancelled (void);
 
+#ifndef DISABLE_EVENT_POOL
+  /**
+   * Allocate an event from the free list of its size class.
+   *
+   * \param [in] size The size of the event type.
+   * \returns The event memory.
+   */
+  static void * operator new (std::size_t size);
+  /**
+   * Return an event to the free list of its size class.
+   *
+   * \param [in] p The event memory.
+   * \param [in] size The size of the event type.
+   */
+  static void operator delete (void *p, std::size_t size);
+  /**
+   * \returns The bytes of the event blocks allocated from the system
+   *          and not returned yet, by all threads: the events alive
+   *          and the blocks kept in the free lists.
+   */
+  static std::size_t GetPoolBytes (void);
+#endif /* DISABLE_EVENT_POOL */
+
 protected:
   /**
    * Implementation for Invoke().
@@ -77,8 +112,105 @@ protected:
 
 private:
   bool m_cancel;  /**< Has this event been cancelled. */
+
+#ifndef DISABLE_EVENT_POOL
+  /** Size class granularity, in bytes. */
+  static const std::size_t POOL_GRANULARITY = 16;
+  /** Largest event allocated from the free lists, in bytes. */
+  static const std::size_t POOL_MAX_SIZE = 256;
+  /** Number of size classes. */
+  static const std::size_t POOL_CLASSES = POOL_MAX_SIZE / POOL_GRANULARITY;
+  /** Bytes kept at most in the free list of a size class. */
+  static const std::size_t POOL_MAX_LIST_BYTES = 1 << 20;
+
+  /**
+   * Allocate a block from the system for an empty free list.
+   *
+   * \param [in] sizeClass The size class.
+   * \returns The block.
+   */
+  static void * PoolAllocate (std::size_t sizeClass);
+  /**
+   * Free a block which does not fit in the free list of the calling
+   * thread: the list is full, not registered for release yet, or
+   * already released.
+   *
+   * \param [in] block The block.
+   * \param [in] sizeClass The size class.
+   */
+  static void PoolFree (void *block, std::size_t sizeClass);
+  /** Free the blocks of all the lists of the calling thread. */
+  static void PoolRelease (void);
+
+  /** State of the free lists of a thread. */
+  enum PoolState
+  {
+    POOL_UNINITIALIZED = 0,  //!< No event was freed yet, the releaser is not registered.
+    POOL_INITIALIZED,        //!< The releaser is registered.
+    POOL_DESTROYED           //!< The thread is exiting, events are freed directly.
+  };
+  /**
+   * The free lists of a thread. It is trivially destructible and zero
+   * initialized, so it stays usable while the thread exits.
+   */
+  struct PoolLists
+  {
+    void *heads[POOL_CLASSES];          //!< Free blocks, linked through their first word.
+    std::size_t counts[POOL_CLASSES];   //!< Blocks per free list.
+    uint8_t state;                      //!< PoolState of the lists.
+  };
+  /** The free lists of the calling thread. */
+  static thread_local PoolLists m_pool;
+
+  /** Releases the free lists of a thread when it exits. */
+  struct PoolReleaser
+  {
+    ~PoolReleaser ();
+  };
+  friend struct PoolReleaser;
+#endif /* DISABLE_EVENT_POOL */
 };
 
+#ifndef DISABLE_EVENT_POOL
+inline void *
+EventImpl::operator new (std::size_t size)
+{
+  if (size > POOL_MAX_SIZE)
+    {
+      return ::operator new (size);
+    }
+  std::size_t sizeClass = (size - 1) / POOL_GRANULARITY;
+  void *block = m_pool.heads[sizeClass];
+  if (block == 0)
+    {
+      return PoolAllocate (sizeClass);
+    }
+  m_pool.heads[sizeClass] = *static_cast<void **> (block);
+  m_pool.counts[sizeClass]--;
+  return block;
+}
+
+inline void
+EventImpl::operator delete (void *p, std::size_t size)
+{
+  if (size > POOL_MAX_SIZE)
+    {
+      ::operator delete (p);
+      return;
+    }
+  std::size_t sizeClass = (size - 1) / POOL_GRANULARITY;
+  if (m_pool.state != POOL_INITIALIZED
+      || (m_pool.counts[sizeClass] + 1) * (sizeClass + 1) * POOL_GRANULARITY > POOL_MAX_LIST_BYTES)
+    {
+      PoolFree (p, sizeClass);
+      return;
+    }
+  *static_cast<void **> (p) = m_pool.heads[sizeClass];
+  m_pool.heads[sizeClass] = p;
+  m_pool.counts[sizeClass]++;
+}
+#endif /* DISABLE_EVENT_POOL */
+
 } // namespace ns3
 
 #endif /* EVENT_IMPL_H */
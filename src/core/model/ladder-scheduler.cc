@@ -0,0 +1,349 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ladder-scheduler.h"
+#include "event-impl.h"
+#include <algorithm>
+#include "assert.h"
+#include "log.h"
+
+/**
+ * \file
+ * \ingroup scheduler
+ * ns3::LadderScheduler class implementation.
+ */
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LadderScheduler");
+
+NS_OBJECT_ENSURE_REGISTERED (LadderScheduler);
+
+namespace {
+
+/**
+ * \ingroup scheduler
+ * Order events latest first, so the bottom pops from its end.
+ * \param [in] a The first event.
+ * \param [in] b The second event.
+ * \returns \c true if \c a is later than \c b
+ */
+bool
+LaterThan (const Scheduler::Event &a, const Scheduler::Event &b)
+{
+  return a.key > b.key;
+}
+
+} // unnamed namespace
+
+TypeId
+LadderScheduler::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LadderScheduler")
+    .SetParent<Scheduler> ()
+    .SetGroupName ("Core")
+    .AddConstructor<LadderScheduler> ()
+  ;
+  return tid;
+}
+
+LadderScheduler::LadderScheduler ()
+  : m_topStart (0),
+    m_rungs (MAX_RUNGS),
+    m_nRungs (0),
+    m_lastTs (0),
+    m_qSize (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+LadderScheduler::~LadderScheduler ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+uint64_t
+LadderScheduler::CurrentStart (const Rung &rung)
+{
+  return rung.start + rung.current * rung.width;
+}
+
+uint64_t
+LadderScheduler::BottomEnd (void) const
+{
+  uint64_t end = m_topStart;
+  for (uint32_t r = 0; r < m_nRungs; r++)
+    {
+      end = std::min (end, CurrentStart (m_rungs[r]));
+    }
+  return end;
+}
+
+LadderScheduler::Rung &
+LadderScheduler::AddRung (uint64_t start, uint64_t end, uint64_t width)
+{
+  NS_LOG_FUNCTION (this << start << end << width);
+  NS_ASSERT (m_nRungs < MAX_RUNGS && end > start && width > 0);
+  Rung &rung = m_rungs[m_nRungs++];
+  rung.buckets.resize ((end - start - 1) / width + 1);
+  rung.start = start;
+  rung.width = width;
+  rung.current = 0;
+  rung.count = 0;
+  return rung;
+}
+
+void
+LadderScheduler::InsertBottom (const Event &ev)
+{
+  Bucket::iterator i = std::lower_bound (m_bottom.begin (), m_bottom.end (), ev, LaterThan);
+  m_bottom.insert (i, ev);
+}
+
+void
+LadderScheduler::FillBottom (Bucket &events)
+{
+  NS_ASSERT (m_bottom.empty ());
+  m_bottom.swap (events);
+  std::sort (m_bottom.begin (), m_bottom.end (), LaterThan);
+}
+
+void
+LadderScheduler::Purge (Bucket &events)
+{
+  if (m_removed.empty ())
+    {
+      return;
+    }
+  Bucket::iterator end = events.begin ();
+  for (Bucket::iterator i = events.begin (); i != events.end (); ++i)
+    {
+      if (m_removed.erase (i->key.m_uid) == 0)
+        {
+          *end++ = *i;
+        }
+    }
+  events.erase (end, events.end ());
+}
+
+void
+LadderScheduler::SpreadBottom (void)
+{
+  NS_LOG_FUNCTION (this << m_bottom.size ());
+  uint64_t last = m_bottom.front ().key.m_ts;
+  uint64_t n = m_bottom.size ();
+  uint64_t width;
+  uint64_t end;
+  if (m_nRungs == 0)
+    {
+      // size the buckets on the events, the top takes over after them
+      width = (last - m_lastTs) / n + 1;
+      end = std::min (m_topStart, m_lastTs + n * width);
+      m_topStart = end;
+    }
+  else
+    {
+      // the new rung has to cover up to the current bucket of the last one
+      end = CurrentStart (m_rungs[m_nRungs - 1]);
+      width = (end - m_lastTs - 1) / n + 1;
+    }
+  Rung &rung = AddRung (m_lastTs, end, width);
+  for (Bucket::const_iterator i = m_bottom.begin (); i != m_bottom.end (); ++i)
+    {
+      rung.buckets[(i->key.m_ts - rung.start) / width].push_back (*i);
+    }
+  rung.count = n;
+  m_bottom.clear ();
+}
+
+void
+LadderScheduler::SpreadTop (void)
+{
+  NS_LOG_FUNCTION (this << m_top.size ());
+  NS_ASSERT (m_nRungs == 0);
+  Purge (m_top);
+  NS_ASSERT (!m_top.empty ());
+  uint64_t first = m_top.front ().key.m_ts;
+  uint64_t last = first;
+  for (Bucket::const_iterator i = m_top.begin (); i != m_top.end (); ++i)
+    {
+      first = std::min (first, i->key.m_ts);
+      last = std::max (last, i->key.m_ts);
+    }
+
+  if (m_top.size () <= THRESHOLD || first == last)
+    {
+      m_topStart = last + 1;
+      FillBottom (m_top);
+      return;
+    }
+
+  uint64_t width = (last - first) / m_top.size () + 1;
+  uint64_t end = first + ((last - first) / width + 1) * width;
+  Rung &rung = AddRung (first, end, width);
+  for (Bucket::const_iterator i = m_top.begin (); i != m_top.end (); ++i)
+    {
+      rung.buckets[(i->key.m_ts - first) / width].push_back (*i);
+    }
+  rung.count = m_top.size ();
+  m_top.clear ();
+  m_topStart = end;
+}
+
+void
+LadderScheduler::Refill (void)
+{
+  NS_LOG_FUNCTION (this);
+  while (m_bottom.empty () && m_qSize > 0)
+    {
+      if (m_nRungs == 0)
+        {
+          SpreadTop ();
+          continue;
+        }
+      Rung &rung = m_rungs[m_nRungs - 1];
+      if (rung.count == 0)
+        {
+          m_nRungs--;
+          continue;
+        }
+      while (rung.buckets[rung.current].empty ())
+        {
+          rung.current++;
+        }
+      Bucket &bucket = rung.buckets[rung.current];
+      uint64_t start = CurrentStart (rung);
+      rung.current++;
+      rung.count -= bucket.size ();
+      Purge (bucket);
+
+      if (bucket.size () > THRESHOLD && rung.width > 1 && m_nRungs < MAX_RUNGS)
+        {
+          NS_LOG_LOGIC ("spread " << bucket.size () << " events from rung " << m_nRungs - 1);
+          uint64_t width = (rung.width - 1) / bucket.size () + 1;
+          Rung &child = AddRung (start, start + rung.width, width);
+          for (Bucket::const_iterator i = bucket.begin (); i != bucket.end (); ++i)
+            {
+              child.buckets[(i->key.m_ts - start) / width].push_back (*i);
+            }
+          child.count = bucket.size ();
+          bucket.clear ();
+        }
+      else if (!bucket.empty ())
+        {
+          NS_LOG_LOGIC ("sort " << bucket.size () << " events from rung " << m_nRungs - 1);
+          FillBottom (bucket);
+        }
+    }
+}
+
+void
+LadderScheduler::Insert (const Event &ev)
+{
+  NS_LOG_FUNCTION (this << ev.key.m_ts << ev.key.m_uid);
+  uint64_t ts = ev.key.m_ts;
+  NS_ASSERT_MSG (ts >= m_lastTs, "Event scheduled before the last event removed");
+  m_qSize++;
+
+  if (ts >= m_topStart)
+    {
+      m_top.push_back (ev);
+    }
+  else
+    {
+      uint32_t r = 0;
+      while (r < m_nRungs && ts < CurrentStart (m_rungs[r]))
+        {
+          r++;
+        }
+      if (r < m_nRungs)
+        {
+          Rung &rung = m_rungs[r];
+          rung.buckets[(ts - rung.start) / rung.width].push_back (ev);
+          rung.count++;
+        }
+      else
+        {
+          InsertBottom (ev);
+          if (m_bottom.size () > THRESHOLD && m_nRungs < MAX_RUNGS
+              && m_bottom.front ().key.m_ts != m_bottom.back ().key.m_ts)
+            {
+              SpreadBottom ();
+            }
+        }
+    }
+
+  if (m_bottom.empty ())
+    {
+      Refill ();
+    }
+}
+bool
+LadderScheduler::IsEmpty (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return m_qSize == 0;
+}
+Scheduler::Event
+LadderScheduler::PeekNext (void) const
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT (!IsEmpty ());
+  return m_bottom.back ();
+}
+
+Scheduler::Event
+LadderScheduler::RemoveNext (void)
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT (!IsEmpty ());
+  Event ev = m_bottom.back ();
+  m_bottom.pop_back ();
+  m_qSize--;
+  m_lastTs = ev.key.m_ts;
+  if (m_bottom.empty ())
+    {
+      Refill ();
+    }
+  return ev;
+}
+
+void
+LadderScheduler::Remove (const Event &ev)
+{
+  NS_LOG_FUNCTION (this << ev.key.m_ts << ev.key.m_uid);
+  NS_ASSERT (!IsEmpty ());
+  uint64_t ts = ev.key.m_ts;
+
+  if (ts >= BottomEnd ())
+    {
+      // searching unsorted buckets is linear, drop the event when it is moved
+      m_removed.insert (ev.key.m_uid);
+    }
+  else
+    {
+      Bucket::iterator i = std::lower_bound (m_bottom.begin (), m_bottom.end (), ev, LaterThan);
+      NS_ASSERT (i != m_bottom.end () && i->key.m_uid == ev.key.m_uid && i->impl == ev.impl);
+      m_bottom.erase (i);
+    }
+
+  m_qSize--;
+  if (m_bottom.empty ())
+    {
+      Refill ();
+    }
+}
+
+} // namespace ns3
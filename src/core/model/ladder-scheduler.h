@@ -0,0 +1,169 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef LADDER_SCHEDULER_H
+#define LADDER_SCHEDULER_H
+
+#include "scheduler.h"
+#include <stdint.h>
+#include <vector>
+#include <unordered_set>
+
+/**
+ * \file
+ * \ingroup scheduler
+ * ns3::LadderScheduler class declaration.
+ */
+
+namespace ns3 {
+
+class EventImpl;
+
+/**
+ * \ingroup scheduler
+ * \brief a ladder queue event scheduler
+ *
+ * This event scheduler implements the ladder queue described in
+ * "Ladder Queue: An O(1) Priority Queue Structure for Large-Scale
+ * Discrete Event Simulation" by Tang, Goh and Thng (2005).
+ *
+ * Events are kept in three tiers, ordered by timestamp:
+ * - Top: an unsorted list of the far future events.
+ * - Ladder: up to MAX_RUNGS rungs of unsorted buckets. When the
+ *   ladder is empty the top is spread over a first rung; a bucket
+ *   holding more than THRESHOLD events is spread over a finer rung
+ *   instead of being sorted.
+ * - Bottom: a short sorted list of the nearest events, refilled from
+ *   the first non empty bucket of the last rung.
+ *
+ * Every event is only ever sorted in a small bottom list, which makes
+ * insertion and removal amortized O(1) when most events are scheduled
+ * a short, varying delay in the future. Events removed before they
+ * reach the bottom are only dropped when their bucket is moved.
+ *
+ * Insertion assumes that events are never scheduled before the last
+ * event removed, as guaranteed by the simulator implementations.
+ */
+class LadderScheduler : public Scheduler
+{
+public:
+  /**
+   *  Register this type.
+   *  \return The object TypeId.
+   */
+  static TypeId GetTypeId (void);
+
+  /** Constructor. */
+  LadderScheduler ();
+  /** Destructor. */
+  virtual ~LadderScheduler ();
+
+  // Inherited
+  virtual void Insert (const Scheduler::Event &ev);
+  virtual bool IsEmpty (void) const;
+  virtual Scheduler::Event PeekNext (void) const;
+  virtual Scheduler::Event RemoveNext (void);
+  virtual void Remove (const Scheduler::Event &ev);
+
+private:
+  /** Ladder bucket type: an unsorted vector of Events. */
+  typedef std::vector<Scheduler::Event> Bucket;
+
+  /** A rung of the ladder. */
+  struct Rung
+  {
+    std::vector<Bucket> buckets; /**< The buckets. */
+    uint64_t start;              /**< Timestamp at the start of the first bucket. */
+    uint64_t width;              /**< Duration of a bucket, in dimensionless time units. */
+    uint32_t current;            /**< First bucket which may still hold events. */
+    uint32_t count;              /**< Number of events in the rung. */
+  };
+
+  /** Maximum number of events sorted at once in the bottom. */
+  static const uint32_t THRESHOLD = 50;
+  /** Maximum number of rungs. */
+  static const uint32_t MAX_RUNGS = 8;
+
+  /**
+   * Get the timestamp at the start of the current bucket of a rung.
+   *
+   * Events before it belong to the next rungs or to the bottom.
+   *
+   * \param [in] rung The rung.
+   * \returns The timestamp.
+   */
+  static inline uint64_t CurrentStart (const Rung &rung);
+  /**
+   * Get the timestamp from which events are in the ladder or the top.
+   *
+   * \returns The timestamp.
+   */
+  uint64_t BottomEnd (void) const;
+  /**
+   * Add a rung below the last one.
+   *
+   * \param [in] start The timestamp at the start of the first bucket.
+   * \param [in] end The timestamp the rung must extend to.
+   * \param [in] width The bucket duration.
+   * \returns The new rung.
+   */
+  Rung & AddRung (uint64_t start, uint64_t end, uint64_t width);
+  /**
+   * Insert an event in the bottom, keeping it sorted.
+   *
+   * \param [in] ev The event.
+   */
+  void InsertBottom (const Scheduler::Event &ev);
+  /**
+   * Sort events into an empty bottom.
+   *
+   * \param [in,out] events The events, cleared on return.
+   */
+  void FillBottom (Bucket &events);
+  /**
+   * Drop the events removed while in the top or the ladder.
+   *
+   * \param [in,out] events The events.
+   */
+  void Purge (Bucket &events);
+  /** Spread an overflowing bottom over a new rung. */
+  void SpreadBottom (void);
+  /** Spread the top over the first rung, or into the bottom if small. */
+  void SpreadTop (void);
+  /** Refill the bottom from the ladder, or from the top, if it is empty. */
+  void Refill (void);
+
+  /** The far future events, from m_topStart. */
+  Bucket m_top;
+  /** Timestamp from which events belong to the top. */
+  uint64_t m_topStart;
+  /** The rungs, with room for MAX_RUNGS. */
+  std::vector<Rung> m_rungs;
+  /** Number of rungs in use. */
+  uint32_t m_nRungs;
+  /** The nearest events, sorted latest first. */
+  Bucket m_bottom;
+  /** Unique ids of the events removed from the top or the ladder. */
+  std::unordered_set<uint32_t> m_removed;
+  /** The timestamp of the last event removed. */
+  uint64_t m_lastTs;
+  /** Number of events in queue. */
+  uint32_t m_qSize;
+};
+
+} // namespace ns3
+
+#endif /* LADDER_SCHEDULER_H */
@@ -0,0 +1,765 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "simulator.h"
+#include "multithreaded-simulator-impl.h"
+#include "system-thread.h"
+#include "scheduler.h"
+#include "event-impl.h"
+
+#include "ptr.h"
+#include "nstime.h"
+#include "assert.h"
+#include "abort.h"
+#include "log.h"
+
+#include <algorithm>
+#include <thread>
+
+/**
+ * \file
+ * \ingroup simulator
+ * ns3::MultithreadedSimulatorImpl implementation.
+ */
+
+namespace ns3 {
+
+// Note:  Logging in this file is largely avoided due to the
+// number of calls that are made to these functions and the possibility
+// of causing recursions leading to stack overflow
+NS_LOG_COMPONENT_DEFINE ("MultithreadedSimulatorImpl");
+
+NS_OBJECT_ENSURE_REGISTERED (MultithreadedSimulatorImpl);
+
+namespace {
+
+/** Timestamp of the end of time, for empty queues and no stop. */
+const uint64_t MAX_TS = 0xffffffffffffffffULL;
+
+/** Barrier iterations spinning before yielding the processor. */
+const uint32_t BARRIER_SPINS = 1000;
+
+} // unnamed namespace
+
+thread_local MultithreadedSimulatorImpl::Partition *MultithreadedSimulatorImpl::g_current = 0;
+
+TypeId
+MultithreadedSimulatorImpl::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::MultithreadedSimulatorImpl")
+    .SetParent<SimulatorImpl> ()
+    .SetGroupName ("Core")
+    .AddConstructor<MultithreadedSimulatorImpl> ()
+    .AddAttribute ("Lookahead",
+                   "The minimum delay of the events scheduled for another "
+                   "partition, usually the smallest delay of the channels "
+                   "between partitions.",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&MultithreadedSimulatorImpl::m_lookahead),
+                   MakeTimeChecker (Seconds (0)))
+  ;
+  return tid;
+}
+
+MultithreadedSimulatorImpl::MultithreadedSimulatorImpl ()
+  : m_distributed (true),
+    m_running (false),
+    m_stop (false),
+    m_stopTs (MAX_TS),
+    m_nextThread (1),
+    m_barrierCount (0),
+    m_barrierGeneration (0)
+{
+  NS_LOG_FUNCTION (this);
+  m_schedulerFactory.SetTypeId ("ns3::MapScheduler");
+  AddPartition ();
+}
+
+MultithreadedSimulatorImpl::~MultithreadedSimulatorImpl ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+MultithreadedSimulatorImpl::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  for (std::vector<Partition *>::iterator i = m_partitions.begin (); i != m_partitions.end (); ++i)
+    {
+      Partition *p = *i;
+      Message *m = p->mailbox.exchange (0);
+      while (m != 0)
+        {
+          Message *next = m->next;
+          m->ev.impl->Unref ();
+          delete m;
+          m = next;
+        }
+      while (!p->events->IsEmpty ())
+        {
+          Scheduler::Event next = p->events->RemoveNext ();
+          next.impl->Unref ();
+        }
+      delete p;
+    }
+  m_partitions.clear ();
+  SimulatorImpl::DoDispose ();
+}
+
+void
+MultithreadedSimulatorImpl::Destroy ()
+{
+  NS_LOG_FUNCTION (this);
+  while (!m_destroyEvents.empty ())
+    {
+      Ptr<EventImpl> ev = m_destroyEvents.front ().PeekEventImpl ();
+      m_destroyEvents.pop_front ();
+      NS_LOG_LOGIC ("handle destroy " << ev);
+      if (!ev->IsCancelled ())
+        {
+          ev->Invoke ();
+        }
+    }
+}
+
+MultithreadedSimulatorImpl::Partition *
+MultithreadedSimulatorImpl::AddPartition (void)
+{
+  NS_LOG_FUNCTION (this << m_partitions.size ());
+  Partition *p = new Partition;
+  p->events = m_schedulerFactory.Create<Scheduler> ();
+  p->index = m_partitions.size ();
+  if (m_partitions.empty ())
+    {
+      // uids are allocated from 4.
+      // uid 0 is "invalid" events
+      // uid 1 is "now" events
+      // uid 2 is "destroy" events
+      p->uid = 4;
+      p->currentTs = 0;
+    }
+  else
+    {
+      p->uid = m_partitions[0]->uid;
+      p->currentTs = m_partitions[0]->currentTs;
+    }
+  p->currentUid = 0;
+  p->currentContext = Simulator::NO_CONTEXT;
+  p->eventCount = 0;
+  p->unscheduledEvents = 0;
+  p->sent = 0;
+  p->nextTs = MAX_TS;
+  p->stop = false;
+  p->stopTs = MAX_TS;
+  p->mailbox.store (0);
+  m_partitions.push_back (p);
+  return p;
+}
+
+void
+MultithreadedSimulatorImpl::SetScheduler (ObjectFactory schedulerFactory)
+{
+  NS_LOG_FUNCTION (this << schedulerFactory);
+  NS_ASSERT (!m_running);
+  m_schedulerFactory = schedulerFactory;
+  for (std::vector<Partition *>::iterator i = m_partitions.begin (); i != m_partitions.end (); ++i)
+    {
+      Ptr<Scheduler> scheduler = schedulerFactory.Create<Scheduler> ();
+      while (!(*i)->events->IsEmpty ())
+        {
+          scheduler->Insert ((*i)->events->RemoveNext ());
+        }
+      (*i)->events = scheduler;
+    }
+}
+
+void
+MultithreadedSimulatorImpl::SetPartition (uint32_t context, uint32_t partition)
+{
+  NS_LOG_FUNCTION (this << context << partition);
+  NS_ASSERT_MSG (!m_running, "Partitions cannot change while the simulation runs");
+  NS_ASSERT (context != Simulator::NO_CONTEXT);
+  if (context >= m_contexts.size ())
+    {
+      m_contexts.resize (context + 1, 0);
+    }
+  m_contexts[context] = partition;
+  while (m_partitions.size () <= partition)
+    {
+      AddPartition ();
+    }
+  m_distributed = false;
+}
+
+uint32_t
+MultithreadedSimulatorImpl::GetPartition (uint32_t context) const
+{
+  return context < m_contexts.size () ? m_contexts[context] : 0;
+}
+
+uint32_t
+MultithreadedSimulatorImpl::GetPartitionCount (void) const
+{
+  return m_partitions.size ();
+}
+
+MultithreadedSimulatorImpl::Partition *
+MultithreadedSimulatorImpl::GetCurrent (void) const
+{
+  return g_current != 0 ? g_current : m_partitions[0];
+}
+
+MultithreadedSimulatorImpl::Partition *
+MultithreadedSimulatorImpl::GetOwner (uint32_t context) const
+{
+  return m_partitions[GetPartition (context)];
+}
+
+// System ID for non-distributed simulation is always zero
+uint32_t
+MultithreadedSimulatorImpl::GetSystemId (void) const
+{
+  return 0;
+}
+
+uint32_t
+MultithreadedSimulatorImpl::Insert (Partition *p, uint64_t ts, uint32_t context, EventImpl *event)
+{
+  Scheduler::Event ev;
+  ev.impl = event;
+  ev.key.m_ts = ts;
+  ev.key.m_context = context;
+  // before Run the events may still move between partitions, so that
+  // their uids come from a single counter
+  Partition *counter = m_running ? p : m_partitions[0];
+  ev.key.m_uid = counter->uid;
+  counter->uid++;
+  p->unscheduledEvents++;
+  p->events->Insert (ev);
+  return ev.key.m_uid;
+}
+
+void
+MultithreadedSimulatorImpl::Distribute (void)
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT (!m_running);
+  std::vector<Scheduler::Event> moved;
+  for (std::vector<Partition *>::iterator i = m_partitions.begin (); i != m_partitions.end (); ++i)
+    {
+      Partition *p = *i;
+      std::vector<Scheduler::Event> kept;
+      while (!p->events->IsEmpty ())
+        {
+          Scheduler::Event ev = p->events->RemoveNext ();
+          if (GetOwner (ev.key.m_context) == p)
+            {
+              kept.push_back (ev);
+            }
+          else
+            {
+              moved.push_back (ev);
+              p->unscheduledEvents--;
+            }
+        }
+      for (std::vector<Scheduler::Event>::const_iterator j = kept.begin (); j != kept.end (); ++j)
+        {
+          p->events->Insert (*j);
+        }
+    }
+  for (std::vector<Scheduler::Event>::const_iterator i = moved.begin (); i != moved.end (); ++i)
+    {
+      Partition *p = GetOwner (i->key.m_context);
+      p->unscheduledEvents++;
+      p->events->Insert (*i);
+    }
+  m_distributed = true;
+}
+
+void
+MultithreadedSimulatorImpl::ProcessOneEvent (Partition *p)
+{
+  Scheduler::Event next = p->events->RemoveNext ();
+
+  NS_ASSERT (next.key.m_ts >= p->currentTs);
+  p->unscheduledEvents--;
+  p->eventCount++;
+
+  p->currentTs = next.key.m_ts;
+  p->currentContext = next.key.m_context;
+  p->currentUid = next.key.m_uid;
+  next.impl->Invoke ();
+  next.impl->Unref ();
+}
+
+bool
+MultithreadedSimulatorImpl::IsFinished (void) const
+{
+  if (m_stop || (m_running && GetCurrent ()->stop))
+    {
+      return true;
+    }
+  for (std::vector<Partition *>::const_iterator i = m_partitions.begin (); i != m_partitions.end (); ++i)
+    {
+      if (!(*i)->events->IsEmpty () || (*i)->mailbox.load () != 0)
+        {
+          return false;
+        }
+    }
+  return true;
+}
+
+bool
+MultithreadedSimulatorImpl::MessageLess (const Message *a, const Message *b)
+{
+  if (a->ev.key.m_ts != b->ev.key.m_ts)
+    {
+      return a->ev.key.m_ts < b->ev.key.m_ts;
+    }
+  if (a->source != b->source)
+    {
+      return a->source < b->source;
+    }
+  return a->ev.key.m_uid < b->ev.key.m_uid;
+}
+
+void
+MultithreadedSimulatorImpl::ReceiveMessages (Partition *p)
+{
+  Message *m = p->mailbox.exchange (0, std::memory_order_acquire);
+  while (m != 0)
+    {
+      p->inbox.push_back (m);
+      m = m->next;
+    }
+  if (p->inbox.empty ())
+    {
+      return;
+    }
+  // the mailbox order depends on the thread timing, the delivery order must not
+  std::sort (p->inbox.begin (), p->inbox.end (), MessageLess);
+  for (std::vector<Message *>::const_iterator i = p->inbox.begin (); i != p->inbox.end (); ++i)
+    {
+      Scheduler::Event ev = (*i)->ev;
+      ev.key.m_uid = p->uid;
+      p->uid++;
+      p->unscheduledEvents++;
+      p->events->Insert (ev);
+      delete *i;
+    }
+  p->inbox.clear ();
+}
+
+void
+MultithreadedSimulatorImpl::Barrier (void)
+{
+  uint32_t n = m_partitions.size ();
+  if (n == 1)
+    {
+      return;
+    }
+  uint32_t generation = m_barrierGeneration.load (std::memory_order_acquire);
+  if (m_barrierCount.fetch_add (1, std::memory_order_acq_rel) + 1 == n)
+    {
+      m_barrierCount.store (0, std::memory_order_relaxed);
+      m_barrierGeneration.fetch_add (1, std::memory_order_release);
+      return;
+    }
+  uint32_t spins = 0;
+  while (m_barrierGeneration.load (std::memory_order_acquire) == generation)
+    {
+      if (++spins > BARRIER_SPINS)
+        {
+          std::this_thread::yield ();
+        }
+    }
+}
+
+void
+MultithreadedSimulatorImpl::ProcessPartition (Partition *p)
+{
+  NS_LOG_FUNCTION (this << p->index);
+  uint32_t n = m_partitions.size ();
+  uint64_t lookahead = m_lookahead.GetTimeStep ();
+  while (true)
+    {
+      // all the messages of the previous window are in the mailboxes
+      Barrier ();
+      ReceiveMessages (p);
+      p->nextTs = p->events->IsEmpty () ? MAX_TS : p->events->PeekNext ().key.m_ts;
+      // the stop requests of the previous window are applied by all
+      // the partitions at once, whatever the timing of the threads;
+      // no event runs between the two barriers to change them
+      bool stop = m_stop;
+      uint64_t stopTs = m_stopTs;
+      for (uint32_t i = 0; i < n; i++)
+        {
+          stop = stop || m_partitions[i]->stop;
+          stopTs = std::min (stopTs, m_partitions[i]->stopTs);
+        }
+      Barrier ();
+
+      uint64_t start = MAX_TS;
+      for (uint32_t i = 0; i < n; i++)
+        {
+          start = std::min (start, m_partitions[i]->nextTs);
+        }
+      if (stop || start == MAX_TS || start >= stopTs)
+        {
+          break;
+        }
+      // the window ends before any message sent in it can be received
+      uint64_t last = stopTs - 1;
+      if (n > 1 && stopTs - start >= lookahead)
+        {
+          last = start + lookahead - 1;
+        }
+      // a stop requested in this window only ends it for its partition
+      while (!p->stop
+             && !p->events->IsEmpty ()
+             && p->events->PeekNext ().key.m_ts <= last
+             && p->events->PeekNext ().key.m_ts < p->stopTs)
+        {
+          ProcessOneEvent (p);
+        }
+    }
+}
+
+void
+MultithreadedSimulatorImpl::RunThread (void)
+{
+  uint32_t index = m_nextThread.fetch_add (1);
+  NS_LOG_FUNCTION (this << index);
+  g_current = m_partitions[index];
+  ProcessPartition (g_current);
+  g_current = 0;
+}
+
+void
+MultithreadedSimulatorImpl::Run (void)
+{
+  NS_LOG_FUNCTION (this);
+  uint32_t n = m_partitions.size ();
+  NS_ABORT_MSG_IF (n > 1 && m_lookahead.IsZero (),
+                   "MultithreadedSimulatorImpl::Run(): partitions need a positive Lookahead");
+#ifndef NS3_MULTITHREADING
+  // reference counts, buffers and packet uids are shared without atomics
+  NS_ABORT_MSG_IF (n > 1, "MultithreadedSimulatorImpl::Run(): partitions need ns-3 "
+                   "configured with --enable-multithreading");
+#endif /* NS3_MULTITHREADING */
+  if (!m_distributed)
+    {
+      Distribute ();
+    }
+  uint32_t uid = m_partitions[0]->uid;
+  for (uint32_t i = 1; i < n; i++)
+    {
+      m_partitions[i]->uid = uid;
+    }
+  m_stop = false;
+  m_running = true;
+  m_nextThread = 1;
+
+  std::vector<Ptr<SystemThread> > threads;
+  for (uint32_t i = 1; i < n; i++)
+    {
+      Ptr<SystemThread> thread =
+        Create<SystemThread> (MakeCallback (&MultithreadedSimulatorImpl::RunThread, this));
+      thread->Start ();
+      threads.push_back (thread);
+    }
+  ProcessPartition (m_partitions[0]);
+  for (std::vector<Ptr<SystemThread> >::iterator i = threads.begin (); i != threads.end (); ++i)
+    {
+      (*i)->Join ();
+    }
+  m_running = false;
+
+  // align the clocks of the partitions, without going past a pending
+  // event, and make sure the uids of the next events stay unique
+  uint64_t now = 0;
+  uint64_t next = MAX_TS;
+  uid = 0;
+  for (uint32_t i = 0; i < n; i++)
+    {
+      Partition *p = m_partitions[i];
+      now = std::max (now, p->currentTs);
+      uid = std::max (uid, p->uid);
+      if (!p->events->IsEmpty ())
+        {
+          next = std::min (next, p->events->PeekNext ().key.m_ts);
+        }
+    }
+  for (uint32_t i = 0; i < n; i++)
+    {
+      Partition *p = m_partitions[i];
+      m_stop = m_stop || p->stop;
+      m_stopTs = std::min (m_stopTs, p->stopTs);
+      p->stop = false;
+      p->stopTs = MAX_TS;
+    }
+  uint64_t stopTs = m_stopTs;
+  if (!m_stop && stopTs != MAX_TS && next >= stopTs)
+    {
+      // the simulation stopped at the time requested
+      now = std::max (now, stopTs);
+      m_stopTs = MAX_TS;
+    }
+  now = std::min (now, next);
+  for (uint32_t i = 0; i < n; i++)
+    {
+      Partition *p = m_partitions[i];
+      if (p->currentTs != now)
+        {
+          p->currentTs = now;
+          p->currentUid = 0;
+        }
+      p->uid = uid;
+    }
+
+  // If the simulator stopped naturally by lack of events, make a
+  // consistency test to check that we didn't lose any events along the way.
+  for (uint32_t i = 0; i < n; i++)
+    {
+      NS_ASSERT (!m_partitions[i]->events->IsEmpty () || m_partitions[i]->unscheduledEvents == 0);
+    }
+}
+
+void
+MultithreadedSimulatorImpl::Stop (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_running)
+    {
+      // seen by the other partitions at the end of the window
+      GetCurrent ()->stop = true;
+    }
+  else
+    {
+      m_stop = true;
+    }
+}
+
+void
+MultithreadedSimulatorImpl::Stop (Time const &delay)
+{
+  NS_LOG_FUNCTION (this << delay.GetTimeStep ());
+  NS_ASSERT_MSG (delay.IsPositive (), "MultithreadedSimulatorImpl::Stop(): Negative delay");
+  Partition *p = GetCurrent ();
+  uint64_t ts = p->currentTs + delay.GetTimeStep ();
+  if (m_running)
+    {
+      p->stopTs = std::min (p->stopTs, ts);
+    }
+  else
+    {
+      m_stopTs = std::min (m_stopTs, ts);
+    }
+}
+
+//
+// Schedule an event for a _relative_ time in the future.
+//
+EventId
+MultithreadedSimulatorImpl::Schedule (Time const &delay, EventImpl *event)
+{
+  NS_LOG_FUNCTION (this << delay.GetTimeStep () << event);
+  NS_ASSERT_MSG (delay.IsPositive (), "MultithreadedSimulatorImpl::Schedule(): Negative delay");
+  Partition *p = GetCurrent ();
+  uint64_t ts = p->currentTs + delay.GetTimeStep ();
+  uint32_t uid = Insert (p, ts, p->currentContext, event);
+  return EventId (event, ts, p->currentContext, uid);
+}
+
+void
+MultithreadedSimulatorImpl::ScheduleWithContext (uint32_t context, Time const &delay, EventImpl *event)
+{
+  NS_LOG_FUNCTION (this << context << delay.GetTimeStep () << event);
+  NS_ASSERT_MSG (delay.IsPositive (), "MultithreadedSimulatorImpl::ScheduleWithContext(): Negative delay");
+  Partition *p = GetCurrent ();
+  Partition *target = GetOwner (context);
+  uint64_t ts = p->currentTs + delay.GetTimeStep ();
+  if (!m_running || target == p)
+    {
+      Insert (target, ts, context, event);
+      return;
+    }
+
+  NS_ABORT_MSG_IF (delay < m_lookahead,
+                   "MultithreadedSimulatorImpl::ScheduleWithContext(): delay " << delay
+                   << " to partition " << target->index << " below the lookahead " << m_lookahead);
+  Message *m = new Message;
+  m->ev.impl = event;
+  m->ev.key.m_ts = ts;
+  m->ev.key.m_context = context;
+  m->ev.key.m_uid = p->sent;
+  p->sent++;
+  m->source = p->index;
+  m->next = target->mailbox.load (std::memory_order_relaxed);
+  while (!target->mailbox.compare_exchange_weak (m->next, m,
+                                                 std::memory_order_release,
+                                                 std::memory_order_relaxed))
+    {
+    }
+}
+
+EventId
+MultithreadedSimulatorImpl::ScheduleNow (EventImpl *event)
+{
+  Partition *p = GetCurrent ();
+  uint32_t uid = Insert (p, p->currentTs, p->currentContext, event);
+  return EventId (event, p->currentTs, p->currentContext, uid);
+}
+
+EventId
+MultithreadedSimulatorImpl::ScheduleDestroy (EventImpl *event)
+{
+  EventId id (Ptr<EventImpl> (event, false), GetCurrent ()->currentTs, 0xffffffff, 2);
+  CriticalSection cs (m_destroyEventsMutex);
+  m_destroyEvents.push_back (id);
+  return id;
+}
+
+Time
+MultithreadedSimulatorImpl::Now (void) const
+{
+  // Do not add function logging here, to avoid stack overflow
+  return TimeStep (GetCurrent ()->currentTs);
+}
+
+Time
+MultithreadedSimulatorImpl::GetDelayLeft (const EventId &id) const
+{
+  if (IsExpired (id))
+    {
+      return TimeStep (0);
+    }
+  else
+    {
+      return TimeStep (id.GetTs () - GetCurrent ()->currentTs);
+    }
+}
+
+void
+MultithreadedSimulatorImpl::Remove (const EventId &id)
+{
+  if (id.GetUid () == 2)
+    {
+      // destroy events.
+      CriticalSection cs (m_destroyEventsMutex);
+      for (DestroyEvents::iterator i = m_destroyEvents.begin (); i != m_destroyEvents.end (); i++)
+        {
+          if (*i == id)
+            {
+              m_destroyEvents.erase (i);
+              break;
+            }
+        }
+      return;
+    }
+  if (IsExpired (id))
+    {
+      return;
+    }
+  if (!m_distributed)
+    {
+      Distribute ();
+    }
+  Partition *p = GetOwner (id.GetContext ());
+  NS_ASSERT_MSG (!m_running || p == GetCurrent (),
+                 "MultithreadedSimulatorImpl::Remove(): event of another partition");
+  Scheduler::Event event;
+  event.impl = id.PeekEventImpl ();
+  event.key.m_ts = id.GetTs ();
+  event.key.m_context = id.GetContext ();
+  event.key.m_uid = id.GetUid ();
+  p->events->Remove (event);
+  event.impl->Cancel ();
+  // whenever we remove an event from the event list, we have to unref it.
+  event.impl->Unref ();
+
+  p->unscheduledEvents--;
+}
+
+void
+MultithreadedSimulatorImpl::Cancel (const EventId &id)
+{
+  if (!IsExpired (id))
+    {
+      id.PeekEventImpl ()->Cancel ();
+    }
+}
+
+bool
+MultithreadedSimulatorImpl::IsExpired (const EventId &id) const
+{
+  if (id.GetUid () == 2)
+    {
+      if (id.PeekEventImpl () == 0 ||
+          id.PeekEventImpl ()->IsCancelled ())
+        {
+          return true;
+        }
+      // destroy events.
+      CriticalSection cs (m_destroyEventsMutex);
+      for (DestroyEvents::const_iterator i = m_destroyEvents.begin (); i != m_destroyEvents.end (); i++)
+        {
+          if (*i == id)
+            {
+              return false;
+            }
+        }
+      return true;
+    }
+  Partition *p = GetOwner (id.GetContext ());
+  if (id.PeekEventImpl () == 0 ||
+      id.GetTs () < p->currentTs ||
+      (id.GetTs () == p->currentTs &&
+       id.GetUid () <= p->currentUid) ||
+      id.PeekEventImpl ()->IsCancelled ())
+    {
+      return true;
+    }
+  else
+    {
+      return false;
+    }
+}
+
+Time
+MultithreadedSimulatorImpl::GetMaximumSimulationTime (void) const
+{
+  return TimeStep (0x7fffffffffffffffLL);
+}
+
+uint32_t
+MultithreadedSimulatorImpl::GetContext (void) const
+{
+  return GetCurrent ()->currentContext;
+}
+
+uint64_t
+MultithreadedSimulatorImpl::GetEventCount (void) const
+{
+  uint64_t count = 0;
+  for (std::vector<Partition *>::const_iterator i = m_partitions.begin (); i != m_partitions.end (); ++i)
+    {
+      count += (*i)->eventCount;
+    }
+  return count;
+}
+
+} // namespace ns3
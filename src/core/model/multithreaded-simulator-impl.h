@@ -0,0 +1,243 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef MULTITHREADED_SIMULATOR_IMPL_H
+#define MULTITHREADED_SIMULATOR_IMPL_H
+
+#include "simulator-impl.h"
+#include "scheduler.h"
+#include "event-impl.h"
+#include "system-mutex.h"
+#include "nstime.h"
+#include "object-factory.h"
+#include "ptr.h"
+
+#include <atomic>
+#include <list>
+#include <vector>
+
+/**
+ * \file
+ * \ingroup simulator
+ * ns3::MultithreadedSimulatorImpl declaration.
+ */
+
+namespace ns3 {
+
+/**
+ * \ingroup simulator
+ *
+ * \brief A conservative parallel simulator running partitions of the
+ * contexts in the threads of one process.
+ *
+ * Each context, usually a node id, is assigned to a partition with
+ * SetPartition; unassigned contexts, and events without context,
+ * belong to partition 0. Every partition has its own event queue and
+ * runs in its own thread, partition 0 in the thread calling Run.
+ *
+ * The partitions advance in windows: all of them execute their events
+ * before the earliest pending timestamp plus the Lookahead, then wait
+ * for each other at a barrier. An event scheduled with context for
+ * another partition must be at least Lookahead in the future, which
+ * is guaranteed when the lookahead is the smallest delay of the
+ * channels between partitions. Such events are pushed to a lock free
+ * mailbox of the target partition and inserted in its queue at the
+ * next barrier, in timestamp, source partition and send order, so
+ * that runs are reproducible.
+ *
+ * Events must only be cancelled, removed or checked by the partition
+ * they belong to. A Stop requested from an event ends the window of
+ * its partition, the other partitions complete theirs and see the
+ * request at the next barrier, so that the events run do not depend
+ * on the timing of the threads. Events at the time of a Stop with
+ * delay are left pending in its partition, and in the others when
+ * the delay is at least the Lookahead.
+ *
+ * Objects and packets shared between partitions are only safe when
+ * ns-3 is configured with --enable-multithreading, which makes their
+ * reference counts atomic: without it, Run aborts if there is more
+ * than one partition.
+ */
+class MultithreadedSimulatorImpl : public SimulatorImpl
+{
+public:
+  /**
+   *  Register this type.
+   *  \return The object TypeId.
+   */
+  static TypeId GetTypeId (void);
+
+  /** Constructor. */
+  MultithreadedSimulatorImpl ();
+  /** Destructor. */
+  ~MultithreadedSimulatorImpl ();
+
+  // Inherited
+  virtual void Destroy ();
+  virtual bool IsFinished (void) const;
+  virtual void Stop (void);
+  virtual void Stop (const Time &delay);
+  virtual EventId Schedule (const Time &delay, EventImpl *event);
+  virtual void ScheduleWithContext (uint32_t context, const Time &delay, EventImpl *event);
+  virtual EventId ScheduleNow (EventImpl *event);
+  virtual EventId ScheduleDestroy (EventImpl *event);
+  virtual void Remove (const EventId &id);
+  virtual void Cancel (const EventId &id);
+  virtual bool IsExpired (const EventId &id) const;
+  virtual void Run (void);
+  virtual Time Now (void) const;
+  virtual Time GetDelayLeft (const EventId &id) const;
+  virtual Time GetMaximumSimulationTime (void) const;
+  virtual void SetScheduler (ObjectFactory schedulerFactory);
+  virtual uint32_t GetSystemId (void) const;
+  virtual uint32_t GetContext (void) const;
+  virtual uint64_t GetEventCount (void) const;
+
+  /**
+   * Assign a context to a partition. Must not be called while
+   * the simulation runs.
+   *
+   * \param [in] context The context, usually a node id.
+   * \param [in] partition The partition.
+   */
+  void SetPartition (uint32_t context, uint32_t partition);
+  /**
+   * \param [in] context The context.
+   * \returns The partition of the context.
+   */
+  uint32_t GetPartition (uint32_t context) const;
+  /** \returns The number of partitions, and of threads running them. */
+  uint32_t GetPartitionCount (void) const;
+
+private:
+  virtual void DoDispose (void);
+
+  /** An event scheduled for another partition. */
+  struct Message
+  {
+    Scheduler::Event ev;  //!< The event, with the send order as uid.
+    uint32_t source;      //!< The source partition.
+    Message *next;        //!< Next message in the mailbox.
+  };
+
+  /** The state of a partition, on its own cache lines. */
+  struct alignas (64) Partition
+  {
+    Ptr<Scheduler> events;          //!< The event queue.
+    uint32_t index;                 //!< The partition index.
+    uint32_t uid;                   //!< Next event unique id.
+    uint32_t currentUid;            //!< Unique id of the current event.
+    uint64_t currentTs;             //!< Timestamp of the current event.
+    uint32_t currentContext;        //!< Context of the current event.
+    uint64_t eventCount;            //!< The event count.
+    int unscheduledEvents;          //!< Events inserted but not executed.
+    uint32_t sent;                  //!< Messages sent, for their order.
+    uint64_t nextTs;                //!< Next timestamp, at the barrier.
+    bool stop;                      //!< Stop requested in the window.
+    uint64_t stopTs;                //!< Stop time requested in the window.
+    std::vector<Message *> inbox;   //!< Received messages being sorted.
+    std::atomic<Message *> mailbox; //!< Messages from other partitions.
+  };
+
+  /**
+   * Order messages by timestamp, source partition and send order.
+   * \param [in] a The first message.
+   * \param [in] b The second message.
+   * \returns \c true if \p a is delivered before \p b.
+   */
+  static bool MessageLess (const Message *a, const Message *b);
+
+  /** \returns The partition of the calling thread. */
+  inline Partition * GetCurrent (void) const;
+  /**
+   * \param [in] context The context.
+   * \returns The partition running the context.
+   */
+  inline Partition * GetOwner (uint32_t context) const;
+  /**
+   * Add a partition, with the clock and uids of partition 0.
+   * \returns The partition.
+   */
+  Partition * AddPartition (void);
+  /**
+   * Insert an event in the queue of a partition.
+   *
+   * \param [in] p The partition.
+   * \param [in] ts The event timestamp.
+   * \param [in] context The event context.
+   * \param [in] event The event.
+   * \returns The event unique id.
+   */
+  uint32_t Insert (Partition *p, uint64_t ts, uint32_t context, EventImpl *event);
+  /** Move the events to the partition of their context. */
+  void Distribute (void);
+  /**
+   * Insert the messages of the mailbox of a partition in its queue.
+   * \param [in] p The partition.
+   */
+  void ReceiveMessages (Partition *p);
+  /**
+   * Process the next event of a partition.
+   * \param [in] p The partition.
+   */
+  void ProcessOneEvent (Partition *p);
+  /**
+   * Run a partition, window by window, until the simulation ends.
+   * \param [in] p The partition.
+   */
+  void ProcessPartition (Partition *p);
+  /** Entry point of the threads running partitions 1 and above. */
+  void RunThread (void);
+  /** Wait until all the partitions reach the barrier. */
+  void Barrier (void);
+
+  /** The partition of the calling thread, 0 for partition 0. */
+  static thread_local Partition *g_current;
+
+  /** The partitions. */
+  std::vector<Partition *> m_partitions;
+  /** The partition of each context. */
+  std::vector<uint32_t> m_contexts;
+  /** The scheduler type of the partitions. */
+  ObjectFactory m_schedulerFactory;
+  /** The minimum delay of the events between partitions. */
+  Time m_lookahead;
+  /** Flag \c true if the events are in the partition of their context. */
+  bool m_distributed;
+  /** Flag \c true while the partitions run. */
+  bool m_running;
+  /** Flag calling for the end of the simulation. */
+  bool m_stop;
+  /** Timestamp at which the simulation stops. */
+  uint64_t m_stopTs;
+  /** Next partition to be run by a new thread. */
+  std::atomic<uint32_t> m_nextThread;
+  /** Partitions arrived at the barrier. */
+  std::atomic<uint32_t> m_barrierCount;
+  /** Barrier generation, incremented when all partitions arrived. */
+  std::atomic<uint32_t> m_barrierGeneration;
+
+  /** Container type for the events to run at Simulator::Destroy() */
+  typedef std::list<EventId> DestroyEvents;
+  /** The container of events to run at Destroy. */
+  DestroyEvents m_destroyEvents;
+  /** Mutex to control access to the list of events to run at Destroy. */
+  mutable SystemMutex m_destroyEventsMutex;
+};
+
+} // namespace ns3
+
+#endif /* MULTITHREADED_SIMULATOR_IMPL_H */
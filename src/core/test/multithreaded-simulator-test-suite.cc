@@ -0,0 +1,445 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/test.h"
+#include "ns3/simulator.h"
+#include "ns3/multithreaded-simulator-impl.h"
+#include "ns3/default-simulator-impl.h"
+#include "ns3/nstime.h"
+#include "ns3/event-impl.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+using namespace ns3;
+
+/**
+ * \ingroup core-tests
+ *
+ * \brief Ring of contexts exchanging events, run by the
+ * MultithreadedSimulatorImpl and by the DefaultSimulatorImpl.
+ */
+class MultithreadedSimulatorRingTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor.
+   * \param [in] partitions The number of partitions.
+   */
+  MultithreadedSimulatorRingTestCase (uint32_t partitions);
+
+private:
+  virtual void DoRun (void);
+
+  /** An event seen by a context: timestamp and value. */
+  typedef std::pair<int64_t, uint32_t> Record;
+  /** The events seen by each context. */
+  typedef std::vector<std::vector<Record> > Trace;
+
+  /**
+   * Record an event, then send it around the ring and, every
+   * other time, schedule a local event.
+   * \param [in] value The event value.
+   */
+  void Hop (uint32_t value);
+  /**
+   * Record a local event.
+   * \param [in] value The event value.
+   */
+  void Local (uint32_t value);
+  /**
+   * Run the ring with the simulator implementation.
+   * \param [in] multithreaded Flag to use the MultithreadedSimulatorImpl.
+   * \param [out] trace The events seen by each context.
+   * \param [out] count The number of events executed.
+   * \param [out] now The time at the end of the simulation.
+   */
+  void RunRing (bool multithreaded, Trace &trace, uint64_t &count, Time &now);
+
+  uint32_t m_partitions;  //!< The number of partitions.
+  Trace m_trace;          //!< The trace being recorded.
+};
+
+/** Number of contexts of the ring. */
+static const uint32_t RING_CONTEXTS = 8;
+
+MultithreadedSimulatorRingTestCase::MultithreadedSimulatorRingTestCase (uint32_t partitions)
+  : TestCase ("Check a ring of contexts over " + std::to_string (partitions) + " partitions"),
+    m_partitions (partitions)
+{
+}
+
+void
+MultithreadedSimulatorRingTestCase::Hop (uint32_t value)
+{
+  uint32_t context = Simulator::GetContext ();
+  m_trace[context].push_back (Record (Simulator::Now ().GetTimeStep (), value));
+  // delays at least the lookahead, some equal to create ties
+  Time delay = MicroSeconds (10 + (value * 7) % 5);
+  Simulator::ScheduleWithContext ((context + 1) % RING_CONTEXTS, delay,
+                                  &MultithreadedSimulatorRingTestCase::Hop, this, value + 1);
+  if (value % 2 == 0)
+    {
+      Simulator::Schedule (MicroSeconds (value % 3), &MultithreadedSimulatorRingTestCase::Local,
+                           this, value);
+    }
+}
+
+void
+MultithreadedSimulatorRingTestCase::Local (uint32_t value)
+{
+  m_trace[Simulator::GetContext ()].push_back (Record (Simulator::Now ().GetTimeStep (), value + 1000000));
+}
+
+void
+MultithreadedSimulatorRingTestCase::RunRing (bool multithreaded, Trace &trace, uint64_t &count, Time &now)
+{
+  m_trace = Trace (RING_CONTEXTS);
+  if (multithreaded)
+    {
+      Ptr<MultithreadedSimulatorImpl> impl = CreateObject<MultithreadedSimulatorImpl> ();
+      impl->SetAttribute ("Lookahead", TimeValue (MicroSeconds (10)));
+      for (uint32_t i = 0; i < RING_CONTEXTS; i++)
+        {
+          impl->SetPartition (i, i % m_partitions);
+        }
+      Simulator::SetImplementation (impl);
+    }
+  else
+    {
+      Simulator::SetImplementation (CreateObject<DefaultSimulatorImpl> ());
+    }
+
+  for (uint32_t i = 0; i < RING_CONTEXTS; i++)
+    {
+      Simulator::ScheduleWithContext (i, MicroSeconds (i), &MultithreadedSimulatorRingTestCase::Hop,
+                                      this, i * 100000);
+    }
+  Simulator::Stop (MilliSeconds (5));
+  Simulator::Run ();
+  now = Simulator::Now ();
+  count = Simulator::GetEventCount ();
+  Simulator::Destroy ();
+  trace = m_trace;
+}
+
+void
+MultithreadedSimulatorRingTestCase::DoRun (void)
+{
+  Trace expected;
+  uint64_t expectedCount;
+  Time expectedNow;
+  RunRing (false, expected, expectedCount, expectedNow);
+
+  Trace trace;
+  uint64_t count;
+  Time now;
+  RunRing (true, trace, count, now);
+  NS_TEST_ASSERT_MSG_EQ (now, expectedNow, "simulation not stopped at the stop time");
+  // the default simulator also counts the Stop event
+  NS_TEST_ASSERT_MSG_EQ (count + 1, expectedCount, "different number of events");
+
+  Trace again;
+  RunRing (true, again, count, now);
+  for (uint32_t i = 0; i < RING_CONTEXTS; i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ ((again[i] == trace[i]), true, "events of context " << i << " not reproducible");
+      // events with the same timestamp may run in another order than
+      // with the default simulator
+      std::sort (trace[i].begin (), trace[i].end ());
+      std::sort (expected[i].begin (), expected[i].end ());
+      NS_TEST_ASSERT_MSG_EQ (trace[i].size (), expected[i].size (), "different number of events in context " << i);
+      NS_TEST_ASSERT_MSG_EQ ((trace[i] == expected[i]), true, "different events in context " << i);
+    }
+}
+
+/**
+ * \ingroup core-tests
+ *
+ * \brief Check Stop, Cancel and Remove within a partition.
+ */
+class MultithreadedSimulatorControlTestCase : public TestCase
+{
+public:
+  MultithreadedSimulatorControlTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /** Event which must not run. */
+  void Unexpected (void);
+  /** Schedule the event cancelled by CancelAndStop. */
+  void Arm (void);
+  /** Event cancelling an event of its partition, then stopping. */
+  void CancelAndStop (void);
+  /** Count an event. */
+  void Count (void);
+
+  EventId m_cancelled;  //!< Event cancelled by CancelAndStop.
+  uint32_t m_count;     //!< Counted events.
+  bool m_unexpected;    //!< Flag set by Unexpected.
+};
+
+MultithreadedSimulatorControlTestCase::MultithreadedSimulatorControlTestCase ()
+  : TestCase ("Check Stop, Cancel and Remove with partitions")
+{
+}
+
+void
+MultithreadedSimulatorControlTestCase::Unexpected (void)
+{
+  m_unexpected = true;
+}
+
+void
+MultithreadedSimulatorControlTestCase::Count (void)
+{
+  m_count++;
+}
+
+void
+MultithreadedSimulatorControlTestCase::Arm (void)
+{
+  m_cancelled = Simulator::Schedule (Seconds (1), &MultithreadedSimulatorControlTestCase::Unexpected, this);
+}
+
+void
+MultithreadedSimulatorControlTestCase::CancelAndStop (void)
+{
+  NS_TEST_EXPECT_MSG_EQ (m_cancelled.IsExpired (), false, "event to cancel already expired");
+  m_cancelled.Cancel ();
+  Simulator::Stop ();
+}
+
+void
+MultithreadedSimulatorControlTestCase::DoRun (void)
+{
+  m_count = 0;
+  m_unexpected = false;
+  Ptr<MultithreadedSimulatorImpl> impl = CreateObject<MultithreadedSimulatorImpl> ();
+  impl->SetAttribute ("Lookahead", TimeValue (MilliSeconds (1)));
+  Simulator::SetImplementation (impl);
+
+  // events scheduled before the partitions are known move to their context
+  Simulator::ScheduleWithContext (5, Seconds (1), &MultithreadedSimulatorControlTestCase::Count, this);
+  Simulator::ScheduleWithContext (6, Seconds (2), &MultithreadedSimulatorControlTestCase::Count, this);
+  Simulator::ScheduleWithContext (5, Seconds (3), &MultithreadedSimulatorControlTestCase::Count, this);
+  impl->SetPartition (5, 1);
+  impl->SetPartition (6, 2);
+  NS_TEST_ASSERT_MSG_EQ (impl->GetPartitionCount (), 3, "partitions not created");
+  NS_TEST_ASSERT_MSG_EQ (impl->GetPartition (6), 2, "bad partition");
+  NS_TEST_ASSERT_MSG_EQ (impl->GetPartition (100), 0, "unassigned context not in partition 0");
+
+  EventId removed = Simulator::Schedule (Seconds (1), &MultithreadedSimulatorControlTestCase::Unexpected, this);
+  Simulator::Remove (removed);
+  NS_TEST_ASSERT_MSG_EQ (removed.IsExpired (), true, "removed event not expired");
+
+  Simulator::Stop (Seconds (2.5));
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (Simulator::Now (), Seconds (2.5), "not stopped at the stop time");
+  NS_TEST_ASSERT_MSG_EQ (m_count, 2, "events up to the stop time not run");
+  NS_TEST_ASSERT_MSG_EQ (Simulator::IsFinished (), false, "events lost at the stop");
+
+  // resume, then stop from an event of partition 1
+  Simulator::ScheduleWithContext (5, Seconds (0.5), &MultithreadedSimulatorControlTestCase::Arm, this);
+  Simulator::ScheduleWithContext (5, Seconds (1), &MultithreadedSimulatorControlTestCase::CancelAndStop, this);
+  Simulator::ScheduleWithContext (6, Seconds (10), &MultithreadedSimulatorControlTestCase::Count, this);
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (m_unexpected, false, "cancelled or removed event run");
+  NS_TEST_ASSERT_MSG_EQ (m_count, 3, "bad number of events");
+  NS_TEST_ASSERT_MSG_EQ (Simulator::IsFinished (), true, "simulation not stopped");
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup core-tests
+ *
+ * \brief Check that a Stop from an event of one partition lets the
+ * other partitions complete the window, whatever the thread timing.
+ */
+class MultithreadedSimulatorStopTestCase : public TestCase
+{
+public:
+  MultithreadedSimulatorStopTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /** Count an event of the current context. */
+  void Count (void);
+  /** Count an event of the current context, then stop. */
+  void CountAndStop (void);
+
+  std::vector<uint32_t> m_counts;  //!< Events run per context.
+};
+
+/** Events of partition 2 in the window of the Stop. */
+static const uint32_t STOP_WINDOW_EVENTS = 1000;
+
+MultithreadedSimulatorStopTestCase::MultithreadedSimulatorStopTestCase ()
+  : TestCase ("Check a Stop from an event ends the window of all the partitions")
+{
+}
+
+void
+MultithreadedSimulatorStopTestCase::Count (void)
+{
+  m_counts[Simulator::GetContext ()]++;
+}
+
+void
+MultithreadedSimulatorStopTestCase::CountAndStop (void)
+{
+  Count ();
+  Simulator::Stop ();
+}
+
+void
+MultithreadedSimulatorStopTestCase::DoRun (void)
+{
+  for (uint32_t run = 0; run < 20; run++)
+    {
+      m_counts.assign (3, 0);
+      Ptr<MultithreadedSimulatorImpl> impl = CreateObject<MultithreadedSimulatorImpl> ();
+      impl->SetAttribute ("Lookahead", TimeValue (MilliSeconds (10)));
+      impl->SetPartition (1, 1);
+      impl->SetPartition (2, 2);
+      Simulator::SetImplementation (impl);
+
+      // the window runs from 1s to 1.01s
+      Simulator::ScheduleWithContext (1, Seconds (1), &MultithreadedSimulatorStopTestCase::CountAndStop, this);
+      Simulator::ScheduleWithContext (1, Seconds (1.001), &MultithreadedSimulatorStopTestCase::Count, this);
+      for (uint32_t i = 0; i < STOP_WINDOW_EVENTS; i++)
+        {
+          Simulator::ScheduleWithContext (2, Seconds (1) + MicroSeconds (5 * i),
+                                          &MultithreadedSimulatorStopTestCase::Count, this);
+        }
+      Simulator::ScheduleWithContext (2, Seconds (1.02), &MultithreadedSimulatorStopTestCase::Count, this);
+      Simulator::Run ();
+
+      NS_TEST_ASSERT_MSG_EQ (m_counts[1], 1, "partition 1 not stopped at its Stop in run " << run);
+      NS_TEST_ASSERT_MSG_EQ (m_counts[2], STOP_WINDOW_EVENTS,
+                             "partition 2 did not complete the window of the Stop in run " << run);
+      NS_TEST_ASSERT_MSG_EQ (Simulator::IsFinished (), true, "simulation not stopped");
+      Simulator::Destroy ();
+    }
+}
+
+#ifndef DISABLE_EVENT_POOL
+/**
+ * \ingroup core-tests
+ *
+ * \brief Check that the event free lists of the partition threads
+ * stay bounded over repeated runs.
+ */
+class MultithreadedSimulatorPoolTestCase : public TestCase
+{
+public:
+  MultithreadedSimulatorPoolTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * Forward the event once to the next context, in another partition.
+   * \param [in] forward Flag to forward the event.
+   */
+  void Hop (bool forward);
+};
+
+/** Events scheduled per context and per run, far beyond the free list limit. */
+static const uint32_t POOL_BURST = 50000;
+/**
+ * Bytes the main thread may keep in its free lists after a run: the
+ * partition threads have exited and released theirs, and the main
+ * thread keeps at most 1 MiB per size class.
+ */
+static const std::size_t POOL_BOUND = 4 << 20;
+
+MultithreadedSimulatorPoolTestCase::MultithreadedSimulatorPoolTestCase ()
+  : TestCase ("Check the event pool stays bounded with partitions")
+{
+}
+
+void
+MultithreadedSimulatorPoolTestCase::Hop (bool forward)
+{
+  if (forward)
+    {
+      Simulator::ScheduleWithContext ((Simulator::GetContext () + 1) % RING_CONTEXTS, MicroSeconds (10),
+                                      &MultithreadedSimulatorPoolTestCase::Hop, this, false);
+    }
+}
+
+void
+MultithreadedSimulatorPoolTestCase::DoRun (void)
+{
+  std::size_t before = EventImpl::GetPoolBytes ();
+  for (uint32_t run = 0; run < 3; run++)
+    {
+      Ptr<MultithreadedSimulatorImpl> impl = CreateObject<MultithreadedSimulatorImpl> ();
+      impl->SetAttribute ("Lookahead", TimeValue (MicroSeconds (10)));
+      for (uint32_t i = 0; i < RING_CONTEXTS; i++)
+        {
+          impl->SetPartition (i, i % 4);
+        }
+      Simulator::SetImplementation (impl);
+      for (uint32_t i = 0; i < RING_CONTEXTS; i++)
+        {
+          for (uint32_t j = 0; j < POOL_BURST; j++)
+            {
+              Simulator::ScheduleWithContext (i, NanoSeconds (j), &MultithreadedSimulatorPoolTestCase::Hop, this, true);
+            }
+        }
+      NS_TEST_ASSERT_MSG_GT (EventImpl::GetPoolBytes (), before + POOL_BOUND, "burst too small to fill the free lists");
+      Simulator::Run ();
+      NS_TEST_ASSERT_MSG_EQ (Simulator::GetEventCount (), 2 * RING_CONTEXTS * POOL_BURST, "events lost");
+      Simulator::Destroy ();
+      NS_TEST_ASSERT_MSG_LT_OR_EQ (EventImpl::GetPoolBytes (), before + POOL_BOUND,
+                                   "event pool not bounded after run " << run);
+    }
+}
+#endif /* DISABLE_EVENT_POOL */
+
+/**
+ * \ingroup core-tests
+ *
+ * \brief MultithreadedSimulatorImpl TestSuite
+ */
+class MultithreadedSimulatorTestSuite : public TestSuite
+{
+public:
+  MultithreadedSimulatorTestSuite ();
+};
+
+MultithreadedSimulatorTestSuite::MultithreadedSimulatorTestSuite ()
+  : TestSuite ("multithreaded-simulator", UNIT)
+{
+  AddTestCase (new MultithreadedSimulatorRingTestCase (1), TestCase::QUICK);
+  // more than one partition needs the atomic reference counts
+#ifdef NS3_MULTITHREADING
+  AddTestCase (new MultithreadedSimulatorRingTestCase (2), TestCase::QUICK);
+  AddTestCase (new MultithreadedSimulatorRingTestCase (4), TestCase::QUICK);
+  AddTestCase (new MultithreadedSimulatorControlTestCase, TestCase::QUICK);
+  AddTestCase (new MultithreadedSimulatorStopTestCase, TestCase::QUICK);
+#ifndef DISABLE_EVENT_POOL
+  AddTestCase (new MultithreadedSimulatorPoolTestCase, TestCase::QUICK);
+#endif /* DISABLE_EVENT_POOL */
+#endif /* NS3_MULTITHREADING */
+}
+
+static MultithreadedSimulatorTestSuite g_multithreadedSimulatorTestSuite; //!< Static variable for test initialization
@@ -23,6 +23,11 @@
 #include "ns3/heap-scheduler.h"
 #include "ns3/map-scheduler.h"
 #include "ns3/calendar-scheduler.h"
+#include "ns3/ladder-scheduler.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
 
 using namespace ns3;
 
@@ -170,6 +175,88 @@ SimulatorEventsTestCase::DoRun (void)
   NS_TEST_EXPECT_MSG_EQ (m_destroy, true, "Event should have run");
 }
 
+class SimulatorRemoveTestCase : public TestCase
+{
+public:
+  SimulatorRemoveTestCase (ObjectFactory schedulerFactory);
+  virtual void DoRun (void);
+  void Run (uint32_t n);
+  std::vector<uint32_t> m_ran;
+  ObjectFactory m_schedulerFactory;
+};
+
+SimulatorRemoveTestCase::SimulatorRemoveTestCase (ObjectFactory schedulerFactory)
+  : TestCase ("Check that removed events leave the others in order with " +
+              schedulerFactory.GetTypeId ().GetName ()),
+    m_schedulerFactory (schedulerFactory)
+{
+}
+
+void
+SimulatorRemoveTestCase::Run (uint32_t n)
+{
+  m_ran.push_back (n);
+}
+
+void
+SimulatorRemoveTestCase::DoRun (void)
+{
+  Simulator::SetScheduler (m_schedulerFactory);
+
+  // In a binary heap these events are stored in insertion order, the
+  // left subtree holds the late events and the right one the early
+  // events.  Removing 101 moves 4, the last event, under 100: it has to
+  // go up to keep the heap ordered.
+  uint32_t times[] = { 1, 100, 2, 101, 102, 3, 4 };
+  std::vector<EventId> ids;
+  for (uint32_t i = 0; i < 7; i++)
+    {
+      ids.push_back (Simulator::Schedule (MicroSeconds (times[i]), &SimulatorRemoveTestCase::Run, this, times[i]));
+    }
+  Simulator::Remove (ids[3]);
+  NS_TEST_EXPECT_MSG_EQ (ids[3].IsExpired (), true, "Event was removed: it is now expired");
+  Simulator::Run ();
+  uint32_t expected[] = { 1, 2, 3, 4, 100, 102 };
+  NS_TEST_ASSERT_MSG_EQ (m_ran.size (), 6, "Wrong number of events run");
+  for (uint32_t i = 0; i < 6; i++)
+    {
+      NS_TEST_EXPECT_MSG_EQ (m_ran[i], expected[i], "Events run out of order");
+    }
+
+  // Interior removals in random heaps
+  std::mt19937 rng (1);
+  std::vector<bool> removed (1000, false);
+  ids.clear ();
+  m_ran.clear ();
+  for (uint32_t i = 0; i < 1000; i++)
+    {
+      ids.push_back (Simulator::Schedule (MicroSeconds (1 + rng () % 100000), &SimulatorRemoveTestCase::Run, this, i));
+    }
+  for (uint32_t i = 0; i < 300; i++)
+    {
+      uint32_t victim = rng () % 1000;
+      if (!removed[victim])
+        {
+          Simulator::Remove (ids[victim]);
+          removed[victim] = true;
+        }
+    }
+  Simulator::Run ();
+  uint32_t kept = std::count (removed.begin (), removed.end (), false);
+  NS_TEST_ASSERT_MSG_EQ (m_ran.size (), kept, "Wrong number of events run");
+  for (uint32_t i = 0; i < m_ran.size (); i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (removed[m_ran[i]], false, "Removed event " << m_ran[i] << " run");
+      if (i > 0)
+        {
+          NS_TEST_ASSERT_MSG_EQ ((ids[m_ran[i - 1]].GetTs () <= ids[m_ran[i]].GetTs ()), true,
+                                 "Events run out of order");
+        }
+    }
+
+  Simulator::Destroy ();
+}
+
 class SimulatorTemplateTestCase : public TestCase
 {
 public:
@@ -477,5 +564,12 @@ public:
     AddTestCase (new SimulatorEventsTestCase (factory), TestCase::QUICK);
     factory.SetTypeId (CalendarScheduler::GetTypeId ());
     AddTestCase (new SimulatorEventsTestCase (factory), TestCase::QUICK);
+    factory.SetTypeId (LadderScheduler::GetTypeId ());
+    AddTestCase (new SimulatorEventsTestCase (factory), TestCase::QUICK);
+
+    factory.SetTypeId (HeapScheduler::GetTypeId ());
+    AddTestCase (new SimulatorRemoveTestCase (factory), TestCase::QUICK);
+    factory.SetTypeId (LadderScheduler::GetTypeId ());
+    AddTestCase (new SimulatorRemoveTestCase (factory), TestCase::QUICK);
   }
 } g_simulatorTestSuite;
@@ -26,6 +26,9 @@
 #include "ns3/net-device-queue-interface.h"
 #include "ns3/csma-net-device.h"
 #include "ns3/csma-channel.h"
+#include "ns3/csma-remote-channel.h"
+#include "ns3/mpi-interface.h"
+#include "ns3/mpi-receiver.h"
 #include "ns3/config.h"
 #include "ns3/packet.h"
 #include "ns3/names.h"
@@ -44,6 +47,7 @@ CsmaHelper::CsmaHelper ()
   m_queueFactory.SetTypeId ("ns3::DropTailQueue<Packet>");
   m_deviceFactory.SetTypeId ("ns3::CsmaNetDevice");
   m_channelFactory.SetTypeId ("ns3::CsmaChannel");
+  m_remoteChannelFactory.SetTypeId ("ns3::CsmaRemoteChannel");
 }
 
 void 
@@ -72,6 +76,7 @@ void
 CsmaHelper::SetChannelAttribute (std::string n1, const AttributeValue &v1)
 {
   m_channelFactory.Set (n1, v1);
+  m_remoteChannelFactory.Set (n1, v1);
 }
 
 void 
@@ -259,9 +264,39 @@ CsmaHelper::Install (std::string nodeName, std::string channelName) const
 NetDeviceContainer 
 CsmaHelper::Install (const NodeContainer &c) const
 {
-  Ptr<CsmaChannel> channel = m_channelFactory.Create ()->GetObject<CsmaChannel> ();
+  // If MPI is enabled and a node is on another system, the channel
+  // must be a remote channel between two full-duplex devices
+  bool useNormalChannel = true;
+  if (MpiInterface::IsEnabled ())
+    {
+      uint32_t currSystemId = MpiInterface::GetSystemId ();
+      for (NodeContainer::Iterator i = c.Begin (); i != c.End (); i++)
+        {
+          if ((*i)->GetSystemId () != currSystemId)
+            {
+              useNormalChannel = false;
+            }
+        }
+    }
 
-  return Install (c, channel);
+  if (useNormalChannel)
+    {
+      Ptr<CsmaChannel> channel = m_channelFactory.Create ()->GetObject<CsmaChannel> ();
+      return Install (c, channel);
+    }
+
+  NS_ABORT_MSG_UNLESS (c.GetN () == 2, "CsmaHelper::Install(): remote csma channels connect exactly two nodes");
+  Ptr<CsmaRemoteChannel> channel = m_remoteChannelFactory.Create<CsmaRemoteChannel> ();
+  NS_ABORT_MSG_UNLESS (channel->IsFullDuplex (), "CsmaHelper::Install(): remote csma channels must be full-duplex");
+  NetDeviceContainer devs = Install (c, channel);
+  for (NetDeviceContainer::Iterator i = devs.Begin (); i != devs.End (); i++)
+    {
+      Ptr<CsmaNetDevice> device = DynamicCast<CsmaNetDevice> (*i);
+      Ptr<MpiReceiver> mpiRec = CreateObject<MpiReceiver> ();
+      mpiRec->SetReceiveCallback (MakeBoundCallback (&CsmaHelper::ReceiveRemote, device));
+      device->AggregateObject (mpiRec);
+    }
+  return devs;
 }
 
 NetDeviceContainer 
@@ -301,6 +336,13 @@ CsmaHelper::AssignStreams (NetDeviceContainer c, int64_t stream)
   return (currentStream - stream);
 }
 
+void
+CsmaHelper::ReceiveRemote (Ptr<CsmaNetDevice> device, Ptr<Packet> packet)
+{
+  // There is no local sender, which the device only compares to itself
+  device->Receive (packet, 0);
+}
+
 Ptr<NetDevice>
 CsmaHelper::InstallPriv (Ptr<Node> node, Ptr<CsmaChannel> channel) const
 {
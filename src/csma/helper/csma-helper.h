@@ -27,6 +27,7 @@
 #include "ns3/net-device-container.h"
 #include "ns3/node-container.h"
 #include "ns3/csma-channel.h"
+#include "ns3/csma-net-device.h"
 #include "ns3/trace-helper.h"
 
 namespace ns3 {
@@ -85,8 +86,8 @@ public:
    * \param n1 the name of the attribute to set
    * \param v1 the value of the attribute to set
    *
-   * Set these attributes on each ns3::CsmaChannel created
-   * by CsmaHelper::Install
+   * Set these attributes on each ns3::CsmaChannel and
+   * ns3::CsmaRemoteChannel created by CsmaHelper::Install
    */
   void SetChannelAttribute (std::string n1, const AttributeValue &v1);
 
@@ -163,6 +164,10 @@ public:
    * configured by CsmaHelper::SetDeviceAttribute); adds the device to the 
    * node; and attaches the channel to the device.
    *
+   * When MPI is enabled and one of the nodes belongs to another system,
+   * the container must hold two nodes, which are connected by an
+   * ns3::CsmaRemoteChannel in full-duplex mode.
+   *
    * \param c The NodeContainer holding the nodes to be changed.
    * \returns A container holding the added net devices.
    */
@@ -218,6 +223,14 @@ private:
    */
   Ptr<NetDevice> InstallPriv (Ptr<Node> node, Ptr<CsmaChannel> channel) const;
 
+  /**
+   * Deliver a packet received from another system to a device.
+   *
+   * \param device The receiving device.
+   * \param packet The packet.
+   */
+  static void ReceiveRemote (Ptr<CsmaNetDevice> device, Ptr<Packet> packet);
+
   /**
    * \brief Enable pcap output on the indicated net device.
    *
@@ -250,6 +263,7 @@ private:
   ObjectFactory m_queueFactory;   //!< factory for the queues
   ObjectFactory m_deviceFactory;  //!< factory for the NetDevices
   ObjectFactory m_channelFactory; //!< factory for the channel
+  ObjectFactory m_remoteChannelFactory; //!< factory for the remote channel
 };
 
 } // namespace ns3
@@ -53,7 +53,7 @@ CsmaChannel::GetTypeId (void)
                    MakeTimeAccessor (&CsmaChannel::m_delay),
                    MakeTimeChecker ())
     .AddAttribute ("FullDuplex", "Whether the channel is full-duplex mode.",
-                   TypeId::ATTR_CONSTRUCT,
+                   TypeId::ATTR_GET | TypeId::ATTR_CONSTRUCT,
                    BooleanValue (false),
                    MakeBooleanAccessor (&CsmaChannel::m_fullDuplex),
                    MakeBooleanChecker ())
@@ -215,7 +215,7 @@ public:
    * \return Returns true unless the source was detached before it
    * completed its transmission.
    */
-  bool TransmitEnd (uint32_t deviceId);
+  virtual bool TransmitEnd (uint32_t deviceId);
 
   /**
    * \brief Indicates that the channel has finished propagating the
@@ -389,6 +389,7 @@ private:
    */
   WireState     m_state[2];
 
+protected:
   /**
    * \brief Gets current packet
    *
@@ -224,6 +224,7 @@ CsmaNetDevice::DoDispose ()
   m_channel = 0;
   m_node = 0;
   m_queue = 0;
+  m_txReadyCallback = MakeNullCallback<void> ();
   NetDevice::DoDispose ();
 }
 
@@ -556,6 +557,11 @@ CsmaNetDevice::TransmitAbort (void)
 
   NS_ASSERT_MSG (m_txMachineState == BACKOFF, "Must be in BACKOFF state to abort.  Tx state is: " << m_txMachineState);
 
+  if (!m_txReadyCallback.IsNull ())
+    {
+      m_txReadyCallback ();
+    }
+
   // 
   // We're done with that one, so reset the backoff algorithm and ready the
   // transmit state machine.
@@ -627,6 +633,15 @@ CsmaNetDevice::TransmitReadyEvent (void)
   // to start the next transmit.
   //
   NS_ASSERT_MSG (m_txMachineState == GAP, "CsmaNetDevice::TransmitReadyEvent(): Must be in interframe gap");
+
+  //
+  // Packets handed over by the callback are still queued while in the gap,
+  // so the queue sees them in the same order as if they had been sent earlier
+  //
+  if (!m_txReadyCallback.IsNull ())
+    {
+      m_txReadyCallback ();
+    }
   m_txMachineState = READY;
 
   //
@@ -653,6 +668,19 @@ CsmaNetDevice::TransmitReadyEvent (void)
     }
 }
 
+void
+CsmaNetDevice::SetTxReadyCallback (Callback<void> callback)
+{
+  NS_LOG_FUNCTION (this);
+  m_txReadyCallback = callback;
+}
+
+bool
+CsmaNetDevice::IsTxBusy (void) const
+{
+  return m_currentPkt != 0 || !m_queue->IsEmpty ();
+}
+
 bool
 CsmaNetDevice::Attach (Ptr<CsmaChannel> ch)
 {
@@ -143,6 +143,23 @@ public:
    */
   Ptr<Queue<Packet> > GetQueue (void) const;
 
+  /**
+   * Set the callback invoked when the transmitter is done with a packet,
+   * before it takes the next one from the queue.  Packets sent from the
+   * callback are queued behind the waiting ones, as if they had been sent
+   * while the transmitter was busy.
+   *
+   * \param callback the callback, a null callback disables it
+   */
+  void SetTxReadyCallback (Callback<void> callback);
+
+  /**
+   * 
+eturn true if a packet is being sent or waits in the queue.  The
+   * transmit ready callback then runs before the next packet is taken.
+   */
+  bool IsTxBusy (void) const;
+
   /**
    * Attach a receive ErrorModel to the CsmaNetDevice.
    *
@@ -698,6 +715,11 @@ private:
    */
   NetDevice::PromiscReceiveCallback m_promiscRxCallback;
 
+  /**
+   * The callback invoked before the next packet is taken from the queue.
+   */
+  Callback<void> m_txReadyCallback;
+
   /**
    * The interface index (really net evice index) that has been assigned to 
    * this network device.
@@ -0,0 +1,108 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "csma-remote-channel.h"
+#include "csma-net-device.h"
+#include "ns3/packet.h"
+#include "ns3/node.h"
+#include "ns3/simulator.h"
+#include "ns3/log.h"
+#include "ns3/abort.h"
+#include "ns3/mpi-interface.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("CsmaRemoteChannel");
+
+NS_OBJECT_ENSURE_REGISTERED (CsmaRemoteChannel);
+
+TypeId
+CsmaRemoteChannel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::CsmaRemoteChannel")
+    .SetParent<CsmaChannel> ()
+    .SetGroupName ("Csma")
+    .AddConstructor<CsmaRemoteChannel> ()
+  ;
+  return tid;
+}
+
+CsmaRemoteChannel::CsmaRemoteChannel ()
+  : CsmaChannel ()
+{
+  NS_LOG_FUNCTION_NOARGS ();
+}
+
+CsmaRemoteChannel::~CsmaRemoteChannel ()
+{
+  NS_LOG_FUNCTION_NOARGS ();
+}
+
+bool
+CsmaRemoteChannel::TransmitEnd (uint32_t srcId)
+{
+  NS_LOG_FUNCTION (this << GetCurrentPkt (srcId) << GetCurrentSrc (srcId));
+  NS_LOG_INFO ("UID is " << GetCurrentPkt (srcId)->GetUid () << ")");
+  NS_ABORT_MSG_UNLESS (IsFullDuplex (), "CsmaRemoteChannel::TransmitEnd(): remote channels must be full-duplex");
+
+  NS_ASSERT (GetState (srcId) == TRANSMITTING);
+  SetState (srcId, PROPAGATING);
+  bool retVal = true;
+
+  uint32_t src = GetCurrentSrc (srcId);
+  if (!IsActive (src))
+    {
+      NS_LOG_ERROR ("CsmaRemoteChannel::TransmitEnd(): Seclected source was detached before the end of the transmission");
+      retVal = false;
+    }
+
+  for (uint32_t devId = 0; devId < GetNDevices (); devId++)
+    {
+      //
+      // Don't deliver the packet back to the sender.
+      //
+      if (devId == src || !IsActive (devId))
+        {
+          continue;
+        }
+      Ptr<CsmaNetDevice> dst = GetCsmaDevice (devId);
+      if (dst->GetNode ()->GetSystemId () == MpiInterface::GetSystemId ())
+        {
+          Simulator::ScheduleWithContext (dst->GetNode ()->GetId (), GetDelay (),
+                                          &CsmaNetDevice::Receive, dst,
+                                          GetCurrentPkt (srcId)->Copy (), GetCsmaDevice (src));
+        }
+      else
+        {
+#ifdef NS3_MPI
+          // Calculate the rxTime (absolute)
+          Time rxTime = Simulator::Now () + GetDelay ();
+          MpiInterface::SendPacket (GetCurrentPkt (srcId)->Copy (), rxTime,
+                                    dst->GetNode ()->GetId (), dst->GetIfIndex ());
+#else
+          NS_FATAL_ERROR ("Can't use distributed simulator without MPI compiled in");
+#endif
+        }
+    }
+
+  //
+  // In full-duplex mode, the channel is IDLE during propagation.
+  //
+  PropagationCompleteEvent (srcId);
+  return retVal;
+}
+
+} // namespace ns3
@@ -0,0 +1,72 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// This object connects two full-duplex csma net devices where at least one
+// is not local to this simulator object.  It over-rides the end of the
+// transmission and uses an MPI Send operation for the remote device.
+
+#ifndef CSMA_REMOTE_CHANNEL_H
+#define CSMA_REMOTE_CHANNEL_H
+
+#include "csma-channel.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup csma
+ * \brief A Remote full-duplex Csma Channel
+ *
+ * This object connects two csma net devices where at least one is not
+ * local to this simulator object. Only the full-duplex mode is supported,
+ * since carrier sense cannot span simulator objects. The devices keep
+ * their Ethernet framing and SendFrom support, so that bridges and
+ * switches can have ports on different MPI ranks.
+ */
+class CsmaRemoteChannel : public CsmaChannel
+{
+public:
+  /**
+   * \brief Get the TypeId
+   *
+   * \return The TypeId for this class
+   */
+  static TypeId GetTypeId (void);
+
+  /**
+   * \brief Constructor
+   */
+  CsmaRemoteChannel ();
+
+  /**
+   * \brief Destructor
+   */
+  ~CsmaRemoteChannel ();
+
+  /**
+   * \brief Deliver the transmitted packet, with an MPI Send operation
+   * for the devices of the other simulator objects.
+   *
+   * \param deviceId The deviceID assigned to the net device when it
+   * was connected to the channel
+   * \return Returns true unless the source was detached before it
+   * completed its transmission.
+   */
+  virtual bool TransmitEnd (uint32_t deviceId);
+};
+
+} // namespace ns3
+
+#endif /* CSMA_REMOTE_CHANNEL_H */
@@ -193,7 +193,7 @@ UdpHeader::Serialize (Buffer::Iterator start) const
     }
   else
     {
-      i.WriteHtonU16 (m_payloadSize);
+      i.WriteHtonU16 (m_payloadSize + GetSerializedSize ());
     }
 
   if ( m_checksum == 0)
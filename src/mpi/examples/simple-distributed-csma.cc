@@ -0,0 +1,269 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * The dumbbell of simple-distributed built with full-duplex CSMA links.
+ * The left half is placed on logical processor 0 and the right half on
+ * logical processor 1, so CsmaHelper connects the two routers with a
+ * CsmaRemoteChannel.
+ *
+ *                 -------   -------
+ *                  RANK 0    RANK 1
+ *                 ------- | -------
+ *                         |
+ * n0 ---------|           |           |---------- n6
+ *             |           |           |
+ * n1 -------\ |           |           | /------- n7
+ *            n4 ----------|---------- n5
+ * n2 -------/ |           |           | \------- n8
+ *             |           |           |
+ * n3 ---------|           |           |---------- n9
+ *
+ *
+ * Each left leaf node sends a fixed number of bytes to a packet sink on
+ * a right leaf node, and each right leaf node answers with the same
+ * amount, so frames cross the remote channel in both directions at the
+ * same time.  At the end each rank checks that its sinks received all
+ * the bytes, the program returns 1 otherwise.  It also runs on a single
+ * logical processor, where all the channels are local.
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/mpi-interface.h"
+#include "ns3/ipv4-global-routing-helper.h"
+#include "ns3/csma-helper.h"
+#include "ns3/csma-remote-channel.h"
+#include "ns3/internet-stack-helper.h"
+#include "ns3/ipv4-address-helper.h"
+#include "ns3/on-off-helper.h"
+#include "ns3/packet-sink-helper.h"
+#include "ns3/packet-sink.h"
+
+#ifdef NS3_MPI
+#include <mpi.h>
+#endif
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("SimpleDistributedCsma");
+
+int
+main (int argc, char *argv[])
+{
+#ifdef NS3_MPI
+
+  bool nullmsg = false;
+  uint32_t maxBytes = 51200;
+
+  // Parse command line
+  CommandLine cmd;
+  cmd.AddValue ("nullmsg", "Enable the use of null-message synchronization", nullmsg);
+  cmd.AddValue ("maxBytes", "Bytes sent by each OnOff application", maxBytes);
+  cmd.Parse (argc, argv);
+
+  // Distributed simulation setup; by default use granted time window algorithm.
+  if (nullmsg)
+    {
+      GlobalValue::Bind ("SimulatorImplementationType",
+                         StringValue ("ns3::NullMessageSimulatorImpl"));
+    }
+  else
+    {
+      GlobalValue::Bind ("SimulatorImplementationType",
+                         StringValue ("ns3::DistributedSimulatorImpl"));
+    }
+
+  // Enable parallel simulator with the command line arguments
+  MpiInterface::Enable (&argc, &argv);
+
+  uint32_t systemId = MpiInterface::GetSystemId ();
+  uint32_t systemCount = MpiInterface::GetSize ();
+
+  // Check for valid distributed parameters.
+  // Must have 1 or 2 Logical Processors (LPs)
+  if (systemCount > 2)
+    {
+      std::cout << "This simulation requires 1 or 2 logical processors." << std::endl;
+      return 1;
+    }
+  uint32_t rightSystemId = systemCount - 1;
+
+  // Some default values
+  Config::SetDefault ("ns3::OnOffApplication::PacketSize", UintegerValue (512));
+  // Below the leaf link rate, so that no packet is dropped
+  Config::SetDefault ("ns3::OnOffApplication::DataRate", StringValue ("512kbps"));
+  Config::SetDefault ("ns3::OnOffApplication::MaxBytes", UintegerValue (maxBytes));
+  // The flows start together, keep their first packets while ARP resolves
+  Config::SetDefault ("ns3::ArpCache::PendingQueueSize", UintegerValue (16));
+
+  // Create leaf nodes on left with system id 0
+  NodeContainer leftLeafNodes;
+  leftLeafNodes.Create (4, 0);
+
+  // Create router nodes.  Left router
+  // with system id 0, right router with
+  // the last system id
+  NodeContainer routerNodes;
+  Ptr<Node> routerNode1 = CreateObject<Node> (0);
+  Ptr<Node> routerNode2 = CreateObject<Node> (rightSystemId);
+  routerNodes.Add (routerNode1);
+  routerNodes.Add (routerNode2);
+
+  // Create leaf nodes on right with the last system id
+  NodeContainer rightLeafNodes;
+  rightLeafNodes.Create (4, rightSystemId);
+
+  // Remote CSMA channels must be full-duplex
+  CsmaHelper routerLink;
+  routerLink.SetChannelAttribute ("DataRate", StringValue ("5Mbps"));
+  routerLink.SetChannelAttribute ("Delay", StringValue ("5ms"));
+  routerLink.SetChannelAttribute ("FullDuplex", BooleanValue (true));
+
+  CsmaHelper leafLink;
+  leafLink.SetChannelAttribute ("DataRate", StringValue ("1Mbps"));
+  leafLink.SetChannelAttribute ("Delay", StringValue ("2ms"));
+  leafLink.SetChannelAttribute ("FullDuplex", BooleanValue (true));
+
+  // Add link connecting routers
+  NetDeviceContainer routerDevices;
+  routerDevices = routerLink.Install (routerNodes);
+  bool remote = DynamicCast<CsmaRemoteChannel> (routerDevices.Get (0)->GetChannel ()) != 0;
+  if (remote != (systemCount == 2))
+    {
+      std::cout << "Router link is " << (remote ? "" : "not ") << "a remote channel" << std::endl;
+      return 1;
+    }
+
+  // Add links for left side leaf nodes to left router
+  NetDeviceContainer leftRouterDevices;
+  NetDeviceContainer leftLeafDevices;
+  for (uint32_t i = 0; i < 4; ++i)
+    {
+      NetDeviceContainer temp = leafLink.Install (NodeContainer (leftLeafNodes.Get (i), routerNodes.Get (0)));
+      leftLeafDevices.Add (temp.Get (0));
+      leftRouterDevices.Add (temp.Get (1));
+    }
+
+  // Add links for right side leaf nodes to right router
+  NetDeviceContainer rightRouterDevices;
+  NetDeviceContainer rightLeafDevices;
+  for (uint32_t i = 0; i < 4; ++i)
+    {
+      NetDeviceContainer temp = leafLink.Install (NodeContainer (rightLeafNodes.Get (i), routerNodes.Get (1)));
+      rightLeafDevices.Add (temp.Get (0));
+      rightRouterDevices.Add (temp.Get (1));
+    }
+
+  InternetStackHelper stack;
+  stack.InstallAll ();
+
+  Ipv4InterfaceContainer routerInterfaces;
+  Ipv4InterfaceContainer leftLeafInterfaces;
+  Ipv4InterfaceContainer rightLeafInterfaces;
+
+  Ipv4AddressHelper leftAddress;
+  leftAddress.SetBase ("10.1.1.0", "255.255.255.0");
+
+  Ipv4AddressHelper routerAddress;
+  routerAddress.SetBase ("10.2.1.0", "255.255.255.0");
+
+  Ipv4AddressHelper rightAddress;
+  rightAddress.SetBase ("10.3.1.0", "255.255.255.0");
+
+  // Router-to-Router interfaces
+  routerInterfaces = routerAddress.Assign (routerDevices);
+
+  // Left interfaces
+  for (uint32_t i = 0; i < 4; ++i)
+    {
+      NetDeviceContainer ndc;
+      ndc.Add (leftLeafDevices.Get (i));
+      ndc.Add (leftRouterDevices.Get (i));
+      Ipv4InterfaceContainer ifc = leftAddress.Assign (ndc);
+      leftLeafInterfaces.Add (ifc.Get (0));
+      leftAddress.NewNetwork ();
+    }
+
+  // Right interfaces
+  for (uint32_t i = 0; i < 4; ++i)
+    {
+      NetDeviceContainer ndc;
+      ndc.Add (rightLeafDevices.Get (i));
+      ndc.Add (rightRouterDevices.Get (i));
+      Ipv4InterfaceContainer ifc = rightAddress.Assign (ndc);
+      rightLeafInterfaces.Add (ifc.Get (0));
+      rightAddress.NewNetwork ();
+    }
+
+  Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+
+  // Packet sinks on all the leafs, OnOff applications from every left
+  // leaf to a right leaf and back
+  uint16_t port = 50000;
+  Address sinkLocalAddress (InetSocketAddress (Ipv4Address::GetAny (), port));
+  PacketSinkHelper sinkHelper ("ns3::UdpSocketFactory", sinkLocalAddress);
+
+  OnOffHelper clientHelper ("ns3::UdpSocketFactory", Address ());
+  clientHelper.SetAttribute
+    ("OnTime", StringValue ("ns3::ConstantRandomVariable[Constant=1]"));
+  clientHelper.SetAttribute
+    ("OffTime", StringValue ("ns3::ConstantRandomVariable[Constant=0]"));
+
+  ApplicationContainer sinkApps;
+  for (uint32_t i = 0; i < 4; ++i)
+    {
+      if (systemId == 0)
+        {
+          sinkApps.Add (sinkHelper.Install (leftLeafNodes.Get (i)));
+          clientHelper.SetAttribute ("Remote", AddressValue (InetSocketAddress (rightLeafInterfaces.GetAddress (i), port)));
+          ApplicationContainer clientApp = clientHelper.Install (leftLeafNodes.Get (i));
+          clientApp.Start (Seconds (1.0));
+          clientApp.Stop (Seconds (5));
+        }
+      if (systemId == rightSystemId)
+        {
+          sinkApps.Add (sinkHelper.Install (rightLeafNodes.Get (i)));
+          clientHelper.SetAttribute ("Remote", AddressValue (InetSocketAddress (leftLeafInterfaces.GetAddress (i), port)));
+          ApplicationContainer clientApp = clientHelper.Install (rightLeafNodes.Get (i));
+          clientApp.Start (Seconds (1.0));
+          clientApp.Stop (Seconds (5));
+        }
+    }
+  sinkApps.Start (Seconds (0.5));
+  sinkApps.Stop (Seconds (6));
+
+  Simulator::Stop (Seconds (6));
+  Simulator::Run ();
+
+  int result = 0;
+  for (uint32_t i = 0; i < sinkApps.GetN (); ++i)
+    {
+      uint64_t rx = DynamicCast<PacketSink> (sinkApps.Get (i))->GetTotalRx ();
+      std::cout << "Rank " << systemId << " sink " << i << " received " << rx << " bytes" << std::endl;
+      if (rx != maxBytes)
+        {
+          result = 1;
+        }
+    }
+
+  Simulator::Destroy ();
+  // Exit the MPI execution environment
+  MpiInterface::Disable ();
+  return result;
+#else
+  NS_FATAL_ERROR ("Can't use distributed simulator without MPI compiled in");
+#endif
+}
@@ -190,13 +190,10 @@ DistributedSimulatorImpl::CalculateLookAhead (void)
           for (uint32_t i = 0; i < (*iter)->GetNDevices (); ++i)
             {
               Ptr<NetDevice> localNetDevice = (*iter)->GetDevice (i);
-              // only works for p2p links currently
-              if (!localNetDevice->IsPointToPoint ())
-                {
-                  continue;
-                }
               Ptr<Channel> channel = localNetDevice->GetChannel ();
-              if (channel == 0)
+              // only works for links between two devices currently, either
+              // point to point or full-duplex csma links
+              if (channel == 0 || channel->GetNDevices () != 2)
                 {
                   continue;
                 }
@@ -220,9 +217,13 @@ DistributedSimulatorImpl::CalculateLookAhead (void)
 
               // compare delay on the channel with current value of
               // m_lookAhead.  if delay on channel is smaller, make
-              // it the new lookAhead.
+              // it the new lookAhead.  channels without a delay
+              // cannot be remote channels
               TimeValue delay;
-              channel->GetAttribute ("Delay", delay);
+              if (!channel->GetAttributeFailSafe ("Delay", delay))
+                {
+                  continue;
+                }
 
               if (delay.Get () < m_lookAhead)
                 {
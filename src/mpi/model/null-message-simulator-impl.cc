@@ -158,13 +158,10 @@ NullMessageSimulatorImpl::CalculateLookAhead (void)
           for (uint32_t i = 0; i < (*iter)->GetNDevices (); ++i)
             {
               Ptr<NetDevice> localNetDevice = (*iter)->GetDevice (i);
-              // only works for p2p links currently
-              if (!localNetDevice->IsPointToPoint ())
-                {
-                  continue;
-                }
               Ptr<Channel> channel = localNetDevice->GetChannel ();
-              if (channel == 0)
+              // only works for links between two devices currently, either
+              // point to point or full-duplex csma links
+              if (channel == 0 || channel->GetNDevices () != 2)
                 {
                   continue;
                 }
@@ -186,6 +183,13 @@ NullMessageSimulatorImpl::CalculateLookAhead (void)
                   continue;
                 }
 
+              // channels without a delay cannot be remote channels
+              TimeValue delay;
+              if (!channel->GetAttributeFailSafe ("Delay", delay))
+                {
+                  continue;
+                }
+
               /**
                * Add this channel to the remote channel bundle from this task to MPI task on other side of the channel.
                */
@@ -195,8 +199,6 @@ NullMessageSimulatorImpl::CalculateLookAhead (void)
                   remoteChannelBundle = RemoteChannelBundleManager::Add (remoteNode->GetSystemId ());
                 }
 
-              TimeValue delay;
-              channel->GetAttribute ("Delay", delay);
               remoteChannelBundle->AddChannel (channel, delay.Get () );
             }
         }
@@ -0,0 +1,175 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/abort.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/multithreaded-simulator-impl.h"
+#include "ns3/node.h"
+#include "ns3/node-list.h"
+#include "ns3/net-device.h"
+#include "ns3/channel.h"
+#include "ns3/boolean.h"
+
+#include "partition-helper.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("PartitionHelper");
+
+namespace {
+
+/**
+ * \param [in] tid The type of a channel.
+ * \param [in] name The name of a channel type, which may not be registered.
+ * \returns \c true if the channel is of the type \p name or derived from it.
+ */
+bool
+IsChannelOf (TypeId tid, std::string name)
+{
+  TypeId other;
+  return TypeId::LookupByNameFailSafe (name, &other) && (tid == other || tid.IsChildOf (other));
+}
+
+/**
+ * The devices on both sides of a channel between partitions run in
+ * different threads, so that the channel must not keep state shared
+ * by its transmitters: only full duplex and point to point channels
+ * qualify.
+ *
+ * \param [in] channel The channel.
+ * \returns \c true if the channel can connect partitions.
+ */
+bool
+IsPartitionSafe (Ptr<Channel> channel)
+{
+  BooleanValue fullDuplex;
+  if (channel->GetAttributeFailSafe ("FullDuplex", fullDuplex))
+    {
+      return fullDuplex.Get ();
+    }
+  TypeId tid = channel->GetInstanceTypeId ();
+  return IsChannelOf (tid, "ns3::SimpleChannel") || IsChannelOf (tid, "ns3::PointToPointChannel");
+}
+
+/**
+ * Bridges report the devices of the channels of their ports as the
+ * devices of their own channel, these channels are checked from the
+ * ports.
+ *
+ * \param [in] device The device.
+ * \param [in] channel The channel of the device.
+ * \returns \c true if the device is one of the devices of the channel.
+ */
+bool
+IsAttached (Ptr<NetDevice> device, Ptr<Channel> channel)
+{
+  for (std::size_t i = 0; i < channel->GetNDevices (); i++)
+    {
+      if (channel->GetDevice (i) == device)
+        {
+          return true;
+        }
+    }
+  return false;
+}
+
+} // unnamed namespace
+
+PartitionHelper::PartitionHelper ()
+{
+}
+
+void
+PartitionHelper::Assign (Ptr<Node> node, uint32_t partition)
+{
+  NS_LOG_FUNCTION (this << node->GetId () << partition);
+  m_partitions[node->GetId ()] = partition;
+}
+
+void
+PartitionHelper::Assign (NodeContainer nodes, uint32_t partition)
+{
+  for (NodeContainer::Iterator i = nodes.Begin (); i != nodes.End (); ++i)
+    {
+      Assign (*i, partition);
+    }
+}
+
+uint32_t
+PartitionHelper::GetPartition (Ptr<Node> node) const
+{
+  std::map<uint32_t, uint32_t>::const_iterator i = m_partitions.find (node->GetId ());
+  return i == m_partitions.end () ? 0 : i->second;
+}
+
+Time
+PartitionHelper::GetLookahead (void) const
+{
+  NS_LOG_FUNCTION (this);
+  Time lookahead = Simulator::GetMaximumSimulationTime ();
+  for (NodeList::Iterator i = NodeList::Begin (); i != NodeList::End (); ++i)
+    {
+      Ptr<Node> node = *i;
+      uint32_t partition = GetPartition (node);
+      for (uint32_t j = 0; j < node->GetNDevices (); j++)
+        {
+          Ptr<NetDevice> device = node->GetDevice (j);
+          Ptr<Channel> channel = device->GetChannel ();
+          if (channel == 0 || !IsAttached (device, channel))
+            {
+              continue;
+            }
+          for (std::size_t k = 0; k < channel->GetNDevices (); k++)
+            {
+              Ptr<Node> peer = channel->GetDevice (k)->GetNode ();
+              if (GetPartition (peer) == partition)
+                {
+                  continue;
+                }
+              NS_ABORT_MSG_UNLESS (IsPartitionSafe (channel),
+                                   "Channel " << channel->GetInstanceTypeId ().GetName ()
+                                   << " between partitions is neither full duplex nor point to point");
+              TimeValue delay;
+              NS_ABORT_MSG_UNLESS (channel->GetAttributeFailSafe ("Delay", delay),
+                                   "Channel " << channel->GetInstanceTypeId ().GetName ()
+                                   << " between partitions has no Delay attribute");
+              NS_LOG_LOGIC ("channel between nodes " << node->GetId () << " and " << peer->GetId ()
+                            << " with delay " << delay.Get ());
+              lookahead = std::min (lookahead, delay.Get ());
+            }
+        }
+    }
+  return lookahead;
+}
+
+Time
+PartitionHelper::Install (void) const
+{
+  NS_LOG_FUNCTION (this);
+  Ptr<MultithreadedSimulatorImpl> impl =
+    DynamicCast<MultithreadedSimulatorImpl> (Simulator::GetImplementation ());
+  NS_ABORT_MSG_IF (impl == 0, "The simulator implementation is not a MultithreadedSimulatorImpl");
+  for (std::map<uint32_t, uint32_t>::const_iterator i = m_partitions.begin (); i != m_partitions.end (); ++i)
+    {
+      impl->SetPartition (i->first, i->second);
+    }
+  Time lookahead = GetLookahead ();
+  impl->SetAttribute ("Lookahead", TimeValue (lookahead));
+  return lookahead;
+}
+
+} // namespace ns3
@@ -0,0 +1,85 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef PARTITION_HELPER_H
+#define PARTITION_HELPER_H
+
+#include <map>
+
+#include "ns3/nstime.h"
+#include "ns3/node-container.h"
+
+namespace ns3 {
+
+/**
+ * \brief Assign nodes to the partitions of a MultithreadedSimulatorImpl
+ *
+ * The nodes keep the partition of their id, partition 0 by default.
+ * The lookahead of the simulator is the smallest "Delay" attribute of
+ * the channels connecting nodes of different partitions, so that
+ * these channels must have such an attribute. They must also be full
+ * duplex or point to point, the two sides running in different threads.
+ *
+ * \code
+ *   Simulator::SetImplementation (CreateObject<MultithreadedSimulatorImpl> ());
+ *   // create the nodes and the channels
+ *   PartitionHelper partitions;
+ *   partitions.Assign (pod0, 0);
+ *   partitions.Assign (pod1, 1);
+ *   partitions.Install ();
+ * \endcode
+ */
+class PartitionHelper
+{
+public:
+  PartitionHelper ();
+
+  /**
+   * \param [in] node The node.
+   * \param [in] partition The partition running the events of the node.
+   */
+  void Assign (Ptr<Node> node, uint32_t partition);
+  /**
+   * \param [in] nodes The nodes.
+   * \param [in] partition The partition running the events of the nodes.
+   */
+  void Assign (NodeContainer nodes, uint32_t partition);
+  /**
+   * \param [in] node The node.
+   * \returns The partition of the node.
+   */
+  uint32_t GetPartition (Ptr<Node> node) const;
+
+  /**
+   * \returns The smallest delay of the channels between partitions,
+   *          the maximum simulation time if there are none.
+   */
+  Time GetLookahead (void) const;
+  /**
+   * Configure the MultithreadedSimulatorImpl of the simulation with
+   * the partitions of the nodes and the lookahead.
+   *
+   * \returns The lookahead.
+   */
+  Time Install (void) const;
+
+private:
+  /** The partitions of the assigned nodes, by node id. */
+  std::map<uint32_t, uint32_t> m_partitions;
+};
+
+} // namespace ns3
+
+#endif /* PARTITION_HELPER_H */
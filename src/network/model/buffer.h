@@ -23,6 +23,9 @@
 #include <stdint.h>
 #include <vector>
 #include <ostream>
+#ifdef NS3_MULTITHREADING
+#include <atomic>
+#endif
 #include "ns3/assert.h"
 
 #define BUFFER_FREE_LIST 1
@@ -663,7 +666,11 @@ private:
      * The reference count of an instance of this data structure.
      * Each buffer which references an instance holds a count.
      */
+#ifdef NS3_MULTITHREADING
+    std::atomic<uint32_t> m_count;
+#else
     uint32_t m_count;
+#endif
     /**
      * the size of the m_data field below.
      */
@@ -765,9 +772,14 @@ private:
   /**
    * location in a newly-allocated buffer where you should start
    * writing data. i.e., m_start should be initialized to this 
-   * value.
+   * value. Each thread keeps its own when the multithreaded simulator
+   * is enabled.
    */
+#ifdef NS3_MULTITHREADING
+  static thread_local uint32_t g_recommendedStart;
+#else
   static uint32_t g_recommendedStart;
+#endif
 
   /**
    * offset to the start of the virtual zero area from the start
@@ -790,18 +802,6 @@ private:
    */
   uint32_t m_end;
 
-#ifdef BUFFER_FREE_LIST
-  /// Container for buffer data
-  typedef std::vector<struct Buffer::Data*> FreeList;
-  /// Local static destructor structure
-  struct LocalStaticDestructor 
-  {
-    ~LocalStaticDestructor ();
-  };
-  static uint32_t g_maxSize; //!< Max observed data size
-  static FreeList *g_freeList; //!< Buffer data container
-  static struct LocalStaticDestructor g_localStaticDestructor; //!< Local static destructor
-#endif
 };
 
 } // namespace ns3
@@ -23,6 +23,9 @@
 #include <stdint.h>
 #include <vector>
 #include <limits>
+#ifdef NS3_MULTITHREADING
+#include <atomic>
+#endif
 #include "ns3/callback.h"
 #include "ns3/assert.h"
 #include "ns3/type-id.h"
@@ -245,6 +248,12 @@ private:
    */
   uint64_t GetUid (void) const;
 
+  /**
+   * \brief Set the packet Uid
+   * \param uid the new packet Uid, the items keep the one they were added with
+   */
+  void SetUid (uint64_t uid);
+
   /**
    * \brief Get the metadata serialized size
    * \return the seralized size
@@ -413,7 +422,11 @@ private:
    */
   struct Data {
     /** number of references to this struct Data instance. */
+#ifdef NS3_MULTITHREADING
+    std::atomic<uint32_t> m_count;
+#else
     uint32_t m_count;
+#endif
     /** size (in bytes) of m_data buffer below */
     uint16_t m_size;
     /** max of the m_used field over all objects which
@@ -494,16 +507,6 @@ private:
     uint64_t packetUid;
   };
 
-  /**
-   * \brief Class to hold all the metadata
-   */
-  class DataFreeList : public std::vector<struct Data *>
-  {
-public:
-    ~DataFreeList ();
-  };
-
-  friend DataFreeList::~DataFreeList ();
   /// Friend class
   friend class ItemIterator;
 
@@ -597,6 +600,12 @@ public:
    * \param n space to reserve
    */
   void ReserveCopy (uint32_t n);
+  /**
+   * \brief Check if appending to the metadata storage needs a copy
+   * \returns true if the bytes after m_used belong to another
+   *          PacketMetadata sharing the storage
+   */
+  inline bool IsDirty (void) const;
 
   /**
    * \brief Get the total size used by the metadata
@@ -661,7 +670,6 @@ public:
    */
   static void Deallocate (struct PacketMetadata::Data *data);
 
-  static DataFreeList m_freeList; //!< the metadata data storage
   static bool m_enable; //!< Enable the packet metadata
   static bool m_enableChecking; //!< Enable the packet metadata checking
 
@@ -672,8 +680,13 @@ public:
    */
   static bool m_metadataSkipped;
 
+#ifdef NS3_MULTITHREADING
+  static thread_local uint32_t m_maxSize; //!< maximum metadata size
+  static thread_local uint16_t m_chunkUid; //!< Chunk Uid
+#else
   static uint32_t m_maxSize; //!< maximum metadata size
   static uint16_t m_chunkUid; //!< Chunk Uid
+#endif
 
   struct Data *m_data; //!< Metadata storage
   /*
@@ -722,8 +735,7 @@ PacketMetadata::operator = (PacketMetadata const& o)
     {
       // not self assignment
       NS_ASSERT (m_data != 0);
-      m_data->m_count--;
-      if (m_data->m_count == 0) 
+      if (--m_data->m_count == 0) 
         {
           PacketMetadata::Recycle (m_data);
         }
@@ -740,8 +752,7 @@ PacketMetadata::operator = (PacketMetadata const& o)
 PacketMetadata::~PacketMetadata ()
 {
   NS_ASSERT (m_data != 0);
-  m_data->m_count--;
-  if (m_data->m_count == 0) 
+  if (--m_data->m_count == 0) 
     {
       PacketMetadata::Recycle (m_data);
     }
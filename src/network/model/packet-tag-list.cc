@@ -26,6 +26,7 @@
 #include "packet-tag-list.h"
 #include "tag-buffer.h"
 #include "tag.h"
+#include "recycling-pool.h"
 #include "ns3/fatal-error.h"
 #include "ns3/log.h"
 #include <cstring>
@@ -43,14 +44,42 @@ PacketTagList::CreateTagData (size_t dataSize)
                  << " exceeds maximum "
                  << std::numeric_limits<decltype(TagData::size)>::max () );
 
-  void * p = std::malloc (sizeof (TagData) + dataSize - 1);
-  // The matching frees are in RemoveAll and RemoveWriter
+  std::size_t capacity;
+  void * p = RecyclingPool::Allocate (RecyclingPool::PACKET_TAG_LIST,
+                                      sizeof (TagData) + dataSize - 1, capacity);
+  // The matching frees are in FreeTagData
 
   TagData * tag = new (p) TagData;
   tag->size = dataSize;
   return tag;
 }
 
+void
+PacketTagList::FreeTagData (TagData * tag)
+{
+  std::size_t size = sizeof (TagData) + tag->size - 1;
+  tag->~TagData ();
+  RecyclingPool::Deallocate (tag, size);
+}
+
+PacketTagList::TagData *
+PacketTagList::CopyList (const TagData * head)
+{
+  TagData * copy = 0;
+  TagData ** prevNext = &copy;
+  for (const TagData * cur = head; cur != 0; cur = cur->next)
+    {
+      TagData * tag = CreateTagData (cur->size);
+      tag->tid = cur->tid;
+      tag->count = 1;
+      std::memcpy (tag->data, cur->data, cur->size);
+      *prevNext = tag;
+      prevNext = &tag->next;
+    }
+  *prevNext = 0;
+  return copy;
+}
+
 bool
 PacketTagList::COWTraverse (Tag & tag, PacketTagList::COWWriter Writer)
 {
@@ -194,8 +223,7 @@ PacketTagList::RemoveWriter (Tag & tag, bool preMerge,
   if (preMerge)
     {
       // found tid before first merge, so delete cur
-      cur->~TagData ();
-      std::free (cur);
+      FreeTagData (cur);
     }
   else
     {
@@ -228,6 +228,21 @@ private:
    */
   static
   TagData * CreateTagData (size_t dataSize);
+  /**
+   * Destruct and free a TagData struct allocated by CreateTagData.
+   *
+   * \param [in] tag The TagData object.
+   */
+  static
+  void FreeTagData (TagData * tag);
+  /**
+   * Make a deep copy of a list of TagData structs.
+   *
+   * \param [in] head The head of the list.
+   * \returns The head of the copy.
+   */
+  static
+  TagData * CopyList (const TagData * head);
   
   /**
    * Typedef of method function pointer for copy-on-write operations
@@ -302,7 +317,12 @@ PacketTagList::PacketTagList (PacketTagList const &o)
 {
   if (m_next != 0)
     {
+#ifdef NS3_MULTITHREADING
+      // the copy may be modified by another thread, do not share it
+      m_next = CopyList (m_next);
+#else
       m_next->count++;
+#endif
     }
 }
 
@@ -318,7 +338,12 @@ PacketTagList::operator = (PacketTagList const &o)
   m_next = o.m_next;
   if (m_next != 0) 
     {
+#ifdef NS3_MULTITHREADING
+      // the copy may be modified by another thread, do not share it
+      m_next = CopyList (m_next);
+#else
       m_next->count++;
+#endif
     }
   return *this;
 }
@@ -341,15 +366,13 @@ PacketTagList::RemoveAll (void)
         }
       if (prev != 0) 
         {
-          prev->~TagData ();
-          std::free (prev);
+          FreeTagData (prev);
         }
       prev = cur;
     }
   if (prev != 0) 
     {
-      prev->~TagData ();
-      std::free (prev);
+      FreeTagData (prev);
     }
   m_next = 0;
 }
@@ -21,6 +21,9 @@
 #define PACKET_H
 
 #include <stdint.h>
+#ifdef NS3_MULTITHREADING
+#include <atomic>
+#endif
 #include "buffer.h"
 #include "header.h"
 #include "trailer.h"
@@ -248,6 +251,18 @@ public:
    * \return the copied object
    */
   Packet &operator = (const Packet &o);
+  /**
+   * \brief Allocate a packet from the RecyclingPool
+   * \param size the object size
+   * \returns the allocated memory
+   */
+  static void *operator new (std::size_t size);
+  /**
+   * \brief Return a packet to the RecyclingPool
+   * \param p the object memory
+   * \param size the object size
+   */
+  static void operator delete (void *p, std::size_t size);
   /**
    * \brief Create a packet with a zero-filled payload.
    *
@@ -453,6 +468,17 @@ public:
    */
   Ptr<Packet> Copy (void) const;
 
+  /**
+   * \brief performs a COW copy of the packet with a new uid.
+   *
+   * \returns a COW copy of the packet, with the uid a newly
+   *          created packet would get.
+   *
+   * Meant for packets stamped out of a prototype: they share its
+   * datasets like a Copy, but tracing sees them as distinct packets.
+   */
+  Ptr<Packet> CopyWithNewUid (void) const;
+
   /**
    * \brief Returns the packet's Uid.
    *
@@ -787,7 +813,11 @@ private:
   /* Please see comments above about nix-vector */
   Ptr<NixVector> m_nixVector; //!< the packet's Nix vector
 
+#ifdef NS3_MULTITHREADING
+  static std::atomic<uint32_t> m_globalUid; //!< Global counter of packets Uid
+#else
   static uint32_t m_globalUid; //!< Global counter of packets Uid
+#endif
 };
 
 /**
@@ -0,0 +1,181 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "recycling-pool.h"
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include <new>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("RecyclingPool");
+
+namespace {
+
+/** Names of the pools, for PrintCounters. */
+const char *g_poolNames[RecyclingPool::N_POOLS] = {
+  "Packet", "Buffer", "ByteTagList", "PacketTagList", "PacketMetadata"
+};
+
+/** State of the free lists of a thread. */
+enum ListsState
+{
+  UNINITIALIZED = 0,  //!< No block was freed yet, the releaser is not registered.
+  INITIALIZED,        //!< The releaser is registered.
+  DESTROYED           //!< The thread is exiting, blocks are freed directly.
+};
+
+} // unnamed namespace
+
+/** A free block, linked through its first word. */
+struct RecyclingPool::FreeBlock
+{
+  FreeBlock *next;  //!< Next free block.
+};
+
+/**
+ * The free lists and counters of a thread. It is trivially destructible
+ * and zero initialized, so it stays usable while the thread exits.
+ */
+struct RecyclingPool::ThreadLists
+{
+  FreeBlock *heads[N_CLASSES];           //!< Free lists, per size class.
+  std::size_t counts[N_CLASSES];         //!< Blocks per free list.
+  RecyclingCounters counters[N_POOLS];   //!< Allocation counters.
+  uint8_t state;                         //!< ListsState of the lists.
+};
+
+thread_local RecyclingPool::ThreadLists RecyclingPool::g_lists;
+
+double
+RecyclingCounters::GetHitRate (void) const
+{
+  uint64_t total = hits + misses;
+  return total == 0 ? 0 : static_cast<double> (hits) / total;
+}
+
+RecyclingPool::ThreadReleaser::~ThreadReleaser ()
+{
+  RecyclingPool::Release ();
+}
+
+uint32_t
+RecyclingPool::GetClass (std::size_t size)
+{
+  uint32_t bits = MIN_CLASS_BITS;
+  while ((std::size_t (1) << bits) < size)
+    {
+      bits++;
+    }
+  return bits - MIN_CLASS_BITS;
+}
+
+void *
+RecyclingPool::Allocate (enum Pool pool, std::size_t size, std::size_t &capacity)
+{
+  if (size > (std::size_t (1) << MAX_CLASS_BITS))
+    {
+      g_lists.counters[pool].misses++;
+      capacity = size;
+      return ::operator new (size);
+    }
+  uint32_t sizeClass = GetClass (size);
+  capacity = std::size_t (1) << (sizeClass + MIN_CLASS_BITS);
+  FreeBlock *block = g_lists.heads[sizeClass];
+  if (block == 0)
+    {
+      g_lists.counters[pool].misses++;
+      return ::operator new (capacity);
+    }
+  g_lists.heads[sizeClass] = block->next;
+  g_lists.counts[sizeClass]--;
+  g_lists.counters[pool].hits++;
+  return block;
+}
+
+void
+RecyclingPool::Deallocate (void *block, std::size_t size)
+{
+  if (size > (std::size_t (1) << MAX_CLASS_BITS))
+    {
+      ::operator delete (block);
+      return;
+    }
+  uint32_t sizeClass = GetClass (size);
+  if (g_lists.state == UNINITIALIZED)
+    {
+      // register the release of the lists when the thread exits
+      static thread_local ThreadReleaser releaser;
+      (void) &releaser;
+      g_lists.state = INITIALIZED;
+    }
+  if (g_lists.state == DESTROYED
+      || (g_lists.counts[sizeClass] + 1) << (sizeClass + MIN_CLASS_BITS) > MAX_LIST_BYTES)
+    {
+      ::operator delete (block);
+      return;
+    }
+  FreeBlock *free = static_cast<FreeBlock *> (block);
+  free->next = g_lists.heads[sizeClass];
+  g_lists.heads[sizeClass] = free;
+  g_lists.counts[sizeClass]++;
+}
+
+void
+RecyclingPool::Release (void)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  for (uint32_t i = 0; i < N_CLASSES; i++)
+    {
+      while (g_lists.heads[i] != 0)
+        {
+          FreeBlock *block = g_lists.heads[i];
+          g_lists.heads[i] = block->next;
+          ::operator delete (block);
+        }
+      g_lists.counts[i] = 0;
+    }
+  g_lists.state = DESTROYED;
+}
+
+RecyclingCounters
+RecyclingPool::GetCounters (enum Pool pool)
+{
+  NS_ASSERT (pool < N_POOLS);
+  return g_lists.counters[pool];
+}
+
+void
+RecyclingPool::ResetCounters (void)
+{
+  for (uint32_t i = 0; i < N_POOLS; i++)
+    {
+      g_lists.counters[i] = RecyclingCounters ();
+    }
+}
+
+void
+RecyclingPool::PrintCounters (std::ostream &os)
+{
+  for (uint32_t i = 0; i < N_POOLS; i++)
+    {
+      const RecyclingCounters &c = g_lists.counters[i];
+      os << g_poolNames[i] << ": hits=" << c.hits << " misses=" << c.misses
+         << " hit rate=" << c.GetHitRate () << std::endl;
+    }
+}
+
+} // namespace ns3
@@ -0,0 +1,144 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef RECYCLING_POOL_H
+#define RECYCLING_POOL_H
+
+#include <stdint.h>
+#include <cstddef>
+#include <ostream>
+
+/**
+ * \file
+ * \ingroup packet
+ * ns3::RecyclingPool declaration.
+ */
+
+namespace ns3 {
+
+/**
+ * \ingroup packet
+ *
+ * \brief Allocation counters of one recycling pool.
+ */
+struct RecyclingCounters
+{
+  uint64_t hits;    //!< Allocations served from a free list.
+  uint64_t misses;  //!< Allocations served by the system allocator.
+
+  /**
+   * \returns The fraction of the allocations served from a free list,
+   *          0 if there was no allocation.
+   */
+  double GetHitRate (void) const;
+};
+
+/**
+ * \ingroup packet
+ *
+ * \brief Thread local recycling pools of the packet data structures.
+ *
+ * Packet objects and the data of their Buffer, ByteTagList,
+ * PacketTagList and PacketMetadata are allocated from free lists,
+ * one per power of two size class from 32 bytes to 64 KiB. Larger
+ * allocations use the system allocator. The free lists belong to the
+ * calling thread: a block freed by another thread than the one which
+ * allocated it joins the free lists of the freeing thread. Each list
+ * keeps at most a few MiB, and all lists are emptied when their
+ * thread exits.
+ *
+ * The blocks are individually allocated, so the structures still
+ * need to use the full capacity returned by Allocate to benefit
+ * from the rounding to a size class.
+ */
+class RecyclingPool
+{
+public:
+  /** The pools, for the allocation counters. */
+  enum Pool
+  {
+    PACKET,           //!< Packet objects.
+    BUFFER,           //!< Buffer data.
+    BYTE_TAG_LIST,    //!< ByteTagList data.
+    PACKET_TAG_LIST,  //!< PacketTagList tag data.
+    METADATA,         //!< PacketMetadata data.
+    N_POOLS           //!< Number of pools.
+  };
+
+  /**
+   * Allocate a block.
+   *
+   * \param [in] pool The pool to account the allocation to.
+   * \param [in] size The requested size, in bytes.
+   * \param [out] capacity The usable size of the block, at least \p size.
+   * \returns The block.
+   */
+  static void * Allocate (enum Pool pool, std::size_t size, std::size_t &capacity);
+  /**
+   * Free a block.
+   *
+   * \param [in] block The block.
+   * \param [in] size The size requested from Allocate or its capacity.
+   */
+  static void Deallocate (void *block, std::size_t size);
+
+  /**
+   * \param [in] pool The pool.
+   * \returns The allocation counters of the pool in the calling thread.
+   */
+  static RecyclingCounters GetCounters (enum Pool pool);
+  /** Reset the allocation counters of the calling thread. */
+  static void ResetCounters (void);
+  /**
+   * Print the allocation counters of the calling thread, one pool per line.
+   *
+   * \param [in] os The output stream.
+   */
+  static void PrintCounters (std::ostream &os);
+
+private:
+  /** Smallest size class, as a power of two. */
+  static const uint32_t MIN_CLASS_BITS = 5;
+  /** Largest size class, as a power of two. */
+  static const uint32_t MAX_CLASS_BITS = 16;
+  /** Number of size classes. */
+  static const uint32_t N_CLASSES = MAX_CLASS_BITS - MIN_CLASS_BITS + 1;
+  /** Bytes kept at most in the free list of a size class. */
+  static const std::size_t MAX_LIST_BYTES = 4 << 20;
+
+  /**
+   * \param [in] size A size, in bytes.
+   * \returns The index of the smallest size class which holds \p size.
+   */
+  static uint32_t GetClass (std::size_t size);
+  /** Free the blocks of all the lists of the calling thread. */
+  static void Release (void);
+
+  struct FreeBlock;
+  struct ThreadLists;
+  /** The free lists and counters of the calling thread. */
+  static thread_local ThreadLists g_lists;
+
+  /** Releases the free lists of a thread when it exits. */
+  struct ThreadReleaser
+  {
+    ~ThreadReleaser ();
+  };
+  friend struct ThreadReleaser;
+};
+
+} // namespace ns3
+
+#endif /* RECYCLING_POOL_H */
@@ -0,0 +1,187 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <vector>
+#include "ns3/test.h"
+#include "ns3/simulator.h"
+#include "ns3/multithreaded-simulator-impl.h"
+#include "ns3/default-simulator-impl.h"
+#include "ns3/node.h"
+#include "ns3/node-container.h"
+#include "ns3/net-device-container.h"
+#include "ns3/simple-net-device-helper.h"
+#include "ns3/partition-helper.h"
+#include "ns3/packet.h"
+
+using namespace ns3;
+
+/**
+ * \ingroup network-test
+ * \ingroup tests
+ *
+ * \brief Packets forwarded around a ring of nodes, one partition per node.
+ */
+class PartitionHelperRingTestCase : public TestCase
+{
+public:
+  PartitionHelperRingTestCase ();
+private:
+  virtual void DoRun (void);
+
+  /**
+   * Count a packet and forward a copy of it to the next node.
+   * \param [in] device The receiving device.
+   * \param [in] packet The packet.
+   * \param [in] protocol The protocol number.
+   * \param [in] from The sender address.
+   * \returns \c true.
+   */
+  bool Receive (Ptr<NetDevice> device, Ptr<const Packet> packet, uint16_t protocol, const Address &from);
+  /**
+   * Send a packet to the next node.
+   * \param [in] node The sending node.
+   * \param [in] size The packet size.
+   */
+  void Send (uint32_t node, uint32_t size);
+  /**
+   * Run the ring with the simulator implementation.
+   * \param [in] multithreaded Flag to use the MultithreadedSimulatorImpl.
+   */
+  void RunRing (bool multithreaded);
+
+  std::vector<Ptr<NetDevice> > m_next;  //!< Device of each node to the next one.
+  std::vector<uint32_t> m_received;     //!< Packets received by each node.
+  std::vector<uint64_t> m_bytes;        //!< Bytes received by each node.
+  std::vector<Time> m_last;             //!< Last reception of each node.
+  Time m_lookahead;                     //!< Lookahead found by the helper.
+};
+
+/** Number of nodes of the ring. */
+static const uint32_t RING_NODES = 4;
+
+PartitionHelperRingTestCase::PartitionHelperRingTestCase ()
+  : TestCase ("Check packets forwarded between partitions")
+{
+}
+
+void
+PartitionHelperRingTestCase::Send (uint32_t node, uint32_t size)
+{
+  Ptr<NetDevice> device = m_next[node];
+  device->Send (Create<Packet> (size), device->GetBroadcast (), 0x800);
+}
+
+bool
+PartitionHelperRingTestCase::Receive (Ptr<NetDevice> device, Ptr<const Packet> packet,
+                                      uint16_t protocol, const Address &from)
+{
+  uint32_t node = device->GetNode ()->GetId ();
+  m_received[node]++;
+  m_bytes[node] += packet->GetSize ();
+  m_last[node] = Simulator::Now ();
+  Ptr<Packet> copy = packet->Copy ();
+  copy->AddPaddingAtEnd (1);
+  m_next[node]->Send (copy, m_next[node]->GetBroadcast (), protocol);
+  return true;
+}
+
+void
+PartitionHelperRingTestCase::RunRing (bool multithreaded)
+{
+  if (multithreaded)
+    {
+      Simulator::SetImplementation (CreateObject<MultithreadedSimulatorImpl> ());
+    }
+  else
+    {
+      Simulator::SetImplementation (CreateObject<DefaultSimulatorImpl> ());
+    }
+
+  NodeContainer nodes;
+  nodes.Create (RING_NODES);
+  m_next.assign (RING_NODES, 0);
+  m_received.assign (RING_NODES, 0);
+  m_bytes.assign (RING_NODES, 0);
+  m_last.assign (RING_NODES, Seconds (0));
+  SimpleNetDeviceHelper helper;
+  PartitionHelper partitions;
+  for (uint32_t i = 0; i < RING_NODES; i++)
+    {
+      Ptr<Node> node = nodes.Get (i);
+      Ptr<Node> next = nodes.Get ((i + 1) % RING_NODES);
+      helper.SetChannelAttribute ("Delay", TimeValue (MilliSeconds (i + 2)));
+      NetDeviceContainer devices = helper.Install (NodeContainer (node, next));
+      m_next[i] = devices.Get (0);
+      devices.Get (1)->SetReceiveCallback (MakeCallback (&PartitionHelperRingTestCase::Receive, this));
+      partitions.Assign (node, multithreaded ? i : 0);
+    }
+  m_lookahead = partitions.GetLookahead ();
+  if (multithreaded)
+    {
+      partitions.Install ();
+    }
+
+  for (uint32_t i = 0; i < RING_NODES; i++)
+    {
+      Simulator::ScheduleWithContext (i, MilliSeconds (i), &PartitionHelperRingTestCase::Send, this, i, 100 * i);
+    }
+  Simulator::Stop (Seconds (1));
+  Simulator::Run ();
+  Simulator::Destroy ();
+}
+
+void
+PartitionHelperRingTestCase::DoRun (void)
+{
+  RunRing (false);
+  NS_TEST_ASSERT_MSG_EQ (m_lookahead, Time::Max (), "lookahead without partitions");
+  std::vector<uint32_t> received = m_received;
+  std::vector<uint64_t> bytes = m_bytes;
+  std::vector<Time> last = m_last;
+
+  RunRing (true);
+  NS_TEST_ASSERT_MSG_EQ (m_lookahead, MilliSeconds (2), "lookahead not the smallest channel delay");
+  for (uint32_t i = 0; i < RING_NODES; i++)
+    {
+      NS_TEST_ASSERT_MSG_GT (m_received[i], 100, "node " << i << " received too few packets");
+      NS_TEST_ASSERT_MSG_EQ (m_received[i], received[i], "node " << i << " received other packets");
+      NS_TEST_ASSERT_MSG_EQ (m_bytes[i], bytes[i], "node " << i << " received other bytes");
+      NS_TEST_ASSERT_MSG_EQ (m_last[i], last[i], "node " << i << " received at another time");
+    }
+}
+
+/**
+ * \ingroup network-test
+ * \ingroup tests
+ *
+ * \brief PartitionHelper TestSuite
+ */
+class PartitionHelperTestSuite : public TestSuite
+{
+public:
+  PartitionHelperTestSuite ();
+};
+
+PartitionHelperTestSuite::PartitionHelperTestSuite ()
+  : TestSuite ("partition-helper", UNIT)
+{
+  // more than one partition needs the atomic reference counts
+#ifdef NS3_MULTITHREADING
+  AddTestCase (new PartitionHelperRingTestCase, TestCase::QUICK);
+#endif /* NS3_MULTITHREADING */
+}
+
+static PartitionHelperTestSuite g_partitionHelperTestSuite; //!< Static variable for test initialization
@@ -0,0 +1,209 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <algorithm>
+#include <cstring>
+#include "ns3/test.h"
+#include "ns3/packet.h"
+#include "ns3/tag.h"
+#include "ns3/recycling-pool.h"
+
+using namespace ns3;
+
+namespace {
+
+/**
+ * \ingroup network-test
+ * \ingroup tests
+ *
+ * \brief Tag carrying a 32 bit value, used as byte and packet tag.
+ */
+class RecyclingTag : public Tag
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return The object TypeId.
+   */
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("RecyclingTag")
+      .SetParent<Tag> ()
+      .SetGroupName ("Network")
+      .AddConstructor<RecyclingTag> ()
+    ;
+    return tid;
+  }
+  virtual TypeId GetInstanceTypeId (void) const
+  {
+    return GetTypeId ();
+  }
+  virtual uint32_t GetSerializedSize (void) const
+  {
+    return 4;
+  }
+  virtual void Serialize (TagBuffer i) const
+  {
+    i.WriteU32 (m_value);
+  }
+  virtual void Deserialize (TagBuffer i)
+  {
+    m_value = i.ReadU32 ();
+  }
+  virtual void Print (std::ostream &os) const
+  {
+    os << m_value;
+  }
+
+  uint32_t m_value; //!< The tag value.
+};
+
+} // unnamed namespace
+
+/**
+ * \ingroup network-test
+ * \ingroup tests
+ *
+ * \brief Check the size classes and the counters of the RecyclingPool.
+ */
+class RecyclingPoolAllocateTestCase : public TestCase
+{
+public:
+  RecyclingPoolAllocateTestCase ();
+private:
+  virtual void DoRun (void);
+};
+
+RecyclingPoolAllocateTestCase::RecyclingPoolAllocateTestCase ()
+  : TestCase ("Check the recycling pool size classes and counters")
+{
+}
+
+void
+RecyclingPoolAllocateTestCase::DoRun (void)
+{
+  std::size_t sizes[] = { 1, 32, 33, 100, 1500, 65536, 70000 };
+  for (uint32_t i = 0; i < sizeof (sizes) / sizeof (sizes[0]); i++)
+    {
+      std::size_t capacity;
+      void *block = RecyclingPool::Allocate (RecyclingPool::BUFFER, sizes[i], capacity);
+      NS_TEST_ASSERT_MSG_GT_OR_EQ (capacity, sizes[i], "capacity below the requested size");
+      NS_TEST_ASSERT_MSG_LT_OR_EQ (capacity, std::max (sizes[i] * 2, std::size_t (32)),
+                                   "capacity above the size class");
+      // the whole capacity is usable
+      std::memset (block, 0xa5, capacity);
+      RecyclingPool::Deallocate (block, capacity);
+    }
+
+  RecyclingPool::ResetCounters ();
+  std::size_t capacity;
+  void *block = RecyclingPool::Allocate (RecyclingPool::BUFFER, 1000, capacity);
+  RecyclingPool::Deallocate (block, 1000);
+  void *again = RecyclingPool::Allocate (RecyclingPool::BUFFER, 700, capacity);
+  NS_TEST_ASSERT_MSG_EQ (again, block, "block of the same size class not recycled");
+  NS_TEST_ASSERT_MSG_EQ (capacity, 1024, "unexpected size class");
+  RecyclingPool::Deallocate (again, capacity);
+
+  RecyclingCounters counters = RecyclingPool::GetCounters (RecyclingPool::BUFFER);
+  NS_TEST_ASSERT_MSG_EQ (counters.hits + counters.misses, 2, "allocations not counted");
+  NS_TEST_ASSERT_MSG_EQ (counters.hits, 1, "recycled allocation not counted as a hit");
+  NS_TEST_ASSERT_MSG_EQ_TOL (counters.GetHitRate (), 0.5, 1e-9, "bad hit rate");
+  counters = RecyclingPool::GetCounters (RecyclingPool::PACKET);
+  NS_TEST_ASSERT_MSG_EQ (counters.GetHitRate (), 0, "hit rate without allocations");
+}
+
+/**
+ * \ingroup network-test
+ * \ingroup tests
+ *
+ * \brief Check that packets and their tags are recycled.
+ */
+class RecyclingPoolPacketTestCase : public TestCase
+{
+public:
+  RecyclingPoolPacketTestCase ();
+private:
+  virtual void DoRun (void);
+};
+
+RecyclingPoolPacketTestCase::RecyclingPoolPacketTestCase ()
+  : TestCase ("Check the recycling of packets and their tags")
+{
+}
+
+void
+RecyclingPoolPacketTestCase::DoRun (void)
+{
+  // warm up the free lists
+  for (uint32_t i = 0; i < 2; i++)
+    {
+      Ptr<Packet> p = Create<Packet> (1000);
+      Ptr<Packet> copy = p->Copy ();
+      copy->AddAtEnd (Create<Packet> (500));
+    }
+
+  RecyclingPool::ResetCounters ();
+  RecyclingTag tag;
+  for (uint32_t i = 0; i < 100; i++)
+    {
+      Ptr<Packet> p = Create<Packet> (1000);
+      tag.m_value = i;
+      p->AddByteTag (tag);
+      p->AddPacketTag (tag);
+      Ptr<Packet> copy = p->Copy ();
+      copy->AddAtEnd (Create<Packet> (500));
+      NS_TEST_ASSERT_MSG_EQ (copy->GetSize (), 1500, "bad packet size");
+
+      RecyclingTag read;
+      read.m_value = 0;
+      NS_TEST_ASSERT_MSG_EQ (copy->PeekPacketTag (read), true, "packet tag lost");
+      NS_TEST_ASSERT_MSG_EQ (read.m_value, i, "packet tag corrupted");
+      read.m_value = 0;
+      NS_TEST_ASSERT_MSG_EQ (copy->FindFirstMatchingByteTag (read), true, "byte tag lost");
+      NS_TEST_ASSERT_MSG_EQ (read.m_value, i, "byte tag corrupted");
+    }
+
+  RecyclingCounters counters = RecyclingPool::GetCounters (RecyclingPool::PACKET);
+  NS_TEST_ASSERT_MSG_EQ (counters.hits + counters.misses, 300, "packet allocations not counted");
+  NS_TEST_ASSERT_MSG_GT (counters.GetHitRate (), 0.9, "packets not recycled");
+  counters = RecyclingPool::GetCounters (RecyclingPool::BUFFER);
+  NS_TEST_ASSERT_MSG_GT (counters.GetHitRate (), 0.9, "buffers not recycled");
+  counters = RecyclingPool::GetCounters (RecyclingPool::BYTE_TAG_LIST);
+  NS_TEST_ASSERT_MSG_GT (counters.GetHitRate (), 0.9, "byte tags not recycled");
+  counters = RecyclingPool::GetCounters (RecyclingPool::PACKET_TAG_LIST);
+  NS_TEST_ASSERT_MSG_GT (counters.GetHitRate (), 0.9, "packet tags not recycled");
+}
+
+/**
+ * \ingroup network-test
+ * \ingroup tests
+ *
+ * \brief RecyclingPool TestSuite
+ */
+class RecyclingPoolTestSuite : public TestSuite
+{
+public:
+  RecyclingPoolTestSuite ();
+};
+
+RecyclingPoolTestSuite::RecyclingPoolTestSuite ()
+  : TestSuite ("recycling-pool", UNIT)
+{
+  AddTestCase (new RecyclingPoolAllocateTestCase, TestCase::QUICK);
+  AddTestCase (new RecyclingPoolPacketTestCase, TestCase::QUICK);
+}
+
+static RecyclingPoolTestSuite g_recyclingPoolTestSuite; //!< Static variable for test initialization
@@ -0,0 +1,572 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// This program benchmarks the data plane models of the p4-switch module.
+// A synthetic packet stream (flows picked with a Zipf distribution, some of
+// them blackholed) crosses a minimal h0 - s1 - s2 - r0 topology built with
+// the selected switch type, and the wall time, packet rate and heap used
+// are reported for every switch type.
+// Results are appended as one JSON object per line to --out so they can be
+// compared between commits.
+// With --multithreaded h0 - s1 and s2 - r0 run in two partitions of the
+// multithreaded simulator (ns-3 configured with --enable-multithreading),
+// the packets delivered must be the same as in the default run.
+// With --lpm-routes the L3 table lookups are also timed on its own, with
+// host (/32) routes only, in the default and in the compact layout.
+// Sample usage:  ./waf --run 'bench-p4-switch --switches=Fancy,NetSeer --flows=10000 --zipf=1.1 --out=bench.json'
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/csma-module.h"
+#include "ns3/p4-switch-module.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <malloc.h>
+#include <unistd.h>
+
+using namespace ns3;
+
+/// Parameters shared by all the switch types
+struct BenchConfig
+{
+  uint32_t flows = 1000;          ///< number of flows (one destination each)
+  uint32_t packets = 100000;      ///< data packets sent
+  double rate = 1e6;              ///< data packets per simulated second
+  uint32_t size = 200;            ///< packet size (IP header included)
+  double zipf = 1.0;              ///< Zipf skew of the flow popularity, 0 is uniform
+  double loss = 0;                ///< fraction of flows blackholed at s1
+  double dropRate = 1;            ///< drop probability of a blackholed flow packet
+  uint32_t seed = 1;
+  bool profile = false;           ///< also collect the per stage cycles of s1
+  bool multithreaded = false;     ///< run each switch in a partition of the multithreaded simulator
+  std::string label;              ///< free text copied to the results (commit, host...)
+
+  /* Fancy */
+  uint32_t treeDepth = 3;
+  uint32_t layerSplit = 2;
+  uint32_t counterWidth = 32;
+  uint32_t topEntries = 0;
+  /* LossRadar */
+  uint32_t lossRadarCells = 2048;
+  /* NetSeer */
+  uint32_t netSeerCells = 2048;
+  uint32_t eventCacheSize = 256;
+};
+
+/// What one run measured
+struct BenchResult
+{
+  std::string switchType;
+  uint64_t sent = 0;
+  uint64_t delivered = 0;
+  double wallSeconds = 0;
+  int64_t heapBytes = 0;
+  uint64_t stageCycles = 0;
+  uint64_t stagePackets = 0;
+  double packetHitRate = 0;   ///< Packet objects served by the recycling pool
+  double bufferHitRate = 0;   ///< Buffer data served by the recycling pool
+};
+
+/// What one L3 table lookup run measured
+struct LpmResult
+{
+  bool compact = false;
+  uint32_t routes = 0;
+  uint64_t lookups = 0;
+  double wallSeconds = 0;
+  int64_t heapBytes = 0;      ///< heap used by the table
+};
+
+/// Bytes currently allocated from the heap
+static int64_t
+HeapBytes (void)
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+  struct mallinfo2 info = mallinfo2 ();
+  return int64_t (info.uordblks + info.hblkhd);
+#else
+  return 0;
+#endif
+}
+
+/// Destination address of flow i, one /24 per flow
+static Ipv4Address
+FlowDestination (uint32_t i)
+{
+  return Ipv4Address ((20u << 24) | ((i + 1) << 8) | 1);
+}
+
+/// Sends the pre-computed packet stream out of the sender port
+class PacketStream
+{
+public:
+  PacketStream (const BenchConfig &config, Ptr<NetDevice> device, Address dst, Ipv4Address src)
+    : m_device (device),
+      m_dst (dst),
+      m_next (0),
+      m_interval (Seconds (1.0 / config.rate))
+  {
+    /* One prototype per flow, every packet is a copy on write copy of it */
+    for (uint32_t i = 0; i < config.flows; i++)
+      {
+        Ptr<Packet> packet = Create<Packet> (config.size - 28);
+        UdpHeader udp;
+        udp.SetSourcePort (1024 + (i % 50000));
+        udp.SetDestinationPort (7000);
+        packet->AddHeader (udp);
+        Ipv4Header ipv4;
+        ipv4.SetSource (src);
+        ipv4.SetDestination (FlowDestination (i));
+        ipv4.SetProtocol (17);
+        ipv4.SetPayloadSize (packet->GetSize ());
+        ipv4.SetTtl (64);
+        packet->AddHeader (ipv4);
+        m_prototypes.push_back (packet);
+      }
+
+    /* Zipf CDF over the flow ranks, sampled by inversion */
+    std::vector<double> cdf (config.flows);
+    double sum = 0;
+    for (uint32_t i = 0; i < config.flows; i++)
+      {
+        sum += 1.0 / std::pow (i + 1, config.zipf);
+        cdf[i] = sum;
+      }
+    Ptr<UniformRandomVariable> uniform = CreateObject<UniformRandomVariable> ();
+    m_order.reserve (config.packets);
+    for (uint32_t i = 0; i < config.packets; i++)
+      {
+        double u = uniform->GetValue (0, sum);
+        uint32_t flow = std::upper_bound (cdf.begin (), cdf.end (), u) - cdf.begin ();
+        m_order.push_back (std::min (flow, config.flows - 1));
+      }
+  }
+
+  void Start (void)
+  {
+    Simulator::ScheduleNow (&PacketStream::Send, this);
+  }
+
+  uint64_t GetSent (void) const
+  {
+    return m_next;
+  }
+
+private:
+  void Send (void)
+  {
+    m_device->Send (m_prototypes[m_order[m_next]]->Copy (), m_dst, 0x0800);
+    m_next++;
+    if (m_next < m_order.size ())
+      {
+        Simulator::Schedule (m_interval, &PacketStream::Send, this);
+      }
+  }
+
+  Ptr<NetDevice> m_device;
+  Address m_dst;
+  std::vector<Ptr<Packet> > m_prototypes;
+  std::vector<uint32_t> m_order;
+  uint64_t m_next;
+  Time m_interval;
+};
+
+static uint64_t g_delivered = 0;
+
+static void
+PacketDelivered (Ptr<const Packet> packet)
+{
+  g_delivered++;
+}
+
+/// Installs the switch type on both switch nodes with the configured sizes
+static NetDeviceContainer
+InstallSwitch (std::string switchType, const BenchConfig &config, Ptr<Node> node,
+               NetDeviceContainer ports, std::string topFile)
+{
+  P4SwitchHelper helper ("ns3::P4Switch" + switchType);
+  helper.SetDeviceAttribute ("EnableDebug", BooleanValue (false));
+  helper.SetDeviceAttribute ("FailDropRate", DoubleValue (config.dropRate));
+  helper.SetDeviceAttribute ("EnableProfiling", BooleanValue (config.profile));
+  if (switchType == "Fancy")
+    {
+      helper.SetDeviceAttribute ("TreeDepth", UintegerValue (config.treeDepth));
+      helper.SetDeviceAttribute ("LayerSplit", UintegerValue (config.layerSplit));
+      helper.SetDeviceAttribute ("CounterWidth", UintegerValue (config.counterWidth));
+      helper.SetDeviceAttribute ("NumTopEntries", UintegerValue (config.topEntries));
+      helper.SetDeviceAttribute ("TopFile", StringValue (topFile));
+      return helper.Install<P4SwitchFancy> (node, ports);
+    }
+  else if (switchType == "LossRadar")
+    {
+      helper.SetDeviceAttribute ("NumberOfCells", UintegerValue (config.lossRadarCells));
+      return helper.Install<P4SwitchLossRadar> (node, ports);
+    }
+  else if (switchType == "NetSeer")
+    {
+      helper.SetDeviceAttribute ("NumberOfCells", UintegerValue (config.netSeerCells));
+      helper.SetDeviceAttribute ("EventCacheSize", UintegerValue (config.eventCacheSize));
+      return helper.Install<P4SwitchNetSeer> (node, ports);
+    }
+  NS_FATAL_ERROR ("Unknown switch type " << switchType);
+  return NetDeviceContainer ();
+}
+
+static BenchResult
+RunBench (std::string switchType, const BenchConfig &config, std::string topFile)
+{
+  BenchResult result;
+  result.switchType = switchType;
+
+  RngSeedManager::SetSeed (config.seed);
+  GlobalValue::Bind ("switchId", UintegerValue (1));
+  g_delivered = 0;
+
+  int64_t heapStart = HeapBytes ();
+
+#ifdef NS3_MULTITHREADING
+  if (config.multithreaded)
+    {
+      Simulator::SetImplementation (CreateObject<MultithreadedSimulatorImpl> ());
+    }
+#endif
+
+  NodeContainer nodes;
+  nodes.Create (4);
+  Ptr<Node> h0 = nodes.Get (0);
+  Ptr<Node> s1 = nodes.Get (1);
+  Ptr<Node> s2 = nodes.Get (2);
+  Ptr<Node> r0 = nodes.Get (3);
+  /* The switches look at the names to find their neighbours */
+  Names::Add ("h0", h0);
+  Names::Add ("s1", s1);
+  Names::Add ("s2", s2);
+  Names::Add ("r0", r0);
+
+  CsmaHelper csma;
+  csma.SetChannelAttribute ("DataRate", DataRateValue (DataRate ("100Gbps")));
+  csma.SetChannelAttribute ("Delay", TimeValue (MicroSeconds (1)));
+  csma.SetQueue ("ns3::DropTailQueue", "MaxSize", StringValue ("100000p"));
+  NetDeviceContainer link0 = csma.Install (NodeContainer (h0, s1));
+  NetDeviceContainer link1 = csma.Install (NodeContainer (s1, s2));
+  NetDeviceContainer link2 = csma.Install (NodeContainer (s2, r0));
+
+#ifdef NS3_MULTITHREADING
+  if (config.multithreaded)
+    {
+      /* One switch per thread, with its host. The LossRadar controller
+         reads the registers of the peer switch, so both stay together */
+      PartitionHelper partitions;
+      partitions.Assign (NodeContainer (h0, s1), 0);
+      partitions.Assign (s2, switchType == "LossRadar" ? 0 : 1);
+      partitions.Assign (r0, 1);
+      partitions.Install ();
+    }
+#endif
+
+  /* Hosts need an address before the switches fill their tables */
+  InternetStackHelper internet;
+  internet.Install (NodeContainer (h0, r0));
+  NetDeviceContainer hostDevices (link0.Get (0), link2.Get (1));
+  Ipv4AddressHelper ipv4 ("10.0.0.0", "255.255.255.0");
+  ipv4.Assign (hostDevices);
+
+  Ptr<P4SwitchNetDevice> sw1 = DynamicCast<P4SwitchNetDevice> (
+    InstallSwitch (switchType, config, s1, NetDeviceContainer (link0.Get (1), link1.Get (0)), topFile).Get (0));
+  Ptr<P4SwitchNetDevice> sw2 = DynamicCast<P4SwitchNetDevice> (
+    InstallSwitch (switchType, config, s2, NetDeviceContainer (link1.Get (1), link2.Get (0)), topFile).Get (0));
+
+  /* s1 sends everything to s2 (its gateway), s2 needs a route to r0 per flow */
+  std::vector<std::pair<uint32_t, Ptr<NetDevice> > > routes;
+  for (uint32_t i = 0; i < config.flows; i++)
+    {
+      routes.push_back (std::make_pair (FlowDestination (i).Get (), link2.Get (0)));
+    }
+  sw2->L3SpecialForwardingRemoveFailures (routes);
+
+  /* Blackhole a random subset of the flows at s1 */
+  std::vector<std::pair<uint32_t, Ptr<NetDevice> > > failures;
+  Ptr<UniformRandomVariable> uniform = CreateObject<UniformRandomVariable> ();
+  for (uint32_t i = 0; i < config.flows; i++)
+    {
+      if (uniform->GetValue () < config.loss)
+        {
+          failures.push_back (std::make_pair (FlowDestination (i).Get (), Ptr<NetDevice> ()));
+        }
+    }
+  sw1->L3SpecialForwardingSetFailures (failures);
+
+  link2.Get (1)->TraceConnectWithoutContext ("MacRx", MakeCallback (&PacketDelivered));
+
+  Ptr<Ipv4> h0Ipv4 = h0->GetObject<Ipv4> ();
+  PacketStream stream (config, link0.Get (0), link0.Get (1)->GetAddress (),
+                       h0Ipv4->GetAddress (1, 0).GetLocal ());
+  stream.Start ();
+
+  Simulator::Stop (Seconds (config.packets / config.rate) + MilliSeconds (10));
+  RecyclingPool::ResetCounters ();
+  auto start = std::chrono::steady_clock::now ();
+  Simulator::Run ();
+  auto end = std::chrono::steady_clock::now ();
+
+  result.wallSeconds = std::chrono::duration<double> (end - start).count ();
+  result.sent = stream.GetSent ();
+  result.delivered = g_delivered;
+  result.heapBytes = HeapBytes () - heapStart;
+  result.packetHitRate = RecyclingPool::GetCounters (RecyclingPool::PACKET).GetHitRate ();
+  result.bufferHitRate = RecyclingPool::GetCounters (RecyclingPool::BUFFER).GetHitRate ();
+  if (sw1->GetProfiler ())
+    {
+      for (int i = 0; i < PipelineProfiler::STAGE_COUNT; i++)
+        {
+          result.stageCycles += sw1->GetProfiler ()->GetStats (PipelineProfiler::Stage (i)).cycles;
+        }
+      result.stagePackets = sw1->GetProfiler ()->GetStats (PipelineProfiler::STAGE_PARSER).packets;
+      /* Printed by the switches when disposed otherwise */
+      sw1->SetProfiling (false);
+      sw2->SetProfiling (false);
+    }
+
+  Simulator::Destroy ();
+  Names::Clear ();
+  return result;
+}
+
+static std::string
+ResultToJson (const BenchResult &result, const BenchConfig &config)
+{
+  double pps = result.wallSeconds > 0 ? result.sent / result.wallSeconds : 0;
+  double nsPerPacket = result.sent ? 1e9 * result.wallSeconds / result.sent : 0;
+
+  std::ostringstream out;
+  out << "{\"switch\":\"" << result.switchType << "\""
+      << ",\"label\":\"" << config.label << "\""
+      << ",\"flows\":" << config.flows
+      << ",\"packets\":" << config.packets
+      << ",\"rate\":" << config.rate
+      << ",\"size\":" << config.size
+      << ",\"zipf\":" << config.zipf
+      << ",\"loss\":" << config.loss
+      << ",\"drop_rate\":" << config.dropRate
+      << ",\"seed\":" << config.seed
+      << ",\"multithreaded\":" << (config.multithreaded ? "true" : "false");
+  if (result.switchType == "Fancy")
+    {
+      out << ",\"tree_depth\":" << config.treeDepth
+          << ",\"layer_split\":" << config.layerSplit
+          << ",\"counter_width\":" << config.counterWidth
+          << ",\"top_entries\":" << config.topEntries;
+    }
+  else if (result.switchType == "LossRadar")
+    {
+      out << ",\"cells\":" << config.lossRadarCells;
+    }
+  else if (result.switchType == "NetSeer")
+    {
+      out << ",\"cells\":" << config.netSeerCells
+          << ",\"event_cache_size\":" << config.eventCacheSize;
+    }
+  out << ",\"sent\":" << result.sent
+      << ",\"delivered\":" << result.delivered
+      << ",\"wall_s\":" << result.wallSeconds
+      << ",\"pps\":" << pps
+      << ",\"ns_per_packet\":" << nsPerPacket
+      << ",\"heap_bytes\":" << result.heapBytes
+      << ",\"packet_pool_hit_rate\":" << result.packetHitRate
+      << ",\"buffer_pool_hit_rate\":" << result.bufferHitRate;
+  if (config.profile)
+    {
+      out << ",\"s1_cycles_per_packet\":"
+          << (result.stagePackets ? double (result.stageCycles) / result.stagePackets : 0);
+    }
+  out << "}";
+  return out.str ();
+}
+
+/// Times lookups in a table with host routes only, half of them hits
+static LpmResult
+RunLpmBench (bool compact, uint32_t routes, uint32_t seed)
+{
+  static const uint32_t LPM_ADDRESSES = 1 << 20;
+  static const uint32_t LPM_ROUNDS = 16;
+
+  LpmResult result;
+  result.compact = compact;
+  result.routes = routes;
+
+  std::mt19937 rng (seed);
+  std::vector<LpmTable::lpm_route> hosts;
+  for (uint32_t i = 0; i < routes; i++)
+    {
+      uint32_t host = (20u << 24) | (rng () & 0xffffff);
+      hosts.push_back ({ host, 32, uint16_t (1 + i % LpmTable::MAX_NEXT_HOP) });
+    }
+  std::vector<uint32_t> addresses (LPM_ADDRESSES);
+  for (uint32_t i = 0; i < LPM_ADDRESSES; i++)
+    {
+      addresses[i] = (i % 2) ? hosts[rng () % routes].prefix : (20u << 24) | (rng () & 0xffffff);
+    }
+
+  int64_t heapBefore = HeapBytes ();
+  LpmTable table;
+  table.SetCompact (compact);
+  table.Insert (hosts);
+  result.heapBytes = HeapBytes () - heapBefore;
+
+  uint64_t found = 0;
+  auto start = std::chrono::steady_clock::now ();
+  for (uint32_t round = 0; round < LPM_ROUNDS; round++)
+    {
+      for (uint32_t addr : addresses)
+        {
+          found += table.Lookup (addr) != LpmTable::NO_ROUTE;
+        }
+    }
+  result.wallSeconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+  result.lookups = uint64_t (LPM_ROUNDS) * LPM_ADDRESSES;
+  NS_ABORT_MSG_IF (found < result.lookups / 2, "Host routes not found");
+  return result;
+}
+
+int main (int argc, char *argv[])
+{
+  BenchConfig config;
+  std::string switches = "Fancy,LossRadar,NetSeer";
+  std::string outFile = "";
+  uint32_t lpmRoutes = 0;
+
+  CommandLine cmd;
+  cmd.Usage ("Benchmark the p4-switch data plane models.\n"
+             "\n"
+             "A synthetic stream of UDP packets crosses two switches of every\n"
+             "selected type. Flows are picked with a Zipf distribution and a\n"
+             "fraction of them is blackholed at the first switch.");
+  cmd.AddValue ("switches", "comma separated switch types (Fancy,LossRadar,NetSeer)", switches);
+  cmd.AddValue ("flows", "number of flows", config.flows);
+  cmd.AddValue ("packets", "number of data packets", config.packets);
+  cmd.AddValue ("rate", "data packets per simulated second", config.rate);
+  cmd.AddValue ("size", "packet size in bytes", config.size);
+  cmd.AddValue ("zipf", "Zipf skew of the flow popularity (0 = uniform)", config.zipf);
+  cmd.AddValue ("loss", "fraction of the flows blackholed at s1", config.loss);
+  cmd.AddValue ("drop-rate", "drop probability of the blackholed flows packets", config.dropRate);
+  cmd.AddValue ("seed", "random seed", config.seed);
+  cmd.AddValue ("profile", "collect the per stage cycles of s1", config.profile);
+  cmd.AddValue ("label", "free text copied to the results", config.label);
+  cmd.AddValue ("multithreaded", "run each switch in a partition of the multithreaded simulator",
+                config.multithreaded);
+  cmd.AddValue ("tree-depth", "Fancy tree depth", config.treeDepth);
+  cmd.AddValue ("layer-split", "Fancy layer split", config.layerSplit);
+  cmd.AddValue ("counter-width", "Fancy counters per tree cell", config.counterWidth);
+  cmd.AddValue ("top-entries", "Fancy dedicated counter entries", config.topEntries);
+  cmd.AddValue ("lr-cells", "LossRadar cells per port and batch", config.lossRadarCells);
+  cmd.AddValue ("ns-cells", "NetSeer ring buffer cells", config.netSeerCells);
+  cmd.AddValue ("ns-cache", "NetSeer event cache size", config.eventCacheSize);
+  cmd.AddValue ("out", "file the results are appended to, one JSON object per line", outFile);
+  cmd.AddValue ("lpm-routes", "also time L3 table lookups with this many host routes (0 = skip)",
+                lpmRoutes);
+  cmd.Parse (argc, argv);
+
+  NS_ABORT_MSG_IF (config.flows == 0 || config.packets == 0, "Need at least one flow and packet");
+  NS_ABORT_MSG_IF (config.size < 28, "Packets need room for the IPv4 and UDP headers");
+  NS_ABORT_MSG_IF (config.topEntries > config.flows, "More top entries than flows");
+#ifndef NS3_MULTITHREADING
+  NS_ABORT_MSG_IF (config.multithreaded, "The multithreaded simulator needs --enable-multithreading");
+#endif
+
+  /* Globals the switches expect */
+  static GlobalValue g_switchId = GlobalValue ("switchId", "Global Switch Id", UintegerValue (1),
+                                               MakeUintegerChecker<uint8_t> ());
+  static GlobalValue g_debugGlobal = GlobalValue ("debugGlobal", "Is debug globally enabled?",
+                                                  BooleanValue (false), MakeBooleanChecker ());
+  Config::SetDefault ("ns3::P4SwitchNetDevice::ForwardingType",
+                      EnumValue (P4SwitchNetDevice::ForwardingType::L3_SPECIAL_FORWARDING));
+  Config::SetDefault ("ns3::CsmaChannel::FullDuplex", BooleanValue (true));
+  Time::SetResolution (Time::PS);
+
+  /* Fancy dedicated entries are the most popular flows */
+  std::string topFile = (std::filesystem::temp_directory_path () /
+                         ("bench-p4-switch-" + std::to_string (getpid ()) + ".top")).string ();
+  {
+    std::ofstream top (topFile);
+    for (uint32_t i = 0; i < config.topEntries; i++)
+      {
+        top << FlowDestination (i) << "\n";
+      }
+  }
+
+  std::vector<BenchResult> results;
+  std::stringstream types (switches);
+  std::string switchType;
+  while (std::getline (types, switchType, ','))
+    {
+      results.push_back (RunBench (switchType, config, topFile));
+    }
+  std::filesystem::remove (topFile);
+
+  std::cout << std::endl << std::left << std::setw (12) << "switch" << std::right
+            << std::setw (12) << "packets" << std::setw (12) << "delivered"
+            << std::setw (14) << "pkt/s" << std::setw (12) << "ns/pkt"
+            << std::setw (14) << "heap KiB" << std::setw (10) << "pkt hit"
+            << std::setw (10) << "buf hit" << std::endl;
+  for (auto const &result : results)
+    {
+      std::cout << std::left << std::setw (12) << result.switchType << std::right
+                << std::setw (12) << result.sent << std::setw (12) << result.delivered
+                << std::setw (14) << std::fixed << std::setprecision (0) << result.sent / result.wallSeconds
+                << std::setw (12) << std::setprecision (1) << 1e9 * result.wallSeconds / result.sent
+                << std::setw (14) << result.heapBytes / 1024
+                << std::setw (10) << std::setprecision (3) << result.packetHitRate
+                << std::setw (10) << result.bufferHitRate << std::endl;
+    }
+
+  if (outFile != "")
+    {
+      std::ofstream out (outFile, std::ios::out | std::ios::app);
+      for (auto const &result : results)
+        {
+          out << ResultToJson (result, config) << "\n";
+        }
+    }
+
+  if (lpmRoutes > 0)
+    {
+      std::cout << std::endl << std::left << std::setw (12) << "L3 table" << std::right
+                << std::setw (12) << "routes" << std::setw (14) << "lookups"
+                << std::setw (12) << "ns/lookup" << std::setw (14) << "heap KiB" << std::endl;
+      for (bool compact : { false, true })
+        {
+          LpmResult result = RunLpmBench (compact, lpmRoutes, config.seed);
+          std::cout << std::left << std::setw (12) << (compact ? "compact" : "tbl24") << std::right
+                    << std::setw (12) << result.routes << std::setw (14) << result.lookups
+                    << std::setw (12) << std::fixed << std::setprecision (2)
+                    << 1e9 * result.wallSeconds / result.lookups
+                    << std::setw (14) << result.heapBytes / 1024 << std::endl;
+        }
+    }
+
+  return 0;
+}
@@ -0,0 +1,73 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// This program rebuilds the single JSON document of a switch simulation
+// state ({"failures": [...], ...}) from the NDJSON file streamed during
+// the run, for the tools that still expect the old layout. The switches
+// only stream: the conversion runs once the simulation is over, one
+// record at a time.
+// Sample usage:  ./waf --run 'p4-switch-state-to-json --in=output/run_s1.ndjson --type=Fancy'
+
+#include "ns3/core-module.h"
+#include "ns3/p4-switch-utils.h"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+using namespace ns3;
+
+int main (int argc, char *argv[])
+{
+  std::string inFile = "";
+  std::string outFile = "";
+  std::string switchType = "Fancy";
+
+  CommandLine cmd;
+  cmd.Usage ("Rebuild the JSON document of a p4-switch simulation state from its NDJSON stream.");
+  cmd.AddValue ("in", "streamed simulation state (.ndjson)", inFile);
+  cmd.AddValue ("out", "document to write, the input name with a .json extension by default", outFile);
+  cmd.AddValue ("type", "switch type that wrote the state (Fancy,LossRadar,NetSeer)", switchType);
+  cmd.Parse (argc, argv);
+
+  NS_ABORT_MSG_IF (inFile.empty (), "Provide the streamed state with --in");
+  if (outFile.empty ())
+    {
+      outFile = std::filesystem::path (inFile).replace_extension (".json").string ();
+    }
+  NS_ABORT_MSG_IF (outFile == inFile, "The document would overwrite the stream " << inFile);
+
+  std::vector<std::string> collections;
+  if (switchType == "Fancy")
+    {
+      collections = FancySimulationState::GetCollections ();
+    }
+  else if (switchType == "LossRadar")
+    {
+      collections = LossRadarSimulationState::GetCollections ();
+    }
+  else if (switchType == "NetSeer")
+    {
+      collections = NetSeerSimulationState::GetCollections ();
+    }
+  else
+    {
+      NS_ABORT_MSG ("Unknown switch type " << switchType);
+    }
+
+  ConvertSimulationStateToJson (inFile, outFile, collections);
+  return 0;
+}